@@ -35,8 +35,8 @@ namespace EntityMapping {
 
 namespace Cases {
 
-AttributeCase::AttributeCase(AttributeComparers::AttributeComparerWrapper* comparerWrapper)
-: mComparerWrapper(std::unique_ptr<AttributeComparers::AttributeComparerWrapper>(comparerWrapper))
+AttributeCase::AttributeCase(std::shared_ptr<const AttributeComparers::AttributeComparerWrapper> comparerWrapper)
+: mComparerWrapper(std::move(comparerWrapper))
 {
 }
 
@@ -59,11 +59,15 @@ namespace Cases {
 class AttributeCase : public Case<Matches::AttributeMatch>
 {
 public:
-	explicit AttributeCase(AttributeComparers::AttributeComparerWrapper* comparerWrapper);
+	/**
+	 * @brief Ctor.
+	 * @param comparerWrapper The comparer to test the attribute with. Unless it depends on the entity it's shared with all other entities using the same mapping definition.
+	 */
+	explicit AttributeCase(std::shared_ptr<const AttributeComparers::AttributeComparerWrapper> comparerWrapper);
 	bool testMatch(const Atlas::Message::Element& attribute);
 
 protected:
-	std::unique_ptr<AttributeComparers::AttributeComparerWrapper> mComparerWrapper;
+	std::shared_ptr<const AttributeComparers::AttributeComparerWrapper> mComparerWrapper;
 };
 
 }
@@ -47,7 +47,7 @@ public:
 	/**
 	Test the attribute.
 	*/
-	virtual bool testAttribute(const Atlas::Message::Element& attribute) = 0;
+	virtual bool testAttribute(const Atlas::Message::Element& attribute) const = 0;
 };
 
 }
@@ -28,6 +28,8 @@
 #include "NumericComparer.h"
 #include <Eris/Entity.h>
 
+#include <utility>
+
 namespace Ember {
 
 
@@ -38,12 +40,12 @@ namespace Cases {
 
 namespace AttributeComparers {
 
-HeightComparerWrapper::HeightComparerWrapper(NumericComparer* comparer, Eris::Entity& entity)
-: mNumericComparer(comparer), mEntity(entity)
+HeightComparerWrapper::HeightComparerWrapper(std::shared_ptr<const NumericComparer> comparer, Eris::Entity& entity)
+: mNumericComparer(std::move(comparer)), mEntity(entity)
 {
 }
 
-bool HeightComparerWrapper::testAttribute(const Atlas::Message::Element&)
+bool HeightComparerWrapper::testAttribute(const Atlas::Message::Element&) const
 {
 	return mEntity.hasBBox() && (mNumericComparer->test(mEntity.getBBox().upperBound(2) - mEntity.getBBox().lowerBound(2)));
 }
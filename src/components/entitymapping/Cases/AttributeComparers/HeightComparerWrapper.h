@@ -53,18 +53,18 @@ class HeightComparerWrapper : public AttributeComparerWrapper
 public:
 	/**
 	* Default constructor.
-	* @param comparer The NumericComparer to use for comparison.
+	* @param comparer The NumericComparer to use for comparison. This is shared with all other entities using the same mapping definition.
 	* @param entity
 	*/
-	HeightComparerWrapper(NumericComparer* comparer, Eris::Entity& entity);
+	HeightComparerWrapper(std::shared_ptr<const NumericComparer> comparer, Eris::Entity& entity);
 
 	/**
 	Test the height. The attribute passed will be ignored.
 	*/
-	bool testAttribute(const Atlas::Message::Element& attribute) override;
+	bool testAttribute(const Atlas::Message::Element& attribute) const override;
 
 protected:
-	std::unique_ptr<NumericComparer> mNumericComparer;
+	std::shared_ptr<const NumericComparer> mNumericComparer;
 	Eris::Entity& mEntity;
 };
 }
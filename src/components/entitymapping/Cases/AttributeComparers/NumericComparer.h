@@ -46,7 +46,7 @@ public:
 	Test the supplied value.
 	@param value The value to test.
 	*/
-	virtual bool test(float value) = 0;
+	virtual bool test(float value) const = 0;
 
 protected:
 };
@@ -42,7 +42,7 @@ NumericComparerWrapper::NumericComparerWrapper(NumericComparer* comparer)
 {
 }
 
-bool NumericComparerWrapper::testAttribute(const Atlas::Message::Element& attribute)
+bool NumericComparerWrapper::testAttribute(const Atlas::Message::Element& attribute) const
 {
  	if (attribute.isNum()) {
 		return mNumericComparer->test(attribute.asNum());
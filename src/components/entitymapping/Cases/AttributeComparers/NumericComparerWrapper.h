@@ -47,7 +47,7 @@ class NumericComparerWrapper : public AttributeComparerWrapper
 public:
 	explicit NumericComparerWrapper(NumericComparer* comparer);
 
-	bool testAttribute(const Atlas::Message::Element& attribute) override;
+	bool testAttribute(const Atlas::Message::Element& attribute) const override;
 private:
 	std::unique_ptr<NumericComparer> mNumericComparer;
 };
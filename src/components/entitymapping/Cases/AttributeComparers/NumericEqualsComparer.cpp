@@ -41,7 +41,7 @@ NumericEqualsComparer::NumericEqualsComparer(float value) : NumericValueHolder(v
 {
 }
 
-bool NumericEqualsComparer::test(float value)
+bool NumericEqualsComparer::test(float value) const
 {
 	return WFMath::Equal(value, mValue);
 }
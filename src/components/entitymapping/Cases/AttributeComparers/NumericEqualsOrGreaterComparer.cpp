@@ -40,7 +40,7 @@ NumericEqualsOrGreaterComparer::NumericEqualsOrGreaterComparer(float value) : Nu
 {
 }
 
-bool NumericEqualsOrGreaterComparer::test(float value)
+bool NumericEqualsOrGreaterComparer::test(float value) const
 {
 	return value >= mValue ;
 }
@@ -48,7 +48,7 @@ public:
 	/**
 	Returns true if the supplied value is equal or greater than the held value.
 	*/
-	bool test(float value) override;
+	bool test(float value) const override;
 
 protected:
 };
@@ -40,7 +40,7 @@ NumericEqualsOrLesserComparer::NumericEqualsOrLesserComparer(float value) : Nume
 {
 }
 
-bool NumericEqualsOrLesserComparer::test(float value)
+bool NumericEqualsOrLesserComparer::test(float value) const
 {
 	return value <= mValue;
 }
@@ -49,7 +49,7 @@ public:
 	/**
 	Returns true if the supplied value is equal or lesser than the held value.
 	*/
-	bool test(float value) override;
+	bool test(float value) const override;
 
 protected:
 };
@@ -40,7 +40,7 @@ NumericGreaterComparer::NumericGreaterComparer(float value) : NumericValueHolder
 {
 }
 
-bool NumericGreaterComparer::test(float value)
+bool NumericGreaterComparer::test(float value) const
 {
 	return value > mValue;
 }
@@ -40,7 +40,7 @@ NumericLesserComparer::NumericLesserComparer(float value) : NumericValueHolder(v
 {
 }
 
-bool NumericLesserComparer::test(float value)
+bool NumericLesserComparer::test(float value) const
 {
 	return value < mValue;
 }
@@ -42,7 +42,7 @@ NumericRangeComparer::NumericRangeComparer(NumericComparer* minComparer, Numeric
 }
 
 
-bool NumericRangeComparer::test(float value)
+bool NumericRangeComparer::test(float value) const
 {
 	return mMinComparer->test(value) && mMaxComparer->test(value);
 }
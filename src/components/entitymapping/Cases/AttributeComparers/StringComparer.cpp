@@ -41,12 +41,12 @@ StringValueComparer::StringValueComparer(std::string value)
 		: mValue(std::move(value)) {
 }
 
-bool StringValueComparer::test(const std::string& value) {
+bool StringValueComparer::test(const std::string& value) const {
 	return mValue == value;
 }
 
 
-bool StringNotEmptyComparer::test(const std::string& value) {
+bool StringNotEmptyComparer::test(const std::string& value) const {
 	return !value.empty();
 }
 }
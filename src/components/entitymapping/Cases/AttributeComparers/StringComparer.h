@@ -41,11 +41,13 @@ namespace AttributeComparers {
 class StringComparer {
 public:
 
+	virtual ~StringComparer() = default;
+
 	/**
 	Returns true if the supplied value equals the stored value. The comparison is case sensitive.
 	@param value
 	*/
-	virtual bool test(const std::string& value) = 0;
+	virtual bool test(const std::string& value) const = 0;
 
 };
 
@@ -56,7 +58,7 @@ class StringValueComparer : public StringComparer {
 public:
 	explicit StringValueComparer(std::string value);
 
-	bool test(const std::string& value) override;
+	bool test(const std::string& value) const override;
 
 protected:
 	std::string mValue;
@@ -69,7 +71,7 @@ protected:
 class StringNotEmptyComparer : public StringComparer {
 public:
 
-	bool test(const std::string& value) override;
+	bool test(const std::string& value) const override;
 
 };
 }
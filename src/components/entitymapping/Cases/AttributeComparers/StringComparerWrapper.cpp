@@ -42,7 +42,7 @@ StringComparerWrapper::StringComparerWrapper(StringComparer* comparer)
 {
 }
 
-bool StringComparerWrapper::testAttribute(const Atlas::Message::Element& attribute)
+bool StringComparerWrapper::testAttribute(const Atlas::Message::Element& attribute) const
 {
 	return attribute.isString() && mStringComparer->test(attribute.String());
 }
@@ -48,7 +48,7 @@ class StringComparerWrapper : public AttributeComparerWrapper
 public:
 	explicit StringComparerWrapper(StringComparer* comparer);
 
-	bool testAttribute(const Atlas::Message::Element& attribute) override;
+	bool testAttribute(const Atlas::Message::Element& attribute) const override;
 private:
 	std::unique_ptr<StringComparer> mStringComparer;
 };
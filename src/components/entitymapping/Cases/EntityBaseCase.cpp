@@ -52,9 +52,9 @@ bool EntityBaseCase::testMatch(Eris::Entity* entity)
 	return false;
 }
 
-void EntityBaseCase::addEntityType(Eris::TypeInfoPtr typeInfo)
+EntityBaseCase::EntityBaseCase(const std::vector<Eris::TypeInfo*>& entityTypes)
+: mEntityTypes(entityTypes)
 {
-	mEntityTypes.push_back(typeInfo);
 }
 
 
@@ -48,17 +48,18 @@ class EntityBaseCase
 {
 public:
 
+	/**
+	 * @brief Ctor.
+	 * @param entityTypes The valid entity types. These are owned by the compiled mapping definition, and shared with all other entities using it.
+	 */
+	explicit EntityBaseCase(const std::vector<Eris::TypeInfo*>& entityTypes);
+
 	virtual ~EntityBaseCase() = default;
 
 	bool testMatch(Eris::Entity* entity);
 
-	/**
-	Adds an entity type to the list of valid entity types for this instance.
-	*/
-	void addEntityType(Eris::TypeInfo* typeInfo);
-
 protected:
-	std::vector<Eris::TypeInfo*> mEntityTypes;
+	const std::vector<Eris::TypeInfo*>& mEntityTypes;
 	virtual void _setState(bool state) = 0;
 };
 
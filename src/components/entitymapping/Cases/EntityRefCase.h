@@ -35,7 +35,7 @@ namespace Cases {
 class EntityRefCase : public Case<Matches::EntityRefMatch>, public EntityBaseCase
 {
 public:
-	EntityRefCase() = default;;
+	explicit EntityRefCase(const std::vector<Eris::TypeInfo*>& entityTypes) : EntityBaseCase(entityTypes) {}
 	~EntityRefCase() override = default;;
 protected:
 	void _setState(bool state) override;
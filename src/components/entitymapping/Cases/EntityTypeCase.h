@@ -54,6 +54,7 @@ namespace Cases {
 class EntityTypeCase : public Case<Matches::EntityTypeMatch>, public EntityBaseCase
 {
 public:
+	explicit EntityTypeCase(const std::vector<Eris::TypeInfo*>& entityTypes) : EntityBaseCase(entityTypes) {}
 
 protected:
 	void _setState(bool state) override;
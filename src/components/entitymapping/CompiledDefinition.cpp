@@ -0,0 +1,201 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "CompiledDefinition.h"
+
+#include "Definitions/EntityMappingDefinition.h"
+
+#include "Cases/AttributeComparers/NumericComparerWrapper.h"
+#include "Cases/AttributeComparers/NumericEqualsComparer.h"
+#include "Cases/AttributeComparers/NumericEqualsOrGreaterComparer.h"
+#include "Cases/AttributeComparers/NumericEqualsOrLesserComparer.h"
+#include "Cases/AttributeComparers/NumericGreaterComparer.h"
+#include "Cases/AttributeComparers/NumericLesserComparer.h"
+#include "Cases/AttributeComparers/NumericRangeComparer.h"
+#include "Cases/AttributeComparers/StringComparer.h"
+#include "Cases/AttributeComparers/StringComparerWrapper.h"
+
+#include <Eris/TypeService.h>
+
+namespace Ember {
+
+namespace EntityMapping {
+
+using namespace Definitions;
+using namespace Cases::AttributeComparers;
+
+namespace {
+
+const CaseDefinition::ParameterEntry* findCaseParameter(const CaseDefinition::ParameterStore& parameters, const std::string& type) {
+	for (auto& entry : parameters) {
+		if (entry.first == type) {
+			return &(entry);
+		}
+	}
+	return nullptr;
+}
+
+const std::string& findProperty(const DefinitionBase::PropertiesMap& properties, const std::string& key) {
+	static const std::string empty;
+	auto I = properties.find(key);
+	if (I != properties.end()) {
+		return I->second;
+	}
+	return empty;
+}
+
+}
+
+const std::vector<std::string> CompiledDefinition::HeightAttributes{"bbox", "scale"};
+
+CompiledDefinition::CompiledDefinition(EntityMappingDefinition& definition, Eris::TypeService& typeService) {
+	mCases.emplace_back();
+	mCases.front().definition = &definition.getRoot();
+	compileMatches(0, definition.getRoot(), typeService);
+}
+
+void CompiledDefinition::compileMatches(size_t caseIndex, CaseDefinition& caseDefinition, Eris::TypeService& typeService) {
+	for (auto& matchDefinition : caseDefinition.getMatches()) {
+		compileMatch(caseIndex, matchDefinition, typeService);
+	}
+}
+
+void CompiledDefinition::compileMatch(size_t caseIndex, MatchDefinition& matchDefinition, Eris::TypeService& typeService) {
+	const auto& properties = static_cast<const MatchDefinition&>(matchDefinition).getProperties();
+	const std::string& comparisonType = findProperty(properties, "type");
+
+	Match match;
+	if (matchDefinition.getType() == "attribute") {
+		match.attributeName = findProperty(properties, "attribute");
+		if (comparisonType == "function") {
+			//"height" is the only function available.
+			if (match.attributeName != "height") {
+				return;
+			}
+			match.type = MatchType::Height;
+		} else {
+			match.type = MatchType::Attribute;
+		}
+	} else if (matchDefinition.getType() == "entitytype") {
+		match.type = MatchType::EntityType;
+	} else if (matchDefinition.getType() == "entityref") {
+		match.type = MatchType::EntityRef;
+		match.attributeName = findProperty(properties, "attribute");
+	} else {
+		return;
+	}
+
+	//Indices are used since the tables will grow while compiling the child matches.
+	size_t matchIndex = mMatches.size();
+	mMatches.push_back(std::move(match));
+	mCases[caseIndex].matches.push_back(matchIndex);
+
+	for (auto& caseDefinition : matchDefinition.getCases()) {
+		Case compiledCase;
+		compiledCase.definition = &caseDefinition;
+
+		switch (mMatches[matchIndex].type) {
+			case MatchType::Attribute:
+				compiledCase.comparer = createAttributeComparer(comparisonType, caseDefinition);
+				if (!compiledCase.comparer) {
+					continue;
+				}
+				break;
+			case MatchType::Height:
+				compiledCase.heightComparer.reset(createNumericComparer(caseDefinition));
+				if (!compiledCase.heightComparer) {
+					continue;
+				}
+				break;
+			case MatchType::EntityType:
+			case MatchType::EntityRef:
+				for (auto& paramEntry : caseDefinition.getCaseParameters()) {
+					if (paramEntry.first == "equals") {
+						compiledCase.entityTypes.push_back(typeService.getTypeByName(paramEntry.second));
+					}
+				}
+				break;
+		}
+
+		size_t childCaseIndex = mCases.size();
+		mCases.push_back(std::move(compiledCase));
+		mMatches[matchIndex].cases.push_back(childCaseIndex);
+
+		compileMatches(childCaseIndex, caseDefinition, typeService);
+	}
+}
+
+std::shared_ptr<const AttributeComparerWrapper> CompiledDefinition::createAttributeComparer(const std::string& comparisonType, CaseDefinition& caseDefinition) {
+	if ((comparisonType.empty()) || (comparisonType == "string")) {
+		//default is string comparison
+		if (auto param = findCaseParameter(caseDefinition.getCaseParameters(), "equals")) {
+			return std::make_shared<StringComparerWrapper>(new StringValueComparer(param->second));
+		} else if (findCaseParameter(caseDefinition.getCaseParameters(), "notempty")) {
+			return std::make_shared<StringComparerWrapper>(new StringNotEmptyComparer());
+		} else {
+			return std::make_shared<StringComparerWrapper>(new StringValueComparer(""));
+		}
+	} else if (comparisonType == "numeric") {
+		if (auto comparer = createNumericComparer(caseDefinition)) {
+			return std::make_shared<NumericComparerWrapper>(comparer);
+		}
+	}
+	return nullptr;
+}
+
+NumericComparer* CompiledDefinition::createNumericComparer(CaseDefinition& caseDefinition) {
+	const CaseDefinition::ParameterEntry* param(nullptr);
+
+	if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "equals"))) {
+		return new NumericEqualsComparer(std::stof(param->second));
+	}
+
+	//If both a min and max value is set, it's a range comparer
+	NumericComparer* mMin(nullptr);
+	NumericComparer* mMax(nullptr);
+	if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "lesser"))) {
+		mMin = new NumericLesserComparer(std::stof(param->second));
+	} else if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "lesserequals"))) {
+		mMin = new NumericEqualsOrLesserComparer(std::stof(param->second));
+	}
+
+	if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "greater"))) {
+		mMax = new NumericGreaterComparer(std::stof(param->second));
+	} else if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "greaterequals"))) {
+		mMax = new NumericEqualsOrGreaterComparer(std::stof(param->second));
+	}
+
+	//check if we have both min and max set, and if so we should use a range comparer
+	if (mMin && mMax) {
+		return new NumericRangeComparer(mMin, mMax);
+	} else if (!mMax && mMin) {
+		return mMin;
+	} else if (mMax) {
+		return mMax;
+	}
+	//invalid, could not find anything to compare against
+	return nullptr;
+}
+
+}
+
+}
@@ -0,0 +1,213 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef EMBER_ENTITYMAPPING_COMPILEDDEFINITION_H
+#define EMBER_ENTITYMAPPING_COMPILEDDEFINITION_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Eris
+{
+class TypeInfo;
+class TypeService;
+}
+
+namespace Ember {
+
+namespace EntityMapping {
+
+namespace Definitions {
+class CaseDefinition;
+class EntityMappingDefinition;
+class MatchDefinition;
+}
+
+namespace Cases {
+namespace AttributeComparers {
+class AttributeComparerWrapper;
+class NumericComparer;
+}
+}
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief An EntityMappingDefinition compiled into flat tables, which are shared by all entities using the definition.
+ *
+ * Everything in an EntityMapping which only depends on the definition is resolved here once, instead of for every entity:
+ * the kind of each match, the attribute names, the entity types of each case (looked up in the type service) and the
+ * comparers of each attribute case (with their parameters parsed).
+ *
+ * The tables are immutable once compiled. Each EntityMapping keeps the instance it was created from alive, since its
+ * matches and cases refer directly to the attribute names, entity type lists and comparers held here.
+ *
+ * Matches and cases refer to each other through indices into the tables. The first case is the root case.
+ */
+class CompiledDefinition
+{
+public:
+
+	/**
+	 * @brief The kinds of matches.
+	 */
+	enum class MatchType
+	{
+		/**
+		 * @brief Compares the value of an attribute.
+		 */
+		Attribute,
+
+		/**
+		 * @brief Compares the height of the entity, as calculated from its bounding box.
+		 */
+		Height,
+
+		/**
+		 * @brief Checks the type of the entity.
+		 */
+		EntityType,
+
+		/**
+		 * @brief Checks the type of an entity referred to by an attribute.
+		 */
+		EntityRef
+	};
+
+	struct Case
+	{
+		/**
+		 * @brief The definition, from which actions are created.
+		 */
+		Definitions::CaseDefinition* definition;
+
+		/**
+		 * @brief The comparer of an attribute case.
+		 */
+		std::shared_ptr<const Cases::AttributeComparers::AttributeComparerWrapper> comparer;
+
+		/**
+		 * @brief The comparer of a height case. Since the height depends on the entity, each entity wraps this in its own comparer.
+		 */
+		std::shared_ptr<const Cases::AttributeComparers::NumericComparer> heightComparer;
+
+		/**
+		 * @brief The valid types of an entity type or entity ref case.
+		 */
+		std::vector<Eris::TypeInfo*> entityTypes;
+
+		/**
+		 * @brief The indices of the child matches.
+		 */
+		std::vector<size_t> matches;
+	};
+
+	struct Match
+	{
+		MatchType type;
+
+		/**
+		 * @brief The name of the attribute of attribute, height and entity ref matches.
+		 */
+		std::string attributeName;
+
+		/**
+		 * @brief The indices of the cases.
+		 */
+		std::vector<size_t> cases;
+	};
+
+	/**
+	 * @brief The attributes which the height of an entity depends on.
+	 */
+	static const std::vector<std::string> HeightAttributes;
+
+	/**
+	 * @brief Ctor.
+	 * @param definition The definition to compile. This must outlive the compiled definition, and not be changed.
+	 * @param typeService The type service in which entity types are looked up.
+	 */
+	CompiledDefinition(Definitions::EntityMappingDefinition& definition, Eris::TypeService& typeService);
+
+	/**
+	 * @brief Gets the root case, which is always true.
+	 */
+	const Case& getRootCase() const;
+
+	const std::vector<Case>& getCases() const;
+
+	const std::vector<Match>& getMatches() const;
+
+private:
+
+	std::vector<Case> mCases;
+
+	std::vector<Match> mMatches;
+
+	/**
+	 * @brief Compiles the child matches of a case.
+	 * @param caseIndex The index of the compiled case.
+	 * @param caseDefinition The definition of the case.
+	 * @param typeService The type service.
+	 */
+	void compileMatches(size_t caseIndex, Definitions::CaseDefinition& caseDefinition, Eris::TypeService& typeService);
+
+	/**
+	 * @brief Compiles a match and all of its cases.
+	 * @param caseIndex The index of the compiled case which the match belongs to.
+	 * @param matchDefinition The definition of the match.
+	 * @param typeService The type service.
+	 */
+	void compileMatch(size_t caseIndex, Definitions::MatchDefinition& matchDefinition, Eris::TypeService& typeService);
+
+	/**
+	 * @brief Creates a comparer for an attribute case.
+	 * @param comparisonType The "type" property of the match; "string", "numeric" or empty (meaning "string").
+	 * @param caseDefinition The definition of the case.
+	 * @return A comparer, or null if the case is invalid.
+	 */
+	static std::shared_ptr<const Cases::AttributeComparers::AttributeComparerWrapper> createAttributeComparer(const std::string& comparisonType, Definitions::CaseDefinition& caseDefinition);
+
+	/**
+	 * @brief Creates a numeric comparer for a case.
+	 * @param caseDefinition The definition of the case.
+	 * @return A comparer, or null if the case has no valid parameters.
+	 */
+	static Cases::AttributeComparers::NumericComparer* createNumericComparer(Definitions::CaseDefinition& caseDefinition);
+};
+
+inline const CompiledDefinition::Case& CompiledDefinition::getRootCase() const
+{
+	return mCases.front();
+}
+
+inline const std::vector<CompiledDefinition::Case>& CompiledDefinition::getCases() const
+{
+	return mCases;
+}
+
+inline const std::vector<CompiledDefinition::Match>& CompiledDefinition::getMatches() const
+{
+	return mMatches;
+}
+
+}
+
+}
+
+#endif
@@ -33,7 +33,9 @@ namespace Ember {
 namespace EntityMapping {
 
 
-EntityMapping::EntityMapping(Eris::Entity& entity) : mEntity(entity) {
+EntityMapping::EntityMapping(Eris::Entity& entity, std::shared_ptr<const CompiledDefinition> definition) :
+		mDefinition(std::move(definition)),
+		mEntity(entity) {
 	mBaseCase.setState(true);
 }
 
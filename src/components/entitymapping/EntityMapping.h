@@ -37,6 +37,7 @@
 #include <Eris/Entity.h>
 
 #include "Matches/EntityTypeMatch.h"
+#include "CompiledDefinition.h"
 
 
 namespace Eris {
@@ -111,6 +112,8 @@ static void cleanVector(T& theVector) {
 
 	These elements are arranged in a node tree structure, contained by the EntityMapping. The EntityMapping is self contained and uses it's own oberservers to watch for changes in the values that will result in changes. At the top of the node tree is an EntityTypeMatch instance, held directly by the EntityMapping. From this instance's Cases the framework determines what EntityMapping to use for a certain Eris::Type.
 
+	The parts of the tree which only depend on the definition, such as the comparers, entity types and attribute names, are held by a CompiledDefinition which is shared by all mappings created from the same definition.
+
 	Instances of this class are normally not created directly by the application, instead EntityMappingManager::createMapping(...) is used.
 
 	@author Erik Ogenvik <erik@ogenvik.org>
@@ -118,7 +121,12 @@ static void cleanVector(T& theVector) {
 class EntityMapping {
 public:
 
-	explicit EntityMapping(Eris::Entity& entity);
+	/**
+	 * @brief Ctor.
+	 * @param entity The entity.
+	 * @param definition The compiled definition which the mapping is created from.
+	 */
+	EntityMapping(Eris::Entity& entity, std::shared_ptr<const CompiledDefinition> definition);
 
 	~EntityMapping() = default;
 
@@ -135,6 +143,12 @@ public:
 
 protected:
 
+	/**
+	 * @brief The compiled definition, which the matches and cases refer to.
+	 * This must be declared before the base case, so that it's destroyed after it.
+	 */
+	std::shared_ptr<const CompiledDefinition> mDefinition;
+
 	Cases::CaseBase mBaseCase;
 
 	Eris::Entity& mEntity;
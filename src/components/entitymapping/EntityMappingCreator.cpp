@@ -26,22 +26,11 @@
 
 #include "EntityMappingCreator.h"
 #include "EntityMapping.h"
-#include "EntityMappingManager.h"
 
-#include "components/entitymapping/Cases/EntityRefCase.h"
+#include "Cases/EntityRefCase.h"
 #include "Cases/AttributeCase.h"
 
 #include "Cases/AttributeComparers/HeightComparerWrapper.h"
-#include "Cases/AttributeComparers/NumericComparer.h"
-#include "Cases/AttributeComparers/NumericComparerWrapper.h"
-#include "Cases/AttributeComparers/NumericEqualsComparer.h"
-#include "Cases/AttributeComparers/NumericEqualsOrGreaterComparer.h"
-#include "Cases/AttributeComparers/NumericEqualsOrLesserComparer.h"
-#include "Cases/AttributeComparers/NumericGreaterComparer.h"
-#include "Cases/AttributeComparers/NumericLesserComparer.h"
-#include "Cases/AttributeComparers/NumericRangeComparer.h"
-#include "Cases/AttributeComparers/StringComparer.h"
-#include "Cases/AttributeComparers/StringComparerWrapper.h"
 
 #include "Matches/Observers/EntityCreationObserver.h"
 #include "Matches/VirtualAttributeMatch.h"
@@ -49,32 +38,23 @@
 
 #include "IActionCreator.h"
 
+#include <utility>
+
 namespace Ember {
 
 
 namespace EntityMapping {
 
-using namespace Definitions;
 using namespace Matches;
 using namespace Observers;
 using namespace Cases;
 using namespace AttributeComparers;
 
-static const CaseDefinition::ParameterEntry* findCaseParameter(const CaseDefinition::ParameterStore& parameters, const std::string& type) {
-	for (auto& entry : parameters) {
-		if (entry.first == type) {
-			return &(entry);
-		}
-	}
-	return nullptr;
-}
-
-EntityMappingCreator::EntityMappingCreator(EntityMappingDefinition& definition, Eris::Entity& entity, IActionCreator& actionCreator, Eris::TypeService& typeService, Eris::View* view)
+EntityMappingCreator::EntityMappingCreator(std::shared_ptr<const CompiledDefinition> definition, Eris::Entity& entity, IActionCreator& actionCreator, Eris::View* view)
 		: mActionCreator(actionCreator),
 		  mEntity(entity),
 		  mEntityMapping(nullptr),
-		  mDefinition(definition),
-		  mTypeService(typeService),
+		  mDefinition(std::move(definition)),
 		  mView(view) {
 }
 
@@ -85,198 +65,101 @@ EntityMapping* EntityMappingCreator::create() {
 
 
 EntityMapping* EntityMappingCreator::createMapping() {
-	mEntityMapping = new EntityMapping(mEntity);
-
-	mActionCreator.createActions(*mEntityMapping, &mEntityMapping->getBaseCase(), mDefinition.getRoot());
+	mEntityMapping = new EntityMapping(mEntity, mDefinition);
 
-	for (auto& aMatch : mDefinition.getRoot().getMatches()) {
-		addMatch(&mEntityMapping->getBaseCase(), aMatch);
-	}
+	populateCase(&mEntityMapping->getBaseCase(), mDefinition->getRootCase());
 
 	//since we already have the entity, we can perform a check right away
 	mEntityMapping->getBaseCase().setEntity(&mEntity);
 	return mEntityMapping;
 }
 
-void EntityMappingCreator::addEntityTypeCases(EntityTypeMatch* entityTypeMatch, MatchDefinition& matchDefinition) {
-
-	for (auto& aCase : matchDefinition.getCases()) {
-		auto* entityCase = new EntityTypeCase();
-
-		for (auto& paramEntry : aCase.getCaseParameters()) {
-			if (paramEntry.first == "equals") {
-				entityCase->addEntityType(mTypeService.getTypeByName(paramEntry.second));
-			}
-		}
-
-		mActionCreator.createActions(*mEntityMapping, entityCase, aCase);
-
-		for (auto& aMatch : aCase.getMatches()) {
-			addMatch(entityCase, aMatch);
+void EntityMappingCreator::populateCase(CaseBase* aCase, const CompiledDefinition::Case& compiledCase) {
+	mActionCreator.createActions(*mEntityMapping, aCase, *compiledCase.definition);
+
+	auto& matches = mDefinition->getMatches();
+	for (auto matchIndex : compiledCase.matches) {
+		auto& match = matches[matchIndex];
+		switch (match.type) {
+			case CompiledDefinition::MatchType::Attribute:
+				addAttributeMatch(aCase, match);
+				break;
+			case CompiledDefinition::MatchType::Height:
+				addHeightMatch(aCase, match);
+				break;
+			case CompiledDefinition::MatchType::EntityType:
+				addEntityTypeMatch(aCase, match);
+				break;
+			case CompiledDefinition::MatchType::EntityRef:
+				addEntityRefMatch(aCase, match);
+				break;
 		}
-		entityTypeMatch->addCase(entityCase);
-		entityCase->setParentMatch(entityTypeMatch);
 	}
 }
 
-void EntityMappingCreator::addEntityRefCases(EntityRefMatch* match, MatchDefinition& matchDefinition) {
-	for (auto& aCase : matchDefinition.getCases()) {
-		auto* entityRefCase = new EntityRefCase();
-
-		for (auto& paramEntry : aCase.getCaseParameters()) {
-			if (paramEntry.first == "equals") {
-				entityRefCase->addEntityType(mTypeService.getTypeByName(paramEntry.second));
-			}
-		}
-		mActionCreator.createActions(*mEntityMapping, entityRefCase, aCase);
-
-		for (auto& aMatch : aCase.getMatches()) {
-			addMatch(entityRefCase, aMatch);
-		}
-		match->addCase(entityRefCase);
-		entityRefCase->setParentMatch(match);
-	}
-}
-
-
-Cases::AttributeComparers::AttributeComparerWrapper* EntityMappingCreator::getAttributeCaseComparer(AttributeMatch* match, MatchDefinition& matchDefinition, CaseDefinition& caseDefinition) {
-	const std::string& matchType = matchDefinition.getProperties()["type"];
-
-	if ((matchType.empty()) || (matchType == "string")) {
-		//default is string comparison
-		if (auto param = findCaseParameter(caseDefinition.getCaseParameters(), "equals")) {
-			return new AttributeComparers::StringComparerWrapper(new AttributeComparers::StringValueComparer(param->second));
-		} else if (findCaseParameter(caseDefinition.getCaseParameters(), "notempty")) {
-			return new AttributeComparers::StringComparerWrapper(new AttributeComparers::StringNotEmptyComparer());
-		} else {
-			return new AttributeComparers::StringComparerWrapper(new AttributeComparers::StringValueComparer(""));
-		}
-	} else if (matchType == "numeric") {
-		return new AttributeComparers::NumericComparerWrapper(createNumericComparer(caseDefinition));
-	} else if (matchType == "function") {
-		if (match->getAttributeName() == "height") {
-			return new AttributeComparers::HeightComparerWrapper(createNumericComparer(caseDefinition), mEntity);
-		}
+void EntityMappingCreator::addAttributeMatch(CaseBase* aCase, const CompiledDefinition::Match& match) {
+	auto singleMatch = new SingleAttributeMatch(match.attributeName);
+	singleMatch->setMatchAttributeObserver(new MatchAttributeObserver(singleMatch, match.attributeName));
+	aCase->addMatch(singleMatch);
+
+	for (auto caseIndex : match.cases) {
+		auto& compiledCase = mDefinition->getCases()[caseIndex];
+		auto* attrCase = new AttributeCase(compiledCase.comparer);
+		populateCase(attrCase, compiledCase);
+		singleMatch->addCase(attrCase);
+		attrCase->setParentMatch(singleMatch);
 	}
-	return nullptr;
-
 }
 
-AttributeComparers::NumericComparer* EntityMappingCreator::createNumericComparer(CaseDefinition& caseDefinition) {
-	const CaseDefinition::ParameterEntry* param(nullptr);
-
-	if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "equals"))) {
-		return new AttributeComparers::NumericEqualsComparer(std::stof(param->second));
+void EntityMappingCreator::addHeightMatch(CaseBase* aCase, const CompiledDefinition::Match& match) {
+	auto virtualMatch = new VirtualAttributeMatch(match.attributeName, CompiledDefinition::HeightAttributes);
+	for (auto& attributeName : CompiledDefinition::HeightAttributes) {
+		virtualMatch->addMatchAttributeObserver(std::unique_ptr<MatchAttributeObserver>(new MatchAttributeObserver(virtualMatch, attributeName)));
 	}
-
-	//If both a min and max value is set, it's a range comparer
-	AttributeComparers::NumericComparer* mMin(nullptr);
-	AttributeComparers::NumericComparer* mMax(nullptr);
-	if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "lesser"))) {
-		mMin = new AttributeComparers::NumericLesserComparer(std::stof(param->second));
-	} else if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "lesserequals"))) {
-		mMin = new AttributeComparers::NumericEqualsOrLesserComparer(std::stof(param->second));
-	}
-
-	if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "greater"))) {
-		mMax = new AttributeComparers::NumericGreaterComparer(std::stof(param->second));
-	} else if ((param = findCaseParameter(caseDefinition.getCaseParameters(), "greaterequals"))) {
-		mMax = new AttributeComparers::NumericEqualsOrGreaterComparer(std::stof(param->second));
-	}
-
-	//check if we have both min and max set, and if so we should use a range comparer
-	if (mMin && mMax) {
-		return new AttributeComparers::NumericRangeComparer(mMin, mMax);
-	} else if (!mMax && mMin) {
-		return mMin;
-	} else if (mMax) {
-		return mMax;
-	}
-	//invalid, could not find anything to compare against
-	return nullptr;
-}
-
-
-void EntityMappingCreator::addAttributeCases(AttributeMatch* match, MatchDefinition& matchDefinition) {
-	for (auto& aCase : matchDefinition.getCases()) {
-		Cases::AttributeComparers::AttributeComparerWrapper* wrapper = getAttributeCaseComparer(match, matchDefinition, aCase);
-		if (wrapper) {
-			auto* attrCase = new AttributeCase(wrapper);
-
-			mActionCreator.createActions(*mEntityMapping, attrCase, aCase);
-
-			for (auto& aMatch : aCase.getMatches()) {
-				addMatch(attrCase, aMatch);
-			}
-
-			match->addCase(attrCase);
-			attrCase->setParentMatch(match);
-		}
-	}
-
-}
-
-void EntityMappingCreator::addMatch(CaseBase* aCase, MatchDefinition& matchDefinition) {
-	if (matchDefinition.getType() == "attribute") {
-		addAttributeMatch(aCase, matchDefinition);
-	} else if (matchDefinition.getType() == "entitytype") {
-		addEntityTypeMatch(aCase, matchDefinition);
-	} else if (matchDefinition.getType() == "entityref") {
-		addEntityRefCase(aCase, matchDefinition);
+	aCase->addMatch(virtualMatch);
+
+	for (auto caseIndex : match.cases) {
+		auto& compiledCase = mDefinition->getCases()[caseIndex];
+		//The height depends on the entity, so this comparer can't be shared.
+		auto* attrCase = new AttributeCase(std::make_shared<HeightComparerWrapper>(compiledCase.heightComparer, mEntity));
+		populateCase(attrCase, compiledCase);
+		virtualMatch->addCase(attrCase);
+		attrCase->setParentMatch(virtualMatch);
 	}
 }
 
-void EntityMappingCreator::addAttributeMatch(CaseBase* aCase, MatchDefinition& matchDefinition) {
-	const std::string& attributeName = matchDefinition.getProperties()["attribute"];
-
-	AttributeMatch* match = nullptr;
-	std::string internalAttributeName;
-	const std::string& matchType = matchDefinition.getProperties()["type"];
-	//TODO: make this check better
-	if (matchType == "function") {
-		if (attributeName == "height") {
-
-			auto virtualMatch = new VirtualAttributeMatch(attributeName, {"bbox", "scale"});
-			virtualMatch->addMatchAttributeObserver(std::unique_ptr<MatchAttributeObserver>(new MatchAttributeObserver(virtualMatch, "bbox")));
-			virtualMatch->addMatchAttributeObserver(std::unique_ptr<MatchAttributeObserver>(new MatchAttributeObserver(virtualMatch, "scale")));
-			match = virtualMatch;
-		}
-	} else {
-		auto singleMatch = new SingleAttributeMatch(attributeName);
-		singleMatch->setMatchAttributeObserver(new MatchAttributeObserver(singleMatch, attributeName));
-		match = singleMatch;
-	}
-	if (match) {
-		aCase->addMatch(match);
-		addAttributeCases(match, matchDefinition);
+void EntityMappingCreator::addEntityTypeMatch(CaseBase* aCase, const CompiledDefinition::Match& match) {
+	auto* entityTypeMatch = new EntityTypeMatch();
+	aCase->addMatch(entityTypeMatch);
 
+	for (auto caseIndex : match.cases) {
+		auto& compiledCase = mDefinition->getCases()[caseIndex];
+		auto* entityCase = new EntityTypeCase(compiledCase.entityTypes);
+		populateCase(entityCase, compiledCase);
+		entityTypeMatch->addCase(entityCase);
+		entityCase->setParentMatch(entityTypeMatch);
 	}
 }
 
-void EntityMappingCreator::addEntityTypeMatch(CaseBase* aCase, MatchDefinition& matchDefinition) {
-	auto* match = new EntityTypeMatch();
-	aCase->addMatch(match);
-	addEntityTypeCases(match, matchDefinition);
-
-	//since we already have the entity, we can perform a check right away
-// 	match->testEntity(mEntity);
-}
-
-void EntityMappingCreator::addEntityRefCase(CaseBase* aCase, MatchDefinition& matchDefinition) {
+void EntityMappingCreator::addEntityRefMatch(CaseBase* aCase, const CompiledDefinition::Match& match) {
 	if (mView) {
-		const std::string& attributeName = matchDefinition.getProperties()["attribute"];
-		auto* match = new EntityRefMatch(attributeName, mView);
-		aCase->addMatch(match);
-
-		addEntityRefCases(match, matchDefinition);
-
+		auto* entityRefMatch = new EntityRefMatch(match.attributeName, mView);
+		aCase->addMatch(entityRefMatch);
+
+		for (auto caseIndex : match.cases) {
+			auto& compiledCase = mDefinition->getCases()[caseIndex];
+			auto* entityRefCase = new EntityRefCase(compiledCase.entityTypes);
+			populateCase(entityRefCase, compiledCase);
+			entityRefMatch->addCase(entityRefCase);
+			entityRefCase->setParentMatch(entityRefMatch);
+		}
 
 		//observe the attribute by the use of an MatchAttributeObserver
-		auto* observer = new MatchAttributeObserver(match, attributeName);
-		match->setMatchAttributeObserver(observer);
+		auto* observer = new MatchAttributeObserver(entityRefMatch, match.attributeName);
+		entityRefMatch->setMatchAttributeObserver(observer);
 
-		auto* entityObserver = new EntityCreationObserver(*match);
-		match->setEntityCreationObserver(entityObserver);
+		auto* entityObserver = new EntityCreationObserver(*entityRefMatch);
+		entityRefMatch->setEntityCreationObserver(entityObserver);
 	}
 
 }
@@ -23,11 +23,13 @@
 #ifndef EMBEROGRE_MODEL_MAPPINGMODELMAPPINGCREATOR_H
 #define EMBEROGRE_MODEL_MAPPINGMODELMAPPINGCREATOR_H
 
-#include "Definitions/EntityMappingDefinition.h"
+#include "CompiledDefinition.h"
+
+#include <memory>
+
 namespace Eris
 {
 class Entity;
-class TypeService;
 class View;
 }
 
@@ -37,55 +39,40 @@ namespace Ember {
 
 namespace EntityMapping {
 
-namespace Definitions {
-class EntityMappingDefinition;
-}
-
-namespace Matches {
-class EntityTypeMatch;
-class AttributeMatch;
-class EntityRefMatch;
-}
 namespace Cases {
-
-namespace AttributeComparers {
-	class NumericComparer;
-	class AttributeComparerWrapper;
-}
-
-class AttributeCase;
-class EntityRefCase;
 class CaseBase;
 }
+
 class EntityMapping;
 class IActionCreator;
+
 /**
-	Creates a EntityMapping instances from the supplied definition.
+	Creates a EntityMapping instances from the supplied compiled definition.
 
+	Since everything which only depends on the definition already has been resolved when it was compiled, this only creates the
+	matches, cases and actions of the entity, which refer to the shared comparers, entity types and attribute names of the compiled definition.
 	@author Erik Ogenvik <erik@ogenvik.org>
 */
-
 class EntityMappingCreator
 {
 public:
 	/**
 	 *    Default constructor.
-	 * @param definition The definition to use.
+	 * @param definition The compiled definition to use.
 	 * @param entity Entity to attach to.
 	 * @param actionCreator Client supplied action creator.
-	 * @param typeService A valid typeservice instance.
 	 * @param view An optional View instance.
 	 */
-	EntityMappingCreator(Definitions::EntityMappingDefinition& definition, Eris::Entity& entity, IActionCreator& actionCreator, Eris::TypeService& typeService, Eris::View* view);
+	EntityMappingCreator(std::shared_ptr<const CompiledDefinition> definition, Eris::Entity& entity, IActionCreator& actionCreator, Eris::View* view);
 
 	~EntityMappingCreator() = default;
 
-
 	/**
 	 *    Creates a new EntityMapping instance.
 	 */
 	EntityMapping* create();
 
+
 protected:
 
 	/**
@@ -94,78 +81,47 @@ protected:
 	EntityMapping* createMapping();
 
 	/**
-	 * Adds EntityTypeCases to the supplied match.
-	 * @param entityTypeMatch
-	 * @param matchDefinition
-	 */
-	void addEntityTypeCases(Matches::EntityTypeMatch* entityTypeMatch, Definitions::MatchDefinition& matchDefinition);
-
-	/**
-	 * Adds AttributeCases to the supplied match.
-	 * @param match
-	 * @param matchDefinition
-	 */
-	void addAttributeCases(Matches::AttributeMatch* match, Definitions::MatchDefinition& matchDefinition);
-
-	/**
-	 * Adds AttachmentCases to the supplied match.
-	 * @param match
-	 * @param matchDefinition
+	 * Creates the actions of, and adds child matches to, the supplied case.
+	 * @param aCase
+	 * @param compiledCase
 	 */
-	void addEntityRefCases(Matches::EntityRefMatch* match, Definitions::MatchDefinition& matchDefinition);
+	void populateCase(Cases::CaseBase* aCase, const CompiledDefinition::Case& compiledCase);
 
 	/**
-	 * Adds matches to the supplied case.
+	 * Adds attribute matches to the supplied case.
 	 * @param aCase
-	 * @param matchDefinition
+	 * @param match
 	 */
-	void addMatch(Cases::CaseBase* aCase, Definitions::MatchDefinition& matchDefinition);
+	void addAttributeMatch(Cases::CaseBase* aCase, const CompiledDefinition::Match& match);
 
 	/**
-	 * Adds attribute matches to the supplied case.
+	 * Adds height matches to the supplied case.
 	 * @param aCase
-	 * @param matchDefinition
+	 * @param match
 	 */
-	void addAttributeMatch(Cases::CaseBase* aCase, Definitions::MatchDefinition& matchDefinition);
+	void addHeightMatch(Cases::CaseBase* aCase, const CompiledDefinition::Match& match);
 
 	/**
 	 * Adds entity type matches to the supplied case.
 	 * @param aCase
-	 * @param matchDefinition
+	 * @param match
 	 */
-	void addEntityTypeMatch(Cases::CaseBase* aCase, Definitions::MatchDefinition& matchDefinition);
+	void addEntityTypeMatch(Cases::CaseBase* aCase, const CompiledDefinition::Match& match);
 
 	/**
 	 * Adds attachment matches to the supplied case.
 	 * @param aCase
-	 * @param matchDefinition
-	 */
-	void addEntityRefCase(Cases::CaseBase* aCase, Definitions::MatchDefinition& matchDefinition);
-
-	/**
-	 * Creates and returns a numeric comparer for the supplied case.
-	 * @param caseDefinition
-	 */
-	Cases::AttributeComparers::NumericComparer* createNumericComparer(Definitions::CaseDefinition& caseDefinition);
-
-	/**
-	 * Creates and returns suitable attribute comparer for the supplied attribute case.
 	 * @param match
-	 * @param matchDefinition
-	 * @param caseDefinition
-	 * @returns An AttributeComparers::AttributeComparerWrapper instance or null.
-	*/
-	Cases::AttributeComparers::AttributeComparerWrapper* getAttributeCaseComparer(Matches::AttributeMatch* match, Definitions::MatchDefinition& matchDefinition, Definitions::CaseDefinition& caseDefinition);
+	 */
+	void addEntityRefMatch(Cases::CaseBase* aCase, const CompiledDefinition::Match& match);
 
 	IActionCreator& mActionCreator;
 	Eris::Entity& mEntity;
 	EntityMapping* mEntityMapping;
-	Definitions::EntityMappingDefinition& mDefinition;
-	Eris::TypeService& mTypeService;
+	std::shared_ptr<const CompiledDefinition> mDefinition;
 	Eris::View* mView;
 };
 
-
 }
 
 }
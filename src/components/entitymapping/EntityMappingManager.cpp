@@ -24,9 +24,6 @@
 #include "config.h"
 #endif
 
-#include <components/entitymapping/Matches/SingleAttributeMatch.h>
-#include "Matches/AttributeMatch.h"
-#include "Cases/AttributeComparers/StringComparerWrapper.h"
 #include "EntityMappingManager.h"
 #include "IActionCreator.h"
 
@@ -40,6 +37,17 @@ using namespace Definitions;
 
 EntityMappingManager::EntityMappingManager() :
 		mTypeService(nullptr) {
+	//Entities without a valid "present" attribute get a mapping which is activated once they get one.
+	MatchDefinition matchDefinition;
+	matchDefinition.setType("attribute");
+	matchDefinition.getProperties()["attribute"] = "present";
+	CaseDefinition caseDefinition;
+	caseDefinition.getCaseParameters().emplace_back("notempty", "");
+	ActionDefinition actionDefinition;
+	actionDefinition.setType("present");
+	caseDefinition.getActions().emplace_back(std::move(actionDefinition));
+	matchDefinition.getCases().emplace_back(std::move(caseDefinition));
+	mDefaultDefinition.getRoot().getMatches().emplace_back(std::move(matchDefinition));
 }
 
 EntityMappingManager::~EntityMappingManager() {
@@ -57,9 +65,19 @@ void EntityMappingManager::addDefinition(EntityMappingDefinition* definition) {
 	}
 }
 
+std::shared_ptr<const CompiledDefinition> EntityMappingManager::getCompiledDefinition(EntityMappingDefinition& definition) {
+	auto I = mCompiledDefinitions.find(&definition);
+	if (I != mCompiledDefinitions.end()) {
+		return I->second;
+	}
+	auto compiledDefinition = std::make_shared<CompiledDefinition>(definition, *mTypeService);
+	mCompiledDefinitions.emplace(&definition, compiledDefinition);
+	return compiledDefinition;
+}
+
 EntityMapping* EntityMappingManager::createMapping(Eris::Entity& entity, IActionCreator& actionCreator, Eris::View* view) {
 	if (mTypeService) {
-		EntityMappingDefinition* definition = nullptr;
+		EntityMappingDefinition* definition = &mDefaultDefinition;
 		if (entity.hasAttr("present")) {
 			auto mappingElement = entity.valueOfAttr("present");
 			if (mappingElement.isString() && !mappingElement.String().empty()) {
@@ -70,29 +88,8 @@ EntityMapping* EntityMappingManager::createMapping(Eris::Entity& entity, IAction
 			}
 		}
 
-		if (definition) {
-			EntityMappingCreator creator(*definition, entity, actionCreator, *mTypeService, view);
-			return creator.create();
-		} else {
-			auto mapping = new EntityMapping(entity);
-
-			auto attributeMatch = new Matches::SingleAttributeMatch("present");
-			auto* attributeCase = new Cases::AttributeCase(new Cases::AttributeComparers::StringComparerWrapper(new Cases::AttributeComparers::StringNotEmptyComparer()));
-			Matches::Observers::MatchAttributeObserver* observer = new Matches::Observers::MatchAttributeObserver(attributeMatch, "present");
-			attributeMatch->setMatchAttributeObserver(observer);
-
-			attributeMatch->addCase(attributeCase);
-			CaseDefinition caseDefinition;
-			ActionDefinition actionDefinition;
-			actionDefinition.setType("present");
-			caseDefinition.getActions().emplace_back(std::move(actionDefinition));
-			actionCreator.createActions(*mapping, attributeCase, caseDefinition);
-			mapping->getBaseCase().addMatch(attributeMatch);
-
-			mapping->getBaseCase().setEntity(&entity);
-
-			return mapping;
-		}
+		EntityMappingCreator creator(getCompiledDefinition(*definition), entity, actionCreator, view);
+		return creator.create();
 	}
 	return nullptr;
 }
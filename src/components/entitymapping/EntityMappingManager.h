@@ -29,6 +29,7 @@
 
 
 #include <vector>
+#include <memory>
 #include <unordered_map>
 
 #include <Eris/TypeInfo.h>
@@ -36,6 +37,7 @@
 
 #include "Definitions/EntityMappingDefinition.h"
 #include "EntityMapping.h"
+#include "CompiledDefinition.h"
 
 
 namespace Ember {
@@ -53,6 +55,7 @@ class IActionCreator;
 	Handles all EntityMapping instances, as well as creation and setup.
 
 	Applications are expected to add definitions to the manager through the addDefinition(...) method. Definitions are managed by the manager and will be deleted by this upon destruction.
+	Each definition is compiled into a CompiledDefinition the first time it's used, which is then shared by all mappings created from it.
 	New EntityMapping instances are created by calling createMapping(...). It's up to the application to delete all EntityMapping instances created by the manager.
 
 	@author Erik Ogenvik <erik@ogenvik.org>
@@ -74,6 +77,13 @@ public:
     */
     void setTypeService(Eris::TypeService* typeService);
 
+    /**
+    Gets the compiled version of a definition, compiling it if needed.
+    The type service must be set.
+    @param definition A definition held by the manager.
+    */
+    std::shared_ptr<const CompiledDefinition> getCompiledDefinition(Definitions::EntityMappingDefinition& definition);
+
     /**
     Adds a definition to the manager. This definition will be deleted by the manager upon destruction.
     @param definition A valid definition.
@@ -93,6 +103,16 @@ protected:
 
 	EntityMappingDefinitionStore mDefinitions;
 
+	/**
+	 * @brief The definitions compiled so far.
+	 */
+	std::unordered_map<const Definitions::EntityMappingDefinition*, std::shared_ptr<const CompiledDefinition>> mCompiledDefinitions;
+
+	/**
+	 * @brief The definition used for entities without a valid "present" attribute, which only waits for such an attribute.
+	 */
+	Definitions::EntityMappingDefinition mDefaultDefinition;
+
 	Eris::TypeService* mTypeService;
 
 
@@ -101,6 +121,8 @@ protected:
 inline void EntityMappingManager::setTypeService(Eris::TypeService* typeService)
 {
 	mTypeService = typeService;
+	//Entity types are resolved when compiling, so the definitions must be compiled again.
+	mCompiledDefinitions.clear();
 }
 
 
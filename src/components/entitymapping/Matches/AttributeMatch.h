@@ -68,7 +68,10 @@ public:
 
 protected:
 
-	std::string mAttributeName;
+	/**
+	 * @brief The name of the attribute. This is interned in the compiled mapping definition.
+	 */
+	const std::string& mAttributeName;
 };
 
 inline const std::string& AttributeMatch::getAttributeName()
@@ -60,7 +60,10 @@ public:
 protected:
 
 	void testEntity(Eris::Entity* entity);
-	std::string mAttributeName;
+	/**
+	 * @brief The name of the attribute. This is interned in the compiled mapping definition.
+	 */
+	const std::string& mAttributeName;
 	Eris::View* mView;
 	std::unique_ptr<Observers::EntityCreationObserver> mEntityObserver;
 	std::unique_ptr<Observers::MatchAttributeObserver> mMatchAttributeObserver;
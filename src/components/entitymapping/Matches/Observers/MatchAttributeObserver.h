@@ -65,7 +65,10 @@ protected:
 
 	AttributeDependentMatch* mMatch;
 
-	std::string mAttributeName;
+	/**
+	 * @brief The name of the attribute. This is interned in the compiled mapping definition.
+	 */
+	const std::string& mAttributeName;
 
 };
 
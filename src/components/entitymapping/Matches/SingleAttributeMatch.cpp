@@ -44,10 +44,9 @@ void SingleAttributeMatch::setEntity(Eris::Entity* entity)
 {
 	AbstractMatch<Cases::AttributeCase>::setEntity(entity);
 	if (mMatchAttributeObserver) {
-		//observe the attribute by the use of an MatchAttributeObserver
+		//observe the attribute by the use of an MatchAttributeObserver, which also tests the current value
 		mMatchAttributeObserver->observeEntity(entity);
-	}
-	if (entity) {
+	} else if (entity) {
 		if (entity->hasAttr(mAttributeName)) {
 			testAttribute(entity->valueOfAttr(mAttributeName), false);
 //		} else {
@@ -25,7 +25,7 @@ namespace EntityMapping {
 namespace Matches {
 
 
-VirtualAttributeMatch::VirtualAttributeMatch(const std::string& attributeName, std::initializer_list<std::string> internalAttributeNames)
+VirtualAttributeMatch::VirtualAttributeMatch(const std::string& attributeName, const std::vector<std::string>& internalAttributeNames)
 		: AttributeMatch(attributeName),
 		  mInternalAttributeNames(internalAttributeNames)
 {
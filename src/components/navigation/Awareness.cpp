@@ -62,12 +62,18 @@
 
 #include "DetourNavMeshQuery.h"
 #include "DetourObstacleAvoidance.h"
+#include "RecastAlloc.h"
 
 #include "domain/IHeightProvider.h"
 #include "domain/EmberEntity.h"
 
 #include "framework/LoggingInstance.h"
 #include "framework/Exception.h"
+#include "framework/Hasher.h"
+#include "framework/MainLoopController.h"
+#include "framework/TimeFrame.h"
+#include "framework/tasks/TaskQueue.h"
+#include "framework/tasks/TemplateNamedTask.h"
 
 #include <Eris/View.h>
 #include <Eris/Avatar.h>
@@ -78,8 +84,16 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
+#include <boost/filesystem.hpp>
 
+#include <fstream>
+#include <memory>
 #include <queue>
+#include <sstream>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
 
 #define MAX_PATHPOLY      256 // max number of polygons in a path
 #define MAX_PATHVERT      512 // most verts in a path
@@ -92,6 +106,9 @@ namespace Navigation
 // This value specifies how many layers (or "floors") each navmesh tile is expected to have.
 static const int EXPECTED_LAYERS_PER_TILE = 1;
 
+// The version of the cached tile files. Increase whenever the rasterization is changed in a way which changes its output.
+static const std::uint32_t TileCacheFormatVersion = 2;
+
 using namespace boost::multi_index;
 
 /**
@@ -131,11 +148,48 @@ private:
 };
 
 
-struct InputGeometry
+/**
+ * @brief The arena used for Recast allocations in the current thread, if any.
+ */
+static thread_local RasterizationArena* sActiveArena = nullptr;
+
+static void* recastAlloc(int size, rcAllocHint hint)
+{
+	if (sActiveArena) {
+		return sActiveArena->alloc(size);
+	}
+	return malloc(size);
+}
+
+static void recastFree(void* ptr)
 {
-	std::vector<float> verts;
-	std::vector<int> tris;
-	std::vector<WFMath::RotBox<2>> entityAreas;
+	//Memory allocated from the arena is released all at once when the arena is reset.
+	if (sActiveArena && sActiveArena->owns(ptr)) {
+		return;
+	}
+	free(ptr);
+}
+
+/**
+ * @brief Routes all Recast allocations in the current thread to an arena for as long as the instance is alive.
+ */
+struct ArenaScope
+{
+	RasterizationArena& arena;
+
+	explicit ArenaScope(RasterizationArena& arena_) :
+			arena(arena_)
+	{
+		static bool installed = (rcAllocSetCustom(recastAlloc, recastFree), true);
+		(void)installed;
+		sActiveArena = &arena;
+	}
+
+	~ArenaScope()
+	{
+		sActiveArena = nullptr;
+		arena.reset();
+	}
 };
 
 class AwarenessContext: public rcContext
@@ -154,7 +208,211 @@ protected:
 
 };
 
-Awareness::Awareness(Eris::View& view, IHeightProvider& heightProvider, unsigned int tileSize) :
+/**
+ * @brief Rasterizes a tile in a background thread, and adds the result to the awareness in the main thread.
+ *
+ * If a cache directory is specified the tile layers are first looked for there, and stored there if they had to be rasterized.
+ */
+class TileRebuildTask: public Tasks::TemplateNamedTask<TileRebuildTask>
+{
+public:
+	enum class CacheResult
+	{
+		NONE, HIT, MISS
+	};
+
+	TileRebuildTask(Awareness& awareness, std::unique_ptr<TileInput> input, Tasks::TaskQueue& taskQueue, const std::string& cacheDirectory, std::uint64_t parameterHash) :
+			mAwareness(awareness), mInput(std::move(input)), mTaskQueue(taskQueue), mCacheDirectory(cacheDirectory), mParameterHash(parameterHash),
+			mTileCount(0), mCacheResult(CacheResult::NONE), mCacheStored(false)
+	{
+		memset(mTiles, 0, sizeof(mTiles));
+	}
+
+	~TileRebuildTask() override
+	{
+		for (int i = 0; i < mTileCount; ++i) {
+			dtFree(mTiles[i].data);
+		}
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		if (!mCacheDirectory.empty()) {
+			std::stringstream ss;
+			ss << mCacheDirectory << "/" << mInput->tx << "_" << mInput->ty << "_" << std::hex << hashInput(*mInput, mParameterHash) << ".navtile";
+			mCachePath = ss.str();
+			mTileCount = readTileLayers(mCachePath, mParameterHash, mTiles, MAX_LAYERS);
+			if (mTileCount > 0) {
+				mCacheResult = CacheResult::HIT;
+				mCacheStored = true;
+				return;
+			}
+			mCacheResult = CacheResult::MISS;
+		}
+
+		//Each worker thread keeps its own scratch memory, so that it can be reused for all tiles it rasterizes.
+		static thread_local RasterizationScratch scratch;
+		AwarenessContext ctx;
+		mTileCount = Awareness::rasterizeTileLayers(ctx, *mInput, scratch, mTiles, MAX_LAYERS);
+
+		if (!mCachePath.empty() && mTileCount > 0) {
+			mCacheStored = writeTileLayers(mCachePath, mParameterHash, mTiles, mTileCount);
+		}
+	}
+
+	bool executeTaskInMainThread() override
+	{
+		//If the queue isn't active the awareness is being destroyed, and the tile layers will just be freed.
+		if (mTaskQueue.isActive()) {
+			if (mCacheResult == CacheResult::HIT) {
+				mAwareness.mTileRebuildStatistics.cacheHits++;
+			} else if (mCacheResult == CacheResult::MISS) {
+				mAwareness.mTileRebuildStatistics.cacheMisses++;
+			}
+			if (mCacheStored) {
+				mAwareness.setCachedTileFile(mInput->tx, mInput->ty, mCachePath);
+			}
+			mAwareness.addTileLayers(mInput->tx, mInput->ty, mTiles, mTileCount);
+			mTileCount = 0;
+			mAwareness.mTileInputPool.push_back(std::move(mInput));
+		}
+		return true;
+	}
+
+private:
+	Awareness& mAwareness;
+	std::unique_ptr<TileInput> mInput;
+	Tasks::TaskQueue& mTaskQueue;
+	const std::string mCacheDirectory;
+	const std::uint64_t mParameterHash;
+	std::string mCachePath;
+	TileCacheData mTiles[MAX_LAYERS];
+	int mTileCount;
+	CacheResult mCacheResult;
+	bool mCacheStored;
+
+	/**
+	 * @brief Calculates a hash of all input to the rasterization.
+	 * @param input The tile input.
+	 * @param parameterHash The hash of the cache version and rasterization parameters.
+	 * @return A hash.
+	 */
+	static std::uint64_t hashInput(const TileInput& input, std::uint64_t parameterHash)
+	{
+		Hasher hasher(parameterHash);
+		hasher.add(input.cfg);
+		hasher.add(input.heightsXMin);
+		hasher.add(input.heightsYMin);
+		hasher.add(input.sizeX);
+		hasher.add(input.sizeY);
+		hasher.add(input.heights.data(), input.heights.size() * sizeof(float));
+		for (auto& rotbox : input.entityAreas) {
+			for (size_t i = 0; i < 4; ++i) {
+				float corner[] { rotbox.getCorner(i).x(), rotbox.getCorner(i).y() };
+				hasher.add(corner);
+			}
+		}
+		return hasher.get();
+	}
+
+	/**
+	 * @brief Reads tile layers from a cached file.
+	 * @param path The path to the file.
+	 * @param parameterHash The hash of the cache version and rasterization parameters, which must match the one in the file.
+	 * @param tiles Out parameter for the tiles. The data is allocated with dtAlloc.
+	 * @param maxTiles The maximum number of tile layers.
+	 * @return The number of tile layers read, or 0 if no valid file could be found.
+	 */
+	static int readTileLayers(const std::string& path, std::uint64_t parameterHash, TileCacheData* tiles, int maxTiles)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		if (!stream) {
+			return 0;
+		}
+		std::int32_t magic = 0;
+		std::int32_t version = 0;
+		std::uint64_t fileParameterHash = 0;
+		std::int32_t ntiles = 0;
+		stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		stream.read(reinterpret_cast<char*>(&version), sizeof(version));
+		stream.read(reinterpret_cast<char*>(&fileParameterHash), sizeof(fileParameterHash));
+		stream.read(reinterpret_cast<char*>(&ntiles), sizeof(ntiles));
+		if (!stream || magic != DT_TILECACHE_MAGIC || version != DT_TILECACHE_VERSION || fileParameterHash != parameterHash || ntiles <= 0 || ntiles > maxTiles) {
+			return 0;
+		}
+		for (int i = 0; i < ntiles; ++i) {
+			std::int32_t dataSize = 0;
+			stream.read(reinterpret_cast<char*>(&dataSize), sizeof(dataSize));
+			if (!stream || dataSize <= 0) {
+				freeTileLayers(tiles, i);
+				return 0;
+			}
+			tiles[i].data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+			tiles[i].dataSize = dataSize;
+			stream.read(reinterpret_cast<char*>(tiles[i].data), dataSize);
+			if (!stream) {
+				freeTileLayers(tiles, i + 1);
+				return 0;
+			}
+		}
+		return ntiles;
+	}
+
+	/**
+	 * @brief Writes tile layers to a cache file.
+	 * The file is first written to a temporary file, and then moved into place, so that an incomplete file never is read.
+	 * @param path The path to the file.
+	 * @param parameterHash The hash of the cache version and rasterization parameters.
+	 * @param tiles The tile layers.
+	 * @param ntiles The number of tile layers.
+	 * @return True if the file was written.
+	 */
+	static bool writeTileLayers(const std::string& path, std::uint64_t parameterHash, const TileCacheData* tiles, int ntiles)
+	{
+		std::string tempPath = path + ".tmp";
+		{
+			std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+			if (!stream) {
+				S_LOG_WARNING("Could not write navigation tile to cache file '" << path << "'.");
+				return false;
+			}
+			std::int32_t magic = DT_TILECACHE_MAGIC;
+			std::int32_t version = DT_TILECACHE_VERSION;
+			std::int32_t count = ntiles;
+			stream.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+			stream.write(reinterpret_cast<const char*>(&version), sizeof(version));
+			stream.write(reinterpret_cast<const char*>(&parameterHash), sizeof(parameterHash));
+			stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			for (int i = 0; i < ntiles; ++i) {
+				std::int32_t dataSize = tiles[i].dataSize;
+				stream.write(reinterpret_cast<const char*>(&dataSize), sizeof(dataSize));
+				stream.write(reinterpret_cast<const char*>(tiles[i].data), dataSize);
+			}
+			if (!stream) {
+				S_LOG_WARNING("Could not write navigation tile to cache file '" << path << "'.");
+				stream.close();
+				std::remove(tempPath.c_str());
+				return false;
+			}
+		}
+		if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+			std::remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	static void freeTileLayers(TileCacheData* tiles, int ntiles)
+	{
+		for (int i = 0; i < ntiles; ++i) {
+			dtFree(tiles[i].data);
+			tiles[i].data = nullptr;
+			tiles[i].dataSize = 0;
+		}
+	}
+};
+
+Awareness::Awareness(Eris::View& view, IHeightProvider& heightProvider, const std::string& tileCacheDirectory, unsigned int tileSize) :
 		mView(view),
 		mHeightProvider(heightProvider),
 		mAvatarEntity(view.getAvatar()->getEntity()),
@@ -165,6 +423,13 @@ Awareness::Awareness(Eris::View& view, IHeightProvider& heightProvider, unsigned
 		mAvatarRadius(0.4f),
 		mDesiredTilesAmount(128),
 		mCtx(new AwarenessContext()),
+		mTileCacheDirectory(tileCacheDirectory),
+		mTileCacheParameterHash(0),
+		mTaskQueue(nullptr),
+		mTileRebuildStatistics{},
+		mTileRatePeriodCount(0),
+		//Zero the config, since it's used when calculating hashes for cached tiles.
+		mCfg(),
 		mTileCache(nullptr),
 		mNavMesh(nullptr),
 		mNavQuery(dtAllocNavMeshQuery()),
@@ -250,6 +515,17 @@ Awareness::Awareness(Eris::View& view, IHeightProvider& heightProvider, unsigned
 			//	m_cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cfg.cs * m_detailSampleDist;
 			//	m_cfg.detailSampleMaxError = m_cfg.m_cellHeight * m_detailSampleMaxError;
 
+			//Cached tiles are only valid for the same tile cache format and rasterization parameters.
+			Hasher parameterHasher(TileCacheFormatVersion);
+			parameterHasher.add(DT_TILECACHE_MAGIC);
+			parameterHasher.add(DT_TILECACHE_VERSION);
+			parameterHasher.add(MAX_LAYERS);
+			parameterHasher.add(mCfg);
+			mTileCacheParameterHash = parameterHasher.get();
+			if (!mTileCacheDirectory.empty()) {
+				scanTileCacheDirectory();
+			}
+
 			// Tile cache params.
 			dtTileCacheParams tcparams{};
 			memset(&tcparams, 0, sizeof(tcparams));
@@ -318,6 +594,10 @@ Awareness::Awareness(Eris::View& view, IHeightProvider& heightProvider, unsigned
 			mObstacleAvoidanceParams->adaptiveRings = 2;
 			mObstacleAvoidanceParams->adaptiveDepth = 5;
 
+			//Leave some cores for the main thread and for terrain generation.
+			mTaskQueue = new Tasks::TaskQueue(std::max(1u, std::thread::hardware_concurrency() / 2), view.getEventService(), false);
+			mSignalConnections.emplace_back(MainLoopController::getSingleton().EventProcessMainThreadTasks.connect(sigc::mem_fun(*this, &Awareness::processMainThreadTasks)));
+
 			mSignalConnections.emplace_back(mAvatarEntity->LocationChanged.connect(sigc::mem_fun(*this, &Awareness::AvatarEntity_LocationChanged)));
 
 			mSignalConnections.emplace_back(view.EntitySeen.connect(sigc::mem_fun(*this, &Awareness::View_EntitySeen)));
@@ -355,6 +635,11 @@ Awareness::Awareness(Eris::View& view, IHeightProvider& heightProvider, unsigned
 				buildEntityAreas(*entity->getContained(i), mEntityAreas);
 			}
 		} catch (const std::exception& e) {
+			for (auto& connection : mSignalConnections) {
+				connection.disconnect();
+			}
+			delete mTaskQueue;
+
 			delete mObstacleAvoidanceParams;
 			dtFreeObstacleAvoidanceQuery(mObstacleAvoidanceQuery);
 
@@ -387,6 +672,9 @@ Awareness::~Awareness()
 		observed.second.beingDeleted.disconnect();
 	}
 
+	//Deleting the queue will wait for all tiles being rasterized, and then discard them.
+	delete mTaskQueue;
+
 	delete mObstacleAvoidanceParams;
 	dtFreeObstacleAvoidanceQuery(mObstacleAvoidanceQuery);
 
@@ -640,23 +928,45 @@ void Awareness::markTilesAsDirty(int tileMinXIndex, int tileMaxXIndex, int tileM
 	}
 }
 
-size_t Awareness::rebuildDirtyTile()
+size_t Awareness::rebuildDirtyTiles()
 {
-	if (!mDirtyAwareTiles.empty()) {
-		const auto tileIndexI = mDirtyAwareOrderedTiles.begin();
-		const auto& tileIndex = *tileIndexI;
-
-		float tilesize = mCfg.tileSize * mCfg.cs;
-		WFMath::AxisBox<2> adjustedArea(WFMath::Point<2>(mCfg.bmin[0] + (tileIndex.first * tilesize), mCfg.bmin[2] + (tileIndex.second * tilesize)), WFMath::Point<2>(mCfg.bmin[0] + ((tileIndex.first + 1) * tilesize), mCfg.bmin[2] + ((tileIndex.second + 1) * tilesize)));
-
-		std::vector<WFMath::RotBox<2>> entityAreas;
-		findEntityAreas(adjustedArea, entityAreas);
+	size_t started = 0;
+	auto I = mDirtyAwareOrderedTiles.begin();
+	while (I != mDirtyAwareOrderedTiles.end()) {
+		const auto tileIndex = *I;
+		//If the tile already is being rebuilt we need to wait until that's done, or the results might be applied in the wrong order.
+		if (mTilesInProgress.find(tileIndex) != mTilesInProgress.end()) {
+			++I;
+			continue;
+		}
 
-		rebuildTile(tileIndex.first, tileIndex.second, entityAreas);
+		std::unique_ptr<TileInput> input;
+		if (mTileInputPool.empty()) {
+			input.reset(new TileInput());
+		} else {
+			input = std::move(mTileInputPool.back());
+			mTileInputPool.pop_back();
+		}
+		buildTileInput(tileIndex.first, tileIndex.second, *input);
+		if (mTaskQueue->enqueueTask(new TileRebuildTask(*this, std::move(input), *mTaskQueue, mTileCacheDirectory, mTileCacheParameterHash))) {
+			mTilesInProgress.insert(tileIndex);
+			started++;
+		}
 		mDirtyAwareTiles.erase(tileIndex);
-		mDirtyAwareOrderedTiles.erase(tileIndexI);
+		I = mDirtyAwareOrderedTiles.erase(I);
 	}
-	return mDirtyAwareTiles.size();
+	mTileRebuildStatistics.tilesInProgress = mTilesInProgress.size();
+	return started;
+}
+
+const Awareness::TileRebuildStatistics& Awareness::getTileRebuildStatistics() const
+{
+	return mTileRebuildStatistics;
+}
+
+void Awareness::processMainThreadTasks(const TimeFrame& timeFrame)
+{
+	mTaskQueue->pollProcessedTasks(timeFrame);
 }
 
 void Awareness::pruneTiles()
@@ -892,33 +1202,149 @@ void Awareness::setAwarenessArea(const WFMath::RotBox<2>& area, const WFMath::Se
 	}
 }
 
-void Awareness::rebuildTile(int tx, int ty, const std::vector<WFMath::RotBox<2>>& entityAreas)
+void Awareness::buildTileInput(int tx, int ty, TileInput& input)
 {
-	TileCacheData tiles[MAX_LAYERS];
-	memset(tiles, 0, sizeof(tiles));
+	input.tx = tx;
+	input.ty = ty;
 
-	int ntiles = rasterizeTileLayers(entityAreas, tx, ty, tiles, MAX_LAYERS);
+	// Tile bounds.
+	const float tcs = mCfg.tileSize * mCfg.cs;
 
-	for (int j = 0; j < ntiles; ++j) {
-		TileCacheData* tile = &tiles[j];
+	rcConfig& tcfg = input.cfg;
+	memcpy(&tcfg, &mCfg, sizeof(tcfg));
 
-		dtTileCacheLayerHeader* header = (dtTileCacheLayerHeader*)tile->data;
-		dtTileRef tileRef = mTileCache->getTileRef(mTileCache->getTileAt(header->tx, header->ty, header->tlayer));
-		if (tileRef) {
-			mTileCache->removeTile(tileRef, NULL, NULL);
+	tcfg.bmin[0] = mCfg.bmin[0] + tx * tcs;
+	tcfg.bmin[1] = mCfg.bmin[1];
+	tcfg.bmin[2] = mCfg.bmin[2] + ty * tcs;
+	tcfg.bmax[0] = mCfg.bmin[0] + (tx + 1) * tcs;
+	tcfg.bmax[1] = mCfg.bmax[1];
+	tcfg.bmax[2] = mCfg.bmin[2] + (ty + 1) * tcs;
+
+	WFMath::AxisBox<2> adjustedArea(WFMath::Point<2>(tcfg.bmin[0], tcfg.bmin[2]), WFMath::Point<2>(tcfg.bmax[0], tcfg.bmax[2]));
+	input.entityAreas.clear();
+	findEntityAreas(adjustedArea, input.entityAreas);
+
+	tcfg.bmin[0] -= tcfg.borderSize * tcfg.cs;
+	tcfg.bmin[2] -= tcfg.borderSize * tcfg.cs;
+	tcfg.bmax[0] += tcfg.borderSize * tcfg.cs;
+	tcfg.bmax[2] += tcfg.borderSize * tcfg.cs;
+
+	//Get one extra vertex in each direction so that there's no cutoff at the tile's edges.
+	input.heightsXMin = std::floor(tcfg.bmin[0]) - 1;
+	int heightsXMax = std::ceil(tcfg.bmax[0]) + 1;
+	input.heightsYMin = std::floor(tcfg.bmin[2]) - 1;
+	int heightsYMax = std::ceil(tcfg.bmax[2]) + 1;
+	input.sizeX = heightsXMax - input.heightsXMin;
+	input.sizeY = heightsYMax - input.heightsYMin;
+
+	//Blit height values with 1 meter interval
+	input.heights.resize(input.sizeX * input.sizeY);
+	mHeightProvider.blitHeights(input.heightsXMin, heightsXMax, input.heightsYMin, heightsYMax, input.heights);
+}
+
+void Awareness::scanTileCacheDirectory()
+{
+	std::map<std::pair<int, int>, std::time_t> newestWriteTimes;
+	try {
+		boost::filesystem::path directory(mTileCacheDirectory);
+		if (!boost::filesystem::is_directory(directory)) {
+			return;
 		}
-		dtStatus status = mTileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);  // Add compressed tiles to tileCache
-		if (dtStatusFailed(status)) {
-			dtFree(tile->data);
-			tile->data = 0;
-			continue;
+		for (boost::filesystem::directory_iterator I(directory), end; I != end; ++I) {
+			if (I->path().extension() != ".navtile") {
+				continue;
+			}
+			std::string fileName = I->path().filename().string();
+			int tx, ty;
+			if (std::sscanf(fileName.c_str(), "%d_%d_", &tx, &ty) != 2) {
+				continue;
+			}
+			//Build the path the same way as TileRebuildTask does, so that the paths can be compared.
+			std::string path = mTileCacheDirectory + "/" + fileName;
+			std::time_t writeTime = boost::filesystem::last_write_time(I->path());
+			auto tileIndex = std::make_pair(tx, ty);
+			auto J = newestWriteTimes.find(tileIndex);
+			if (J == newestWriteTimes.end()) {
+				newestWriteTimes.emplace(tileIndex, writeTime);
+				mCachedTileFiles.emplace(tileIndex, path);
+			} else if (writeTime > J->second) {
+				std::remove(mCachedTileFiles[tileIndex].c_str());
+				J->second = writeTime;
+				mCachedTileFiles[tileIndex] = path;
+			} else {
+				std::remove(path.c_str());
+			}
+		}
+	} catch (const boost::filesystem::filesystem_error& e) {
+		S_LOG_WARNING("Could not scan navigation tile cache directory '" << mTileCacheDirectory << "'." << e);
+	}
+}
+
+void Awareness::setCachedTileFile(int tx, int ty, const std::string& path)
+{
+	auto& currentPath = mCachedTileFiles[std::make_pair(tx, ty)];
+	if (currentPath != path) {
+		if (!currentPath.empty()) {
+			std::remove(currentPath.c_str());
 		}
+		currentPath = path;
 	}
+}
 
-	mTileCache->buildNavMeshTilesAt(tx, ty, mNavMesh);
+void Awareness::addTileLayers(int tx, int ty, TileCacheData* tiles, int ntiles)
+{
+	std::pair<int, int> tileIndex(tx, ty);
+	mTilesInProgress.erase(tileIndex);
+
+	if (mAwareTiles.find(tileIndex) == mAwareTiles.end()) {
+		//The tile isn't part of the awareness area anymore. Discard the result, but make sure it's rebuilt if it's needed again.
+		for (int j = 0; j < ntiles; ++j) {
+			dtFree(tiles[j].data);
+			tiles[j].data = nullptr;
+		}
+		if (mTileCache->getTileAt(tx, ty, 0)) {
+			mDirtyUnwareTiles.insert(tileIndex);
+		}
+	} else {
+		for (int j = 0; j < ntiles; ++j) {
+			TileCacheData* tile = &tiles[j];
 
-	EventTileUpdated(tx, ty);
+			dtTileCacheLayerHeader* header = (dtTileCacheLayerHeader*)tile->data;
+			dtTileRef tileRef = mTileCache->getTileRef(mTileCache->getTileAt(header->tx, header->ty, header->tlayer));
+			if (tileRef) {
+				mTileCache->removeTile(tileRef, NULL, NULL);
+			}
+			dtStatus status = mTileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);  // Add compressed tiles to tileCache
+			if (dtStatusFailed(status)) {
+				dtFree(tile->data);
+				tile->data = 0;
+				continue;
+			}
+		}
 
+		mTileCache->buildNavMeshTilesAt(tx, ty, mNavMesh);
+
+		mTileRebuildStatistics.tilesRebuilt++;
+		mTileRatePeriodCount++;
+		auto now = std::chrono::steady_clock::now();
+		if (mTileRatePeriodCount == 1) {
+			mTileRatePeriodStart = now;
+		} else {
+			std::chrono::duration<float> elapsed = now - mTileRatePeriodStart;
+			if (elapsed.count() >= 1.0f) {
+				mTileRebuildStatistics.tilesPerSecond = mTileRatePeriodCount / elapsed.count();
+				mTileRatePeriodCount = 0;
+			}
+		}
+
+		EventTileUpdated(tx, ty);
+	}
+
+	//If the tile was marked as dirty while being rebuilt it needs to be rebuilt again.
+	if (mDirtyAwareTiles.find(tileIndex) != mDirtyAwareTiles.end()) {
+		rebuildDirtyTiles();
+	}
+	mTileRebuildStatistics.tilesInProgress = mTilesInProgress.size();
 }
 
 void Awareness::buildEntityAreas(Eris::Entity& entity, std::map<Eris::Entity*, WFMath::RotBox<2>>& entityAreas)
@@ -979,95 +1405,76 @@ void Awareness::findEntityAreas(const WFMath::AxisBox<2>& extent, std::vector<WF
 	}
 }
 
-int Awareness::rasterizeTileLayers(const std::vector<WFMath::RotBox<2>>& entityAreas, const int tx, const int ty, TileCacheData* tiles, const int maxTiles)
+int Awareness::rasterizeTileLayers(rcContext& ctx, const TileInput& input, RasterizationScratch& scratch, TileCacheData* tiles, const int maxTiles)
 {
-	std::vector<float> vertsVector;
-	std::vector<int> trisVector;
+	const rcConfig& tcfg = input.cfg;
+	const int sizeX = input.sizeX;
+	const int sizeY = input.sizeY;
+	const int nverts = sizeX * sizeY;
+	const int ntris = (sizeX - 1) * (sizeY - 1) * 2;
+
+	if (scratch.arena.capacity == 0) {
+		//Reserve a reasonable guess up front; the arena will grow if it's not enough.
+		scratch.arena.reserve(static_cast<size_t>(tcfg.width) * tcfg.height * 64);
+	}
+	//Must be declared before the rasterization context, so that all Recast memory is released into the arena.
+	ArenaScope arenaScope(scratch.arena);
 
 	FastLZCompressor comp;
 	RasterizationContext rc;
 
-// Tile bounds.
-	const float tcs = mCfg.tileSize * mCfg.cs;
-
-	rcConfig tcfg;
-	memcpy(&tcfg, &mCfg, sizeof(tcfg));
-
-	tcfg.bmin[0] = mCfg.bmin[0] + tx * tcs;
-	tcfg.bmin[1] = mCfg.bmin[1];
-	tcfg.bmin[2] = mCfg.bmin[2] + ty * tcs;
-	tcfg.bmax[0] = mCfg.bmin[0] + (tx + 1) * tcs;
-	tcfg.bmax[1] = mCfg.bmax[1];
-	tcfg.bmax[2] = mCfg.bmin[2] + (ty + 1) * tcs;
-	tcfg.bmin[0] -= tcfg.borderSize * tcfg.cs;
-	tcfg.bmin[2] -= tcfg.borderSize * tcfg.cs;
-	tcfg.bmax[0] += tcfg.borderSize * tcfg.cs;
-	tcfg.bmax[2] += tcfg.borderSize * tcfg.cs;
-
-//First define all vertices. Get one extra vertex in each direction so that there's no cutoff at the tile's edges.
-	int heightsXMin = std::floor(tcfg.bmin[0]) - 1;
-	int heightsXMax = std::ceil(tcfg.bmax[0]) + 1;
-	int heightsYMin = std::floor(tcfg.bmin[2]) - 1;
-	int heightsYMax = std::ceil(tcfg.bmax[2]) + 1;
-	int sizeX = heightsXMax - heightsXMin;
-	int sizeY = heightsYMax - heightsYMin;
-
-//Blit height values with 1 meter interval
-	std::vector<float> heights(sizeX * sizeY);
-	mHeightProvider.blitHeights(heightsXMin, heightsXMax, heightsYMin, heightsYMax, heights);
-
-	float* heightData = heights.data();
-	for (int y = heightsYMin; y < heightsYMax; ++y) {
-		for (int x = heightsXMin; x < heightsXMax; ++x) {
-			vertsVector.push_back(x);
-			vertsVector.push_back(*heightData);
-			vertsVector.push_back(y);
-			heightData++;
+//First define all vertices, directly from the height grid.
+	scratch.verts.resize(nverts * 3);
+	float* verts = scratch.verts.data();
+	const float* heightData = input.heights.data();
+	for (int y = 0; y < sizeY; ++y) {
+		for (int x = 0; x < sizeX; ++x) {
+			*verts++ = input.heightsXMin + x;
+			*verts++ = *heightData++;
+			*verts++ = input.heightsYMin + y;
 		}
 	}
-
-//Then define the triangles
-	for (int y = 0; y < (sizeY - 1); y++) {
-		for (int x = 0; x < (sizeX - 1); x++) {
-			size_t vertPtr = (y * sizeX) + x;
-			//make a square, including the vertices to the right and below
-			trisVector.push_back(vertPtr);
-			trisVector.push_back(vertPtr + sizeX);
-			trisVector.push_back(vertPtr + 1);
-
-			trisVector.push_back(vertPtr + 1);
-			trisVector.push_back(vertPtr + sizeX);
-			trisVector.push_back(vertPtr + 1 + sizeX);
+	verts = scratch.verts.data();
+
+//Then define the triangles. These only depend on the size of the grid, which normally is the same for all tiles.
+	if (scratch.trisSizeX != sizeX || scratch.trisSizeY != sizeY) {
+		scratch.tris.resize(ntris * 3);
+		int* tri = scratch.tris.data();
+		for (int y = 0; y < (sizeY - 1); y++) {
+			for (int x = 0; x < (sizeX - 1); x++) {
+				int vertPtr = (y * sizeX) + x;
+				//make a square, including the vertices to the right and below
+				*tri++ = vertPtr;
+				*tri++ = vertPtr + sizeX;
+				*tri++ = vertPtr + 1;
+
+				*tri++ = vertPtr + 1;
+				*tri++ = vertPtr + sizeX;
+				*tri++ = vertPtr + 1 + sizeX;
+			}
 		}
+		scratch.trisSizeX = sizeX;
+		scratch.trisSizeY = sizeY;
 	}
-
-	float* verts = vertsVector.data();
-	int* tris = trisVector.data();
-	const int nverts = vertsVector.size() / 3;
-	const int ntris = trisVector.size() / 3;
+	const int* tris = scratch.tris.data();
 
 // Allocate voxel heightfield where we rasterize our input data to.
 	rc.solid = rcAllocHeightfield();
 	if (!rc.solid) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
 		return 0;
 	}
-	if (!rcCreateHeightfield(mCtx, *rc.solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch)) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
-		return 0;
-	}
-
-// Allocate array that can hold triangle flags.
-	rc.triareas = new unsigned char[ntris];
-	if (!rc.triareas) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", ntris / 3);
+	if (!rcCreateHeightfield(&ctx, *rc.solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch)) {
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
 		return 0;
 	}
 
-	memset(rc.triareas, 0, ntris * sizeof(unsigned char));
-	rcMarkWalkableTriangles(mCtx, tcfg.walkableSlopeAngle, verts, nverts, tris, ntris, rc.triareas);
+// Array that can hold triangle flags.
+	scratch.triareas.assign(ntris, 0);
+	unsigned char* triareas = scratch.triareas.data();
+	rcMarkWalkableTriangles(&ctx, tcfg.walkableSlopeAngle, verts, nverts, tris, ntris, triareas);
 
-	rcRasterizeTriangles(mCtx, verts, nverts, tris, rc.triareas, ntris, *rc.solid, tcfg.walkableClimb);
+	rcRasterizeTriangles(&ctx, verts, nverts, tris, triareas, ntris, *rc.solid, tcfg.walkableClimb);
 
 // Once all geometry is rasterized, we do initial pass of filtering to
 // remove unwanted overhangs caused by the conservative rasterization
@@ -1081,22 +1488,22 @@ int Awareness::rasterizeTileLayers(const std::vector<WFMath::RotBox<2>>& entityA
 
 	rc.chf = rcAllocCompactHeightfield();
 	if (!rc.chf) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
 		return 0;
 	}
-	if (!rcBuildCompactHeightfield(mCtx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid, *rc.chf)) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
+	if (!rcBuildCompactHeightfield(&ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid, *rc.chf)) {
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
 		return 0;
 	}
 
 // Erode the walkable area by agent radius.
-	if (!rcErodeWalkableArea(mCtx, tcfg.walkableRadius, *rc.chf)) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
+	if (!rcErodeWalkableArea(&ctx, tcfg.walkableRadius, *rc.chf)) {
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
 		return 0;
 	}
 
 // Mark areas.
-	for (auto& rotbox : entityAreas) {
+	for (auto& rotbox : input.entityAreas) {
 		float boxVerts[3 * 4];
 
 		boxVerts[0] = rotbox.getCorner(1).x();
@@ -1115,16 +1522,16 @@ int Awareness::rasterizeTileLayers(const std::vector<WFMath::RotBox<2>>& entityA
 		boxVerts[10] = 0;
 		boxVerts[11] = rotbox.getCorner(0).y();
 
-		rcMarkConvexPolyArea(mCtx, boxVerts, 4, tcfg.bmin[1], tcfg.bmax[1], DT_TILECACHE_NULL_AREA, *rc.chf);
+		rcMarkConvexPolyArea(&ctx, boxVerts, 4, tcfg.bmin[1], tcfg.bmax[1], DT_TILECACHE_NULL_AREA, *rc.chf);
 	}
 
 	rc.lset = rcAllocHeightfieldLayerSet();
 	if (!rc.lset) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'lset'.");
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Out of memory 'lset'.");
 		return 0;
 	}
-	if (!rcBuildHeightfieldLayers(mCtx, *rc.chf, tcfg.borderSize, tcfg.walkableHeight, *rc.lset)) {
-		mCtx->log(RC_LOG_ERROR, "buildNavigation: Could not build heighfield layers.");
+	if (!rcBuildHeightfieldLayers(&ctx, *rc.chf, tcfg.borderSize, tcfg.walkableHeight, *rc.lset)) {
+		ctx.log(RC_LOG_ERROR, "buildNavigation: Could not build heighfield layers.");
 		return 0;
 	}
 
@@ -1139,8 +1546,8 @@ int Awareness::rasterizeTileLayers(const std::vector<WFMath::RotBox<2>>& entityA
 		header.version = DT_TILECACHE_VERSION;
 
 		// Tile layer location in the navmesh.
-		header.tx = tx;
-		header.ty = ty;
+		header.tx = input.tx;
+		header.ty = input.ty;
 		header.tlayer = i;
 		dtVcopy(header.bmin, layer->bmin);
 		dtVcopy(header.bmax, layer->bmax);
@@ -34,6 +34,10 @@
 #include <map>
 #include <unordered_map>
 #include <functional>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
 
 class dtNavMeshQuery;
 class dtNavMesh;
@@ -54,13 +58,20 @@ class Entity;
 namespace Ember
 {
 class IHeightProvider;
+class TimeFrame;
+namespace Tasks
+{
+class TaskQueue;
+}
 namespace Navigation
 {
 template <typename T>
 class MRUList;
 
 struct TileCacheData;
-struct InputGeometry;
+struct TileInput;
+struct RasterizationScratch;
+class TileRebuildTask;
 
 enum PolyAreas
 {
@@ -108,9 +119,18 @@ struct EntityConnections
  *
  * Internally this class uses a dtTileCache to manage the tiles. Since the world is dynamic we need to manage the
  * navmeshes through tiles in order to keep the resource usage down.
+ *
+ * Tiles are rasterized in background threads through a task queue, allowing many dirty tiles to be rebuilt at once. Only adding the
+ * resulting tile layers to the tile cache is done in the main thread, within the time allotted to main thread tasks each frame.
+ *
+ * If a tile cache directory is specified the compressed tile layers are also stored on disk, keyed by the tile index and a hash of all input
+ * to the rasterization (heights, entity areas and configuration). Whenever a tile with the exact same input is rebuilt again, for example when
+ * revisiting an area, the tile layers are loaded from disk instead of being rasterized.
+ * Only the latest file of each tile is kept; when a tile is rebuilt with different input the file of its previous input is removed.
  */
 class Awareness
 {
+friend class TileRebuildTask;
 public:
 	/**
 	 * A callback function for processing tiles.
@@ -121,9 +141,10 @@ public:
 	 * @brief Ctor.
 	 * @param view The world view.
 	 * @param heightProvider A height provider, used for getting terrain height data.
+	 * @param tileCacheDirectory A directory in which rasterized tiles are cached. If empty, no caching on disk will occur.
 	 * @param tileSize The size, in voxels, of one side of a tile. The larger this is the longer each tile takes to generate, but the overhead of managing tiles is decreased.
 	 */
-	Awareness(Eris::View& view, IHeightProvider& heightProvider, unsigned int tileSize = 64);
+	Awareness(Eris::View& view, IHeightProvider& heightProvider, const std::string& tileCacheDirectory, unsigned int tileSize = 64);
 	virtual ~Awareness();
 
 	/**
@@ -136,10 +157,65 @@ public:
 	void setAwarenessArea(const WFMath::RotBox<2>& area, const WFMath::Segment<2>& focusLine);
 
 	/**
-	 * @brief Rebuilds a dirty tile if any such exists.
-	 * @return The number of dirty tiles remaining.
+	 * @brief Statistics for the rebuilding of tiles.
+	 */
+	struct TileRebuildStatistics
+	{
+		/**
+		 * @brief The total number of tiles rebuilt.
+		 */
+		size_t tilesRebuilt;
+
+		/**
+		 * @brief The number of tiles rebuilt per second, measured over the last second during which tiles were rebuilt.
+		 */
+		float tilesPerSecond;
+
+		/**
+		 * @brief The number of tiles currently being rebuilt in the background.
+		 */
+		size_t tilesInProgress;
+
+		/**
+		 * @brief The number of tiles which were loaded from the tile cache directory.
+		 */
+		size_t cacheHits;
+
+		/**
+		 * @brief The number of tiles which weren't found in the tile cache directory, and had to be rasterized.
+		 */
+		size_t cacheMisses;
+	};
+
+	/**
+	 * @brief Starts rebuilding all dirty tiles.
+	 *
+	 * The tiles are rasterized in background threads, and added to the navmesh in the main thread when done.
+	 * Tiles which already are being rebuilt will be rebuilt again once the current rebuild is done.
+	 * @return The number of tiles for which rebuilding was started.
 	 */
-	size_t rebuildDirtyTile();
+	size_t rebuildDirtyTiles();
+
+	/**
+	 * @brief Gets statistics about rebuilding of tiles.
+	 * @return Statistics.
+	 */
+	const TileRebuildStatistics& getTileRebuildStatistics() const;
+
+	/**
+	 * @brief Rasterizes a tile.
+	 *
+	 * This only operates on the supplied data, and is safe to call from any thread.
+	 * All temporary memory, including all memory allocated by Recast, is taken from the scratch. Once the scratch has grown
+	 * large enough no more memory is allocated from the system, except for the resulting tile layers.
+	 * @param ctx A Recast context.
+	 * @param input The input data for the tile.
+	 * @param scratch Scratch memory, which should be reused between calls. Must not be shared between threads.
+	 * @param tiles Out parameter for the tiles. The data is allocated with dtAlloc.
+	 * @param maxTiles The maximum number of tile layers to create.
+	 * @return The number of tile layers that were created.
+	 */
+	static int rasterizeTileLayers(rcContext& ctx, const TileInput& input, RasterizationScratch& scratch, TileCacheData* tiles, const int maxTiles);
 
 	/**
 	 * @brief Finds a path from the start to the finish.
@@ -219,7 +295,7 @@ public:
 	/**
 	 * @brief Emitted when a tile has been marked as dirty.
 	 *
-	 * Any controlling code should call rebuildDirtyTile() to rebuild the dirty tiles.
+	 * Any controlling code should call rebuildDirtyTiles() to rebuild the dirty tiles.
 	 */
 	sigc::signal<void> EventTileDirty;
 
@@ -270,6 +346,51 @@ protected:
 	 */
 	rcContext* mCtx;
 
+	/**
+	 * @brief A directory in which rasterized tiles are cached. If empty, no caching on disk will occur.
+	 */
+	const std::string mTileCacheDirectory;
+
+	/**
+	 * @brief A hash of the version of the cache files and the rasterization parameters. Part of the name and header of each cached tile file.
+	 */
+	std::uint64_t mTileCacheParameterHash;
+
+	/**
+	 * @brief The latest cache file of each tile, so that it can be removed once the tile is stored with different input.
+	 */
+	std::map<std::pair<int, int>, std::string> mCachedTileFiles;
+
+	/**
+	 * @brief The task queue used for rasterizing tiles in background threads.
+	 */
+	Tasks::TaskQueue* mTaskQueue;
+
+	/**
+	 * @brief Tiles which are being rebuilt in the background.
+	 */
+	std::set<std::pair<int, int>> mTilesInProgress;
+
+	/**
+	 * @brief Tile inputs which can be reused, to avoid reallocating the height data for each tile.
+	 */
+	std::vector<std::unique_ptr<TileInput>> mTileInputPool;
+
+	/**
+	 * @brief Statistics for the rebuilding of tiles.
+	 */
+	TileRebuildStatistics mTileRebuildStatistics;
+
+	/**
+	 * @brief The start of the current period over which the tiles per second rate is measured.
+	 */
+	std::chrono::steady_clock::time_point mTileRatePeriodStart;
+
+	/**
+	 * @brief The number of tiles rebuilt in the current measuring period.
+	 */
+	size_t mTileRatePeriodCount;
+
 	/**
 	 * @brief The Recast configuration.
 	 */
@@ -352,12 +473,45 @@ protected:
 	MRUList<std::pair<int, int>>* mActiveTileList;
 
 	/**
-	 * @brief Rebuild the tile at the specific index.
+	 * @brief Collects all data needed for rasterizing the tile at the specific index.
+	 *
+	 * This needs to be done in the main thread, since it accesses the height provider and the entities.
 	 * @param tx X index.
 	 * @param ty Y index.
-	 * @param entityAreas A list of entities, projected as 2d rotation boxes, which affects the tile.
+	 * @param input The tile input to fill.
 	 */
-	void rebuildTile(int tx, int ty, const std::vector<WFMath::RotBox<2>>& entityAreas);
+	void buildTileInput(int tx, int ty, TileInput& input);
+
+	/**
+	 * @brief Finds the cached tile files in the tile cache directory.
+	 * Should there be more than one file for a tile only the newest one is kept, as the others can never be used again.
+	 */
+	void scanTileCacheDirectory();
+
+	/**
+	 * @brief Registers the current cache file of a tile, removing the file previously used for the tile.
+	 * @param tx The x index of the tile.
+	 * @param ty The y index of the tile.
+	 * @param path The path to the cache file.
+	 */
+	void setCachedTileFile(int tx, int ty, const std::string& path);
+
+	/**
+	 * @brief Adds newly rasterized tile layers to the tile cache and builds the navmesh for the tile.
+	 *
+	 * Called in the main thread when a tile has been rasterized. Ownership of the tile layer data is transferred.
+	 * @param tx X index.
+	 * @param ty Y index.
+	 * @param tiles The tile layers.
+	 * @param ntiles The number of tile layers.
+	 */
+	void addTileLayers(int tx, int ty, TileCacheData* tiles, int ntiles);
+
+	/**
+	 * @brief Called each frame, processes tiles which have been rasterized in the background.
+	 * @param timeFrame The time allotted for processing.
+	 */
+	void processMainThreadTasks(const TimeFrame& timeFrame);
 
 	/**
 	 * @brief Calculates the 2d rotbox area of the entity and adds it to the supplied map of areas.
@@ -373,16 +527,6 @@ protected:
 	 */
 	void findEntityAreas(const WFMath::AxisBox<2>& extent, std::vector<WFMath::RotBox<2> >& areas);
 
-	/**
-	 * @brief Rasterizes the tile at the specified index.
-	 * @param entityAreas The entity areas that affects the tile.
-	 * @param tx X index.
-	 * @param ty Y index.
-	 * @param tiles Out parameter for the tiles.
-	 * @param maxTiles The maximum number of tile layers to create.
-	 * @return The number of tile layers that were created.
-	 */
-	int rasterizeTileLayers(const std::vector<WFMath::RotBox<2>>& entityAreas, const int tx, const int ty, TileCacheData* tiles, const int maxTiles);
 
 	/**
 	 * @brief Applies the supplied processor on the supplied tiles.
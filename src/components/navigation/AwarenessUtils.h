@@ -46,7 +46,14 @@
 #include "DetourCommon.h"
 #include "DetourTileCache.h"
 #include "DetourTileCacheBuilder.h"
+#include "Recast.h"
+
+#include <wfmath/rotbox.h>
+
 #include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 namespace Ember
 {
@@ -166,7 +173,7 @@ static const int MAX_LAYERS = 32;
 struct RasterizationContext
 {
 	RasterizationContext() :
-			solid(0), triareas(0), lset(0), chf(0), ntiles(0)
+			solid(0), lset(0), chf(0), ntiles(0)
 	{
 		memset(tiles, 0, sizeof(TileCacheData) * MAX_LAYERS);
 	}
@@ -174,7 +181,6 @@ struct RasterizationContext
 	~RasterizationContext()
 	{
 		rcFreeHeightField(solid);
-		delete[] triareas;
 		rcFreeHeightfieldLayerSet(lset);
 		rcFreeCompactHeightfield(chf);
 		for (int i = 0; i < MAX_LAYERS; ++i) {
@@ -184,13 +190,160 @@ struct RasterizationContext
 	}
 
 	rcHeightfield* solid;
-	unsigned char* triareas;
 	rcHeightfieldLayerSet* lset;
 	rcCompactHeightfield* chf;
 	TileCacheData tiles[MAX_LAYERS];
 	int ntiles;
 };
 
+/**
+ * @brief All data needed for rasterizing a tile.
+ *
+ * This is collected in the main thread, so that the rasterization can be done in a background thread.
+ */
+struct TileInput
+{
+	int tx;
+	int ty;
+
+	/**
+	 * @brief The configuration for the tile, with its bounds including the border.
+	 */
+	rcConfig cfg;
+
+	/**
+	 * @brief Terrain heights, with one meter interval, starting at heightsXMin and heightsYMin.
+	 */
+	std::vector<float> heights;
+	int heightsXMin;
+	int heightsYMin;
+	int sizeX;
+	int sizeY;
+
+	std::vector<WFMath::RotBox<2>> entityAreas;
+};
+
+/**
+ * @brief An arena from which all Recast allocations are made while rasterizing a tile.
+ *
+ * Recast allocates and frees a lot of memory when rasterizing a tile. The arena hands out memory from one buffer, and frees
+ * it all at once when reset. Any allocation which doesn't fit is made from the system, and the buffer is grown on the next reset,
+ * so that once the arena has grown large enough no system allocations are needed.
+ */
+struct RasterizationArena
+{
+	unsigned char* buffer;
+	size_t capacity;
+	size_t top;
+
+	/**
+	 * @brief Allocations which didn't fit in the buffer. These are freed when the arena is reset.
+	 */
+	std::vector<void*> overflow;
+	size_t overflowSize;
+
+	/**
+	 * @brief The number of times memory has been allocated from the system.
+	 */
+	size_t systemAllocations;
+
+	RasterizationArena() :
+			buffer(0), capacity(0), top(0), overflowSize(0), systemAllocations(0)
+	{
+		overflow.reserve(256);
+	}
+
+	~RasterizationArena()
+	{
+		reset();
+		free(buffer);
+	}
+
+	void* alloc(size_t size)
+	{
+		//Keep all allocations 16 byte aligned.
+		size = (size + 15) & ~static_cast<size_t>(15);
+		if (top + size <= capacity) {
+			unsigned char* mem = &buffer[top];
+			top += size;
+			return mem;
+		}
+		void* mem = malloc(size);
+		if (mem) {
+			overflow.push_back(mem);
+			overflowSize += size;
+			systemAllocations++;
+		}
+		return mem;
+	}
+
+	/**
+	 * @brief Makes sure that the buffer can hold at least the specified amount of memory.
+	 * Must only be called when the arena is empty.
+	 * @param size The size in bytes.
+	 */
+	void reserve(size_t size)
+	{
+		if (size > capacity && top == 0) {
+			free(buffer);
+			buffer = static_cast<unsigned char*>(malloc(size));
+			capacity = buffer ? size : 0;
+			systemAllocations++;
+		}
+	}
+
+	bool owns(const void* ptr) const
+	{
+		const unsigned char* mem = static_cast<const unsigned char*>(ptr);
+		if (mem >= buffer && mem < buffer + capacity) {
+			return true;
+		}
+		return std::find(overflow.begin(), overflow.end(), ptr) != overflow.end();
+	}
+
+	void reset()
+	{
+		for (auto mem : overflow) {
+			free(mem);
+		}
+		overflow.clear();
+		size_t required = top + overflowSize;
+		overflowSize = 0;
+		top = 0;
+		if (required > capacity) {
+			//Grow the buffer so that everything would have fit, with some margin.
+			reserve((required * 5) / 4);
+		}
+	}
+};
+
+/**
+ * @brief Scratch memory used when rasterizing tiles.
+ *
+ * Each thread keeps one instance, which is reused for all tiles rasterized by the thread.
+ */
+struct RasterizationScratch
+{
+	std::vector<float> verts;
+	std::vector<int> tris;
+	std::vector<unsigned char> triareas;
+
+	/**
+	 * @brief The size of the height grid for which "tris" currently is built.
+	 *
+	 * All tiles normally have the same size, so the triangles only need to be built once.
+	 */
+	int trisSizeX;
+	int trisSizeY;
+
+	RasterizationArena arena;
+
+	RasterizationScratch() :
+			trisSizeX(0), trisSizeY(0)
+	{
+	}
+};
+
 }
 }
 
@@ -31,12 +31,17 @@
 #include "services/config/ConfigService.h"
 #include "services/server/ServerService.h"
 
-#include <Eris/EntityRef.h>
+#include "framework/MainLoopController.h"
+#include "framework/TimeFrame.h"
+
+#include <Eris/Avatar.h>
 #include <Eris/View.h>
-#include <Eris/EventService.h>
 
 #include <sigc++/bind.h>
 
+#include <algorithm>
+#include <limits>
+
 #ifdef _WIN32
 #include "platform/platform_windows.h"
 #else
@@ -48,8 +53,10 @@ namespace OgreView
 {
 
 EmberEntityFactory::EmberEntityFactory(Eris::View& view, Scene& scene, EntityMappingManager& mappingManager) :
-		mView(view), mTypeService(view.getTypeService()), mScene(scene), mMappingManager(mappingManager)
+		mView(view), mTypeService(view.getTypeService()), mScene(scene), mMappingManager(mappingManager),
+		mPendingEntitiesUnsorted(false), mProcessedCount(0), mQueuedCount(0)
 {
+	MainLoopController::getSingleton().EventProcessMainThreadTasks.connect(sigc::mem_fun(*this, &EmberEntityFactory::processPendingEntities));
 }
 
 EmberEntityFactory::~EmberEntityFactory()
@@ -62,20 +69,85 @@ Eris::Entity* EmberEntityFactory::instantiate(const Atlas::Objects::Entity::Root
 {
 
 	EmberEntity* entity = new EmberEntity(ge->getId(), type, w);
-	Eris::EntityRef entityRef(entity);
-	mView.getEventService().runOnMainThread([this, entityRef, entity] {
+	//The entity hasn't been initialized with its attributes yet, so the mapping is created later on, when the queue is processed.
+	mPendingEntities.push_back(PendingEntity{std::numeric_limits<float>::max(), Eris::EntityRef(entity)});
+	mPendingEntitiesUnsorted = true;
+	mQueuedCount++;
+	S_LOG_VERBOSE("Entity " << entity->getId() << " (" << type->getName() << ") added to game view.");
+	return entity;
+}
+
+size_t EmberEntityFactory::getPendingEntityCount() const
+{
+	return mPendingEntities.size();
+}
+
+void EmberEntityFactory::processPendingEntities(const TimeFrame& timeFrame)
+{
+	if (mPendingEntities.empty()) {
+		return;
+	}
+
+	if (mPendingEntitiesUnsorted) {
+		sortPendingEntities();
+		mPendingEntitiesUnsorted = false;
+	}
+
+	//Make sure that some progress is made even when the frame is out of time, which it often is when a large sight is received.
+	TimeFrame minimumTimeFrame(boost::posix_time::milliseconds(2));
+	do {
+		Eris::EntityRef entityRef = mPendingEntities.back().entity;
+		mPendingEntities.pop_back();
+		mProcessedCount++;
 		if (entityRef) {
-			//the creator binds the model mapping and this instance together by creating instance of EmberEntityModelAction and EmberEntityPartAction which in turn calls the setModel(..) and show/hideModelPart(...) methods.
-			EmberEntityActionCreator creator(*entity, mScene);
-			EntityMapping::EntityMapping* mapping = mMappingManager.createMapping(*entity, creator, &mView);
-			if (mapping) {
-				entity->BeingDeleted.connect(sigc::bind(sigc::mem_fun(*this, &EmberEntityFactory::deleteMapping), mapping));
-				mapping->initialize();
-			}
+			createMapping(static_cast<EmberEntity&>(*entityRef));
 		}
+	} while (!mPendingEntities.empty() && (timeFrame.isTimeLeft() || minimumTimeFrame.isTimeLeft()));
+
+	size_t processedCount = mProcessedCount;
+	size_t queuedCount = mQueuedCount;
+	if (mPendingEntities.empty()) {
+		mProcessedCount = 0;
+		mQueuedCount = 0;
+	}
+	EventInstantiationProgress(processedCount, queuedCount);
+}
+
+void EmberEntityFactory::sortPendingEntities()
+{
+	Eris::Avatar* avatar = mView.getAvatar();
+	Eris::Entity* avatarEntity = avatar ? avatar->getEntity() : nullptr;
+	WFMath::Point<3> avatarPosition = avatarEntity ? avatarEntity->getViewPosition() : WFMath::Point<3>();
+
+	for (auto& pendingEntity : mPendingEntities) {
+		if (!pendingEntity.entity) {
+			//Deleted entities are just skipped when processed, so they might as well be processed first.
+			pendingEntity.distance = -1;
+		} else if (avatar && pendingEntity.entity->getId() == avatar->getEntityId()) {
+			pendingEntity.distance = 0;
+		} else if (avatarPosition.isValid()) {
+			auto position = pendingEntity.entity->getViewPosition();
+			pendingEntity.distance = position.isValid() ? static_cast<float>(WFMath::SquaredDistance(position, avatarPosition)) : std::numeric_limits<float>::max();
+		} else {
+			pendingEntity.distance = std::numeric_limits<float>::max();
+		}
+	}
+
+	//Entities are taken from the back, so the closest should be last.
+	std::stable_sort(mPendingEntities.begin(), mPendingEntities.end(), [](const PendingEntity& lhs, const PendingEntity& rhs) {
+		return lhs.distance > rhs.distance;
 	});
-	S_LOG_VERBOSE("Entity " << entity->getId() << " (" << type->getName() << ") added to game view.");
-	return entity;
+}
+
+void EmberEntityFactory::createMapping(EmberEntity& entity)
+{
+	//the creator binds the model mapping and this instance together by creating instance of EmberEntityModelAction and EmberEntityPartAction which in turn calls the setModel(..) and show/hideModelPart(...) methods.
+	EmberEntityActionCreator creator(entity, mScene);
+	EntityMapping::EntityMapping* mapping = mMappingManager.createMapping(entity, creator, &mView);
+	if (mapping) {
+		entity.BeingDeleted.connect(sigc::bind(sigc::mem_fun(*this, &EmberEntityFactory::deleteMapping), mapping));
+		mapping->initialize();
+	}
 }
 
 void EmberEntityFactory::deleteMapping(EntityMapping::EntityMapping* mapping)
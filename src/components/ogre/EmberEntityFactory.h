@@ -22,12 +22,14 @@
 #include "EmberOgrePrerequisites.h"
 
 #include <Eris/Factory.h>
+#include <Eris/EntityRef.h>
 
 #include <Atlas/Objects/Entity.h>
 
 #include <sigc++/trackable.h>
 #include <sigc++/signal.h>
 #include <set>
+#include <vector>
 
 namespace Eris
 {
@@ -41,6 +43,7 @@ class Avatar;
 namespace Ember
 {
 class EmberEntity;
+class TimeFrame;
 namespace EntityMapping
 {
 class EntityMapping;
@@ -57,6 +60,10 @@ class Scene;
  * @brief Creates the EmberEntities required.
  *
  * Basically this attaches to Eris and creates Entites on demand.
+ *
+ * Creating the entity mappings, and through them the models, is deferred. New entities are queued, and the queue is processed
+ * each frame within the time left of the frame, closest to the avatar first. This spreads out the work when the server sends
+ * a sight of thousands of entities at once, which otherwise would all be set up in a couple of frames.
  * @see Eris::Factory
  */
 class EmberEntityFactory: public Eris::Factory, public virtual sigc::trackable
@@ -86,11 +93,24 @@ public:
 	 returns one. */
 	virtual int priority();
 
+	/**
+	 * @brief Gets the number of entities waiting to get their mappings created.
+	 */
+	size_t getPendingEntityCount() const;
+
 	/**
 	 * @brief Emitted when the factory is being deleted.
 	 */
 	sigc::signal<void> EventBeingDeleted;
 
+	/**
+	 * @brief Emitted each frame in which queued entities have been processed.
+	 *
+	 * The first parameter is the number of entities processed, and the second the number of entities queued, since the queue last was empty.
+	 * When they are equal, all queued entities have been processed.
+	 */
+	sigc::signal<void, size_t, size_t> EventInstantiationProgress;
+
 protected:
 
 	Eris::View& mView;
@@ -104,6 +124,61 @@ protected:
 
 	EntityMapping::EntityMappingManager& mMappingManager;
 
+	/**
+	 * @brief An entity waiting to get its mapping created.
+	 */
+	struct PendingEntity
+	{
+		/**
+		 * @brief The squared distance to the avatar, as of the last time the queue was sorted.
+		 */
+		float distance;
+
+		/**
+		 * @brief The entity. If the entity is deleted before it's processed this becomes empty.
+		 */
+		Eris::EntityRef entity;
+	};
+
+	/**
+	 * @brief Entities waiting to get their mappings created, with the closest at the back.
+	 */
+	std::vector<PendingEntity> mPendingEntities;
+
+	/**
+	 * @brief True if entities have been added to the queue since it last was sorted.
+	 */
+	bool mPendingEntitiesUnsorted;
+
+	/**
+	 * @brief The number of entities processed since the queue last was empty.
+	 */
+	size_t mProcessedCount;
+
+	/**
+	 * @brief The number of entities queued since the queue last was empty.
+	 */
+	size_t mQueuedCount;
+
+	/**
+	 * @brief Creates the mappings of queued entities, for as long as there's time left in the frame.
+	 * @param timeFrame The time frame of the current frame.
+	 */
+	void processPendingEntities(const TimeFrame& timeFrame);
+
+	/**
+	 * @brief Sorts the queue by the distance to the avatar.
+	 *
+	 * The avatar itself is always put first. Entities without a valid position, and all entities if there's no avatar entity yet, are put last.
+	 */
+	void sortPendingEntities();
+
+	/**
+	 * @brief Creates and initializes the mapping of an entity, which in turn creates its model.
+	 * @param entity The entity.
+	 */
+	void createMapping(EmberEntity& entity);
+
 	/**
 	 * @brief Deletes the entity mapping.
 	 *
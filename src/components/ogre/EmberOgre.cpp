@@ -379,6 +379,7 @@ bool EmberOgre::setup(Input& input, MainLoopController& mainLoopController, Eris
 		}
 		Ogre::MeshLodGenerator::getSingleton()._initWorkQueue();
 		Ogre::LodWorkQueueInjector::getSingleton().setInjectorListener(mPMInjectorSignaler);
+		mPMInjectorSignaler->LodInjected.connect(sigc::mem_fun(*mLodManager, &Lod::LodManager::lodInjected));
 
 		Gui::LoadingBarSection wfutSection(loadingBar, 0.2, "Media update");
 		if (useWfut) {
@@ -43,9 +43,11 @@
 
 #include "services/EmberServices.h"
 #include "services/server/ServerService.h"
+#include "services/config/ConfigService.h"
 
 #include "framework/MainLoopController.h"
 #include "framework/ConsoleBackend.h"
+#include "framework/osdir.h"
 
 #include <Eris/View.h>
 #include <Eris/EventService.h>
@@ -54,6 +56,8 @@
 #include <OgreCamera.h>
 #include <OgreSceneNode.h>
 
+#include <sstream>
+
 using namespace Ogre;
 using namespace Ember;
 namespace Ember {
@@ -101,7 +105,8 @@ MovementController::MovementController(Avatar& avatar, Camera::MainCamera& camer
 		MovementMoveUpwards("+movement_move_upwards", this, "Move upwards."),
 		MovementStrafeLeft("+movement_strafe_left", this, "Strafe left."),
 		MovementStrafeRight("+movement_strafe_right", this, "Strafe right."),
-		CameraOnAvatar("camera_on_avatar", this, "Positions the free flying camera on the avatar.")
+		CameraOnAvatar("camera_on_avatar", this, "Positions the free flying camera on the avatar."),
+		NavigationStatistics("navigation_statistics", this, "Prints statistics about the navigation tiles.")
 		/*, MovementRotateLeft("+Movement_rotate_left", this, "Rotate left.")
 		 , MovementRotateRight("+Movement_rotate_right", this, "Rotate right.")*/
 		//, MoveCameraTo("movecamerato", this, "Moves the camera to a point.")
@@ -124,7 +129,18 @@ MovementController::MovementController(Avatar& avatar, Camera::MainCamera& camer
 	//We can only do navigation if there's a valid bbox for the top level entity
 	if (avatar.getEmberEntity().getView()->getTopLevel()->getBBox().isValid()) {
 		try {
-			mAwareness = new Navigation::Awareness(*avatar.getEmberEntity().getView(), heightProvider);
+			//Cache navigation tiles on disk, so that they don't need to be rasterized again when revisiting an area.
+			std::string tileCacheDirectory = EmberServices::getSingleton().getConfigService().getHomeDirectory(BaseDirType_CACHE) + "/navmesh/";
+			try {
+				oslink::directory osdir(tileCacheDirectory);
+				if (!osdir.isExisting()) {
+					oslink::directory::mkdir(tileCacheDirectory.c_str());
+				}
+			} catch (const std::exception& ex) {
+				S_LOG_WARNING("Could not create directory for navigation tile cache; tiles won't be cached." << ex);
+				tileCacheDirectory = "";
+			}
+			mAwareness = new Navigation::Awareness(*avatar.getEmberEntity().getView(), heightProvider, tileCacheDirectory);
 			mAwarenessVisualizer = new Authoring::AwarenessVisualizer(*mAwareness, *camera.getCamera().getSceneManager());
 			mSteering = new Navigation::Steering(*mAwareness, *avatar.getEmberEntity().getView()->getAvatar());
 			mSteering->EventPathUpdated.connect(sigc::mem_fun(*this, &MovementController::Steering_PathUpdated));
@@ -197,10 +213,7 @@ MovementController::~MovementController() {
 
 void MovementController::tileRebuild() {
 	if (mAwareness) {
-		size_t dirtyTiles = mAwareness->rebuildDirtyTile();
-		if (dirtyTiles) {
-			mAvatar.getEmberEntity().getView()->getEventService().runOnMainThread([this] { this->tileRebuild(); }, mActiveMarker);
-		}
+		mAwareness->rebuildDirtyTiles();
 	}
 }
 
@@ -274,6 +287,16 @@ void MovementController::runCommand(const std::string& command, const std::strin
 		if (mFreeFlyingNode && mAvatar.getEmberEntity().getPosition().isValid()) {
 			mFreeFlyingNode->setPosition(Convert::toOgre(mAvatar.getEmberEntity().getViewPosition()));
 		}
+	} else if (NavigationStatistics == command) {
+		if (mAwareness) {
+			auto& stats = mAwareness->getTileRebuildStatistics();
+			std::stringstream ss;
+			ss << "Navigation tiles rebuilt: " << stats.tilesRebuilt << ", tiles per second: " << stats.tilesPerSecond << ", tiles in progress: " << stats.tilesInProgress
+			   << ", cache hits: " << stats.cacheHits << ", cache misses: " << stats.cacheMisses;
+			ConsoleBackend::getSingleton().pushMessage(ss.str(), "info");
+		} else {
+			ConsoleBackend::getSingleton().pushMessage("Navigation is disabled.", "info");
+		}
 	}
 	if (mMovementDirection != WFMath::Vector<3>::ZERO()) {
 		stopSteering();
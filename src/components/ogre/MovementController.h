@@ -143,6 +143,11 @@ public:
 	 */
 	const ConsoleCommandWrapper CameraOnAvatar;
 
+	/**
+	 * @brief Prints statistics about the navigation tiles to the console.
+	 */
+	const ConsoleCommandWrapper NavigationStatistics;
+
 	/**
 	 *    Reimplements the ConsoleObject::runCommand method
 	 * @param command
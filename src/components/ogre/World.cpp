@@ -319,6 +319,7 @@ void World::View_gotAvatarCharacter(Eris::Entity* entity)
 
 		mSignals.EventMovementControllerCreated.emit();
 		mSignals.EventCreatedAvatarEntity.emit(emberEntity);
+		mTerrainManager->getHandler().setFocusEntity(&emberEntity);
 		mTerrainManager->startPaging();
 		EventGotAvatar();
 	} else {
@@ -328,6 +329,7 @@ void World::View_gotAvatarCharacter(Eris::Entity* entity)
 
 void World::avatarEntity_BeingDeleted()
 {
+	mTerrainManager->getHandler().setFocusEntity(nullptr);
 	delete mAvatarCameraWarper;
 	mAvatarCameraWarper = nullptr;
 	mMainCamera->attachToMount(nullptr);
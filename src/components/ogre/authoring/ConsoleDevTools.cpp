@@ -28,6 +28,10 @@
 #include "components/ogre/MovementController.h"
 #include "components/ogre/camera/ICameraMount.h"
 #include "components/ogre/camera/MainCamera.h"
+#include "components/ogre/SceneNodeProvider.h"
+#include "components/ogre/model/Model.h"
+#include "components/ogre/model/ModelDefinitionManager.h"
+#include "components/ogre/model/ModelRepresentation.h"
 #include <CEGUI/BasicImage.h>
 #include <CEGUI/ImageManager.h>
 #include <CEGUI/WindowManager.h>
@@ -41,13 +45,18 @@
 #include <Ogre.h>
 #include <components/ogre/OgreInfo.h>
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
 namespace Ember {
 namespace OgreView {
 
 ConsoleDevTools::ConsoleDevTools() :
 		mReloadMaterial("reload_material", this, "Reloads the material. Parameters: <material name>. For example \"/reload_material /base/normalmap/specular\""),
 		mShowTexture("show_texture", this, "Show given texture in a separated window. Parameters: <texture name>. For example \"/show_texture DepthBuffer\""),
-		mBenchmark("benchmark", this, "Performs a benchmark test") {
+		mBenchmark("benchmark", this, "Performs a benchmark test"),
+		mBenchmarkModels("benchmark_models", this, "Renders many models in front of the camera and reports draw calls and frame time. Parameters: <model name> <count>. For example \"/benchmark_models settler 300\"") {
 
 }
 
@@ -65,6 +74,13 @@ void ConsoleDevTools::runCommand(const std::string& command, const std::string&
 		showTexture(textureName);
 	} else if (mBenchmark == command) {
 		performBenchmark();
+	} else if (mBenchmarkModels == command) {
+		Tokeniser tokeniser;
+		tokeniser.initTokens(args);
+		std::string modelName(tokeniser.nextToken());
+		std::string countString(tokeniser.nextToken());
+		int count = countString.empty() ? 100 : std::atoi(countString.c_str());
+		performModelBenchmark(modelName, count);
 	}
 }
 
@@ -323,5 +339,136 @@ void ConsoleDevTools::performBenchmark() {
 	}
 }
 
+void ConsoleDevTools::performModelBenchmark(const std::string& modelName, int count) {
+	auto& emberOgre = EmberOgre::getSingleton();
+	if (!emberOgre.getWorld()) {
+		ConsoleBackend::getSingleton().pushMessage("There's no world to render the models in.", "error");
+		return;
+	}
+	auto definition = Model::ModelDefinitionManager::getSingleton().getByName(modelName);
+	if (!definition) {
+		ConsoleBackend::getSingleton().pushMessage("'" + modelName + "' model not found.", "error");
+		return;
+	}
+	if (count <= 0) {
+		ConsoleBackend::getSingleton().pushMessage("The number of models must be positive.", "error");
+		return;
+	}
+
+	//A model and the node it's attached to. The model must be destroyed first, since it detaches itself from the node provider.
+	struct BenchmarkModel {
+		std::unique_ptr<SceneNodeProvider> nodeProvider;
+		std::unique_ptr<Model::Model> model;
+	};
+
+	//Waits for all models to load, and then lets them render for 120 frames while keeping track of the time and the draw calls.
+	//The benchmark is given up if the models don't load in time, or if the world is destroyed.
+	struct ModelBenchmarkFrameListener : public Ogre::FrameListener {
+		std::vector<BenchmarkModel> models;
+		std::string modelName;
+		int frames = 0;
+		size_t batches = 0;
+		size_t triangles = 0;
+		std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point start;
+		double originalFps = 0;
+		sigc::connection worldBeingDestroyedConnection;
+
+		void finish() {
+			worldBeingDestroyedConnection.disconnect();
+			EmberServices::getSingleton().getConfigService().setValue("general", "desiredfps", originalFps);
+			Ogre::Root::getSingleton().removeFrameListener(this);
+			delete this;
+		}
+
+		void abort(const std::string& reason) {
+			std::string message = "Model benchmark aborted: " + reason;
+			S_LOG_WARNING(message);
+			ConsoleBackend::getSingleton().pushMessage(message, "error");
+			finish();
+		}
+
+		bool frameStarted(const Ogre::FrameEvent& evt) override {
+			for (auto& entry : models) {
+				auto action = entry.model->getAction(Model::ActivationDefinition::MOVEMENT, Model::ModelRepresentation::ACTION_STAND);
+				if (action) {
+					action->getAnimations().addTime(evt.timeSinceLastFrame);
+				}
+				entry.model->updateInstancedAnimations();
+			}
+			return true;
+		}
+
+		bool frameEnded(const Ogre::FrameEvent& evt) override {
+			if (frames == 0) {
+				for (auto& entry : models) {
+					if (!entry.model->isLoaded()) {
+						if (std::chrono::steady_clock::now() - loadStart > std::chrono::seconds(60)) {
+							abort("the models didn't load within 60 seconds.");
+						}
+						return true;
+					}
+				}
+				start = std::chrono::steady_clock::now();
+			} else {
+				auto& statistics = EmberOgre::getSingleton().getRenderWindow()->getStatistics();
+				batches += statistics.batchCount;
+				triangles += statistics.triangleCount;
+			}
+			frames++;
+
+			if (frames == 121) {
+				auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+				size_t instancedModels = std::count_if(models.begin(), models.end(), [](const auto& entry) { return entry.model->useInstancing(); });
+
+				std::stringstream ss;
+				ss << "Rendered " << models.size() << " '" << modelName << "' models (" << instancedModels << " instanced): " << (microseconds / 120000.0) << " ms/frame, "
+				   << (batches / 120) << " draw calls/frame, " << (triangles / 120) << " triangles/frame";
+				S_LOG_INFO(ss.str());
+				ConsoleBackend::getSingleton().pushMessage(ss.str(), "info");
+
+				finish();
+				return true;
+			}
+			return true;
+		}
+	};
+
+	auto listener = new ModelBenchmarkFrameListener();
+	listener->modelName = modelName;
+	listener->originalFps = (double) EmberServices::getSingleton().getConfigService().getValue("general", "desiredfps");
+	EmberServices::getSingleton().getConfigService().setValue("general", "desiredfps", 0);
+
+	//Place the models in a square grid in front of the camera.
+	auto& sceneManager = emberOgre.getWorld()->getSceneManager();
+	auto& camera = emberOgre.getWorld()->getMainCamera().getCamera();
+	Ogre::Vector3 direction = camera.getDerivedDirection();
+	direction.y = 0;
+	direction.normalise();
+	Ogre::Vector3 side(-direction.z, 0, direction.x);
+	int modelsPerRow = static_cast<int>(std::ceil(std::sqrt(count)));
+	const float spacing = 2.0f;
+	Ogre::Vector3 origin = camera.getDerivedPosition() + (direction * 5.0f) - (side * (modelsPerRow * spacing * 0.5f));
+
+	for (int i = 0; i < count; ++i) {
+		Ogre::Vector3 position = origin + (direction * ((i / modelsPerRow) * spacing)) + (side * ((i % modelsPerRow) * spacing));
+		auto node = sceneManager.getRootSceneNode()->createChildSceneNode(position);
+		std::unique_ptr<SceneNodeProvider> nodeProvider(new SceneNodeProvider(node, sceneManager.getRootSceneNode()));
+		std::unique_ptr<Model::Model> model(new Model::Model(sceneManager, definition, OgreInfo::createUniqueResourceName("BenchmarkModel")));
+		model->attachToNode(nodeProvider.get());
+		model->load();
+
+		//Give each model its own animation time, so that they don't all move in sync.
+		auto action = model->getAction(Model::ActivationDefinition::MOVEMENT, Model::ModelRepresentation::ACTION_STAND);
+		if (action) {
+			action->getAnimations().addTime(Ogre::Math::RangeRandom(0, 15));
+		}
+		listener->models.push_back(BenchmarkModel{std::move(nodeProvider), std::move(model)});
+	}
+
+	//The models must be destroyed before the scene manager of the world is.
+	listener->worldBeingDestroyedConnection = emberOgre.EventWorldBeingDestroyed.connect([listener]() { listener->abort("the world was destroyed."); });
+	Ogre::Root::getSingleton().addFrameListener(listener);
+}
 }
 }
@@ -48,6 +48,14 @@ public:
 	void reloadTexture(const std::string& textureName);
 	void performBenchmark();
 
+	/**
+	 * @brief Renders a large number of models in front of the camera, and reports the number of draw calls and the frame time.
+	 * All models are animated with their idle animation, each with its own time.
+	 * @param modelName The name of the model definition.
+	 * @param count The number of models.
+	 */
+	void performModelBenchmark(const std::string& modelName, int count);
+
 protected:
 	/**
 	 * Reloads material at runtime.
@@ -61,6 +69,11 @@ protected:
 
 	const ConsoleCommandWrapper mBenchmark;
 
+	/**
+	 * Renders many instances of a model, for measuring rendering performance.
+	 */
+	const ConsoleCommandWrapper mBenchmarkModels;
+
 	/**
 	 * Reimplements the ConsoleObject::runCommand method
 	 */
@@ -156,6 +156,13 @@ double getTerrainHeight(double x, double z, void* userData)
 	heightProvider->getHeight(TerrainPosition(x, z), height);
 	return (double)height;
 }
+
+//Gets the heights of the terrain at many x/z coordinates at once
+void getTerrainHeights(const float* xs, const float* zs, float* heights, unsigned int count, void* userData)
+{
+	IHeightProvider* heightProvider = reinterpret_cast<IHeightProvider*>(userData);
+	heightProvider->getHeights(xs, zs, heights, count);
+}
 }
 
 }
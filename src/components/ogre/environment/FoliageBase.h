@@ -142,6 +142,7 @@ protected:
 
 float getTerrainHeight(float x, float z, void* userData = 0);
 double getTerrainHeight(double x, double z, void* userData = 0);
+void getTerrainHeights(const float* xs, const float* zs, float* heights, unsigned int count, void* userData = 0);
 
 }
 
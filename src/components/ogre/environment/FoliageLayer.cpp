@@ -35,6 +35,8 @@
 
 #include <OgreTechnique.h>
 
+#include <algorithm>
+
 using namespace Forests;
 using namespace Ogre;
 using namespace Ember::OgreView::Terrain;
@@ -99,15 +101,12 @@ unsigned int FoliageLayer::_populateGrassList(PageInfo /*page*/, float *posBuff,
 	unsigned int finalGrassCount = 0;
 	if (mLatestPlantsResult) {
 		const PlantAreaQueryResult::PlantStore& store = mLatestPlantsResult->getStore();
-		for (const auto& I : store) {
-			if (finalGrassCount == grassCount) {
-				break;
-			}
-			*posBuff++ = I.position.x;
-			*posBuff++ = I.position.z;
-			*posBuff++ = I.scale.x;
-			*posBuff++ = I.orientation;
-			finalGrassCount++;
+		finalGrassCount = static_cast<unsigned int>(std::min<size_t>(grassCount, store.size()));
+		for (unsigned int i = 0; i < finalGrassCount; ++i) {
+			*posBuff++ = store.positionX[i];
+			*posBuff++ = store.positionZ[i];
+			*posBuff++ = store.scaleX[i];
+			*posBuff++ = store.orientation[i];
 		}
 	} else {
 		S_LOG_CRITICAL("_populateGrassList called without mLatestPlantsResult being set. This should never happen.");
@@ -84,12 +84,11 @@ void FoliageLoader::loadPage(::Forests::PageInfo&)
 	const PlantAreaQueryResult::PlantStore& store = mLatestPlantsResult->getStore();
 	const int maxCount = (int)(store.size() * mDensityFactor);
 
-	for (PlantAreaQueryResult::PlantStore::const_iterator I = store.begin(); I != store.end(); ++I) {
+	for (size_t i = 0; i < store.size(); ++i) {
 		if (plantNo == maxCount) {
 			break;
 		}
-		const PlantInstance& plantInstance(*I);
-		addEntity(mEntity, plantInstance.position, Ogre::Quaternion(Ogre::Degree(plantInstance.orientation), Ogre::Vector3::UNIT_Y), Ogre::Vector3(plantInstance.scale.x, plantInstance.scale.y, plantInstance.scale.x), colour);
+		addEntity(mEntity, Ogre::Vector3(store.positionX[i], store.positionY[i], store.positionZ[i]), Ogre::Quaternion(Ogre::Degree(store.orientation[i]), Ogre::Vector3::UNIT_Y), Ogre::Vector3(store.scaleX[i], store.scaleY[i], store.scaleX[i]), colour);
 		plantNo++;
 	}
 }
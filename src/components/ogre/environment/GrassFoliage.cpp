@@ -99,6 +99,7 @@ void GrassFoliage::initialize()
 	mGrassLoader = new ::Forests::GrassLoader<FoliageLayer>(mPagedGeometry);
  	mPagedGeometry->setPageLoader(mGrassLoader);	//Assign the "treeLoader" to be used to load
 	mGrassLoader->setHeightFunction(&getTerrainHeight, static_cast<IHeightProvider*>(&mTerrainManager));
+	mGrassLoader->setHeightsFunction(&getTerrainHeights, static_cast<IHeightProvider*>(&mTerrainManager));
 
 	//Add some grass to the scene with GrassLoader::addLayer()
 	FoliageLayer *l = mGrassLoader->addLayer(mFoliageDefinition.getParameter("material"));
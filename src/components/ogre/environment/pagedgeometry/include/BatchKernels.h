@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------------------
+Copyright (c) 2018 Erik Ogenvik
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------------*/
+
+#ifndef FORESTS_BATCHKERNELS_H_
+#define FORESTS_BATCHKERNELS_H_
+
+#include <OgrePrerequisites.h>
+#include <OgreColourValue.h>
+#include <OgreQuaternion.h>
+#include <OgreVector3.h>
+
+#include <cstddef>
+
+namespace Forests {
+
+/**
+\brief Functions for copying the vertices and indices of meshes into a batch.
+
+The vertex functions work on one element of interleaved vertices, i.e. on every "stride" bytes, so that all vertices
+of a mesh are processed for one element at a time instead of looking up the element of each vertex.
+
+When compiled with SSE2 support the x, y and z of a vertex are transformed at once, else a scalar fallback is used.
+Both give the exact same result. None of the functions touch any Ogre resources, so they can be used from any thread.
+*/
+namespace BatchKernels {
+
+/**
+\brief The transform of an instance in a batch, as matrix columns.
+
+Each column is padded to four floats, so that it can be loaded as one SIMD vector.
+*/
+struct InstanceTransform
+{
+	/**
+	\brief The columns of the rotation matrix multiplied by the scale, followed by the translation. Used for positions.
+	*/
+	alignas(16) float positionColumns[4][4];
+
+	/**
+	\brief The columns of the rotation matrix. Used for normals, tangents and binormals.
+	*/
+	alignas(16) float rotationColumns[3][4];
+};
+
+/**
+\brief Creates the transform of an instance.
+\param orientation The orientation of the instance.
+\param scale The scale of the instance.
+\param translation The position of the instance, relative to the center of the batch.
+*/
+InstanceTransform makeInstanceTransform(const Ogre::Quaternion &orientation, const Ogre::Vector3 &scale, const Ogre::Vector3 &translation);
+
+/**
+\brief Scales, rotates and translates positions. Only the first three floats of each element are written.
+\param source The first source element.
+\param destination The first destination element. Source and destination may be the same.
+\param stride The number of bytes between the elements of each vertex, in both source and destination.
+\param count The number of vertices.
+\param transform The transform.
+*/
+void transformPositions(const unsigned char *source, unsigned char *destination, size_t stride, size_t count, const InstanceTransform &transform);
+
+/**
+\brief Rotates normals, tangents or binormals. Only the first three floats of each element are written.
+\param source The first source element.
+\param destination The first destination element. Source and destination may be the same.
+\param stride The number of bytes between the elements of each vertex, in both source and destination.
+\param count The number of vertices.
+\param transform The transform, of which only the rotation is used.
+*/
+void rotateVectors(const unsigned char *source, unsigned char *destination, size_t stride, size_t count, const InstanceTransform &transform);
+
+/**
+\brief Multiplies the first three channels of packed colours with a colour. The fourth channel is copied as is.
+\param source The first source element.
+\param destination The first destination element.
+\param stride The number of bytes between the elements of each vertex, in both source and destination.
+\param count The number of vertices.
+\param colour The colour, with its channels in the same order as the packed colours.
+*/
+void modulateColours(const unsigned char *source, unsigned char *destination, size_t stride, size_t count, const Ogre::ColourValue &colour);
+
+/**
+\brief Copies indices, adding an offset to each.
+The 16 bit to 16 bit version wraps around just like a cast of the sum would.
+\param source The source indices.
+\param destination The destination indices.
+\param count The number of indices.
+\param offset The offset to add.
+*/
+void offsetIndices(const Ogre::uint16 *source, Ogre::uint16 *destination, size_t count, Ogre::uint32 offset);
+void offsetIndices(const Ogre::uint16 *source, Ogre::uint32 *destination, size_t count, Ogre::uint32 offset);
+void offsetIndices(const Ogre::uint32 *source, Ogre::uint32 *destination, size_t count, Ogre::uint32 offset);
+
+}
+
+}
+
+#endif
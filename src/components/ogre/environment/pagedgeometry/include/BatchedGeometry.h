@@ -20,6 +20,11 @@ Permission is granted to anyone to use this software for any purpose, including
 #include <OgreMovableObject.h>
 #include <OgreSceneNode.h>
 #include <OgreMaterialManager.h>
+#include <OgreHardwareIndexBuffer.h>
+
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace Forests {
 
@@ -31,6 +36,21 @@ public:
 
 	virtual void addEntity(Ogre::Entity *ent, const Ogre::Vector3 &position, const Ogre::Quaternion &orientation = Ogre::Quaternion::IDENTITY, const Ogre::Vector3 &scale = Ogre::Vector3::UNIT_SCALE, const Ogre::ColourValue &color = Ogre::ColourValue::White);
 	void build();
+
+	/**
+	\brief Builds the batch, transforming the vertices in a background thread.
+
+	The batch is prepared on the main thread, after which the vertices and indices of all added entities are copied and
+	transformed in one of the threads of Ogre's work queue. The hardware buffers are created once the work queue hands
+	back the result on the main thread; the batch isn't shown until then. Calling clear() cancels a pending build.
+	*/
+	virtual void buildInBackground();
+
+	/**
+	\brief True if a background build has been started, but hasn't been uploaded yet.
+	*/
+	bool isBuildPending() const { return buildJob != nullptr; }
+
 	void clear();
 
 	Ogre::Vector3 _convertToLocal(const Ogre::Vector3 &globalVec) const;
@@ -56,6 +76,32 @@ public:
 		void addSubEntity(Ogre::SubEntity *ent, const Ogre::Vector3 &position, const Ogre::Quaternion &orientation, const Ogre::Vector3 &scale, const Ogre::ColourValue &color = Ogre::ColourValue::White, void* userData = NULL);
 		virtual void build();
 		void clear();
+
+		/**
+		\brief Prepares the batch for building. Must be called on the main thread.
+
+		Adds any needed vertex colours to the vertex declaration, works out which elements of each vertex buffer need to be
+		transformed, and copies the vertices and indices of each queued SubMesh into new build data, since hardware buffers
+		can't be read from other threads.
+		*/
+		void prepareBuild();
+
+		/**
+		\brief Fills the buffers of the build data on the calling thread. See BuildData::fill().
+		*/
+		void fillBuffers();
+
+		/**
+		\brief Creates the hardware buffers from the filled buffers of the build data. Must be called on the main thread.
+		*/
+		void upload();
+
+		struct BuildData;
+
+		/**
+		\brief The build data made by prepareBuild(), until it has been uploaded.
+		*/
+		const std::shared_ptr<BuildData> &getBuildData() const { return buildData; }
 		
 		void setMaterial(Ogre::MaterialPtr &mat) { material = mat; }
 		void setMaterialName(const Ogre::String &mat) { material = Ogre::MaterialManager::getSingleton().getByName(mat); }
@@ -105,6 +151,38 @@ public:
 		typedef std::vector<QueuedMesh>::iterator MeshQueueIterator;
 		typedef std::vector<QueuedMesh> MeshQueue;
 		MeshQueue meshQueue;	//The list of meshes to be added to this batch
+
+		// A vertex element which is transformed, rather than copied as is.
+		struct ElementTransform
+		{
+			enum Type
+			{
+				Position,
+				Vector,
+				Colour
+			};
+			Type type;
+			size_t offset;
+		};
+
+		// The layout of a vertex buffer, worked out once from the vertex declaration instead of for each vertex.
+		struct BufferLayout
+		{
+			size_t vertexSize;
+			std::vector<ElementTransform> transforms;
+		};
+
+		// The vertices and indices of a queued SubMesh, copied from its hardware buffers.
+		struct SourceGeometry
+		{
+			std::vector<std::vector<Ogre::uchar>> vertexBuffers;
+			std::vector<Ogre::uchar> indices;
+			size_t vertexCount;
+			size_t indexCount;
+			bool indices32Bit;
+		};
+
+		std::shared_ptr<BuildData> buildData;	//The pending build, if any
 	};
 
 
@@ -118,6 +196,21 @@ private:
 	bool withinFarDistance;
 
 
+	class BuildJob;
+	class BuildHandler;
+
+	// The pending background build, if any.
+	std::shared_ptr<BuildJob> buildJob;
+
+	// Kept while the batch exists, so that the handler stays registered with the work queue.
+	std::shared_ptr<BuildHandler> buildHandler;
+
+	// Finishes the bounds and creates the scene node. Returns false if there's nothing to build.
+	bool prepareBuild();
+
+	// Uploads the buffers filled by a background build.
+	void finishBuild();
+
 protected:
 	static void extractVertexDataFromShared(Ogre::MeshPtr mesh);
 
@@ -135,6 +228,26 @@ public:
 	SubBatchIterator getSubBatchIterator() const;
 };
 
+// The data a build of a sub batch works on. It's kept apart from the sub batch, so that a background build never touches
+// the sub batch, and the sub batch can be cleared without waiting for the build to finish.
+struct BatchedGeometry::SubBatch::BuildData
+{
+	// Fills the buffers with the transformed vertices and the offset indices of all queued meshes. Only touches the build
+	// data, and can thus be called from any thread.
+	void fill();
+
+	MeshQueue meshQueue;
+	std::vector<BufferLayout> bufferLayouts;	//One per vertex buffer of the batch
+	std::map<Ogre::SubMesh*, SourceGeometry> sourceGeometries;
+	size_t vertexCount;
+	size_t indexCount;
+	bool requireVertexColors;
+	Ogre::HardwareIndexBuffer::IndexType destIndexType;
+	Ogre::Vector3 batchCenter;
+	std::vector<std::vector<Ogre::uchar>> filledVertexBuffers;
+	std::vector<Ogre::uchar> filledIndices;
+};
+
 
 }
 
@@ -47,6 +47,7 @@ Permission is granted to anyone to use this software for any purpose, including
 #include <OgreTechnique.h>
 
 #include <memory>
+#include <vector>
 
 using namespace Ogre;
 namespace Forests {
@@ -210,6 +211,22 @@ public:
 		heightFunctionUserData = userData;
 	}
 
+	/** \brief Sets a function which calculates the heights of many grass positions at once
+	\param heightsFunction A pointer to a function which writes the height of each x/z position into the heights array
+
+	The heights of all grass of a page are needed when the page is loaded. If looking up many heights at once is
+	cheaper than looking up each by itself, supply a function with the following prototype, which will then be used
+	instead of the height function:
+
+	\code
+	void getHeightsAt(const float *xs, const float *zs, float *heights, unsigned int count, void *userData);
+	\endcode
+	*/
+	void setHeightsFunction(void (*heightsFunction)(const float *xs, const float *zs, float *heights, unsigned int count, void *userData), void *userData = NULL) {
+		this->heightsFunction = heightsFunction;
+		heightsFunctionUserData = userData;
+	}
+
 	bool preparePage(PageInfo &page);
 
 	/** INTERNAL FUNCTION - DO NOT USE */
@@ -230,12 +247,18 @@ private:
 	Ogre::Mesh *generateGrass_CROSSQUADS(PageInfo &page, TGrassLayer *layer, float *grassPositions, unsigned int grassCount);
 	Ogre::Mesh *generateGrass_SPRITE(PageInfo &page, TGrassLayer *layer, float *grassPositions, unsigned int grassCount);
 
+	//Calculates the heights of the grass at once. Each grass gets one height for its center if pointsPerGrass is 1,
+	//else one for each edge of its quad (2) or quads (4), in the same order as the generateGrass_ functions use them.
+	void calculateHeights(TGrassLayer *layer, const float *grassPositions, unsigned int grassCount, unsigned int pointsPerGrass, std::vector<float> &heights);
+
 	//List of grass types
 	std::list<TGrassLayer*> layerList;
 
 	//Height data
 	Ogre::Real (*heightFunction)(Ogre::Real x, Ogre::Real z, void *userData);	//Pointer to height function
 	void *heightFunctionUserData;
+	void (*heightsFunction)(const float *xs, const float *zs, float *heights, unsigned int count, void *userData);	//Pointer to batch height function
+	void *heightsFunctionUserData;
 
 	//Misc.
 	PagedGeometry *geom;
@@ -700,6 +723,8 @@ GrassLoader<TGrassLayer>::GrassLoader(PagedGeometry *geom)
 
 	heightFunction = NULL;
 	heightFunctionUserData = NULL;
+	heightsFunction = NULL;
+	heightsFunctionUserData = NULL;
 
 	windDir = Ogre::Vector3::UNIT_X;
 	densityFactor = 1.0f;
@@ -866,6 +891,57 @@ void GrassLoader<TGrassLayer>::unloadPage(PageInfo &page)
 {
 	// we unload the page in the page's destructor
 }
+template <class TGrassLayer>
+void GrassLoader<TGrassLayer>::calculateHeights(TGrassLayer *layer, const float *grassPositions, unsigned int grassCount, unsigned int pointsPerGrass, std::vector<float> &heights)
+{
+	heights.clear();
+	if (!heightFunction && !heightsFunction) {
+		return;
+	}
+
+	//Work out the points in the same way as the generateGrass_ functions do
+	std::vector<float> xs, zs;
+	xs.reserve(grassCount * pointsPerGrass);
+	zs.reserve(grassCount * pointsPerGrass);
+	float rndWidth = layer->maxWidth - layer->minWidth;
+	const float *posPtr = grassPositions;
+	for (unsigned int i = 0; i < grassCount; ++i)
+	{
+		float x = *posPtr++;
+		float z = *posPtr++;
+		float rnd = *posPtr++;
+		float angle = *posPtr++;
+		if (pointsPerGrass == 1) {
+			xs.push_back(x);
+			zs.push_back(z);
+			continue;
+		}
+
+		float halfScaleX = (layer->minWidth + rndWidth * rnd) * 0.5f;
+		float xTrans = Math::Cos(angle) * halfScaleX;
+		float zTrans = Math::Sin(angle) * halfScaleX;
+		xs.push_back(x - xTrans);
+		zs.push_back(z - zTrans);
+		xs.push_back(x + xTrans);
+		zs.push_back(z + zTrans);
+		if (pointsPerGrass == 4) {
+			xs.push_back(x + zTrans);
+			zs.push_back(z - xTrans);
+			xs.push_back(x - zTrans);
+			zs.push_back(z + xTrans);
+		}
+	}
+
+	heights.resize(xs.size());
+	if (heightsFunction) {
+		heightsFunction(xs.data(), zs.data(), heights.data(), static_cast<unsigned int>(xs.size()), heightsFunctionUserData);
+	} else {
+		for (size_t i = 0; i < xs.size(); ++i) {
+			heights[i] = heightFunction(xs[i], zs[i], heightFunctionUserData);
+		}
+	}
+}
+
 template <class TGrassLayer>
 Mesh *GrassLoader<TGrassLayer>::generateGrass_QUAD(PageInfo &page, TGrassLayer *layer, float *grassPositions, unsigned int grassCount)
 {
@@ -923,6 +999,9 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_QUAD(PageInfo &page, TGrassLayer *
 	float rndHeight = layer->maxHeight - layer->minHeight;
 	Vector3 normal(0.0f, 1.0f, 0.0f); //We'll use a normal pointing straight up, to best simulate grass and sunlight.
 
+	std::vector<float> heights;
+	calculateHeights(layer, grassPositions, grassCount, 2, heights);
+
 	float minY = Math::POS_INFINITY, maxY = Math::NEG_INFINITY;
 	float *posPtr = grassPositions;	//Position array "iterator"
 	for (uint16 i = 0; i < grassCount; ++i)
@@ -952,9 +1031,9 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_QUAD(PageInfo &page, TGrassLayer *
 		float x2 = x + xTrans, z2 = z + zTrans;
 
 		float y1, y2;
-		if (heightFunction){
-			y1 = heightFunction(x1, z1, heightFunctionUserData);
-			y2 = heightFunction(x2, z2, heightFunctionUserData);
+		if (!heights.empty()){
+			y1 = heights[i * 2];
+			y2 = heights[(i * 2) + 1];
 
 			if (layer->getMaxSlope() < (Math::Abs(y1 - y2) / (halfScaleX * 2))) {
 				//Degenerate the face
@@ -1116,6 +1195,9 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_CROSSQUADS(PageInfo &page, TGrassL
 	float rndWidth = layer->maxWidth - layer->minWidth;
 	float rndHeight = layer->maxHeight - layer->minHeight;
 
+	std::vector<float> heights;
+	calculateHeights(layer, grassPositions, grassCount, 4, heights);
+
 	float minY = Math::POS_INFINITY, maxY = Math::NEG_INFINITY;
 	float *posPtr = grassPositions;	//Position array "iterator"
 	Vector3 normal(0.0f, 1.0f, 0.0f); //We'll use a normal pointing straight up, to best simulate grass and sunlight.
@@ -1147,9 +1229,9 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_CROSSQUADS(PageInfo &page, TGrassL
 		float x2 = x + xTrans, z2 = z + zTrans;
 
 		float y1, y2;
-		if (heightFunction){
-			y1 = heightFunction(x1, z1, heightFunctionUserData);
-			y2 = heightFunction(x2, z2, heightFunctionUserData);
+		if (!heights.empty()){
+			y1 = heights[i * 4];
+			y2 = heights[(i * 4) + 1];
 
 			if (layer->getMaxSlope() < (Math::Abs(y1 - y2) / (halfScaleX * 2))) {
 				//Degenerate the face
@@ -1210,9 +1292,9 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_CROSSQUADS(PageInfo &page, TGrassL
 		float x4 = x - zTrans, z4 = z + xTrans;
 
 		float y3, y4;
-		if (heightFunction){
-			y3 = heightFunction(x3, z3, heightFunctionUserData);
-			y4 = heightFunction(x4, z4, heightFunctionUserData);
+		if (!heights.empty()){
+			y3 = heights[(i * 4) + 2];
+			y4 = heights[(i * 4) + 3];
 			if (layer->getMaxSlope() < (Math::Abs(y3 - y4) / (halfScaleX * 2))) {
 				//Degenerate the face
 				x4 = x3;
@@ -1370,6 +1452,9 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_SPRITE(PageInfo &page, TGrassLayer
 	float rndWidth = layer->maxWidth - layer->minWidth;
 	float rndHeight = layer->maxHeight - layer->minHeight;
 
+	std::vector<float> heights;
+	calculateHeights(layer, grassPositions, grassCount, 1, heights);
+
 	float minY = Math::POS_INFINITY, maxY = Math::NEG_INFINITY;
 	float *posPtr = grassPositions;	//Position array "iterator"
 	for (uint16 i = 0; i < grassCount; ++i)
@@ -1380,8 +1465,8 @@ Mesh *GrassLoader<TGrassLayer>::generateGrass_SPRITE(PageInfo &page, TGrassLayer
 
 		//Calculate height
 		float y;
-		if (heightFunction){
-			y = heightFunction(x, z, heightFunctionUserData);
+		if (!heights.empty()){
+			y = heights[i];
 		} else {
 			y = 0;
 		}
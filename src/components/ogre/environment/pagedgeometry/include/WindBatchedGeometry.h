@@ -33,6 +33,11 @@ public:
 	void addEntity(Ogre::Entity *ent, const Ogre::Vector3 &position, const Ogre::Quaternion &orientation = Ogre::Quaternion::IDENTITY, const Ogre::Vector3 &scale = Ogre::Vector3::UNIT_SCALE, const Ogre::ColourValue &color = Ogre::ColourValue::White);
 	inline void setGeom(const PagedGeometry * geom) { mGeom = geom; }
 
+	/**
+	\brief Builds the batch right away, since the wind parameters are looked up in the PagedGeometry while building.
+	*/
+	void buildInBackground() { build(); }
+
 	class WindSubBatch: public SubBatch
 	{
 	public:
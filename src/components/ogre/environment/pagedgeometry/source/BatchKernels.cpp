@@ -0,0 +1,188 @@
+/*-------------------------------------------------------------------------------------
+Copyright (c) 2018 Erik Ogenvik
+
+This software is provided 'as-is', without any express or implied warranty. In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose, including commercial applications, and to alter it and redistribute it freely, subject to the following restrictions:
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+-------------------------------------------------------------------------------------*/
+
+#include "BatchKernels.h"
+
+#include <OgreMatrix3.h>
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Forests {
+
+namespace BatchKernels {
+
+namespace {
+
+#ifdef __SSE2__
+/**
+\brief Multiplies the three first columns with the x, y and z of a vector.
+The additions are grouped the same way as in the scalar version, so that the results are identical.
+*/
+inline __m128 multiply(const float *vector, __m128 column0, __m128 column1, __m128 column2)
+{
+	__m128 xy = _mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(vector[0])), _mm_mul_ps(column1, _mm_set1_ps(vector[1])));
+	return _mm_add_ps(xy, _mm_mul_ps(column2, _mm_set1_ps(vector[2])));
+}
+
+inline void store3(float *destination, __m128 value)
+{
+	_mm_storel_pi(reinterpret_cast<__m64*>(destination), value);
+	_mm_store_ss(destination + 2, _mm_movehl_ps(value, value));
+}
+#else
+inline void multiply(const float *vector, const float (*columns)[4], float *result)
+{
+	for (int i = 0; i < 3; ++i) {
+		result[i] = ((columns[0][i] * vector[0]) + (columns[1][i] * vector[1])) + (columns[2][i] * vector[2]);
+	}
+}
+#endif
+
+}
+
+InstanceTransform makeInstanceTransform(const Ogre::Quaternion &orientation, const Ogre::Vector3 &scale, const Ogre::Vector3 &translation)
+{
+	Ogre::Matrix3 rotation;
+	orientation.ToRotationMatrix(rotation);
+
+	InstanceTransform transform;
+	for (int column = 0; column < 3; ++column) {
+		for (int row = 0; row < 3; ++row) {
+			transform.positionColumns[column][row] = rotation[row][column] * scale[column];
+			transform.rotationColumns[column][row] = rotation[row][column];
+		}
+		transform.positionColumns[column][3] = 0;
+		transform.rotationColumns[column][3] = 0;
+	}
+	transform.positionColumns[3][0] = translation.x;
+	transform.positionColumns[3][1] = translation.y;
+	transform.positionColumns[3][2] = translation.z;
+	transform.positionColumns[3][3] = 0;
+	return transform;
+}
+
+void transformPositions(const unsigned char *source, unsigned char *destination, size_t stride, size_t count, const InstanceTransform &transform)
+{
+#ifdef __SSE2__
+	const __m128 column0 = _mm_load_ps(transform.positionColumns[0]);
+	const __m128 column1 = _mm_load_ps(transform.positionColumns[1]);
+	const __m128 column2 = _mm_load_ps(transform.positionColumns[2]);
+	const __m128 translation = _mm_load_ps(transform.positionColumns[3]);
+	for (size_t i = 0; i < count; ++i) {
+		__m128 result = _mm_add_ps(multiply(reinterpret_cast<const float*>(source), column0, column1, column2), translation);
+		store3(reinterpret_cast<float*>(destination), result);
+		source += stride;
+		destination += stride;
+	}
+#else
+	for (size_t i = 0; i < count; ++i) {
+		float result[3];
+		multiply(reinterpret_cast<const float*>(source), transform.positionColumns, result);
+		float *destinationVector = reinterpret_cast<float*>(destination);
+		for (int j = 0; j < 3; ++j) {
+			destinationVector[j] = result[j] + transform.positionColumns[3][j];
+		}
+		source += stride;
+		destination += stride;
+	}
+#endif
+}
+
+void rotateVectors(const unsigned char *source, unsigned char *destination, size_t stride, size_t count, const InstanceTransform &transform)
+{
+#ifdef __SSE2__
+	const __m128 column0 = _mm_load_ps(transform.rotationColumns[0]);
+	const __m128 column1 = _mm_load_ps(transform.rotationColumns[1]);
+	const __m128 column2 = _mm_load_ps(transform.rotationColumns[2]);
+	for (size_t i = 0; i < count; ++i) {
+		store3(reinterpret_cast<float*>(destination), multiply(reinterpret_cast<const float*>(source), column0, column1, column2));
+		source += stride;
+		destination += stride;
+	}
+#else
+	for (size_t i = 0; i < count; ++i) {
+		float result[3];
+		multiply(reinterpret_cast<const float*>(source), transform.rotationColumns, result);
+		std::memcpy(destination, result, sizeof(result));
+		source += stride;
+		destination += stride;
+	}
+#endif
+}
+
+void modulateColours(const unsigned char *source, unsigned char *destination, size_t stride, size_t count, const Ogre::ColourValue &colour)
+{
+	for (size_t i = 0; i < count; ++i) {
+		Ogre::uint32 packed;
+		std::memcpy(&packed, source, sizeof(packed));
+		Ogre::uint8 r = static_cast<Ogre::uint8>((packed & 0xFF) * colour.r);
+		Ogre::uint8 g = static_cast<Ogre::uint8>(((packed >> 8) & 0xFF) * colour.g);
+		Ogre::uint8 b = static_cast<Ogre::uint8>(((packed >> 16) & 0xFF) * colour.b);
+		packed = r | (g << 8) | (b << 16) | (packed & 0xFF000000);
+		std::memcpy(destination, &packed, sizeof(packed));
+		source += stride;
+		destination += stride;
+	}
+}
+
+void offsetIndices(const Ogre::uint16 *source, Ogre::uint16 *destination, size_t count, Ogre::uint32 offset)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i offsets = _mm_set1_epi16(static_cast<short>(offset));
+	for (; i + 8 <= count; i += 8) {
+		__m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_add_epi16(indices, offsets));
+	}
+#endif
+	for (; i < count; ++i) {
+		destination[i] = static_cast<Ogre::uint16>(source[i] + offset);
+	}
+}
+
+void offsetIndices(const Ogre::uint16 *source, Ogre::uint32 *destination, size_t count, Ogre::uint32 offset)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offsets = _mm_set1_epi32(static_cast<int>(offset));
+	for (; i + 8 <= count; i += 8) {
+		__m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_add_epi32(_mm_unpacklo_epi16(indices, zero), offsets));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(indices, zero), offsets));
+	}
+#endif
+	for (; i < count; ++i) {
+		destination[i] = source[i] + offset;
+	}
+}
+
+void offsetIndices(const Ogre::uint32 *source, Ogre::uint32 *destination, size_t count, Ogre::uint32 offset)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	const __m128i offsets = _mm_set1_epi32(static_cast<int>(offset));
+	for (; i + 4 <= count; i += 4) {
+		__m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_add_epi32(indices, offsets));
+	}
+#endif
+	for (; i < count; ++i) {
+		destination[i] = source[i] + offset;
+	}
+}
+
+}
+
+}
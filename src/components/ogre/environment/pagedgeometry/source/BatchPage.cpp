@@ -102,7 +102,8 @@ void BatchPage::addEntity(Entity *ent, const Vector3 &position, const Quaternion
 
 void BatchPage::build()
 {
-	batch->build();
+	//The batch is shown once its vertices have been transformed in the background
+	batch->buildInBackground();
 
 	BatchedGeometry::SubBatchIterator it = batch->getSubBatchIterator();
 	while (it.hasMoreElements()){
@@ -14,6 +14,7 @@ Permission is granted to anyone to use this software for any purpose, including
 //-------------------------------------------------------------------------------------
 
 #include "BatchedGeometry.h"
+#include "BatchKernels.h"
 
 #include <OgreRoot.h>
 #include <OgreRenderSystem.h>
@@ -33,6 +34,10 @@ Permission is granted to anyone to use this software for any purpose, including
 #include <OgreMaterialManager.h>
 #include <OgreMaterial.h>
 #include <OgreTechnique.h>
+#include <OgreWorkQueue.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <string>
 using namespace Ogre;
 
@@ -280,22 +285,115 @@ String BatchedGeometry::getFormatString(SubEntity *ent)
 	return str.str();
 }
 
-void BatchedGeometry::build()
+// A background build. The worker thread only touches the build data of the sub batches, which the job shares, so
+// clear() can cancel the job and delete the sub batches without waiting for the worker.
+class BatchedGeometry::BuildJob
+{
+public:
+	BuildJob(BatchedGeometry *owner) : owner(owner), cancelled(false) {}
+
+	void fill()
+	{
+		for (auto &data : buildData) {
+			//A cancelled build is thrown away, so there's no need to fill the rest.
+			if (cancelled)
+				return;
+			data->fill();
+		}
+	}
+
+	void finish()
+	{
+		if (!cancelled)
+			owner->finishBuild();
+	}
+
+	void cancel()
+	{
+		cancelled = true;
+	}
+
+	std::vector<std::shared_ptr<SubBatch::BuildData>> buildData;
+
+private:
+	BatchedGeometry *owner;
+	std::atomic<bool> cancelled;
+};
+
+// Handles background builds on Ogre's work queue. It's shared by all batches, and registered with the work queue for
+// as long as any batch holds it.
+class BatchedGeometry::BuildHandler: public WorkQueue::RequestHandler, public WorkQueue::ResponseHandler
+{
+public:
+	static std::shared_ptr<BuildHandler> getInstance()
+	{
+		static std::weak_ptr<BuildHandler> instance;
+		std::shared_ptr<BuildHandler> handler = instance.lock();
+		if (!handler) {
+			handler = std::make_shared<BuildHandler>();
+			instance = handler;
+		}
+		return handler;
+	}
+
+	BuildHandler()
+	{
+		WorkQueue *workQueue = Root::getSingleton().getWorkQueue();
+		channel = workQueue->getChannel("Forests/BatchedGeometry");
+		workQueue->addRequestHandler(channel, this);
+		workQueue->addResponseHandler(channel, this);
+	}
+
+	~BuildHandler()
+	{
+		WorkQueue *workQueue = Root::getSingleton().getWorkQueue();
+		workQueue->removeRequestHandler(channel, this);
+		workQueue->removeResponseHandler(channel, this);
+	}
+
+	void submit(const std::shared_ptr<BuildJob> &job)
+	{
+		Root::getSingleton().getWorkQueue()->addRequest(channel, 0, Any(job));
+	}
+
+	WorkQueue::Response* handleRequest(const WorkQueue::Request *req, const WorkQueue *srcQ) override
+	{
+		any_cast<std::shared_ptr<BuildJob>>(req->getData())->fill();
+		return OGRE_NEW WorkQueue::Response(req, true, Any());
+	}
+
+	void handleResponse(const WorkQueue::Response *res, const WorkQueue *srcQ) override
+	{
+		any_cast<std::shared_ptr<BuildJob>>(res->getRequest()->getData())->finish();
+	}
+
+private:
+	uint16 channel;
+};
+
+bool BatchedGeometry::prepareBuild()
 {
 	//Make sure the batch hasn't already been built
-	if (built)
+	if (built || buildJob)
 		OGRE_EXCEPT(Exception::ERR_DUPLICATE_ITEM, "Invalid call to build() - geometry is already batched (call clear() first)", "BatchedGeometry::GeomBatch::build()");
 
-	if (subBatchMap.size() != 0) {
-		//Finish bounds information
-		center = bounds.getCenter();			//Calculate bounds center
-		bounds.setMinimum(bounds.getMinimum() - center);	//Center the bounding box
-		bounds.setMaximum(bounds.getMaximum() - center);	//Center the bounding box
-		radius = bounds.getMaximum().length();	//Calculate BB radius
-		
-		//Create scene node
-		sceneNode = parentSceneNode->createChildSceneNode(center);
+	if (subBatchMap.size() == 0)
+		return false;
 
+	//Finish bounds information
+	center = bounds.getCenter();			//Calculate bounds center
+	bounds.setMinimum(bounds.getMinimum() - center);	//Center the bounding box
+	bounds.setMaximum(bounds.getMaximum() - center);	//Center the bounding box
+	radius = bounds.getMaximum().length();	//Calculate BB radius
+
+	//Create scene node
+	sceneNode = parentSceneNode->createChildSceneNode(center);
+	return true;
+}
+
+void BatchedGeometry::build()
+{
+	if (prepareBuild()) {
 		//Build each batch
 		for (SubBatchMap::iterator i = subBatchMap.begin(); i != subBatchMap.end(); ++i){
 			i->second->build();
@@ -312,8 +410,46 @@ void BatchedGeometry::build()
 	
 }
 
+void BatchedGeometry::buildInBackground()
+{
+	if (prepareBuild()) {
+		std::shared_ptr<BuildJob> job = std::make_shared<BuildJob>(this);
+		for (SubBatchMap::iterator i = subBatchMap.begin(); i != subBatchMap.end(); ++i){
+			i->second->prepareBuild();
+			job->buildData.push_back(i->second->getBuildData());
+		}
+
+		if (!buildHandler)
+			buildHandler = BuildHandler::getInstance();
+
+		//Set before submitting, since a work queue without threads handles the request right away.
+		buildJob = job;
+		buildHandler->submit(job);
+	}
+}
+
+void BatchedGeometry::finishBuild()
+{
+	buildJob.reset();
+
+	for (SubBatchMap::iterator i = subBatchMap.begin(); i != subBatchMap.end(); ++i){
+		i->second->upload();
+	}
+
+	//Attach the batch to the scene node
+	sceneNode->attachObject(this);
+
+	built = true;
+}
+
 void BatchedGeometry::clear()
 {
+	//Make sure that a pending background build doesn't touch the batches
+	if (buildJob){
+		buildJob->cancel();
+		buildJob.reset();
+	}
+
 	//Remove the batch from the scene
 	if (sceneNode){
 		sceneNode->removeAllChildren();
@@ -483,182 +619,186 @@ void BatchedGeometry::SubBatch::addSubEntity(SubEntity *ent, const Vector3 &posi
 }
 
 void BatchedGeometry::SubBatch::build()
+{
+	prepareBuild();
+	fillBuffers();
+	upload();
+}
+
+void BatchedGeometry::SubBatch::prepareBuild()
 {
 	assert(!built);
 
 	//Misc. setup
-	Vector3 batchCenter = parent->center;
+	std::shared_ptr<BuildData> data = std::make_shared<BuildData>();
+	data->batchCenter = parent->center;
+	data->vertexCount = vertexData->vertexCount;
+	data->indexCount = indexData->indexCount;
+	data->requireVertexColors = requireVertexColors;
 
 	HardwareIndexBuffer::IndexType srcIndexType = meshType->indexData->indexBuffer->getType();
-	HardwareIndexBuffer::IndexType destIndexType;
 	if (vertexData->vertexCount > 0xFFFF || srcIndexType == HardwareIndexBuffer::IT_32BIT)
-		destIndexType = HardwareIndexBuffer::IT_32BIT;
-	else
-		destIndexType = HardwareIndexBuffer::IT_16BIT;
-
-	//Allocate the index buffer
-	indexData->indexBuffer = HardwareBufferManager::getSingleton()
-		.createIndexBuffer(destIndexType, indexData->indexCount, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-
-	//Lock the index buffer
-	uint32 *indexBuffer32;
-	uint16 *indexBuffer16;
-	if (destIndexType == HardwareIndexBuffer::IT_32BIT)
-		indexBuffer32 = static_cast<uint32*>(indexData->indexBuffer->lock(HardwareBuffer::HBL_DISCARD));
+		data->destIndexType = HardwareIndexBuffer::IT_32BIT;
 	else
-		indexBuffer16 = static_cast<uint16*>(indexData->indexBuffer->lock(HardwareBuffer::HBL_DISCARD));
-
-	//Allocate & lock the vertex buffers
-	std::vector<uchar*> vertexBuffers;
-	std::vector<VertexDeclaration::VertexElementList> vertexBufferElements;
+		data->destIndexType = HardwareIndexBuffer::IT_16BIT;
 
 	VertexBufferBinding *vertBinding = vertexData->vertexBufferBinding;
 	VertexDeclaration *vertDecl = vertexData->vertexDeclaration;
 
-	for (Ogre::ushort i = 0; i < vertBinding->getBufferCount(); ++i)
-	{
-		HardwareVertexBufferSharedPtr buffer = HardwareBufferManager::getSingleton()
-			.createVertexBuffer(vertDecl->getVertexSize(i), vertexData->vertexCount, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-		vertBinding->setBinding(i, buffer);
-		
-		vertexBuffers.push_back(static_cast<uchar*>(buffer->lock(HardwareBuffer::HBL_DISCARD)));
-		vertexBufferElements.push_back(vertDecl->findElementsBySource(i));
-	}
+	//The buffers of the meshes; any buffer after these is filled with the color of each mesh
+	Ogre::ushort sourceBufferCount = (Ogre::ushort)vertBinding->getBufferCount();
+	Ogre::ushort bufferCount = sourceBufferCount;
 
 	//If no vertex colors are used, make sure the final batch includes them (so the shade values work)
 	if (requireVertexColors) {
-		if (!vertexData->vertexDeclaration->findElementBySemantic(VES_DIFFUSE)) {
-			Ogre::ushort i = (Ogre::ushort)vertBinding->getBufferCount();
+		if (!vertDecl->findElementBySemantic(VES_DIFFUSE)) {
+			vertDecl->addElement(bufferCount, 0, VET_COLOUR, VES_DIFFUSE);
+			++bufferCount;
+		}
 
-			vertDecl->addElement(i, 0, VET_COLOUR, VES_DIFFUSE);
+		Pass *p = material->getTechnique(0)->getPass(0);
+		p->setVertexColourTracking(TVC_AMBIENT);
+	}
 
-			HardwareVertexBufferSharedPtr buffer = HardwareBufferManager::getSingleton()
-				.createVertexBuffer(vertDecl->getVertexSize(i), vertexData->vertexCount, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
-			vertBinding->setBinding(i, buffer);
-			
-			vertexBuffers.push_back(static_cast<uchar*>(buffer->lock(HardwareBuffer::HBL_DISCARD)));
-			vertexBufferElements.push_back(vertDecl->findElementsBySource(i));
+	//Work out which elements need to be transformed once, instead of for every vertex. Everything else is copied as is.
+	std::vector<BufferLayout> &bufferLayouts = data->bufferLayouts;
+	for (Ogre::ushort i = 0; i < bufferCount; ++i)
+	{
+		BufferLayout layout;
+		layout.vertexSize = vertDecl->getVertexSize(i);
+
+		const VertexDeclaration::VertexElementList elems = vertDecl->findElementsBySource(i);
+		for (VertexDeclaration::VertexElementList::const_iterator ei = elems.begin(); ei != elems.end(); ++ei)
+		{
+			const VertexElement &elem = *ei;
+			bool isFloatVector = elem.getType() == VET_FLOAT3 || elem.getType() == VET_FLOAT4;
+
+			ElementTransform transform;
+			transform.offset = elem.getOffset();
+			switch (elem.getSemantic())
+			{
+			case VES_POSITION:
+				if (!isFloatVector)
+					continue;
+				transform.type = ElementTransform::Position;
+				break;
+
+			case VES_NORMAL:
+			case VES_TANGENT:
+			case VES_BINORMAL:
+				if (!isFloatVector)
+					continue;
+				transform.type = ElementTransform::Vector;
+				break;
+
+			case VES_DIFFUSE:
+				//Only the meshes' own colors are modulated; an added color buffer is filled instead.
+				if (i >= sourceBufferCount || (elem.getType() != VET_COLOUR && elem.getType() != VET_COLOUR_ARGB && elem.getType() != VET_COLOUR_ABGR))
+					continue;
+				transform.type = ElementTransform::Colour;
+				break;
 
+			default:
+				continue;
+			}
+			layout.transforms.push_back(transform);
 		}
+		bufferLayouts.push_back(layout);
+	}
 
-		Pass *p = material->getTechnique(0)->getPass(0);
-		p->setVertexColourTracking(TVC_AMBIENT);
+	//Copy the vertices and indices of each distinct SubMesh, since hardware buffers can only be read here.
+	//Batches are mostly made up of many instances of the same few meshes, so this is done once per mesh rather than per instance.
+	std::map<SubMesh*, SourceGeometry> &sourceGeometries = data->sourceGeometries;
+	for (MeshQueueIterator it = meshQueue.begin(); it != meshQueue.end(); ++it) {
+		if (sourceGeometries.find(it->mesh) != sourceGeometries.end())
+			continue;
+
+		const VertexData *sourceVertexData = it->mesh->vertexData;
+		const IndexData *sourceIndexData = it->mesh->indexData;
+		SourceGeometry &source = sourceGeometries[it->mesh];
+		source.vertexCount = sourceVertexData->vertexCount;
+		source.indexCount = sourceIndexData->indexCount;
+
+		VertexBufferBinding *sourceBinds = sourceVertexData->vertexBufferBinding;
+		Ogre::ushort copiedBufferCount = std::min(sourceBufferCount, (Ogre::ushort)sourceBinds->getBufferCount());
+		source.vertexBuffers.resize(copiedBufferCount);
+		for (Ogre::ushort i = 0; i < copiedBufferCount; ++i)
+		{
+			HardwareVertexBufferSharedPtr sourceBuffer = sourceBinds->getBuffer(i);
+			size_t vertexSize = sourceBuffer->getVertexSize();
+			assert(vertexSize == bufferLayouts[i].vertexSize && "Batched meshes must have the same vertex format");
+			source.vertexBuffers[i].resize(vertexSize * source.vertexCount);
+			sourceBuffer->readData(sourceVertexData->vertexStart * vertexSize, source.vertexBuffers[i].size(), source.vertexBuffers[i].data());
+		}
+
+		HardwareIndexBufferSharedPtr sourceIndexBuffer = sourceIndexData->indexBuffer;
+		size_t indexSize = sourceIndexBuffer->getIndexSize();
+		source.indices32Bit = sourceIndexBuffer->getType() == HardwareIndexBuffer::IT_32BIT;
+		source.indices.resize(indexSize * source.indexCount);
+		sourceIndexBuffer->readData(sourceIndexData->indexStart * indexSize, source.indices.size(), source.indices.data());
 	}
 
+	//The queue is handed over to the build, since it's cleared once the batch has been built anyway.
+	data->meshQueue.swap(meshQueue);
+	buildData = data;
+}
+
+void BatchedGeometry::SubBatch::fillBuffers()
+{
+	buildData->fill();
+}
+
+void BatchedGeometry::SubBatch::BuildData::fill()
+{
+	size_t destIndexSize = (destIndexType == HardwareIndexBuffer::IT_32BIT) ? sizeof(uint32) : sizeof(uint16);
+	filledIndices.resize(indexCount * destIndexSize);
+	filledVertexBuffers.resize(bufferLayouts.size());
+	std::vector<uchar*> vertexBuffers;
+	for (size_t i = 0; i < bufferLayouts.size(); ++i) {
+		filledVertexBuffers[i].resize(bufferLayouts[i].vertexSize * vertexCount);
+		vertexBuffers.push_back(filledVertexBuffers[i].data());
+	}
+	uchar *indexBuffer = filledIndices.data();
+
 	//For each queued mesh...
-	MeshQueueIterator it;
-	size_t indexOffset = 0;
-	for (it = meshQueue.begin(); it != meshQueue.end(); ++it) {
-		const QueuedMesh queuedMesh = (*it);
-		const IndexData *sourceIndexData = queuedMesh.mesh->indexData;
-		const VertexData *sourceVertexData = queuedMesh.mesh->vertexData;
-
-		//Copy mesh vertex data into the vertex buffer
-		VertexBufferBinding *sourceBinds = sourceVertexData->vertexBufferBinding;
-		VertexBufferBinding *destBinds = vertexData->vertexBufferBinding;
-		for (Ogre::ushort i = 0; i < destBinds->getBufferCount(); ++i)
+	uint32 indexOffset = 0;
+	for (MeshQueueIterator it = meshQueue.begin(); it != meshQueue.end(); ++it) {
+		const QueuedMesh &queuedMesh = *it;
+		const SourceGeometry &source = sourceGeometries.find(queuedMesh.mesh)->second;
+		const BatchKernels::InstanceTransform transform = BatchKernels::makeInstanceTransform(queuedMesh.orientation, queuedMesh.scale, queuedMesh.position - batchCenter);
+
+		//Copy mesh vertex data into the vertex buffers
+		for (size_t i = 0; i < bufferLayouts.size(); ++i)
 		{
-			if (i < sourceBinds->getBufferCount()){
-				//Lock the input buffer
-				HardwareVertexBufferSharedPtr sourceBuffer = sourceBinds->getBuffer(i);
-				uchar *sourceBase = static_cast<uchar*>(sourceBuffer->lock(HardwareBuffer::HBL_READ_ONLY));
+			const BufferLayout &layout = bufferLayouts[i];
+			uchar *destBase = vertexBuffers[i];
 
-				//Get the locked output buffer
-				uchar *destBase = vertexBuffers[i];
+			if (i < source.vertexBuffers.size()) {
+				//Copy all vertices as they are, and then overwrite the elements which are transformed
+				const uchar *sourceBase = source.vertexBuffers[i].data();
+				memcpy(destBase, sourceBase, source.vertexBuffers[i].size());
 
-				//Copy vertices
-				float *sourcePtr, *destPtr;
-				for (size_t v = 0; v < sourceVertexData->vertexCount; ++v)
+				for (std::vector<ElementTransform>::const_iterator ti = layout.transforms.begin(); ti != layout.transforms.end(); ++ti)
 				{
-					// Iterate over vertex elements
-					VertexDeclaration::VertexElementList &elems = vertexBufferElements[i];
-					VertexDeclaration::VertexElementList::iterator ei;
-					for (ei = elems.begin(); ei != elems.end(); ++ei)
+					switch (ti->type)
 					{
-						VertexElement &elem = *ei;
-						elem.baseVertexPointerToElement(sourceBase, &sourcePtr);
-						elem.baseVertexPointerToElement(destBase, &destPtr);
-
-						Vector3 tmp;
-						uint32 tmpColor;
-						uint8 tmpR, tmpG, tmpB, tmpA;
-
-						switch (elem.getSemantic())
-						{
-						case VES_POSITION:
-							tmp.x = *sourcePtr++;
-							tmp.y = *sourcePtr++;
-							tmp.z = *sourcePtr++;
-							
-							//Transform
-							tmp = (queuedMesh.orientation * (tmp * queuedMesh.scale)) + queuedMesh.position;
-							tmp -= batchCenter;		//Adjust for batch center
-
-							*destPtr++ = tmp.x;
-							*destPtr++ = tmp.y;
-							*destPtr++ = tmp.z;
-							break;
-
-						case VES_NORMAL:
-							tmp.x = *sourcePtr++;
-							tmp.y = *sourcePtr++;
-							tmp.z = *sourcePtr++;
-
-							//Rotate
-							tmp = queuedMesh.orientation * tmp;
-
-							*destPtr++ = tmp.x;
-							*destPtr++ = tmp.y;
-							*destPtr++ = tmp.z;
-							break;
-
-						case VES_DIFFUSE:
-							tmpColor = *((uint32*)sourcePtr++);
-							tmpR = ((tmpColor) & 0xFF) * queuedMesh.color.r;
-							tmpG = ((tmpColor >> 8) & 0xFF) * queuedMesh.color.g;
-							tmpB = ((tmpColor >> 16) & 0xFF) * queuedMesh.color.b;
-							tmpA = (tmpColor >> 24) & 0xFF;
-
-							tmpColor = tmpR | (tmpG << 8) | (tmpB << 16) | (tmpA << 24);
-							*((uint32*)destPtr++) = tmpColor;
-							break;
-
-						case VES_TANGENT:
-						case VES_BINORMAL:
-							tmp.x = *sourcePtr++;
-							tmp.y = *sourcePtr++;
-							tmp.z = *sourcePtr++;
-
-							//Rotate
-							tmp = queuedMesh.orientation * tmp;
-
-							*destPtr++ = tmp.x;
-							*destPtr++ = tmp.y;
-							*destPtr++ = tmp.z;
-							break;
-
-						default:
-							//Raw copy
-							memcpy(destPtr, sourcePtr, VertexElement::getTypeSize(elem.getType()));
-							break;
-						};
+					case ElementTransform::Position:
+						BatchKernels::transformPositions(sourceBase + ti->offset, destBase + ti->offset, layout.vertexSize, source.vertexCount, transform);
+						break;
+
+					case ElementTransform::Vector:
+						BatchKernels::rotateVectors(sourceBase + ti->offset, destBase + ti->offset, layout.vertexSize, source.vertexCount, transform);
+						break;
+
+					case ElementTransform::Colour:
+						if (queuedMesh.color != ColourValue::White)
+							BatchKernels::modulateColours(sourceBase + ti->offset, destBase + ti->offset, layout.vertexSize, source.vertexCount, queuedMesh.color);
+						break;
 					}
-
-					// Increment both pointers
-					destBase += sourceBuffer->getVertexSize();
-					sourceBase += sourceBuffer->getVertexSize();
 				}
-
-				//Unlock the input buffer
-				vertexBuffers[i] = destBase;
-				sourceBuffer->unlock();
 			} else {
 				assert(requireVertexColors);
 
-				//Get the locked output buffer
-				uint32 *startPtr = (uint32*)vertexBuffers[vertBinding->getBufferCount()-1];
-				uint32 *endPtr = startPtr + sourceVertexData->vertexCount;
-				
 				//Generate color
 				uint8 tmpR = queuedMesh.color.r * 255;
 				uint8 tmpG = queuedMesh.color.g * 255;
@@ -666,78 +806,51 @@ void BatchedGeometry::SubBatch::build()
 				uint32 tmpColor = tmpR | (tmpG << 8) | (tmpB << 16) | (0xFF << 24);
 
 				//Copy colors
-				while (startPtr < endPtr) {
-					*startPtr++ = tmpColor;
-				}
-
-				vertexBuffers[vertBinding->getBufferCount()-1] += (sizeof(uint32) * sourceVertexData->vertexCount);
+				uint32 *startPtr = (uint32*)destBase;
+				std::fill(startPtr, startPtr + source.vertexCount, tmpColor);
 			}
-		}
 
+			vertexBuffers[i] += layout.vertexSize * source.vertexCount;
+		}
 
 		//Copy mesh index data into the index buffer
-		if (srcIndexType == HardwareIndexBuffer::IT_32BIT) {
-			//Lock the input buffer
-			uint32 *source = static_cast<uint32*>(sourceIndexData->indexBuffer->lock(
-				sourceIndexData->indexStart, sourceIndexData->indexCount, HardwareBuffer::HBL_READ_ONLY
-				));
-			uint32 *sourceEnd = source + sourceIndexData->indexCount;
-
-			//And copy it to the output buffer
-			while (source != sourceEnd) {
-				*indexBuffer32++ = static_cast<uint32>(*source++ + indexOffset);
-			}
-			
-			//Unlock the input buffer
-			sourceIndexData->indexBuffer->unlock();
-
-			//Increment the index offset
-			indexOffset += sourceVertexData->vertexCount;
+		if (source.indices32Bit) {
+			BatchKernels::offsetIndices((const uint32*)source.indices.data(), (uint32*)indexBuffer, source.indexCount, indexOffset);
+		} else if (destIndexType == HardwareIndexBuffer::IT_32BIT) {
+			//-- Convert 16 bit to 32 bit indices --
+			BatchKernels::offsetIndices((const uint16*)source.indices.data(), (uint32*)indexBuffer, source.indexCount, indexOffset);
 		} else {
-			if (destIndexType == HardwareIndexBuffer::IT_32BIT){
-				//-- Convert 16 bit to 32 bit indices --
-				//Lock the input buffer
-				uint16 *source = static_cast<uint16*>(sourceIndexData->indexBuffer->lock(
-					sourceIndexData->indexStart, sourceIndexData->indexCount, HardwareBuffer::HBL_READ_ONLY
-					));
-				uint16 *sourceEnd = source + sourceIndexData->indexCount;
-
-				//And copy it to the output buffer
-				while (source != sourceEnd) {
-					uint32 indx = *source++;
-					*indexBuffer32++ = (indx + indexOffset);
-				}
+			BatchKernels::offsetIndices((const uint16*)source.indices.data(), (uint16*)indexBuffer, source.indexCount, indexOffset);
+		}
+		indexBuffer += source.indexCount * destIndexSize;
 
-				//Unlock the input buffer
-				sourceIndexData->indexBuffer->unlock();
+		//Increment the index offset
+		indexOffset += (uint32)source.vertexCount;
+	}
 
-				//Increment the index offset
-				indexOffset += sourceVertexData->vertexCount;
-			} else {
-				//Lock the input buffer
-				uint16 *source = static_cast<uint16*>(sourceIndexData->indexBuffer->lock(
-					sourceIndexData->indexStart, sourceIndexData->indexCount, HardwareBuffer::HBL_READ_ONLY
-					));
-				uint16 *sourceEnd = source + sourceIndexData->indexCount;
-
-				//And copy it to the output buffer
-				while (source != sourceEnd) {
-					*indexBuffer16++ = static_cast<uint16>(*source++ + indexOffset);
-				}
+	//The copies of the meshes aren't needed any more
+	sourceGeometries.clear();
+}
 
-				//Unlock the input buffer
-				sourceIndexData->indexBuffer->unlock();
+void BatchedGeometry::SubBatch::upload()
+{
+	//Allocate and fill the index buffer
+	indexData->indexBuffer = HardwareBufferManager::getSingleton()
+		.createIndexBuffer(buildData->destIndexType, indexData->indexCount, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+	indexData->indexBuffer->writeData(0, buildData->filledIndices.size(), buildData->filledIndices.data(), true);
 
-				//Increment the index offset
-				indexOffset += sourceVertexData->vertexCount;
-			}
-		}
+	//Allocate and fill the vertex buffers
+	VertexBufferBinding *vertBinding = vertexData->vertexBufferBinding;
+	for (Ogre::ushort i = 0; i < buildData->bufferLayouts.size(); ++i)
+	{
+		HardwareVertexBufferSharedPtr buffer = HardwareBufferManager::getSingleton()
+			.createVertexBuffer(buildData->bufferLayouts[i].vertexSize, vertexData->vertexCount, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+		buffer->writeData(0, buildData->filledVertexBuffers[i].size(), buildData->filledVertexBuffers[i].data(), true);
+		vertBinding->setBinding(i, buffer);
 	}
 
-	//Unlock buffers
-	indexData->indexBuffer->unlock();
-	for (Ogre::ushort i = 0; i < vertBinding->getBufferCount(); ++i)
-		vertBinding->getBuffer(i)->unlock();
+	//Free the memory
+	buildData.reset();
 
 	//Clear mesh queue
 	meshQueue.clear();
@@ -760,8 +873,9 @@ void BatchedGeometry::SubBatch::clear()
 		indexData->indexCount = 0;
 	}
 
-	//Clear mesh queue
+	//Clear mesh queue, and drop any pending build
 	meshQueue.clear();
+	buildData.reset();
 
 	built = false;
 }
@@ -0,0 +1,482 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "LodCache.h"
+
+#include "framework/Hasher.h"
+#include "framework/LoggingInstance.h"
+
+#include <OgreHardwareBufferManager.h>
+#include <OgreLodStrategy.h>
+#include <OgreMesh.h>
+#include <OgreResourceGroupManager.h>
+#include <OgreRoot.h>
+#include <OgreSubMesh.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace Ember
+{
+namespace OgreView
+{
+namespace Lod
+{
+
+namespace
+{
+
+/**
+ * @brief Identifies a cached Lod file, and its version.
+ */
+const std::uint32_t LodMagic = 0x454c4431; // "ELD1"
+
+/**
+ * @brief Included in all keys, so that it can be bumped if the way keys are calculated changes.
+ */
+const std::uint64_t KeyVersion = 2;
+
+struct LodHeader
+{
+	std::uint32_t magic;
+	std::uint32_t levelCount;
+	std::uint32_t subMeshCount;
+};
+
+struct IndexHeader
+{
+	std::uint32_t indexCount;
+	std::uint32_t is32Bit;
+};
+
+/**
+ * @brief Reads values from a buffer, keeping track of how much is left.
+ */
+class Reader
+{
+public:
+	explicit Reader(const std::vector<char>& buffer) : mPosition(buffer.data()), mEnd(buffer.data() + buffer.size())
+	{
+	}
+
+	const char* read(size_t size)
+	{
+		if (static_cast<size_t>(mEnd - mPosition) < size) {
+			return nullptr;
+		}
+		const char* data = mPosition;
+		mPosition += size;
+		return data;
+	}
+
+	template<typename T>
+	bool read(T& value)
+	{
+		const char* data = read(sizeof(T));
+		if (!data) {
+			return false;
+		}
+		std::memcpy(&value, data, sizeof(T));
+		return true;
+	}
+
+	bool isAtEnd() const
+	{
+		return mPosition == mEnd;
+	}
+
+private:
+	const char* mPosition;
+	const char* mEnd;
+};
+
+std::uint64_t hashMeshName(const std::string& meshName)
+{
+	Hasher hasher;
+	hasher.add(meshName);
+	return hasher.get();
+}
+
+}
+
+/**
+ * @brief A request to look up or store the levels of a mesh in the background.
+ */
+struct LodCache::Job
+{
+	enum class Type
+	{
+		Load,
+		Store
+	};
+
+	Type type;
+	Ogre::LodConfig lodConfig;
+
+	/**
+	 * @brief The name and group of the mesh, copied on the main thread.
+	 */
+	std::string meshName;
+	std::string meshGroup;
+
+	std::uint64_t key;
+	LodLevels levels;
+	bool found;
+	LoadCallback callback;
+};
+
+LodCache::LodCache(std::string directory) :
+		mDirectory(std::move(directory)),
+		mChannel(0),
+		mTemporaryFileCounter(0)
+{
+	scanDirectory();
+	Ogre::WorkQueue* workQueue = Ogre::Root::getSingleton().getWorkQueue();
+	mChannel = workQueue->getChannel("Ember/LodCache");
+	workQueue->addRequestHandler(mChannel, this);
+	workQueue->addResponseHandler(mChannel, this);
+}
+
+LodCache::~LodCache()
+{
+	Ogre::WorkQueue* workQueue = Ogre::Root::getSingleton().getWorkQueue();
+	workQueue->abortRequestsByChannel(mChannel);
+	workQueue->removeRequestHandler(mChannel, this);
+	workQueue->removeResponseHandler(mChannel, this);
+}
+
+std::uint64_t LodCache::createKey(Ogre::DataStream& meshStream, const Ogre::LodConfig& lodConfig)
+{
+	Hasher hasher(KeyVersion);
+	//Another version of the MeshLodGenerator might reduce the same mesh differently.
+	hasher.add(static_cast<std::uint32_t>(OGRE_VERSION));
+	char buffer[16384];
+	while (!meshStream.eof()) {
+		size_t read = meshStream.read(buffer, sizeof(buffer));
+		if (read == 0) {
+			break;
+		}
+		hasher.add(buffer, read);
+	}
+
+	hasher.add(lodConfig.strategy ? lodConfig.strategy->getName() : std::string());
+	for (auto& level : lodConfig.levels) {
+		hasher.add(level.distance);
+		hasher.add(static_cast<int>(level.reductionMethod));
+		hasher.add(level.reductionValue);
+		hasher.add(level.manualMeshName);
+	}
+	hasher.add(lodConfig.advanced.useCompression);
+	hasher.add(lodConfig.advanced.useVertexNormals);
+	hasher.add(lodConfig.advanced.outsideWeight);
+	hasher.add(lodConfig.advanced.outsideWalkAngle);
+	return hasher.get();
+}
+
+std::string LodCache::getPath(const std::string& meshName, std::uint64_t key) const
+{
+	std::stringstream ss;
+	ss << mDirectory << "/" << std::hex << hashMeshName(meshName) << "_" << key << ".lod";
+	return ss.str();
+}
+
+void LodCache::load(const Ogre::LodConfig& lodConfig, LoadCallback callback)
+{
+	auto job = std::make_shared<Job>();
+	job->type = Job::Type::Load;
+	job->lodConfig = lodConfig;
+	job->meshName = lodConfig.mesh->getName();
+	job->meshGroup = lodConfig.mesh->getGroup();
+	job->key = 0;
+	job->found = false;
+	job->callback = std::move(callback);
+	Ogre::Root::getSingleton().getWorkQueue()->addRequest(mChannel, 0, Ogre::Any(job));
+}
+
+void LodCache::store(const Ogre::LodConfig& lodConfig, std::uint64_t key)
+{
+	auto job = std::make_shared<Job>();
+	if (!extractLevels(*lodConfig.mesh, job->levels)) {
+		return;
+	}
+	job->type = Job::Type::Store;
+	job->meshName = lodConfig.mesh->getName();
+	job->key = key;
+	job->found = false;
+	Ogre::Root::getSingleton().getWorkQueue()->addRequest(mChannel, 0, Ogre::Any(job));
+}
+
+Ogre::WorkQueue::Response* LodCache::handleRequest(const Ogre::WorkQueue::Request* req, const Ogre::WorkQueue* srcQ)
+{
+	auto job = Ogre::any_cast<std::shared_ptr<Job>>(req->getData());
+	if (job->type == Job::Type::Load) {
+		try {
+			//Opening resources from the work queue is safe, as Ogre does the same when preparing resources in the background.
+			Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(job->meshName, job->meshGroup);
+			job->key = createKey(*stream, job->lodConfig);
+			job->found = read(job->meshName, job->key, job->levels);
+		} catch (const Ogre::Exception&) {
+			//Meshes which aren't loaded from a file (such as manually created ones) can't be cached.
+			job->key = 0;
+		}
+	} else {
+		write(job->meshName, job->key, job->levels);
+	}
+	return OGRE_NEW Ogre::WorkQueue::Response(req, true, Ogre::Any());
+}
+
+void LodCache::handleResponse(const Ogre::WorkQueue::Response* res, const Ogre::WorkQueue* srcQ)
+{
+	auto job = Ogre::any_cast<std::shared_ptr<Job>>(res->getRequest()->getData());
+	if (job->type != Job::Type::Load || !job->lodConfig.mesh->isLoaded()) {
+		return;
+	}
+	bool loaded = false;
+	if (job->found) {
+		loaded = injectLevels(job->lodConfig, job->levels);
+		if (loaded) {
+			S_LOG_VERBOSE("Loaded " << job->levels.usages.size() << " Lod levels for mesh '" << job->meshName << "' from the cache.");
+		} else {
+			S_LOG_WARNING("Cached Lod levels don't match the mesh '" << job->meshName << "'; they will be regenerated.");
+		}
+	}
+	job->callback(job->lodConfig, job->key, loaded);
+}
+
+bool LodCache::read(const std::string& meshName, std::uint64_t key, LodLevels& levels)
+{
+	std::string path = getPath(meshName, key);
+	std::vector<char> buffer;
+	{
+		std::ifstream stream(path, std::ios::binary | std::ios::ate);
+		if (!stream) {
+			return false;
+		}
+		buffer.resize(static_cast<size_t>(stream.tellg()));
+		stream.seekg(0);
+		if (!stream.read(buffer.data(), buffer.size())) {
+			return false;
+		}
+	}
+
+	Reader reader(buffer);
+	LodHeader header{};
+	if (!reader.read(header) || header.magic != LodMagic || header.levelCount == 0) {
+		S_LOG_WARNING("Cached Lod file '" << path << "' is invalid.");
+		return false;
+	}
+
+	levels.subMeshCount = header.subMeshCount;
+	levels.usages.resize(header.levelCount);
+	for (auto& usage : levels.usages) {
+		if (!reader.read(usage)) {
+			return false;
+		}
+	}
+
+	levels.indices.resize(static_cast<size_t>(header.levelCount) * header.subMeshCount);
+	for (auto& indices : levels.indices) {
+		IndexHeader indexHeader{};
+		if (!reader.read(indexHeader)) {
+			return false;
+		}
+		size_t size = static_cast<size_t>(indexHeader.indexCount) * (indexHeader.is32Bit ? 4 : 2);
+		const char* data = reader.read(size);
+		if (!data) {
+			return false;
+		}
+		indices.count = indexHeader.indexCount;
+		indices.is32Bit = indexHeader.is32Bit != 0;
+		indices.data.assign(data, data + size);
+	}
+	if (!reader.isAtEnd()) {
+		return false;
+	}
+	setCurrentFile(meshName, path);
+	return true;
+}
+
+bool LodCache::write(const std::string& meshName, std::uint64_t key, const LodLevels& levels)
+{
+	std::string path = getPath(meshName, key);
+	//Write to a temporary file first, and then move it into place, so that an incomplete file never is read.
+	std::string tempPath = path + ".tmp" + std::to_string(mTemporaryFileCounter++);
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		LodHeader header{LodMagic, static_cast<std::uint32_t>(levels.usages.size()), levels.subMeshCount};
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (auto& usage : levels.usages) {
+			stream.write(reinterpret_cast<const char*>(&usage), sizeof(usage));
+		}
+		for (auto& indices : levels.indices) {
+			IndexHeader indexHeader{indices.count, indices.is32Bit};
+			stream.write(reinterpret_cast<const char*>(&indexHeader), sizeof(indexHeader));
+			stream.write(indices.data.data(), indices.data.size());
+		}
+		if (!stream) {
+			S_LOG_WARNING("Could not write Lod levels to cache file '" << path << "'.");
+			stream.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	setCurrentFile(meshName, path);
+	return true;
+}
+
+void LodCache::setCurrentFile(const std::string& meshName, const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mCurrentFilesMutex);
+	auto& currentPath = mCurrentFiles[hashMeshName(meshName)];
+	if (currentPath != path) {
+		if (!currentPath.empty()) {
+			std::remove(currentPath.c_str());
+		}
+		currentPath = path;
+	}
+}
+
+void LodCache::scanDirectory()
+{
+	std::map<std::uint64_t, std::time_t> newestWriteTimes;
+	try {
+		boost::filesystem::path directory(mDirectory);
+		if (!boost::filesystem::is_directory(directory)) {
+			return;
+		}
+		for (boost::filesystem::directory_iterator I(directory), end; I != end; ++I) {
+			std::string fileName = I->path().filename().string();
+			//Build the path the same way as getPath() does, so that the paths can be compared.
+			std::string path = mDirectory + "/" + fileName;
+			std::string extension = I->path().extension().string();
+			if (extension.compare(0, 4, ".tmp") == 0) {
+				//Left behind by an interrupted write.
+				std::remove(path.c_str());
+				continue;
+			}
+			if (extension != ".lod") {
+				continue;
+			}
+			std::uint64_t meshHash, key;
+			if (std::sscanf(fileName.c_str(), "%" SCNx64 "_%" SCNx64, &meshHash, &key) != 2) {
+				//Written by an earlier version, which didn't name files by mesh.
+				std::remove(path.c_str());
+				continue;
+			}
+			std::time_t writeTime = boost::filesystem::last_write_time(I->path());
+			auto J = newestWriteTimes.find(meshHash);
+			if (J == newestWriteTimes.end()) {
+				newestWriteTimes.emplace(meshHash, writeTime);
+				mCurrentFiles.emplace(meshHash, path);
+			} else if (writeTime > J->second) {
+				std::remove(mCurrentFiles[meshHash].c_str());
+				J->second = writeTime;
+				mCurrentFiles[meshHash] = path;
+			} else {
+				std::remove(path.c_str());
+			}
+		}
+	} catch (const boost::filesystem::filesystem_error& e) {
+		S_LOG_WARNING("Could not scan Lod cache directory '" << mDirectory << "'." << e);
+	}
+}
+
+bool LodCache::extractLevels(const Ogre::Mesh& mesh, LodLevels& levels)
+{
+	if (mesh.getNumLodLevels() <= 1) {
+		return false;
+	}
+
+	levels.subMeshCount = mesh.getNumSubMeshes();
+	for (unsigned short level = 1; level < mesh.getNumLodLevels(); ++level) {
+		auto& meshUsage = mesh.getLodLevel(level);
+		levels.usages.push_back(LodLevels::Usage{meshUsage.userValue, meshUsage.value});
+	}
+	for (unsigned short level = 1; level < mesh.getNumLodLevels(); ++level) {
+		for (unsigned short subMeshIndex = 0; subMeshIndex < mesh.getNumSubMeshes(); ++subMeshIndex) {
+			auto subMesh = mesh.getSubMesh(subMeshIndex);
+			const Ogre::IndexData* indexData = subMesh->mLodFaceList.size() >= level ? subMesh->mLodFaceList[level - 1] : nullptr;
+			LodLevels::Indices indices{0, false, {}};
+			if (indexData && indexData->indexBuffer && indexData->indexCount > 0) {
+				auto& indexBuffer = indexData->indexBuffer;
+				const size_t indexSize = indexBuffer->getIndexSize();
+				indices.count = static_cast<std::uint32_t>(indexData->indexCount);
+				indices.is32Bit = indexBuffer->getType() == Ogre::HardwareIndexBuffer::IT_32BIT;
+				//The generated levels may share one buffer, so only the part used by this level is read.
+				auto data = static_cast<const char*>(indexBuffer->lock(indexData->indexStart * indexSize, indexData->indexCount * indexSize, Ogre::HardwareBuffer::HBL_READ_ONLY));
+				indices.data.assign(data, data + indexData->indexCount * indexSize);
+				indexBuffer->unlock();
+			}
+			levels.indices.push_back(std::move(indices));
+		}
+	}
+	return true;
+}
+
+bool LodCache::injectLevels(const Ogre::LodConfig& lodConfig, const LodLevels& levels)
+{
+	Ogre::Mesh& mesh = *lodConfig.mesh;
+	if (levels.subMeshCount != mesh.getNumSubMeshes()) {
+		return false;
+	}
+
+	mesh.removeLodLevels();
+	if (lodConfig.strategy) {
+		mesh.setLodStrategy(lodConfig.strategy);
+	}
+	const auto levelCount = static_cast<unsigned short>(levels.usages.size());
+	mesh._setLodInfo(static_cast<unsigned short>(levelCount + 1));
+	auto indicesIterator = levels.indices.begin();
+	for (unsigned short level = 1; level <= levelCount; ++level) {
+		Ogre::MeshLodUsage usage;
+		usage.userValue = levels.usages[level - 1].userValue;
+		usage.value = levels.usages[level - 1].value;
+		usage.edgeData = nullptr;
+		mesh._setLodUsage(level, usage);
+
+		for (unsigned short subMeshIndex = 0; subMeshIndex < levels.subMeshCount; ++subMeshIndex, ++indicesIterator) {
+			auto& indices = *indicesIterator;
+			auto indexData = OGRE_NEW Ogre::IndexData();
+			indexData->indexStart = 0;
+			indexData->indexCount = indices.count;
+			if (indices.count > 0) {
+				auto indexType = indices.is32Bit ? Ogre::HardwareIndexBuffer::IT_32BIT : Ogre::HardwareIndexBuffer::IT_16BIT;
+				indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(indexType, indices.count,
+																									   mesh.getIndexBufferUsage(), mesh.isIndexBufferShadowed());
+				indexData->indexBuffer->writeData(0, indexData->indexBuffer->getSizeInBytes(), indices.data.data(), true);
+			}
+			mesh._setSubMeshLodFaceList(subMeshIndex, level, indexData);
+		}
+	}
+	return true;
+}
+
+}
+}
+}
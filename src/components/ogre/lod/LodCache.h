@@ -0,0 +1,223 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef LODCACHE_H
+#define LODCACHE_H
+
+#include <MeshLodGenerator/OgreLodConfig.h>
+#include <OgreWorkQueue.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Ember
+{
+namespace OgreView
+{
+namespace Lod
+{
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Caches automatically generated Lod levels on disk, so that they don't need to be generated again the next time a mesh is loaded.
+ *
+ * Reducing a mesh is an expensive edge collapse pass over all of its vertices. Since neither the meshes nor the Lod definitions
+ * change often, the index buffers of the generated levels are stored in a cache directory. Each file is keyed by a hash of the
+ * contents of the mesh file, the Lod configuration and the Ogre version (as another version of the MeshLodGenerator might reduce
+ * the mesh differently). Only the latest file of each mesh is kept; any file it supersedes is removed when it's written, and
+ * when the cache is created.
+ *
+ * Hashing the mesh file and reading and writing cache files are done in Ogre's work queue. Only the index buffers, which can't
+ * be touched from other threads, are created and read on the main thread.
+ *
+ * Only the index buffers and the Lod usages are stored, since the generated levels share the vertices of the full detail mesh.
+ */
+class LodCache : public Ogre::WorkQueue::RequestHandler, public Ogre::WorkQueue::ResponseHandler
+{
+public:
+
+	/**
+	 * @brief The Lod levels of a mesh, as stored in a cache file.
+	 */
+	struct LodLevels
+	{
+		struct Usage
+		{
+			float userValue;
+			float value;
+		};
+
+		struct Indices
+		{
+			std::uint32_t count;
+			bool is32Bit;
+			std::vector<char> data;
+		};
+
+		std::uint32_t subMeshCount;
+
+		/**
+		 * @brief The usage of each level, not including the full detail level.
+		 */
+		std::vector<Usage> usages;
+
+		/**
+		 * @brief The indices of each submesh, for each level in turn.
+		 */
+		std::vector<Indices> indices;
+	};
+
+	/**
+	 * @brief Called on the main thread once the levels of a mesh have been looked up.
+	 *
+	 * The arguments are the configuration which was looked up, the key to pass to store() once the levels have been generated,
+	 * and whether the levels were loaded into the mesh. The key is 0 if the mesh can't be cached.
+	 */
+	typedef std::function<void(Ogre::LodConfig&, std::uint64_t, bool)> LoadCallback;
+
+	/**
+	 * @brief Ctor.
+	 * Any files which have been superseded, or which were left behind by an interrupted write, are removed.
+	 * @param directory The directory in which cached files are stored. It must already exist.
+	 */
+	explicit LodCache(std::string directory);
+
+	/**
+	 * @brief Dtor.
+	 * Any requests which haven't been handled yet are discarded.
+	 */
+	~LodCache() override;
+
+	/**
+	 * @brief Looks up the Lod levels of a mesh in the background, and loads them into the mesh if they have been stored.
+	 * Any existing Lod levels of the mesh are replaced.
+	 * @param lodConfig The configuration which the levels are generated with. The mesh is taken from this.
+	 * @param callback Called once done. It's not called if the mesh has been unloaded in the meantime.
+	 */
+	void load(const Ogre::LodConfig& lodConfig, LoadCallback callback);
+
+	/**
+	 * @brief Stores the Lod levels of a mesh in the cache.
+	 * The index buffers are read right away, and the file is written in the background.
+	 * @param lodConfig The configuration which the levels were generated with. The mesh is taken from this.
+	 * @param key The key which was passed to the callback of load().
+	 */
+	void store(const Ogre::LodConfig& lodConfig, std::uint64_t key);
+
+	/**
+	 * @brief Calculates the key of a mesh file and a Lod configuration.
+	 * @param meshStream The contents of the mesh file. The stream is read to its end.
+	 * @param lodConfig The configuration.
+	 * @return A key.
+	 */
+	static std::uint64_t createKey(Ogre::DataStream& meshStream, const Ogre::LodConfig& lodConfig);
+
+	/**
+	 * @brief Reads the levels of a mesh from the cache.
+	 * This can be called from any thread.
+	 * @param meshName The name of the mesh.
+	 * @param key The key of the mesh file and the configuration.
+	 * @param levels The levels are read into this.
+	 * @return True if there was a valid file for the mesh and the key.
+	 */
+	bool read(const std::string& meshName, std::uint64_t key, LodLevels& levels);
+
+	/**
+	 * @brief Writes the levels of a mesh to the cache, removing any file of the mesh which it supersedes.
+	 * This can be called from any thread.
+	 * @param meshName The name of the mesh.
+	 * @param key The key of the mesh file and the configuration.
+	 * @param levels The levels.
+	 * @return True if the file was written.
+	 */
+	bool write(const std::string& meshName, std::uint64_t key, const LodLevels& levels);
+
+	Ogre::WorkQueue::Response* handleRequest(const Ogre::WorkQueue::Request* req, const Ogre::WorkQueue* srcQ) override;
+
+	void handleResponse(const Ogre::WorkQueue::Response* res, const Ogre::WorkQueue* srcQ) override;
+
+private:
+
+	struct Job;
+
+	const std::string mDirectory;
+
+	Ogre::uint16 mChannel;
+
+	/**
+	 * @brief The latest file of each mesh, keyed by the hash of the mesh name.
+	 */
+	std::map<std::uint64_t, std::string> mCurrentFiles;
+
+	/**
+	 * @brief Guards mCurrentFiles.
+	 */
+	std::mutex mCurrentFilesMutex;
+
+	/**
+	 * @brief Used for giving each temporary file a unique name, as files might be written from multiple threads.
+	 */
+	std::atomic<unsigned long> mTemporaryFileCounter;
+
+	/**
+	 * @brief Gets the path of the cache file for a mesh and a key.
+	 * @param meshName The name of the mesh.
+	 * @param key The key.
+	 * @return A path.
+	 */
+	std::string getPath(const std::string& meshName, std::uint64_t key) const;
+
+	/**
+	 * @brief Records the latest file of a mesh, removing the file it supersedes.
+	 * @param meshName The name of the mesh.
+	 * @param path The path of the latest file.
+	 */
+	void setCurrentFile(const std::string& meshName, const std::string& path);
+
+	/**
+	 * @brief Finds the latest file of each mesh in the directory, and removes all others.
+	 */
+	void scanDirectory();
+
+	/**
+	 * @brief Copies the generated Lod levels of a mesh from its index buffers. Must be called on the main thread.
+	 * @param mesh The mesh.
+	 * @param levels The levels are copied into this.
+	 * @return False if the mesh has no generated levels.
+	 */
+	static bool extractLevels(const Ogre::Mesh& mesh, LodLevels& levels);
+
+	/**
+	 * @brief Replaces the Lod levels of a mesh. Must be called on the main thread.
+	 * @param lodConfig The configuration which the levels were generated with. The mesh is taken from this.
+	 * @param levels The levels.
+	 * @return False if the levels don't match the mesh.
+	 */
+	static bool injectLevels(const Ogre::LodConfig& lodConfig, const LodLevels& levels);
+};
+
+}
+}
+}
+#endif // ifndef LODCACHE_H
@@ -21,9 +21,16 @@
  */
 
 #include "LodManager.h"
+#include "LodCache.h"
 #include "LodDefinitionManager.h"
+#include "PMInjectorSignaler.h"
 #include "ScaledPixelCountLodStrategy.h"
 
+#include "services/EmberServices.h"
+#include "services/config/ConfigService.h"
+#include "framework/LoggingInstance.h"
+#include "framework/osdir.h"
+
 #include <MeshLodGenerator/OgreMeshLodGenerator.h>
 #include <OgrePixelCountLodStrategy.h>
 #include <OgreDistanceLodStrategy.h>
@@ -40,6 +47,19 @@ namespace Lod
 
 LodManager::LodManager()
 {
+	auto& configService = EmberServices::getSingleton().getConfigService();
+	if (!configService.itemExists("graphics", "lodcache") || static_cast<bool>(configService.getValue("graphics", "lodcache"))) {
+		std::string directory = configService.getHomeDirectory(BaseDirType_CACHE) + "/lod/";
+		try {
+			oslink::directory osdir(directory);
+			if (!osdir.isExisting()) {
+				oslink::directory::mkdir(directory.c_str());
+			}
+			mCache.reset(new LodCache(directory));
+		} catch (const std::exception& ex) {
+			S_LOG_WARNING("Could not create directory for Lod cache; generated Lod levels won't be cached." << ex);
+		}
+	}
 }
 
 LodManager::~LodManager()
@@ -59,14 +79,14 @@ void LodManager::loadLod(Ogre::MeshPtr mesh)
 	} catch (const Ogre::FileNotFoundException& ex) {
 		// Exception is thrown if a mesh hasn't got a loddef.
 		// By default, use the automatic mesh lod management system.
-		Ogre::MeshLodGenerator::getSingleton().generateAutoconfiguredLodLevels(mesh);
+		loadAutomaticLod(mesh);
 	}
 }
 
 void LodManager::loadLod(Ogre::MeshPtr mesh, const LodDefinition& def)
 {
 	if (def.getUseAutomaticLod()) {
-		Ogre::MeshLodGenerator::getSingleton().generateAutoconfiguredLodLevels(mesh);
+		loadAutomaticLod(mesh);
 	} else if (def.getLodDistanceCount() == 0) {
 		mesh->removeLodLevels();
 		return;
@@ -91,7 +111,7 @@ void LodManager::loadLod(Ogre::MeshPtr mesh, const LodDefinition& def)
 			} else {
 				loadAutomaticLodImpl(data.rbegin(), data.rend(), lodConfig);
 			}
-			Ogre::MeshLodGenerator::getSingleton().generateLodLevels(lodConfig);
+			generateLodLevels(lodConfig);
 		} else {
 			// User created Lod
 
@@ -108,6 +128,56 @@ void LodManager::loadLod(Ogre::MeshPtr mesh, const LodDefinition& def)
 	}
 }
 
+void LodManager::loadAutomaticLod(Ogre::MeshPtr mesh)
+{
+	Ogre::LodConfig lodConfig;
+	Ogre::MeshLodGenerator::getSingleton().getAutoconfig(mesh, lodConfig);
+	generateLodLevels(lodConfig);
+}
+
+void LodManager::generateLodLevels(Ogre::LodConfig& lodConfig)
+{
+	if (!mCache) {
+		startGeneratingLodLevels(lodConfig, 0);
+		return;
+	}
+
+	// The full detail mesh is shown while the cache is looked up.
+	mCache->load(lodConfig, [this](Ogre::LodConfig& config, std::uint64_t key, bool loaded) {
+		if (loaded) {
+			// Let any listeners know that the levels are available, just as if they had been generated.
+			if (PMInjectorSignaler::getSingletonPtr()) {
+				PMInjectorSignaler::getSingleton().LodInjected.emit(&config);
+			}
+		} else {
+			startGeneratingLodLevels(config, key);
+		}
+	});
+}
+
+void LodManager::startGeneratingLodLevels(Ogre::LodConfig& lodConfig, std::uint64_t cacheKey)
+{
+	// Reducing a large mesh can take seconds, so it's done in the background while the full detail mesh is shown.
+	// The levels are injected into the mesh on the main thread once done, after which lodInjected() is called.
+	if (cacheKey != 0) {
+		mPendingMeshes[lodConfig.mesh->getName()] = cacheKey;
+	}
+	lodConfig.advanced.useBackgroundQueue = true;
+	Ogre::MeshLodGenerator::getSingleton().generateLodLevels(lodConfig);
+}
+
+void LodManager::lodInjected(Ogre::LodConfig* lodConfig)
+{
+	if (!mCache) {
+		return;
+	}
+	auto I = mPendingMeshes.find(lodConfig->mesh->getName());
+	if (I != mPendingMeshes.end()) {
+		mCache->store(*lodConfig, I->second);
+		mPendingMeshes.erase(I);
+	}
+}
+
 std::string LodManager::convertMeshNameToLodName(std::string meshName)
 {
 	size_t start = meshName.find_last_of("/\\");
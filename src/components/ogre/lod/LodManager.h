@@ -28,6 +28,11 @@
 #include "components/ogre/EmberOgrePrerequisites.h"
 #include "framework/Singleton.h"
 
+#include <sigc++/trackable.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
 
 namespace Ember
@@ -37,11 +42,18 @@ namespace OgreView
 namespace Lod
 {
 
+class LodCache;
+
 /**
  * @brief LodManager will assign Lod settings to meshes.
+ *
+ * Automatically reduced Lod levels are generated in the background, and the full detail mesh is used until they are done.
+ * Once generated they are stored in a LodCache, from which they are loaded the next time the same mesh is loaded with the
+ * same settings. The cache is looked up in the background too. It can be disabled by setting "graphics:lodcache" to false.
  */
 class LodManager :
-	public Ember::Singleton<LodManager>
+	public Ember::Singleton<LodManager>,
+	public virtual sigc::trackable
 {
 public:
 
@@ -72,8 +84,44 @@ public:
 	 */
 	void loadLod(Ogre::MeshPtr mesh, const LodDefinition& definition);
 
+	/**
+	 * @brief Called when Lod levels generated in the background have been injected into a mesh.
+	 * Levels which were requested through this instance are stored in the cache.
+	 * @param lodConfig The configuration which the levels were generated with.
+	 */
+	void lodInjected(Ogre::LodConfig* lodConfig);
+
 private:
 
+	/**
+	 * @brief Caches generated Lod levels. Null if caching is disabled.
+	 */
+	std::unique_ptr<LodCache> mCache;
+
+	/**
+	 * @brief The meshes for which Lod levels are being generated in the background, and the key to store their levels with.
+	 */
+	std::map<std::string, std::uint64_t> mPendingMeshes;
+
+	/**
+	 * @brief Generates automatically configured Lod levels for a mesh.
+	 * @param mesh The mesh.
+	 */
+	void loadAutomaticLod(Ogre::MeshPtr mesh);
+
+	/**
+	 * @brief Loads automatically reduced Lod levels from the cache, or else starts generating them in the background.
+	 * @param lodConfig The Lod configuration.
+	 */
+	void generateLodLevels(Ogre::LodConfig& lodConfig);
+
+	/**
+	 * @brief Starts generating automatically reduced Lod levels in the background.
+	 * @param lodConfig The Lod configuration.
+	 * @param cacheKey The key to store the levels in the cache with, or 0 if they shouldn't be stored.
+	 */
+	void startGeneratingLodLevels(Ogre::LodConfig& lodConfig, std::uint64_t cacheKey);
+
 	template<typename T>
 	void loadUserLodImpl(T it, T itEnd, Ogre::Mesh* mesh);
 	template<typename T>
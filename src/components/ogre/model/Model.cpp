@@ -24,6 +24,7 @@
 #include "Model.h"
 #include "SubModel.h"
 #include "SubModelPart.h"
+#include "ModelInstanceManager.h"
 #include "ParticleSystemBinding.h"
 
 #include "ModelDefinitionManager.h"
@@ -196,11 +197,6 @@ bool Model::createModelAssets() {
 			if (mesh) {
 				mesh->load();
 
-				//Instancing (currently) doesn't support HW skeletons, so we'll have to disable for any meshes with skeletons.
-				if (mesh->hasSkeleton()) {
-					mUseInstancing = false;
-				}
-
 				Ogre::Entity* entity;
 				if (!mName.empty()) {
 					entity = mManager.createEntity(mName + "/" + submodelDef->getMeshName(), mesh);
@@ -284,6 +280,11 @@ bool Model::createModelAssets() {
 					ModelPart& modelPart = mAssetCreationContext.mModelParts[part.getName()];
 					modelPart.addSubModelPart(&part);
 				}
+				//Meshes with skeletons can only be instanced if the bones can be read from a texture in the vertex shader, by all submeshes.
+				//This is checked once the materials of the submeshes have been set.
+				if (mUseInstancing && !ModelInstanceManager::canInstance(*entity)) {
+					mUseInstancing = false;
+				}
 				mAssetCreationContext.mSubmodels.insert(submodel);
 				timedLog.report("Created submodel.");
 
@@ -494,7 +495,8 @@ bool Model::addSubmodel(SubModel* submodel) {
 	}
 	auto result = mSubmodels.insert(submodel);
 	if (result.second) {
-		if (!mUseInstancing) {
+		//Entities with skeletons are kept even when instanced, since they drive the animations and hold anything attached to the bones.
+		if (!mUseInstancing || entity->hasSkeleton()) {
 			addMovable(entity);
 		}
 	}
@@ -895,6 +897,17 @@ bool Model::useInstancing() const {
 	return mUseInstancing;
 }
 
+void Model::updateInstancedAnimations() {
+	if (!mAnimatedInstancedEntities.empty()) {
+		auto animationStates = getAllAnimationStates();
+		if (animationStates) {
+			for (auto instancedEntity : mAnimatedInstancedEntities) {
+				ModelInstanceManager::copyAnimationStates(*animationStates, *instancedEntity);
+			}
+		}
+	}
+}
+
 void Model::doWithMovables(std::function<void(Ogre::MovableObject*, int)> callback) {
 	int i = 0;
 	for (auto movable : mMovableObjects) {
@@ -279,6 +279,14 @@ public:
 
 	bool useInstancing() const;
 
+	/**
+	 * @brief Copies the state of the animations to all instances with skeletons, so that they are posed as the model.
+	 *
+	 * This should be called each frame after the animations have been updated. Each model has its own animation states, so every
+	 * instance is animated independently even though they're rendered in the same batches.
+	 */
+	void updateInstancedAnimations();
+
 	/**
 	 * Applies the supplied callback to all movables.
 	 * @param callback
@@ -416,6 +424,11 @@ protected:
 	bool mLoaded;
 	AssetCreationContext mAssetCreationContext;
 	bool mUseInstancing;
+
+	/**
+	 * @brief All instances with skeletons, which need to have the animation states copied to them.
+	 */
+	std::vector<Ogre::InstancedEntity*> mAnimatedInstancedEntities;
 };
 
 inline const std::set<SubModel*>& Model::getSubmodels() const {
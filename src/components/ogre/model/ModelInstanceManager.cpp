@@ -0,0 +1,252 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ModelInstanceManager.h"
+
+#include "framework/LoggingInstance.h"
+
+#include <OgreAnimationState.h>
+#include <OgreEntity.h>
+#include <OgreHighLevelGpuProgramManager.h>
+#include <OgreInstanceManager.h>
+#include <OgreInstancedEntity.h>
+#include <OgreMaterialManager.h>
+#include <OgreMesh.h>
+#include <OgrePass.h>
+#include <OgreRenderSystem.h>
+#include <OgreRoot.h>
+#include <OgreSceneManager.h>
+#include <OgreSubEntity.h>
+#include <OgreTechnique.h>
+#include <boost/algorithm/string.hpp>
+
+#include <vector>
+
+namespace Ember {
+namespace OgreView {
+namespace Model {
+
+namespace {
+
+//We would like to use the HW based technique for static meshes, but as of 1.10.9 that causes corruption with the PSSM shadows.
+//Until that's fixed we instead use the Shader based technique, which performs worse.
+//The HW based technique uses the suffix "/Instanced/HW".
+const std::string StaticSuffix = "/Instanced/Shader";
+const Ogre::InstanceManager::InstancingTechnique StaticTechnique = Ogre::InstanceManager::ShaderBased;
+
+//Skinned meshes store the bone matrices of all instances in a texture.
+const std::string SkinnedSuffix = "/Instanced/VTF";
+const Ogre::InstanceManager::InstancingTechnique SkinnedTechnique = Ogre::InstanceManager::TextureVTF;
+
+const size_t InstancesPerBatch = 50;
+
+/**
+ * @brief Replaces the vertex program of the first pass of each technique with one with a suffix, if such a program exists.
+ * @return True if the vertex program of any technique was replaced.
+ */
+bool replaceVertexPrograms(Ogre::Material& material, const std::string& suffix) {
+	bool replaced = false;
+	for (auto* tech : material.getTechniques()) {
+		if (tech->getPasses().empty()) {
+			continue;
+		}
+		auto pass = tech->getPass(0);
+		if (pass->hasVertexProgram()) {
+			std::string vertexProgramName = pass->getVertexProgram()->getName() + suffix;
+			if (Ogre::HighLevelGpuProgramManager::getSingleton().resourceExists(vertexProgramName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME)) {
+				pass->setVertexProgram(vertexProgramName);
+				replaced = true;
+			}
+		}
+	}
+	return replaced;
+}
+
+/**
+ * @brief Checks whether the first pass of the best technique of a material has a vertex program with a suffix, or one which can be replaced by such.
+ */
+bool hasInstancedVertexProgram(Ogre::Material& material, const std::string& suffix) {
+	material.load();
+	auto tech = material.getBestTechnique();
+	if (!tech || tech->getPasses().empty() || !tech->getPass(0)->hasVertexProgram()) {
+		return false;
+	}
+	const std::string& vertexProgramName = tech->getPass(0)->getVertexProgramName();
+	return boost::algorithm::ends_with(vertexProgramName, suffix)
+		   || Ogre::HighLevelGpuProgramManager::getSingleton().resourceExists(vertexProgramName + suffix, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+}
+
+}
+
+bool ModelInstanceManager::canInstance(const Ogre::Entity& entity) {
+	if (!entity.hasSkeleton()) {
+		return true;
+	}
+	auto renderSystem = Ogre::Root::getSingleton().getRenderSystem();
+	if (!renderSystem || !renderSystem->getCapabilities()->hasCapability(Ogre::RSC_VERTEX_TEXTURE_FETCH)) {
+		return false;
+	}
+	for (size_t i = 0; i < entity.getNumSubEntities(); ++i) {
+		auto& material = entity.getSubEntity(i)->getMaterial();
+		if (!material || !hasInstancedVertexProgram(*material, SkinnedSuffix)) {
+			S_LOG_VERBOSE("No vertex texture skinning program available for a submesh of mesh '" << entity.getMesh()->getName() << "'; it won't be instanced.");
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string ModelInstanceManager::getInstancedMaterial(const std::string& materialName, const std::string& suffix) {
+	//Check if the material already is "instanced", i.e. has the suffix.
+	if (boost::algorithm::ends_with(materialName, suffix)) {
+		return materialName;
+	}
+
+	std::string instancedMaterialName = materialName + suffix;
+	auto& materialMgr = Ogre::MaterialManager::getSingleton();
+	if (materialMgr.resourceExists(instancedMaterialName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME)) {
+		return instancedMaterialName;
+	}
+
+	//Create a new material by cloning the original and replacing the vertex shader with one with the suffix,
+	//if such one is available and supported.
+	auto originalMaterial = materialMgr.getByName(materialName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	if (!originalMaterial) {
+		return "";
+	}
+	originalMaterial->load();
+	auto material = originalMaterial->clone(instancedMaterialName);
+	material->load();
+	replaceVertexPrograms(*material, suffix);
+
+	for (auto* tech : material->getTechniques()) {
+		auto shadowCasterMat = tech->getShadowCasterMaterial();
+		if (shadowCasterMat && !boost::algorithm::ends_with(shadowCasterMat->getName(), suffix)) {
+			std::string instancedShadowCasterMatName = shadowCasterMat->getName() + suffix;
+			auto shadowCasterMatInstanced = materialMgr.getByName(instancedShadowCasterMatName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+			if (!shadowCasterMatInstanced) {
+				shadowCasterMat->load();
+				shadowCasterMatInstanced = shadowCasterMat->clone(instancedShadowCasterMatName);
+				replaceVertexPrograms(*shadowCasterMatInstanced, suffix);
+			}
+			shadowCasterMatInstanced->load();
+			tech->setShadowCasterMaterial(shadowCasterMatInstanced);
+		}
+	}
+	return instancedMaterialName;
+}
+
+Ogre::InstancedEntity* ModelInstanceManager::createInstancedEntity(Ogre::SubEntity& subEntity, unsigned short subEntityIndex, const std::string& materialName) {
+	Ogre::Entity* entity = subEntity.getParent();
+	Ogre::SceneManager* sceneManager = entity->_getManager();
+	auto& mesh = entity->getMesh();
+	const bool isSkinned = mesh->hasSkeleton();
+	const std::string& suffix = isSkinned ? SkinnedSuffix : StaticSuffix;
+
+	std::string instancedMaterialName = getInstancedMaterial(materialName, suffix);
+	if (instancedMaterialName.empty()) {
+		S_LOG_WARNING("The material '" << materialName << "' used by a submesh of the mesh '" << mesh->getName() << "' could not be found. The submesh will be hidden.");
+		return nullptr;
+	}
+
+	std::string instanceName = mesh->getName() + "/" + std::to_string(subEntityIndex);
+	Ogre::InstanceManager* instanceManager;
+	if (sceneManager->hasInstanceManager(instanceName)) {
+		instanceManager = sceneManager->getInstanceManager(instanceName);
+	} else {
+		auto bestTech = subEntity.getMaterial()->getBestTechnique();
+		if (bestTech->getPasses().empty() || !bestTech->getPass(0)->hasVertexProgram()) {
+			S_LOG_WARNING("Could not create instanced version of subentity with index " << subEntityIndex << " of entity " << entity->getName());
+			return nullptr;
+		}
+		if (isSkinned) {
+			//Without a vertex program which reads the bones from the texture the instances would be rendered in their bind pose.
+			auto instancedMaterial = Ogre::MaterialManager::getSingleton().getByName(instancedMaterialName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+			auto instancedTech = instancedMaterial ? instancedMaterial->getBestTechnique() : nullptr;
+			if (!instancedTech || instancedTech->getPasses().empty() || !instancedTech->getPass(0)->hasVertexProgram()
+				|| !boost::algorithm::ends_with(instancedTech->getPass(0)->getVertexProgramName(), suffix)) {
+				S_LOG_VERBOSE("No vertex texture skinning program available for material '" << materialName << "'; mesh '" << mesh->getName() << "' won't be instanced.");
+				return nullptr;
+			}
+		}
+
+		try {
+			instanceManager = sceneManager->createInstanceManager(instanceName,
+																  mesh->getName(),
+																  mesh->getGroup(),
+																  isSkinned ? SkinnedTechnique : StaticTechnique,
+																  InstancesPerBatch, Ogre::IM_USEALL, subEntityIndex);
+			//Skinned instances are animated and move around, so their batches must be updated each frame.
+			if (!isSkinned) {
+				instanceManager->setBatchesAsStaticAndUpdate(true);
+			}
+		} catch (const std::exception& e) {
+			S_LOG_FAILURE("Could not create instanced versions of mesh " << mesh->getName() << e);
+			return nullptr;
+		}
+	}
+
+	try {
+		auto instancedEntity = instanceManager->createInstancedEntity(instancedMaterialName);
+		if (!instancedEntity) {
+			S_LOG_FAILURE("Could not create instanced entity " << instanceManager->getName());
+		}
+		return instancedEntity;
+	} catch (const std::exception& ex) {
+		S_LOG_FAILURE("Could not create instanced entity " << instanceManager->getName() << ex);
+		return nullptr;
+	}
+}
+
+void ModelInstanceManager::copyAnimationStates(const Ogre::AnimationStateSet& source, Ogre::InstancedEntity& instancedEntity) {
+	auto target = instancedEntity.getAllAnimationStates();
+	if (!target) {
+		return;
+	}
+
+	//Disable the animations which no longer are enabled in the model. This can't be done while iterating over the enabled animations.
+	std::vector<Ogre::AnimationState*> disabledStates;
+	auto targetIterator = target->getEnabledAnimationStateIterator();
+	while (targetIterator.hasMoreElements()) {
+		auto targetState = targetIterator.getNext();
+		if (!source.hasAnimationState(targetState->getAnimationName()) || !source.getAnimationState(targetState->getAnimationName())->getEnabled()) {
+			disabledStates.push_back(targetState);
+		}
+	}
+	for (auto targetState : disabledStates) {
+		targetState->setEnabled(false);
+	}
+
+	auto sourceIterator = source.getEnabledAnimationStateIterator();
+	while (sourceIterator.hasMoreElements()) {
+		auto sourceState = sourceIterator.getNext();
+		if (target->hasAnimationState(sourceState->getAnimationName())) {
+			auto targetState = target->getAnimationState(sourceState->getAnimationName());
+			targetState->copyStateFrom(*sourceState);
+			if (sourceState->hasBlendMask()) {
+				targetState->_setBlendMask(sourceState->getBlendMask());
+			} else if (targetState->hasBlendMask()) {
+				targetState->destroyBlendMask();
+			}
+		}
+	}
+}
+
+}
+}
+}
@@ -0,0 +1,104 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MODELINSTANCEMANAGER_H_
+#define MODELINSTANCEMANAGER_H_
+
+#include "components/ogre/EmberOgrePrerequisites.h"
+
+#include <string>
+
+namespace Ogre {
+class AnimationStateSet;
+class Entity;
+class InstancedEntity;
+class SubEntity;
+}
+
+namespace Ember {
+namespace OgreView {
+namespace Model {
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Groups the submeshes of all models which share a mesh into instanced batches.
+ *
+ * Every submesh of every mesh gets its own Ogre::InstanceManager in each scene manager, named after the mesh and the index of the
+ * submesh. All models which use the same mesh thus end up in the same batches, and are rendered with one draw call per batch instead
+ * of one draw call per submesh and model.
+ *
+ * Meshes without skeletons use the shader based technique, with static batches since such models rarely move.
+ *
+ * Meshes with skeletons use the vertex texture technique, where the bone matrices of every instance in a batch are stored in a
+ * texture which is read by the vertex shader. Each instance has its own skeleton and animation states, so each model can be
+ * animated independently of all others. The animations are still driven through the Ogre::Entity of the model, which is kept
+ * in the scene (with its submeshes hidden) so that attachments to bones keep working; see copyAnimationStates().
+ *
+ * The instanced materials are created by cloning the original material and replacing the vertex programs with programs with the
+ * same name, but with a suffix for the technique ("/Instanced/Shader" or "/Instanced/VTF"). If no such program exists the submesh
+ * can't be instanced, and is rendered through its Ogre::Entity as usual. Meshes with skeletons are only instanced if all their
+ * submeshes can be, since the skeleton of the entity otherwise would have to be animated too; see canInstance().
+ */
+class ModelInstanceManager
+{
+public:
+
+	/**
+	 * @brief Checks whether the submeshes of an entity can be instanced.
+	 * Entities with skeletons require support for vertex texture fetches, and a vertex texture skinning program for the material
+	 * of every submesh. Otherwise the submeshes without such a program would have to be rendered through the entity, whose
+	 * skeleton then would have to be animated along with those of the instances.
+	 * @param entity An entity, with the materials it will use.
+	 * @return True if the entity can be instanced.
+	 */
+	static bool canInstance(const Ogre::Entity& entity);
+
+	/**
+	 * @brief Creates an instance of a submesh, placed in the same batches as all other instances of the submesh.
+	 * @param subEntity The sub entity to create an instance of.
+	 * @param subEntityIndex The index of the sub entity in its entity.
+	 * @param materialName The material to use, without any instancing suffix.
+	 * @return An instanced entity, or null if the submesh can't be instanced.
+	 */
+	static Ogre::InstancedEntity* createInstancedEntity(Ogre::SubEntity& subEntity, unsigned short subEntityIndex, const std::string& materialName);
+
+	/**
+	 * @brief Copies the state of animations to an instance, so that its skeleton is posed the same way as the model it belongs to.
+	 * The time, weight and bone blend masks are copied for every animation that is enabled in either set.
+	 * @param source The animation states of the model.
+	 * @param instancedEntity An instance with a skeleton.
+	 */
+	static void copyAnimationStates(const Ogre::AnimationStateSet& source, Ogre::InstancedEntity& instancedEntity);
+
+private:
+
+	/**
+	 * @brief Gets a material where all vertex programs are replaced with ones with a suffix, creating it if needed.
+	 * The shadow caster materials of all techniques are replaced the same way.
+	 * @param materialName The original material.
+	 * @param suffix The suffix of the instanced material and vertex programs.
+	 * @return The name of the instanced material, or an empty string if the original material couldn't be found.
+	 */
+	static std::string getInstancedMaterial(const std::string& materialName, const std::string& suffix);
+};
+
+}
+}
+}
+
+#endif /* MODELINSTANCEMANAGER_H_ */
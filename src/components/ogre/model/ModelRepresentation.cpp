@@ -369,6 +369,7 @@ void ModelRepresentation::updateAnimation(float timeSlice) {
 		bool continuePlay = false;
 		mCurrentMovementAction->getAnimations().addTime(timeSlice, continuePlay);
 	}
+	mModel->updateInstancedAnimations();
 }
 
 void ModelRepresentation::resetAnimations() {
@@ -381,6 +382,7 @@ void ModelRepresentation::resetAnimations() {
 	if (mTaskAction) {
 		mTaskAction->getAnimations().reset();
 	}
+	mModel->updateInstancedAnimations();
 }
 
 void ModelRepresentation::entity_Acted(const Atlas::Objects::Operation::RootOperation& act) {
@@ -30,6 +30,7 @@
 #include "ModelDefinition.h"
 #include "Model.h"
 #include "SubModel.h"
+#include "ModelInstanceManager.h"
 
 #include <OgreSubEntity.h>
 #include <OgreSubMesh.h>
@@ -38,7 +39,6 @@
 #include <OgreEntity.h>
 #include <OgreMesh.h>
 #include <OgreSceneManager.h>
-#include <OgreInstanceManager.h>
 #include <OgreInstancedEntity.h>
 #include <OgreTechnique.h>
 #include <OgrePass.h>
@@ -47,6 +47,8 @@
 #include <OgreInstanceBatch.h>
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
+
 namespace Ember {
 namespace OgreView {
 namespace Model {
@@ -79,10 +81,14 @@ const std::string& SubModelPart::getName() const {
 }
 
 void SubModelPart::show() {
-	showSubEntities();
-	if (mSubModel.mModel.mUseInstancing) {
+	if (mSubModel.mModel.mUseInstancing && mInstancedEntities.empty()) {
 		createInstancedEntities();
 	}
+	for (auto& item : mInstancedEntities) {
+		item->setVisible(true);
+	}
+	//Sub entities which couldn't be instanced are shown as they are.
+	showSubEntities();
 }
 
 void SubModelPart::showSubEntities() {
@@ -174,26 +180,13 @@ void SubModelPart::showSubEntities() {
 			//TODO: store the material ptr in the definition so we'll avoid a lookup in setMaterialName
 			subModelPartEntity.SubEntity->setMaterialName(materialName);
 		}
-		subModelPartEntity.SubEntity->setVisible(true);
+		//Sub entities which are rendered through an instance are kept hidden.
+		subModelPartEntity.SubEntity->setVisible(subModelPartEntity.InstancedEntity == nullptr);
 	}
 }
 
 bool SubModelPart::createInstancedEntities() {
-	std::vector<std::pair<Ogre::InstanceManager*, std::string>> managersAndMaterials;
-
-	//We would like to use the HW based technique, but as of 1.10.9 that causes corruption with the PSSM shadows.
-	//Until that's fixed we instead use the Shader based technique, which performs worse.
-	//The HW based technique uses the suffix "/Instanced/HW".
-	static std::string instancedSuffix = "/Instanced/Shader";
-	static Ogre::InstanceManager::InstancingTechnique instancedTechnique = Ogre::InstanceManager::ShaderBased;
-
 	for (auto& entry : mSubEntities) {
-		Ogre::SubEntity* subEntity = entry.SubEntity;
-		Ogre::Entity* entity = subEntity->getParent();
-		Ogre::SceneManager* sceneManager = entity->_getManager();
-		std::string instanceName = entity->getMesh()->getName() + "/" + std::to_string(entry.subEntityIndex);
-
-
 		std::string materialName;
 		if (entry.Definition != nullptr && !entry.Definition->getMaterialName().empty()) {
 			materialName = entry.Definition->getMaterialName();
@@ -202,98 +195,15 @@ bool SubModelPart::createInstancedEntities() {
 			materialName = entry.SubEntity->getSubMesh()->getMaterialName();
 		}
 
-		std::string instancedMaterialName = materialName;
-
-		//Check if the material is "instanced", i.e. has the suffix as specified in "instancedSuffix".
-		//If not, we'll create a new material by cloning the original and replacing the vertex shader with
-		//one with the correct suffix, if such one is available and supported.
-		if (!boost::algorithm::ends_with(materialName, instancedSuffix)) {
-
-			instancedMaterialName += instancedSuffix;
-			auto& materialMgr = Ogre::MaterialManager::getSingleton();
-
-			if (!materialMgr.resourceExists(instancedMaterialName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME)) {
-				auto originalMaterial = materialMgr.getByName(materialName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-				if (originalMaterial) {
-					originalMaterial->load();
-					auto material = originalMaterial->clone(instancedMaterialName);
-					material->load();
-					for (auto* tech : material->getTechniques()) {
-						auto pass = tech->getPass(0);
-						if (pass->hasVertexProgram()) {
-							std::string vertexProgramName = pass->getVertexProgram()->getName() + instancedSuffix;
-							if (Ogre::HighLevelGpuProgramManager::getSingleton().resourceExists(vertexProgramName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME)) {
-								pass->setVertexProgram(vertexProgramName);
-							}
-						}
-
-						auto shadowCasterMat = tech->getShadowCasterMaterial();
-						if (shadowCasterMat && !boost::algorithm::ends_with(shadowCasterMat->getName(), instancedSuffix)) {
-							std::string instancedShadowCasterMatName = shadowCasterMat->getName() + instancedSuffix;
-							auto shadowCasterMatInstanced = materialMgr.getByName(instancedShadowCasterMatName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-							if (!shadowCasterMatInstanced) {
-								shadowCasterMat->load();
-								shadowCasterMatInstanced = shadowCasterMat->clone(instancedShadowCasterMatName);
-								for (auto* shadowCasterTech : shadowCasterMatInstanced->getTechniques()) {
-									auto shadowCasterPass = shadowCasterTech->getPass(0);
-									if (shadowCasterPass->hasVertexProgram()) {
-										std::string vertexProgramName = shadowCasterPass->getVertexProgram()->getName() + instancedSuffix;
-										if (Ogre::HighLevelGpuProgramManager::getSingleton().resourceExists(vertexProgramName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME)) {
-											shadowCasterPass->setVertexProgram(vertexProgramName);
-										}
-									}
-								}
-							}
-							shadowCasterMatInstanced->load();
-							tech->setShadowCasterMaterial(shadowCasterMatInstanced);
-						}
-					}
-				} else {
-					S_LOG_WARNING("The material '" << materialName << "' used by a submesh of the mesh '" << entity->getMesh()->getName() << "' could not be found. The submesh will be hidden.");
-					continue;
-				}
-			}
-		}
-
-		if (sceneManager->hasInstanceManager(instanceName)) {
-			managersAndMaterials.emplace_back(std::make_pair(sceneManager->getInstanceManager(instanceName), instancedMaterialName));
-		} else {
-			auto bestTech = subEntity->getMaterial()->getBestTechnique();
-			if (!bestTech->getPasses().empty() && bestTech->getPass(0)->hasVertexProgram()) {
-				auto& meshName = entity->getMesh()->getName();
-
-				try {
-					Ogre::InstanceManager* instanceManager = sceneManager->createInstanceManager(instanceName,
-																								 meshName,
-																								 entity->getMesh()->getGroup(),
-																								 instancedTechnique,
-																								 50, Ogre::IM_USEALL, entry.subEntityIndex);
-					instanceManager->setBatchesAsStaticAndUpdate(true);
-
-					managersAndMaterials.emplace_back(std::make_pair(instanceManager, instancedMaterialName));
-				} catch (const std::exception& e) {
-					S_LOG_FAILURE("Could not create instanced versions of mesh " << meshName);
-				}
-
-			} else {
-				//Could not make into instanced.
-				S_LOG_WARNING("Could not create instanced version of subentity with index " << entry.subEntityIndex << " of entity " << entity->getName());
-			}
-		}
-	}
-
-	for (auto& entry : managersAndMaterials) {
-		try {
-			auto instancedEntity = entry.first->createInstancedEntity(entry.second);
-			if (instancedEntity) {
-				mInstancedEntities.push_back(instancedEntity);
-				mSubModel.mModel.addMovable(instancedEntity);
-				::Ember::OgreView::Model::Model::sInstancedEntities[entry.first->getSceneManager()][instancedEntity] = &mSubModel.mModel;
-			} else {
-				S_LOG_FAILURE("Could not create instanced entity " << entry.first->getName());
+		auto instancedEntity = ModelInstanceManager::createInstancedEntity(*entry.SubEntity, entry.subEntityIndex, materialName);
+		if (instancedEntity) {
+			entry.InstancedEntity = instancedEntity;
+			mInstancedEntities.push_back(instancedEntity);
+			mSubModel.mModel.addMovable(instancedEntity);
+			if (instancedEntity->hasSkeleton()) {
+				mSubModel.mModel.mAnimatedInstancedEntities.push_back(instancedEntity);
 			}
-		} catch (const std::exception& ex) {
-			S_LOG_FAILURE("Could not create instanced entity " << entry.first->getName() << ex);
+			::Ember::OgreView::Model::Model::sInstancedEntities[instancedEntity->_getOwner()->_getManager()][instancedEntity] = &mSubModel.mModel;
 		}
 	}
 	return true;
@@ -301,16 +211,15 @@ bool SubModelPart::createInstancedEntities() {
 
 
 void SubModelPart::hide() {
-	if (!mInstancedEntities.empty()) {
-		for (auto& item : mInstancedEntities) {
-			item->setVisible(false);
-		}
-	} else {
-		for (auto& item : mSubEntities) {
+	for (auto& item : mInstancedEntities) {
+		item->setVisible(false);
+	}
+	//Sub entities which couldn't be instanced are rendered as they are, and must be hidden too.
+	for (auto& item : mSubEntities) {
+		if (item.InstancedEntity == nullptr) {
 			item.SubEntity->setVisible(false);
 		}
 	}
-
 }
 
 const std::vector<SubModelPartEntity>& SubModelPart::getSubentities() const {
@@ -321,6 +230,8 @@ void SubModelPart::destroy() {
 	for (auto& item : mInstancedEntities) {
 		//There's a bug where the InstancedEntity doesn't contain a pointer to it's scene manager; we need to go through the InstanceBatch instead
 		::Ember::OgreView::Model::Model::sInstancedEntities[item->_getOwner()->_getManager()].erase(item);
+		auto& animatedEntities = mSubModel.mModel.mAnimatedInstancedEntities;
+		animatedEntities.erase(std::remove(animatedEntities.begin(), animatedEntities.end(), item), animatedEntities.end());
 		mSubModel.mModel.removeMovable(item);
 		mSubModel.mEntity._getManager()->destroyInstancedEntity(item);
 	}
@@ -48,6 +48,10 @@ struct SubModelPartEntity
 	Ogre::SubEntity* SubEntity;
 	SubEntityDefinition* Definition;
 	unsigned short subEntityIndex;
+	/**
+	 * @brief The instance which renders the sub entity, if it's instanced.
+	 */
+	Ogre::InstancedEntity* InstancedEntity = nullptr;
 };
 
 
@@ -0,0 +1,134 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "BlendMapKernels.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+namespace BlendMapKernels
+{
+
+namespace
+{
+
+inline unsigned char average(const unsigned char* row, const unsigned char* nextRow, unsigned int x)
+{
+	return static_cast<unsigned char>((row[x] + row[x + 1] + nextRow[x] + nextRow[x + 1]) / 4);
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Averages 16 texels at once.
+ * Reads 17 values from each row.
+ */
+inline __m128i average16(const unsigned char* row, const unsigned char* nextRow)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+	__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 1));
+	__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nextRow));
+	__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(nextRow + 1));
+
+	__m128i low = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+								_mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+	__m128i high = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+								 _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+	return _mm_packus_epi16(_mm_srli_epi16(low, 2), _mm_srli_epi16(high, 2));
+}
+#endif
+
+}
+
+void downsample(const unsigned char* source, unsigned int resolution, unsigned char* destination, unsigned int destinationChannels, size_t destinationStride)
+{
+	const unsigned int sourceStride = resolution + 1;
+	for (unsigned int y = 0; y < resolution; ++y) {
+		const unsigned char* row = source + (y * sourceStride);
+		const unsigned char* nextRow = row + sourceStride;
+		unsigned char* destinationRow = destination + (y * destinationStride);
+		unsigned int x = 0;
+#ifdef __SSE2__
+		for (; x + 16 <= resolution; x += 16) {
+			__m128i texels = average16(row + x, nextRow + x);
+			if (destinationChannels == 1) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destinationRow + x), texels);
+			} else {
+				alignas(16) unsigned char values[16];
+				_mm_store_si128(reinterpret_cast<__m128i*>(values), texels);
+				unsigned char* destinationTexel = destinationRow + (x * destinationChannels);
+				for (unsigned int i = 0; i < 16; ++i) {
+					destinationTexel[i * destinationChannels] = values[i];
+				}
+			}
+		}
+#endif
+		for (; x < resolution; ++x) {
+			destinationRow[x * destinationChannels] = average(row, nextRow, x);
+		}
+	}
+}
+
+void downsampleInterleaved(const unsigned char* const sources[InterleavedLayers], unsigned int resolution, unsigned char* destination, size_t destinationStride)
+{
+	const unsigned int sourceStride = resolution + 1;
+	for (unsigned int y = 0; y < resolution; ++y) {
+		const size_t rowOffset = y * sourceStride;
+		unsigned char* destinationRow = destination + (y * destinationStride);
+		unsigned int x = 0;
+#ifdef __SSE2__
+		for (; x + 16 <= resolution; x += 16) {
+			__m128i layers[InterleavedLayers];
+			for (unsigned int i = 0; i < InterleavedLayers; ++i) {
+				layers[i] = sources[i] ? average16(sources[i] + rowOffset + x, sources[i] + rowOffset + sourceStride + x) : _mm_setzero_si128();
+			}
+			//Interleave into BGRA-ordered texels, i.e. layer 0 in the first byte of each texel.
+			__m128i layers01Low = _mm_unpacklo_epi8(layers[0], layers[1]);
+			__m128i layers01High = _mm_unpackhi_epi8(layers[0], layers[1]);
+			__m128i layers23Low = _mm_unpacklo_epi8(layers[2], layers[3]);
+			__m128i layers23High = _mm_unpackhi_epi8(layers[2], layers[3]);
+			__m128i* destinationTexels = reinterpret_cast<__m128i*>(destinationRow + (x * InterleavedLayers));
+			_mm_storeu_si128(destinationTexels, _mm_unpacklo_epi16(layers01Low, layers23Low));
+			_mm_storeu_si128(destinationTexels + 1, _mm_unpackhi_epi16(layers01Low, layers23Low));
+			_mm_storeu_si128(destinationTexels + 2, _mm_unpacklo_epi16(layers01High, layers23High));
+			_mm_storeu_si128(destinationTexels + 3, _mm_unpackhi_epi16(layers01High, layers23High));
+		}
+#endif
+		for (; x < resolution; ++x) {
+			unsigned char* destinationTexel = destinationRow + (x * InterleavedLayers);
+			for (unsigned int i = 0; i < InterleavedLayers; ++i) {
+				destinationTexel[i] = sources[i] ? average(sources[i] + rowOffset, sources[i] + rowOffset + sourceStride, x) : 0;
+			}
+		}
+	}
+}
+
+}
+
+}
+}
+}
@@ -0,0 +1,74 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BLENDMAPKERNELS_H_
+#define BLENDMAPKERNELS_H_
+
+#include <cstddef>
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+/**
+ * @brief Functions for turning the coverage of Mercator surfaces into blend maps.
+ *
+ * A Mercator surface has one coverage value per point of its segment, i.e. (resolution + 1) * (resolution + 1) values. The blend map
+ * needs one value per texel, which is calculated as the average of the four points surrounding the texel.
+ *
+ * When compiled with SSE2 support 16 texels are processed at once, else a scalar fallback is used. Both give the exact same result.
+ */
+namespace BlendMapKernels
+{
+
+/**
+ * @brief The number of layers which are interleaved by downsampleInterleaved().
+ */
+static const unsigned int InterleavedLayers = 4;
+
+/**
+ * @brief Downsamples the coverage of one layer of a segment.
+ * @param source The coverage, with (resolution + 1) * (resolution + 1) values.
+ * @param resolution The resolution of the segment.
+ * @param destination Where the value of the first texel is written.
+ * @param destinationChannels The number of channels of the destination image. Only the channel pointed to by "destination" is written.
+ * @param destinationStride The number of bytes between the start of each row in the destination.
+ */
+void downsample(const unsigned char* source, unsigned int resolution, unsigned char* destination, unsigned int destinationChannels, size_t destinationStride);
+
+/**
+ * @brief Downsamples the coverage of up to four layers of a segment, interleaving them into a four channel image in one pass.
+ * The coverage of layer "i" is written to channel "i". All channels of the texels are written; channels without a layer are set to zero.
+ * @param sources The coverage of each layer, with (resolution + 1) * (resolution + 1) values. Null for layers which don't cover the segment.
+ * @param resolution The resolution of the segment.
+ * @param destination Where the first texel is written.
+ * @param destinationStride The number of bytes between the start of each row in the destination.
+ */
+void downsampleInterleaved(const unsigned char* const sources[InterleavedLayers], unsigned int resolution, unsigned char* destination, size_t destinationStride);
+
+}
+
+}
+}
+}
+
+#endif /* BLENDMAPKERNELS_H_ */
@@ -25,6 +25,7 @@
 #include "ITerrainPageBridge.h"
 
 #include "framework/tasks/TaskExecutionContext.h"
+#include "framework/tasks/TaskGraph.h"
 namespace Ember
 {
 namespace OgreView
@@ -33,6 +34,50 @@ namespace OgreView
 namespace Terrain
 {
 
+/**
+ * @brief Populates the heights and normals of the segments of a page.
+ */
+class GeometryRepopulationTask : public Tasks::TemplateNamedTask<GeometryRepopulationTask>
+{
+public:
+	explicit GeometryRepopulationTask(TerrainPageGeometryPtr geometry) :
+			mGeometry(std::move(geometry))
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		mGeometry->repopulate();
+		//Release Segment references as soon as we can
+		mGeometry.reset();
+	}
+
+private:
+	TerrainPageGeometryPtr mGeometry;
+};
+
+/**
+ * @brief Lets a bridge update the Ogre representation of a page from its geometry.
+ */
+class BridgeUpdateTask : public Tasks::TemplateNamedTask<BridgeUpdateTask>
+{
+public:
+	BridgeUpdateTask(ITerrainPageBridgePtr bridge, TerrainPageGeometryPtr geometry) :
+			mBridge(std::move(bridge)), mGeometry(std::move(geometry))
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		mBridge->updateTerrain(*mGeometry);
+		mGeometry.reset();
+	}
+
+private:
+	ITerrainPageBridgePtr mBridge;
+	TerrainPageGeometryPtr mGeometry;
+};
+
 GeometryUpdateTask::GeometryUpdateTask(const BridgeBoundGeometryPtrVector& pages,
 									   const std::vector<WFMath::AxisBox<2>>& areas,
 									   TerrainHandler& handler,
@@ -61,10 +106,16 @@ void GeometryUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionConte
 		shaderList.push_back(entry.second);
 	}
 
-	//first populate the geometry for all pages, and then regenerate the shaders
+	//Each page is first populated, after which the shaders and the Ogre representation can be updated independently of each other.
+	//The height map needs all pages to be populated.
+	Tasks::TaskGraph graph;
+	std::vector<Tasks::TaskGraph::NodeId> repopulationTasks;
 	for (BridgeBoundGeometryPtrVector::const_iterator I = mGeometry.begin(); I != mGeometry.end(); ++I) {
-		TerrainPageGeometryPtr geometry = I->first;
-		geometry->repopulate();
+		const TerrainPageGeometryPtr& geometry = I->first;
+		const ITerrainPageBridgePtr& bridge = I->second;
+		auto repopulationTask = graph.addTask(new GeometryRepopulationTask(geometry));
+		repopulationTasks.push_back(repopulationTask);
+
 		const SegmentVector& segmentVector = geometry->getValidSegments();
 		for (const auto& entry : segmentVector) {
 			segments.push_back(entry.segment);
@@ -72,25 +123,19 @@ void GeometryUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionConte
 		GeometryPtrVector geometries;
 		geometries.push_back(geometry);
 
-		context.executeTask(new TerrainShaderUpdateTask(geometries, shaderList, mAreas, mHandler.EventLayerUpdated, mHandler.EventTerrainMaterialRecompiled, mLightDirection));
-	}
-	context.executeTask(new HeightMapUpdateTask(mHeightMapBufferProvider, mHeightMap, segments));
-
-	for (BridgeBoundGeometryPtrVector::const_iterator I = mGeometry.begin(); I != mGeometry.end(); ++I) {
-		const TerrainPageGeometryPtr& geometry = I->first;
-		const ITerrainPageBridgePtr& bridge = I->second;
+		graph.addTask(new TerrainShaderUpdateTask(geometries, shaderList, mAreas, mHandler.EventLayerUpdated, mHandler.EventTerrainMaterialRecompiled, mLightDirection), {repopulationTask});
 		if (bridge) {
-			bridge->updateTerrain(*geometry);
+			graph.addTask(new BridgeUpdateTask(bridge, geometry), {repopulationTask});
 			mBridgesToNotify.insert(bridge);
 		}
+		mPages.insert(&geometry->getPage());
 	}
-	for (BridgeBoundGeometryPtrVector::const_iterator I = mGeometry.begin(); I != mGeometry.end(); ++I) {
-		TerrainPage* page = &(I->first)->getPage();
-		mPages.insert(page);
-	}
+	graph.addTask(new HeightMapUpdateTask(mHeightMapBufferProvider, mHeightMap, segments), repopulationTasks);
 
 	//Release Segment references as soon as we can
 	mGeometry.clear();
+
+	context.executeTaskGraph(graph);
 }
 
 bool GeometryUpdateTask::executeTaskInMainThread()
@@ -21,6 +21,10 @@
 #include "framework/LoggingInstance.h"
 #include <wfmath/vector.h>
 
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
 //MSVC 11.0 doesn't support std::lround so we'll use boost. When MSVC gains support for std::lround this could be removed.
 #ifdef _MSC_VER
 #include <boost/math/special_functions/round.hpp>
@@ -38,7 +42,7 @@ namespace Terrain
 {
 
 HeightMap::HeightMap(float defaultLevel, unsigned int segmentResolution) :
-		mDefaultLevel(defaultLevel), mSegmentResolution(segmentResolution)
+		mGridXMin(0), mGridYMin(0), mGridWidth(0), mGridHeight(0), mDefaultLevel(defaultLevel), mSegmentResolution(segmentResolution)
 {
 
 }
@@ -49,24 +53,55 @@ HeightMap::~HeightMap()
 
 void HeightMap::insert(int xIndex, int yIndex, IHeightMapSegment* segment)
 {
-	mSegments[xIndex][yIndex] = std::shared_ptr < IHeightMapSegment > (segment);
+	std::unique_lock<std::shared_timed_mutex> lock(mMutex);
+	growGrid(xIndex, yIndex);
+	mSegments[((yIndex - mGridYMin) * mGridWidth) + (xIndex - mGridXMin)].reset(segment);
 }
 
 bool HeightMap::remove(int xIndex, int yIndex)
 {
-	Segmentstore::iterator column = mSegments.find(xIndex);
-	if (column != mSegments.end()) {
-		Segmentcolumn::iterator row = column->second.find(yIndex);
-		if (row != column->second.end()) {
-			column->second.erase(row);
-			return true;
-		}
+	std::unique_lock<std::shared_timed_mutex> lock(mMutex);
+	if (getSegment(xIndex, yIndex)) {
+		mSegments[((yIndex - mGridYMin) * mGridWidth) + (xIndex - mGridXMin)].reset();
+		return true;
 	}
 	return false;
 }
 
+void HeightMap::growGrid(int xIndex, int yIndex)
+{
+	if (mGridWidth != 0 && xIndex >= mGridXMin && xIndex < mGridXMin + mGridWidth && yIndex >= mGridYMin && yIndex < mGridYMin + mGridHeight) {
+		return;
+	}
+
+	//Grow with some margin on the sides which need to grow, since segments are often inserted in sweeps.
+	const int margin = 4;
+	int xMin = xIndex, xMax = xIndex, yMin = yIndex, yMax = yIndex;
+	if (mGridWidth != 0) {
+		xMin = xIndex < mGridXMin ? xIndex - margin : mGridXMin;
+		yMin = yIndex < mGridYMin ? yIndex - margin : mGridYMin;
+		xMax = xIndex >= mGridXMin + mGridWidth ? xIndex + margin : mGridXMin + mGridWidth - 1;
+		yMax = yIndex >= mGridYMin + mGridHeight ? yIndex + margin : mGridYMin + mGridHeight - 1;
+	}
+	int width = xMax - xMin + 1;
+	int height = yMax - yMin + 1;
+
+	std::vector<std::unique_ptr<IHeightMapSegment>> segments(width * height);
+	for (int y = 0; y < mGridHeight; ++y) {
+		for (int x = 0; x < mGridWidth; ++x) {
+			segments[((y + mGridYMin - yMin) * width) + (x + mGridXMin - xMin)] = std::move(mSegments[(y * mGridWidth) + x]);
+		}
+	}
+	mSegments = std::move(segments);
+	mGridXMin = xMin;
+	mGridYMin = yMin;
+	mGridWidth = width;
+	mGridHeight = height;
+}
+
 void HeightMap::blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<float>& heights) const
 {
+	std::shared_lock<std::shared_timed_mutex> lock(mMutex);
 
 	int xSize = xMax - xMin;
 
@@ -75,12 +110,11 @@ void HeightMap::blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<
 	int segmentYMin = I_ROUND(floor(yMin / (double)mSegmentResolution));
 	int segmentYMax = I_ROUND(floor(yMax / (double)mSegmentResolution));
 
-	for (int segmentX = segmentXMin; segmentX <= segmentXMax; ++segmentX) {
-		for (int segmentY = segmentYMin; segmentY <= segmentYMax; ++segmentY) {
+	for (int segmentY = segmentYMin; segmentY <= segmentYMax; ++segmentY) {
+		for (int segmentX = segmentXMin; segmentX <= segmentXMax; ++segmentX) {
 
-			auto segmentPtr = getSegment(segmentX, segmentY);
-			if (segmentPtr) {
-				auto segment = segmentPtr.get();
+			auto segment = getSegment(segmentX, segmentY);
+			if (segment) {
 
 				int segmentXStart = segmentX * mSegmentResolution;
 				int segmentYStart = segmentY * mSegmentResolution;
@@ -92,10 +126,8 @@ void HeightMap::blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<
 				int xEnd = std::min<int>(xMax - segmentXStart, mSegmentResolution);
 				int yEnd = std::min<int>(yMax - segmentYStart, mSegmentResolution);
 
-				for (int x = xStart; x < xEnd; ++x) {
-					for (int y = yStart; y < yEnd; ++y) {
-						heights[((dataYOffset + y) * xSize) + (dataXOffset + x)] = segment->getHeight(x, y);
-					}
+				if (xStart < xEnd && yStart < yEnd) {
+					segment->blitHeights(xStart, xEnd, yStart, yEnd, heights.data() + ((dataYOffset + yStart) * xSize) + (dataXOffset + xStart), xSize);
 				}
 			}
 		}
@@ -104,11 +136,12 @@ void HeightMap::blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<
 
 float HeightMap::getHeight(float x, float y) const
 {
+	std::shared_lock<std::shared_timed_mutex> lock(mMutex);
 	int ix = I_ROUND(floor(x / mSegmentResolution));
 	int iy = I_ROUND(floor(y / mSegmentResolution));
 
-	std::shared_ptr<IHeightMapSegment> segment(getSegment(ix, iy));
-	if (!segment.get()) {
+	auto segment = getSegment(ix, iy);
+	if (!segment) {
 		return mDefaultLevel;
 	}
 	return segment->getHeight(I_ROUND(x) - (ix * mSegmentResolution), I_ROUND(y) - (iy * mSegmentResolution));
@@ -117,28 +150,81 @@ float HeightMap::getHeight(float x, float y) const
 
 bool HeightMap::getHeightAndNormal(float x, float y, float& height, WFMath::Vector<3>& normal) const
 {
+	std::shared_lock<std::shared_timed_mutex> lock(mMutex);
 	int ix = I_ROUND(floor(x / mSegmentResolution));
 	int iy = I_ROUND(floor(y / mSegmentResolution));
 
-	std::shared_ptr<IHeightMapSegment> segment(getSegment(ix, iy));
-	if (!segment.get()) {
+	auto segment = getSegment(ix, iy);
+	if (!segment) {
 		return false;
 	}
 	segment->getHeightAndNormal(x - (ix * (int)mSegmentResolution), y - (iy * (int)mSegmentResolution), height, normal);
 	return true;
 }
 
-std::shared_ptr<IHeightMapSegment> HeightMap::getSegment(int xIndex, int yIndex) const
+size_t HeightMap::getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const
 {
-	Segmentstore::const_iterator I = mSegments.find(xIndex);
-	if (I == mSegments.end()) {
-		return std::shared_ptr<IHeightMapSegment>();
+	std::shared_lock<std::shared_timed_mutex> lock(mMutex);
+
+	const size_t blockSize = 64;
+	float localXs[blockSize], localYs[blockSize];
+	size_t found = 0;
+
+	size_t i = 0;
+	int ix = 0, iy = 0;
+	if (count) {
+		ix = I_ROUND(floor(xs[0] / mSegmentResolution));
+		iy = I_ROUND(floor(ys[0] / mSegmentResolution));
 	}
-	Segmentcolumn::const_iterator J = I->second.find(yIndex);
-	if (J == I->second.end()) {
-		return std::shared_ptr<IHeightMapSegment>();
+	while (i < count) {
+		//Collect a run of consecutive locations which all are in the same segment.
+		size_t runEnd = i + 1;
+		int nextIx = ix, nextIy = iy;
+		while (runEnd < count) {
+			nextIx = I_ROUND(floor(xs[runEnd] / mSegmentResolution));
+			nextIy = I_ROUND(floor(ys[runEnd] / mSegmentResolution));
+			if (nextIx != ix || nextIy != iy || runEnd - i == blockSize) {
+				break;
+			}
+			runEnd++;
+		}
+		size_t runCount = runEnd - i;
+
+		auto segment = getSegment(ix, iy);
+		if (segment) {
+			float xOffset = ix * (int)mSegmentResolution;
+			float yOffset = iy * (int)mSegmentResolution;
+			for (size_t j = 0; j < runCount; ++j) {
+				localXs[j] = xs[i + j] - xOffset;
+				localYs[j] = ys[i + j] - yOffset;
+			}
+			segment->getHeights(localXs, localYs, heights + i, normals ? normals + (i * 3) : nullptr, runCount);
+			found += runCount;
+		} else {
+			for (size_t j = i; j < runEnd; ++j) {
+				heights[j] = mDefaultLevel;
+				if (normals) {
+					normals[(j * 3)] = 0;
+					normals[(j * 3) + 1] = 1;
+					normals[(j * 3) + 2] = 0;
+				}
+			}
+		}
+		i = runEnd;
+		ix = nextIx;
+		iy = nextIy;
+	}
+	return found;
+}
+
+IHeightMapSegment* HeightMap::getSegment(int xIndex, int yIndex) const
+{
+	int x = xIndex - mGridXMin;
+	int y = yIndex - mGridYMin;
+	if (x < 0 || y < 0 || x >= mGridWidth || y >= mGridHeight) {
+		return nullptr;
 	}
-	return J->second;
+	return mSegments[(y * mGridWidth) + x].get();
 }
 
 }
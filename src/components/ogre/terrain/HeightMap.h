@@ -21,7 +21,8 @@
 
 #include "Types.h"
 #include <memory>
-#include <unordered_map>
+#include <shared_mutex>
+#include <vector>
 
 namespace WFMath
 {
@@ -43,21 +44,17 @@ class IHeightMapSegment;
  * @brief Keeps data about the height map of the terrain.
  * This class is safe for threading, in contrast to the Mercator::Terrain class which primarily provides height map features.
  * The whole reason for this class existing is basically Mercator not being thread safe. We want to be able to update the Mercator terrain in a background thread, but at the same time be able to provide real time height checking functionality for other subsystems in Ember which are running in the main thread.
+ *
+ * Since this is used a lot (by the camera, when snapping entities to the ground and when rasterizing the navigation mesh) the segments are stored in a dense grid,
+ * covering the area of all segments inserted so far. Looking up a segment is thus only a matter of indexing into an array.
+ * When many heights are needed at once, use the batch methods getHeights() and blitHeights(), which avoid most of the per sample overhead.
+ *
+ * Segments are inserted and removed in the main thread, but the height map can be read from any thread, such as when placing plants in a background task.
  */
 class HeightMap
 {
 public:
 
-    /**
-     * @brief STL map to store sparse array of Segment pointers.
-     */
-    typedef std::unordered_map<int, std::shared_ptr<IHeightMapSegment>> Segmentcolumn;
-
-    /**
-     * @brief STL map to store sparse array of Segment pointer columns.
-     */
-    typedef std::unordered_map<int, Segmentcolumn > Segmentstore;
-
     /**
      * @Ctor.
      * @param defaultLevel The default level of the terrain, if no valid segment can be found for a requested location.
@@ -109,6 +106,19 @@ public:
      */
     bool getHeightAndNormal(float x, float y, float& height, WFMath::Vector<3>& normal) const;
 
+    /**
+     * @brief Gets the heights, and optionally the normals, for a batch of locations.
+     * This calculates the same precise heights as getHeightAndNormal(), but is much faster when many locations are to be looked up, especially if consecutive locations are close to each other.
+     * For locations where there's no segment the default level will be reported, with a normal pointing straight up.
+     * @param xs The x locations, in world units.
+     * @param ys The y locations, in world units.
+     * @param heights The heights will be stored here. Must have room for "count" values.
+     * @param normals If not null, the normals will be stored here, as three consecutive floats (x, y, z) per location.
+     * @param count The number of locations.
+     * @returns The number of locations for which a segment was found.
+     */
+    size_t getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const;
+
     /**
      * @brief Performs a fast copy of the raw height data for the supplied area.
      * @param xMin Minimum x coord of the area.
@@ -122,10 +132,35 @@ public:
 
 private:
 
-    /**
-     * @brief A sparse map of height map segments.
-     */
-	Segmentstore mSegments;
+	/**
+	 * @brief Guards the grid, so that it can be read from background threads while segments are inserted or removed in the main thread.
+	 */
+	mutable std::shared_timed_mutex mMutex;
+
+	/**
+	 * @brief A dense grid of height map segments, stored row by row. Cells without any segment are null.
+	 */
+	std::vector<std::unique_ptr<IHeightMapSegment>> mSegments;
+
+	/**
+	 * @brief The x index of the first column in the grid.
+	 */
+	int mGridXMin;
+
+	/**
+	 * @brief The y index of the first row in the grid.
+	 */
+	int mGridYMin;
+
+	/**
+	 * @brief The number of columns in the grid.
+	 */
+	int mGridWidth;
+
+	/**
+	 * @brief The number of rows in the grid.
+	 */
+	int mGridHeight;
 
 	/**
 	 * @brief The default height to report a height query is requested for a position for which there is no segment.
@@ -141,9 +176,16 @@ private:
 	 * @brief Gets the segment at the specified index.
 	 * @param xIndex The x index.
 	 * @param yIndex The y index.
-	 * @returns A shared pointer to a segment, or to null if no segment could be found.
+	 * @returns A pointer to a segment, or null if no segment could be found.
+	 */
+	IHeightMapSegment* getSegment(int xIndex, int yIndex) const;
+
+	/**
+	 * @brief Grows the grid so that it covers the specified index.
+	 * @param xIndex The x index.
+	 * @param yIndex The y index.
 	 */
-	std::shared_ptr<IHeightMapSegment> getSegment(int xIndex, int yIndex) const;
+	void growGrid(int xIndex, int yIndex);
 };
 
 }
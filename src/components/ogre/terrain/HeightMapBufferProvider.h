@@ -20,6 +20,7 @@
 #define HEIGHTMAPBUFFERPROVIDER_H_
 
 #include <vector>
+#include <mutex>
 
 namespace Ember
 {
@@ -37,6 +38,8 @@ class HeightMapBuffer;
  * @brief A height map buffer provider, which for performance reasons keeps a pool of buffers which are recycled as new HeightMapBuffer instances are created.
  * To help with performance and to avoid memory fragmentation this class is used to keep a collection of Buffer instances, which are used by HeightMapBuffer instances.
  * The HeightMapBuffer class will at destruction automatically return the Buffer instance to the provider.
+ *
+ * Buffers are checked out from background threads and checked in from both background threads and the main thread, so access to the pool is guarded by a mutex.
  */
 class HeightMapBufferProvider
 {
@@ -74,6 +77,11 @@ private:
 	 */
 	BufferStore mPrimitiveBuffers;
 
+	/**
+	 * @brief Guards mPrimitiveBuffers.
+	 */
+	std::mutex mMutex;
+
 	/**
 	 * @brief The resolution of one buffer. This is normally the size of one terrain segment plus one (to match Mercator::Segment).
 	 */
@@ -19,6 +19,8 @@
 #include "HeightMapFlatSegment.h"
 #include "wfmath/vector.h"
 
+#include <algorithm>
+
 namespace Ember
 {
 namespace OgreView
@@ -49,6 +51,26 @@ void HeightMapFlatSegment::getHeightAndNormal(float x, float y, float& height, W
 	normal.z() = 0;
 }
 
+void HeightMapFlatSegment::getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const
+{
+	std::fill(heights, heights + count, mHeight);
+	if (normals) {
+		for (size_t i = 0; i < count; ++i) {
+			normals[(i * 3)] = 0;
+			normals[(i * 3) + 1] = 1;
+			normals[(i * 3) + 2] = 0;
+		}
+	}
+}
+
+void HeightMapFlatSegment::blitHeights(int xStart, int xEnd, int yStart, int yEnd, float* destination, size_t destinationRowSize) const
+{
+	for (int y = yStart; y < yEnd; ++y) {
+		float* row = destination + ((y - yStart) * destinationRowSize);
+		std::fill(row, row + (xEnd - xStart), mHeight);
+	}
+}
+
 }
 
 }
@@ -60,6 +60,16 @@ public:
      */
 	virtual void getHeightAndNormal(float x, float y, float& height, WFMath::Vector<3>& normal) const;
 
+	/**
+	 * @copydoc IHeightMapSegment::getHeights()
+	 */
+	virtual void getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const;
+
+	/**
+	 * @copydoc IHeightMapSegment::blitHeights()
+	 */
+	virtual void blitHeights(int xStart, int xEnd, int yStart, int yEnd, float* destination, size_t destinationRowSize) const;
+
 
 protected:
 	float mHeight;
@@ -21,7 +21,14 @@
 #include "HeightMapBuffer.h"
 #include "Buffer.h"
 #include <wfmath/vector.h>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace Ember
 {
@@ -100,6 +107,121 @@ void HeightMapSegment::getHeightAndNormal(float x, float y, float& h, WFMath::Ve
 	}
 }
 
+void HeightMapSegment::getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const
+{
+	interpolateHeights(mBuffer->getBuffer()->getData(), mBuffer->getResolution(), xs, ys, heights, normals, count);
+}
+
+void HeightMapSegment::interpolateHeights(const float* data, size_t rowSize, const float* xs, const float* ys, float* heights, float* normals, size_t count)
+{
+	//Work in blocks; first gather the corner heights of each tile, then do the interpolation on the gathered data.
+	//The latter is done four locations at a time when SSE2 is available.
+	const size_t blockSize = 64;
+	float h1[blockSize], h2[blockSize], h3[blockSize], h4[blockSize], offX[blockSize], offY[blockSize];
+
+	for (size_t blockStart = 0; blockStart < count; blockStart += blockSize) {
+		size_t blockCount = std::min(blockSize, count - blockStart);
+
+		for (size_t i = 0; i < blockCount; ++i) {
+			float x = xs[blockStart + i];
+			float y = ys[blockStart + i];
+			assert(x <= rowSize);
+			assert(x >= 0.0f);
+			assert(y <= rowSize);
+			assert(y >= 0.0f);
+			int tileX = (int)std::floor(x);
+			int tileY = (int)std::floor(y);
+			offX[i] = x - tileX;
+			offY[i] = y - tileY;
+			const float* tile = data + (tileY * rowSize) + tileX;
+			h1[i] = tile[0];
+			h2[i] = tile[rowSize];
+			h3[i] = tile[rowSize + 1];
+			h4[i] = tile[1];
+		}
+
+		float* blockHeights = heights + blockStart;
+		float* blockNormals = normals ? normals + (blockStart * 3) : nullptr;
+		size_t i = 0;
+#ifdef __SSE2__
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= blockCount; i += 4) {
+			__m128 v1 = _mm_loadu_ps(h1 + i);
+			__m128 v2 = _mm_loadu_ps(h2 + i);
+			__m128 v3 = _mm_loadu_ps(h3 + i);
+			__m128 v4 = _mm_loadu_ps(h4 + i);
+			__m128 ox = _mm_loadu_ps(offX + i);
+			__m128 oy = _mm_loadu_ps(offY + i);
+
+			//See getHeightAndNormal() for the scalar version of this.
+			__m128 top = _mm_cmple_ps(_mm_sub_ps(ox, oy), zero);
+			__m128 topHeight = _mm_add_ps(v1, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v3, v2), ox), _mm_mul_ps(_mm_sub_ps(v2, v1), oy)));
+			__m128 bottomHeight = _mm_add_ps(v1, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v4, v1), ox), _mm_mul_ps(_mm_sub_ps(v3, v4), oy)));
+			_mm_storeu_ps(blockHeights + i, _mm_or_ps(_mm_and_ps(top, topHeight), _mm_andnot_ps(top, bottomHeight)));
+
+			if (blockNormals) {
+				__m128 diagonal = _mm_and_ps(top, _mm_cmpeq_ps(ox, oy));
+				__m128 bottomX = _mm_sub_ps(v1, v4);
+				__m128 bottomZ = _mm_sub_ps(v4, v3);
+				__m128 topX = _mm_add_ps(_mm_sub_ps(v2, v3), _mm_and_ps(diagonal, bottomX));
+				__m128 topZ = _mm_add_ps(_mm_sub_ps(v1, v2), _mm_and_ps(diagonal, bottomZ));
+				__m128 nx = _mm_or_ps(_mm_and_ps(top, topX), _mm_andnot_ps(top, bottomX));
+				__m128 ny = _mm_add_ps(one, _mm_and_ps(diagonal, one));
+				__m128 nz = _mm_or_ps(_mm_and_ps(top, topZ), _mm_andnot_ps(top, bottomZ));
+				__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_add_ps(_mm_mul_ps(ny, ny), _mm_mul_ps(nz, nz))));
+				float x[4], y[4], z[4];
+				_mm_storeu_ps(x, _mm_div_ps(nx, length));
+				_mm_storeu_ps(y, _mm_div_ps(ny, length));
+				_mm_storeu_ps(z, _mm_div_ps(nz, length));
+				for (size_t j = 0; j < 4; ++j) {
+					float* normal = blockNormals + ((i + j) * 3);
+					normal[0] = x[j];
+					normal[1] = y[j];
+					normal[2] = z[j];
+				}
+			}
+		}
+#endif
+		for (; i < blockCount; ++i) {
+			float nx, ny, nz;
+			if ((offX[i] - offY[i]) <= 0.f) {
+				nx = h2[i] - h3[i];
+				ny = 1.0f;
+				nz = h1[i] - h2[i];
+				if (offX[i] == offY[i]) {
+					nx += h1[i] - h4[i];
+					ny += 1.0f;
+					nz += h4[i] - h3[i];
+				}
+				blockHeights[i] = h1[i] + (h3[i] - h2[i]) * offX[i] + (h2[i] - h1[i]) * offY[i];
+			} else {
+				nx = h1[i] - h4[i];
+				ny = 1.0f;
+				nz = h4[i] - h3[i];
+				blockHeights[i] = h1[i] + (h4[i] - h1[i]) * offX[i] + (h3[i] - h4[i]) * offY[i];
+			}
+			if (blockNormals) {
+				float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+				float* normal = blockNormals + (i * 3);
+				normal[0] = nx / length;
+				normal[1] = ny / length;
+				normal[2] = nz / length;
+			}
+		}
+	}
+}
+
+void HeightMapSegment::blitHeights(int xStart, int xEnd, int yStart, int yEnd, float* destination, size_t destinationRowSize) const
+{
+	const float* data = mBuffer->getBuffer()->getData();
+	const size_t rowSize = mBuffer->getResolution();
+	const size_t rowLength = sizeof(float) * (xEnd - xStart);
+	for (int y = yStart; y < yEnd; ++y) {
+		std::memcpy(destination + ((y - yStart) * destinationRowSize), data + (y * rowSize) + xStart, rowLength);
+	}
+}
+
 }
 
 }
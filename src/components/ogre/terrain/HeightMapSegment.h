@@ -70,6 +70,29 @@ public:
      */
 	virtual void getHeightAndNormal(float x, float y, float& height, WFMath::Vector<3>& normal) const;
 
+	/**
+	 * @copydoc IHeightMapSegment::getHeights()
+	 */
+	virtual void getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const;
+
+	/**
+	 * @copydoc IHeightMapSegment::blitHeights()
+	 */
+	virtual void blitHeights(int xStart, int xEnd, int yStart, int yEnd, float* destination, size_t destinationRowSize) const;
+
+	/**
+	 * @brief Calculates the heights, and optionally the normals, for a batch of locations in a grid of heights.
+	 * This is what getHeights() uses, but it works for any height data laid out the same way, such as the points of a Mercator::Segment.
+	 * @param data The heights, stored row by row.
+	 * @param rowSize The number of heights in each row.
+	 * @param xs The x locations, in world units, relative to the grid.
+	 * @param ys The y locations, in world units, relative to the grid.
+	 * @param heights The heights will be stored here.
+	 * @param normals If not null, the normals will be stored here, as three consecutive floats per location.
+	 * @param count The number of locations.
+	 */
+	static void interpolateHeights(const float* data, size_t rowSize, const float* xs, const float* ys, float* heights, float* normals, size_t count);
+
 private:
 
 	/**
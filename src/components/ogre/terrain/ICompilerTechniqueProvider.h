@@ -55,8 +55,10 @@ public:
 	 * @param geometry The geometry to compile a material for.
 	 * @param terrainPageSurfaces The surfaces attached to the geometry.
 	 * @param terrainPageShadow An optional shadow for the geometry.
+	 * @param dirtyAreas The areas which have changed since the material last was compiled. Parts of textures outside of these areas can be left as they are.
+	 * @param blendMapContents The layers which the blend map textures of the page currently hold. Updated by the technique when it uploads blend maps.
 	 */
-	virtual TerrainPageSurfaceCompilerTechnique* createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow) const = 0;
+	virtual TerrainPageSurfaceCompilerTechnique* createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas, BlendMapContentStore& blendMapContents) const = 0;
 
 };
 
@@ -20,6 +20,7 @@
 #define EMBEROGRETERRAINIHEIGHTMAPSEGMENT_H_
 
 #include "Types.h"
+#include <cstddef>
 
 namespace WFMath
 {
@@ -58,6 +59,28 @@ public:
 	 * @param normal The normal will be stored here.
      */
 	virtual void getHeightAndNormal(float x, float y, float& height, WFMath::Vector<3>& normal) const = 0;
+
+	/**
+	 * @brief Gets the heights, and optionally the normals, for a batch of locations.
+	 * This calculates the same precise heights as getHeightAndNormal(), but is much faster when many locations are to be looked up.
+	 * @param xs The x locations, in world units, relative to the segment.
+	 * @param ys The y locations, in world units, relative to the segment.
+	 * @param heights The heights will be stored here.
+	 * @param normals If not null, the normals will be stored here, as three consecutive floats per location.
+	 * @param count The number of locations.
+	 */
+	virtual void getHeights(const float* xs, const float* ys, float* heights, float* normals, size_t count) const = 0;
+
+	/**
+	 * @brief Copies the raw height data of an area of the segment.
+	 * @param xStart The first x position to copy, relative to the segment.
+	 * @param xEnd The x position at which to stop copying, relative to the segment.
+	 * @param yStart The first y position to copy, relative to the segment.
+	 * @param yEnd The y position at which to stop copying, relative to the segment.
+	 * @param destination Where the height for xStart, yStart is to be placed.
+	 * @param destinationRowSize The number of floats in each row of the destination.
+	 */
+	virtual void blitHeights(int xStart, int xEnd, int yStart, int yEnd, float* destination, size_t destinationRowSize) const = 0;
 };
 }
 }
@@ -66,8 +66,9 @@ public:
 
 	/**
 	 * @brief Emitted when a piece of the area being observed is shown.
+	 * The argument is the piece which was shown, in world units.
 	 */
-	sigc::signal<void> EventAreaShown;
+	sigc::signal<void, const WFMath::AxisBox<2>&> EventAreaShown;
 
 protected:
 
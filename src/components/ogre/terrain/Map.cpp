@@ -25,7 +25,12 @@
 #endif
 
 #include "Map.h"
+#include "framework/LoggingInstance.h"
+
+#include <wfmath/axisbox.h>
+
 #include <OgreHardwarePixelBuffer.h>
+#include <OgreImage.h>
 #include <OgreTextureManager.h>
 #include <OgreRenderTexture.h>
 #include <OgreCamera.h>
@@ -33,6 +38,11 @@
 #include <OgreViewport.h>
 #include <OgreSceneNode.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
 namespace Ember {
 namespace OgreView {
 
@@ -40,11 +50,17 @@ namespace Terrain {
 
 Map::Map(Ogre::SceneManager& sceneManager)
 :
-mRenderTexture(0)
+mAtlasRenderTexture(nullptr)
 , mTexturePixelSize(256)
+, mTilePixelSize(64)
+//Enough for a couple of screens worth of scrolling in each direction.
+, mAtlasTilesPerSide(16)
 , mMetersPerPixel(1.0f)
+, mPosition(Ogre::Vector2::ZERO)
+//Enough to render a new row of tiles in one frame when scrolling.
+, mTileRendersPerUpdate(4)
 , mCamera(*this, sceneManager)
-, mView(*this, mCamera)
+, mView(*this)
 {
 }
 
@@ -54,6 +70,9 @@ Map::~Map()
 	if (mTexture) {
 		Ogre::TextureManager::getSingleton().remove(mTexture->getName(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
 	}
+	if (mAtlasTexture) {
+		Ogre::TextureManager::getSingleton().remove(mAtlasTexture->getName(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	}
 }
 
 void Map::initialize()
@@ -64,31 +83,200 @@ void Map::initialize()
 
 void Map::setupCamera()
 {
-	mCamera.setRenderTarget(mRenderTexture);
+	mCamera.setRenderTarget(mAtlasRenderTexture);
 	reposition(Ogre::Vector2(0, 0));
 }
 
 void Map::createTexture()
 {
 	//don't use alpha for our map texture
-	mTexture = Ogre::TextureManager::getSingleton().createManual("TerrainMap", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, mTexturePixelSize, mTexturePixelSize, 1, Ogre::PF_R8G8B8,Ogre::TU_RENDERTARGET);
-	mRenderTexture = mTexture->getBuffer()->getRenderTarget();
-	mRenderTexture->removeAllViewports();
+	//The map texture is only written to by copying tiles from the atlas, so it doesn't need to be a render target.
+	mTexture = Ogre::TextureManager::getSingleton().createManual("TerrainMap", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, mTexturePixelSize, mTexturePixelSize, 0, Ogre::PF_R8G8B8, Ogre::TU_DEFAULT);
+
+	unsigned int atlasPixelSize = mAtlasTilesPerSide * mTilePixelSize;
+	mAtlasTexture = Ogre::TextureManager::getSingleton().createManual("TerrainMapTiles", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, atlasPixelSize, atlasPixelSize, 0, Ogre::PF_R8G8B8, Ogre::TU_RENDERTARGET);
+	mAtlasRenderTexture = mAtlasTexture->getBuffer()->getRenderTarget();
+	mAtlasRenderTexture->removeAllViewports();
+
+	mAtlasRenderTexture->setAutoUpdated(false);
+
+	//Tiles which haven't been rendered yet are copied from the blank slot.
+	Ogre::Image blank;
+	size_t size = Ogre::PixelUtil::getMemorySize(mTilePixelSize, mTilePixelSize, 1, Ogre::PF_R8G8B8);
+	//The image takes ownership of the data.
+	blank.loadDynamicImage(OGRE_ALLOC_T(Ogre::uchar, size, Ogre::MEMCATEGORY_GENERAL), mTilePixelSize, mTilePixelSize, 1, Ogre::PF_R8G8B8, true);
+	memset(blank.getData(), 0xFF, size);
+	try {
+		mAtlasTexture->getBuffer()->blitFromMemory(blank.getPixelBox(), getSlotBox(mAtlasTilesPerSide * mAtlasTilesPerSide - 1));
+	} catch (const std::exception& ex) {
+		S_LOG_WARNING("Error when clearing blank map tile." << ex);
+	}
+	clearTiles();
+}
 
-	mRenderTexture->setAutoUpdated(false);
-	//initially deactivate it until setActive(true) is called
-// 	mRenderTexture->setActive(false);
+void Map::render()
+{
+	renderTiles(std::numeric_limits<size_t>::max());
+}
 
+bool Map::update()
+{
+	return renderTiles(mTileRendersPerUpdate);
 }
 
-void Map::render()
+bool Map::renderTiles(size_t maxRenderedTiles)
 {
+	if (!mTexture) {
+		return true;
+	}
+	TileIndex firstTileIndex = getFirstTileIndex();
+	int tilesPerSide = static_cast<int>(mTexturePixelSize / mTilePixelSize);
+
+	//Render the tiles closest to the center first, and the missing tiles before the invalidated ones, since the latter can be shown as they were.
+	std::vector<std::pair<TileIndex, bool>> invalidTiles;
+	for (int z = 0; z < tilesPerSide; ++z) {
+		for (int x = 0; x < tilesPerSide; ++x) {
+			TileIndex index(firstTileIndex.first + x, firstTileIndex.second + z);
+			auto I = mTiles.find(index);
+			if (I == mTiles.end()) {
+				invalidTiles.emplace_back(index, true);
+			} else if (I->second.invalid) {
+				invalidTiles.emplace_back(index, false);
+			}
+		}
+	}
+	float center = (tilesPerSide - 1) / 2.0f;
+	std::sort(invalidTiles.begin(), invalidTiles.end(), [&](const std::pair<TileIndex, bool>& lhs, const std::pair<TileIndex, bool>& rhs) {
+		if (lhs.second != rhs.second) {
+			return lhs.second;
+		}
+		auto distance = [&](const TileIndex& index) {
+			return std::abs(index.first - firstTileIndex.first - center) + std::abs(index.second - firstTileIndex.second - center);
+		};
+		return distance(lhs.first) < distance(rhs.first);
+	});
+
+	size_t renderCount = std::min(maxRenderedTiles, invalidTiles.size());
+	for (size_t i = 0; i < renderCount; ++i) {
+		renderTile(invalidTiles[i].first, getTile(invalidTiles[i].first));
+	}
+
+	//Copy the tiles from the atlas on the GPU.
+	Ogre::HardwarePixelBufferSharedPtr buffer = mTexture->getBuffer();
+	Ogre::HardwarePixelBufferSharedPtr atlasBuffer = mAtlasTexture->getBuffer();
+	const unsigned int blankSlot = mAtlasTilesPerSide * mAtlasTilesPerSide - 1;
+	for (int z = 0; z < tilesPerSide; ++z) {
+		for (int x = 0; x < tilesPerSide; ++x) {
+			auto I = mTiles.find(TileIndex(firstTileIndex.first + x, firstTileIndex.second + z));
+			unsigned int slot = blankSlot;
+			if (I != mTiles.end()) {
+				mTileLru.splice(mTileLru.begin(), mTileLru, I->second.lruEntry);
+				slot = I->second.slot;
+			}
+			Ogre::Box box(x * mTilePixelSize, z * mTilePixelSize, (x + 1) * mTilePixelSize, (z + 1) * mTilePixelSize);
+			try {
+				buffer->blit(atlasBuffer, getSlotBox(slot), box);
+			} catch (const std::exception& ex) {
+				S_LOG_WARNING("Error when copying map tile into the map texture." << ex);
+			}
+		}
+	}
+	return renderCount == invalidTiles.size();
+}
+
+Map::Tile& Map::getTile(const TileIndex& index)
+{
+	auto I = mTiles.find(index);
+	if (I != mTiles.end()) {
+		return I->second;
+	}
+
+	unsigned int slot;
+	if (mFreeSlots.empty()) {
+		//Reuse the slot of the least recently used tile. Since all shown tiles are used on each update, it's never one of them.
+		auto J = mTiles.find(mTileLru.back());
+		slot = J->second.slot;
+		mTiles.erase(J);
+		mTileLru.pop_back();
+	} else {
+		slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+
+	Tile& tile = mTiles[index];
+	tile.slot = slot;
+	tile.invalid = true;
+	mTileLru.push_front(index);
+	tile.lruEntry = mTileLru.begin();
+	return tile;
+}
+
+void Map::renderTile(const TileIndex& index, Tile& tile)
+{
+	float tileMeters = getTileResolutionMeters();
+	float slotSize = 1.0f / mAtlasTilesPerSide;
+	mCamera.setViewportDimensions((tile.slot % mAtlasTilesPerSide) * slotSize, (tile.slot / mAtlasTilesPerSide) * slotSize, slotSize, slotSize);
+	mCamera.reposition(Ogre::Vector2((index.first + 0.5f) * tileMeters, (index.second + 0.5f) * tileMeters));
 	mCamera.render();
+	tile.invalid = false;
+}
+
+Ogre::Box Map::getSlotBox(unsigned int slot) const
+{
+	unsigned int left = (slot % mAtlasTilesPerSide) * mTilePixelSize;
+	unsigned int top = (slot / mAtlasTilesPerSide) * mTilePixelSize;
+	return Ogre::Box(left, top, left + mTilePixelSize, top + mTilePixelSize);
+}
+
+Map::TileIndex Map::getFirstTileIndex() const
+{
+	float tileMeters = getTileResolutionMeters();
+	int halfTilesPerSide = static_cast<int>(mTexturePixelSize / mTilePixelSize) / 2;
+	return TileIndex(static_cast<int>(std::round(mPosition.x / tileMeters)) - halfTilesPerSide, static_cast<int>(std::round(mPosition.y / tileMeters)) - halfTilesPerSide);
+}
+
+bool Map::invalidate(const WFMath::AxisBox<2>& area)
+{
+	float tileMeters = getTileResolutionMeters();
+	int minX = static_cast<int>(std::floor(area.lowCorner().x() / tileMeters));
+	int maxX = static_cast<int>(std::floor(area.highCorner().x() / tileMeters));
+	int minZ = static_cast<int>(std::floor(area.lowCorner().y() / tileMeters));
+	int maxZ = static_cast<int>(std::floor(area.highCorner().y() / tileMeters));
+
+	TileIndex firstTileIndex = getFirstTileIndex();
+	int tilesPerSide = static_cast<int>(mTexturePixelSize / mTilePixelSize);
+	bool invalidatedShownTile = false;
+	for (int z = minZ; z <= maxZ; ++z) {
+		for (int x = minX; x <= maxX; ++x) {
+			auto I = mTiles.find(TileIndex(x, z));
+			if (I != mTiles.end()) {
+				I->second.invalid = true;
+				if (x >= firstTileIndex.first && x < firstTileIndex.first + tilesPerSide && z >= firstTileIndex.second && z < firstTileIndex.second + tilesPerSide) {
+					invalidatedShownTile = true;
+				}
+			}
+		}
+	}
+	return invalidatedShownTile;
+}
+
+void Map::clearTiles()
+{
+	mTiles.clear();
+	mTileLru.clear();
+	//The last slot is kept blank.
+	mFreeSlots.clear();
+	for (unsigned int slot = mAtlasTilesPerSide * mAtlasTilesPerSide - 1; slot > 0; --slot) {
+		mFreeSlots.push_back(slot - 1);
+	}
 }
 
 void Map::reposition(const Ogre::Vector2& pos)
 {
-	mCamera.reposition(pos);
+	//Snap to the closest tile corner, so that the map is made up of whole tiles.
+	float tileMeters = getTileResolutionMeters();
+	mPosition.x = std::round(pos.x / tileMeters) * tileMeters;
+	mPosition.y = std::round(pos.y / tileMeters) * tileMeters;
 }
 
 void Map::reposition(float x, float y)
@@ -96,10 +284,16 @@ void Map::reposition(float x, float y)
 	reposition(Ogre::Vector2(x, y));
 }
 
+const Ogre::Vector2& Map::getPosition() const
+{
+	return mPosition;
+}
+
 
 void Map::setDistance(float distance)
 {
 	mCamera.setDistance(distance);
+	clearTiles();
 }
 
 float Map::getDistance() const
@@ -112,11 +306,6 @@ Ogre::TexturePtr Map::getTexture() const
 	return mTexture;
 }
 
-Ogre::RenderTexture* Map::getRenderTexture() const
-{
-	return mRenderTexture;
-}
-
 float Map::getResolution() const
 {
 	return mMetersPerPixel;
@@ -126,6 +315,8 @@ void Map::setResolution(float metersPerPixel)
 {
 	if (metersPerPixel > 0) {
 		mMetersPerPixel = metersPerPixel;
+		clearTiles();
+		reposition(mPosition);
 		mView.recalculateBounds();
 	}
 }
@@ -135,6 +326,11 @@ float Map::getResolutionMeters() const
 	return mTexturePixelSize * mMetersPerPixel;
 }
 
+float Map::getTileResolutionMeters() const
+{
+	return mTilePixelSize * mMetersPerPixel;
+}
+
 MapView& Map::getView()
 {
 	return mView;
@@ -144,12 +340,11 @@ MapView& Map::getView()
 
 
 
-MapView::MapView(Map& map, MapCamera& mapCamera)
+MapView::MapView(Map& map)
 :
 //set it to invalid values so we'll force an update when it's repositioned
 mFullBounds(1, 1, -1, -1)
 , mMap(map)
-, mMapCamera(mapCamera)
 , mViewSize(0.5)
 {
 }
@@ -160,13 +355,23 @@ bool MapView::reposition(const Ogre::Vector2& pos)
 	//check if we need to reposition the camera
 	if (pos.x - halfViewSizeMeters < mFullBounds.left || pos.x + halfViewSizeMeters > mFullBounds.right
 		|| pos.y - halfViewSizeMeters < mFullBounds.bottom || pos.y + halfViewSizeMeters > mFullBounds.top) {
-		mMapCamera.reposition(pos);
-		mMapCamera.render();
+		mMap.reposition(pos);
+		//Any tiles which aren't rendered now are rendered in the following frames.
+		mMap.update();
 
 		recalculateBounds();
+		//Since the map is centered on a tile corner, the view will be off center.
+		updateRelativeBounds(pos);
 
 		return true;
 	}
+	updateRelativeBounds(pos);
+	return false;
+
+}
+
+void MapView::updateRelativeBounds(const Ogre::Vector2& pos)
+{
 	mRelativeViewPosition.x = (pos.x - mFullBounds.left) / static_cast<float>(mMap.getResolutionMeters());
 	mRelativeViewPosition.y = (pos.y - mFullBounds.bottom) / static_cast<float>(mMap.getResolutionMeters());
 	float halfViewSize = mViewSize / 2;
@@ -174,8 +379,6 @@ bool MapView::reposition(const Ogre::Vector2& pos)
 	mVisibleRelativeBounds.right= mRelativeViewPosition.x + halfViewSize;
 	mVisibleRelativeBounds.bottom = mRelativeViewPosition.y - halfViewSize;
 	mVisibleRelativeBounds.top = mRelativeViewPosition.y + halfViewSize;
-	return false;
-
 }
 
 const Ogre::TRect<float>& MapView::getRelativeViewBounds() const
@@ -196,7 +399,7 @@ const Ogre::TRect<int>& MapView::getFullBounds() const
 
 void MapView::recalculateBounds()
 {
-	Ogre::Vector2 pos(mMapCamera.getPosition());
+	Ogre::Vector2 pos(mMap.getPosition());
 	mFullBounds.left = static_cast<int>(pos.x - (mMap.getResolutionMeters() / 2));
 	mFullBounds.right = static_cast<int>(pos.x + (mMap.getResolutionMeters() / 2));
 	mFullBounds.bottom = static_cast<int>(pos.y - (mMap.getResolutionMeters() / 2));
@@ -260,6 +463,11 @@ void MapCamera::setRenderTarget(Ogre::RenderTarget* renderTarget)
     mViewport->setVisibilityMask(Ogre::SceneManager::WORLD_GEOMETRY_TYPE_MASK);
 }
 
+void MapCamera::setViewportDimensions(float left, float top, float width, float height)
+{
+	mViewport->setDimensions(left, top, width, height);
+}
+
 void MapCamera::setDistance(float distance)
 {
 	mDistance = distance;
@@ -289,7 +497,7 @@ void MapCamera::render()
 	mCamera->setFarClipDistance(mDistance * 200);
 
 	mCamera->setProjectionType(Ogre::PT_ORTHOGRAPHIC);
-	mCamera->setOrthoWindow(mMap.getResolutionMeters(), mMap.getResolutionMeters());
+	mCamera->setOrthoWindow(mMap.getTileResolutionMeters(), mMap.getTileResolutionMeters());
 	mCamera->setAspectRatio(1.0);
 	{
 		//use a RAII rendering instance so that we're sure to reset all settings of the scene manager that we change, even if something goes wrong here
@@ -24,6 +24,8 @@
 #define EMBEROGRE_TERRAINMAP_H
 
 #include "components/ogre/EmberOgrePrerequisites.h"
+#include <list>
+#include <map>
 #include <vector>
 #include <OgrePrerequisites.h>
 #include <OgreColourValue.h>
@@ -34,6 +36,12 @@
 
 #include <sigc++/signal.h>
 
+namespace WFMath
+{
+template<int>
+class AxisBox;
+}
+
 namespace Ember {
 namespace OgreView {
 
@@ -132,6 +140,7 @@ protected:
 
 /**
 	@brief Responsible for handling the camera used to render the terrain overhead map.
+	The camera renders one tile of the map at a time, into the part of the tile atlas which holds the tile.
 	@author Erik Ogenvik <erik@ogenvik.org>
 
 */
@@ -156,6 +165,15 @@ public:
 
 	void setRenderTarget(Ogre::RenderTarget* renderTarget);
 
+	/**
+	 * @brief Sets the part of the render target which is rendered to.
+	 * @param left The left edge, relative to the render target, expressed as 0..1.
+	 * @param top The top edge, relative to the render target, expressed as 0..1.
+	 * @param width The width, relative to the render target, expressed as 0..1.
+	 * @param height The height, relative to the render target, expressed as 0..1.
+	 */
+	void setViewportDimensions(float left, float top, float width, float height);
+
 protected:
 	Map& mMap;
 
@@ -176,7 +194,7 @@ protected:
 class MapView
 {
 public:
-	MapView(Map& map, MapCamera& mapCamera);
+	explicit MapView(Map& map);
 
 	/**
 	 * @brief Reposition the view.
@@ -216,6 +234,11 @@ public:
 
 protected:
 
+	/**
+	 * @brief Updates the relative position and bounds of the subview, for a position within the current full bounds.
+	 * @param pos The world position in ogre space of the view.
+	 */
+	void updateRelativeBounds(const Ogre::Vector2& pos);
 
 	/**
 	 * @brief The full bounds of the map being rendered, in world units.
@@ -237,11 +260,6 @@ protected:
 	 */
 	Map& mMap;
 
-	/**
-	 * @brief The camera used to render the map.
-	 */
-	MapCamera& mMapCamera;
-
 	/**
 	 * @brief In relative terms, how much of the total map should be used to render the visible subview.
 	 * Expressed as [0..1], where 1 denotes the full rendered map.
@@ -252,6 +270,15 @@ protected:
 
 /**
  * @brief An overhead map of the terrain, rendered into a texture.
+ *
+ * The world is divided into fixed size tiles, each rendered once through an orthographic camera into a slot of a tile atlas
+ * texture. The map texture is composited from the tiles around the current position by copying them from the atlas on the
+ * GPU, so when the map is scrolled only the tiles which haven't been seen before need to be rendered. The least recently
+ * used tiles are dropped when the atlas is full.
+ *
+ * Since only the terrain is rendered, a tile only needs to be rendered again when the terrain under it changes. Call
+ * invalidate() with the changed areas, and then update() once per frame until it returns true, which spreads the rendering
+ * of the tiles over a couple of frames. Invalidated tiles are shown as they were until they have been rendered again.
  * @author Erik Ogenvik <erik@ogenvik.org>
  */
 class Map{
@@ -265,17 +292,30 @@ public:
     Ogre::TexturePtr getTexture() const;
 
     /**
-     * @brief Gets the render texture into which the map is being rendered.
-     * This is the same texture as the one you will get from getTexture(), but this accesses the more low level rendering structure, allowing you to access the actual ViewPort.
-     * If you haven't called initialize() yet this will return a null pointer.
-     * @return A pointer to the render texture being used for rendering the map, or null if no such has been created yet.
+     * @brief Updates the map texture with the tiles around the current position, rendering all tiles which are missing or invalidated.
      */
-    Ogre::RenderTexture* getRenderTexture() const;
-
     void render();
+
+    /**
+     * @brief Updates the map texture with the tiles around the current position, rendering only a few of the tiles which are missing or invalidated.
+     * Tiles which haven't been rendered yet are shown blank. Call this once per frame until it returns true.
+     * @return True if all of the tiles in the map texture are up to date.
+     */
+    bool update();
+
+    /**
+     * @brief Moves the map, so that it's centered on the tile corner closest to the position.
+     * @note This will not update the map texture, so a call to render() needs to be made if you want the update to show.
+     * @param pos The position, in world units.
+     */
     void reposition(const Ogre::Vector2& pos);
     void reposition(float x, float y);
 
+    /**
+     * @brief Gets the position of the center of the map, in world units.
+     */
+    const Ogre::Vector2& getPosition() const;
+
 	void setDistance(float distance);
 	float getDistance() const;
 
@@ -287,6 +327,7 @@ public:
 
 	/**
 	 * @brief Sets the resolution of the map.
+	 * All tiles are rendered anew at the new resolution.
 	 * @note This will not rerender the map, so a call to render() needs to be made if you want the update to show.
 	 * @param metersPerPixel The resolution of the map in pixels per meter.
 	 */
@@ -298,21 +339,136 @@ public:
 	 */
 	float getResolutionMeters() const;
 
+	/**
+	 * @brief Gets the size of one side of a tile, in meters.
+	 */
+	float getTileResolutionMeters() const;
+
+	/**
+	 * @brief Marks all tiles which overlap an area as invalid, so that they are rendered again.
+	 * @param area The area, in world units.
+	 * @return True if any of the tiles currently used by the map texture were invalidated, in which case update() should be called.
+	 */
+	bool invalidate(const WFMath::AxisBox<2>& area);
+
 	MapView& getView();
 
 
 protected:
 
+	/**
+	 * @brief The index of a tile, along the x and z axes. The tile with index 0,0 starts at the world origin.
+	 */
+	typedef std::pair<int, int> TileIndex;
+
+	struct Tile
+	{
+		/**
+		 * @brief The slot of the tile atlas which holds the rendered tile.
+		 */
+		unsigned int slot;
+
+		/**
+		 * @brief True if the terrain under the tile has changed since it was rendered.
+		 */
+		bool invalid;
+
+		/**
+		 * @brief The position of the tile in the LRU list.
+		 */
+		std::list<TileIndex>::iterator lruEntry;
+	};
+
 	void setupCamera();
 	void createTexture();
 
+	/**
+	 * @brief Updates the map texture, rendering at most a certain number of tiles.
+	 * @param maxRenderedTiles The maximum number of tiles to render.
+	 * @return True if all of the tiles in the map texture are up to date.
+	 */
+	bool renderTiles(size_t maxRenderedTiles);
+
+	/**
+	 * @brief Gets a tile, allocating a slot for it if it's not in the atlas. A newly allocated tile is invalid.
+	 * @param index The index of the tile.
+	 * @return The tile.
+	 */
+	Tile& getTile(const TileIndex& index);
+
+	/**
+	 * @brief Renders a tile into its slot of the tile atlas.
+	 * @param index The index of the tile.
+	 * @param tile The tile.
+	 */
+	void renderTile(const TileIndex& index, Tile& tile);
+
+	/**
+	 * @brief Gets the pixel box of a slot in the tile atlas.
+	 * @param slot The slot.
+	 */
+	Ogre::Box getSlotBox(unsigned int slot) const;
+
+	/**
+	 * @brief Gets the index of the first tile used by the map texture.
+	 */
+	TileIndex getFirstTileIndex() const;
+
+	/**
+	 * @brief Drops all tiles.
+	 */
+	void clearTiles();
 
+	/**
+	 * @brief The map texture, composited from the tiles.
+	 */
 	Ogre::TexturePtr mTexture;
-	Ogre::RenderTexture* mRenderTexture;
+
+	/**
+	 * @brief The texture into which the tiles are rendered, one in each slot. The last slot is kept blank.
+	 */
+	Ogre::TexturePtr mAtlasTexture;
+	Ogre::RenderTexture* mAtlasRenderTexture;
 
 	unsigned int mTexturePixelSize;
+
+	/**
+	 * @brief The size of one side of a tile, in pixels. The texture size must be a multiple of this.
+	 */
+	unsigned int mTilePixelSize;
+
+	/**
+	 * @brief The number of tiles along one side of the tile atlas.
+	 */
+	unsigned int mAtlasTilesPerSide;
+
 	float mMetersPerPixel;
 
+	/**
+	 * @brief The center of the map, in world units. This is always a tile corner.
+	 */
+	Ogre::Vector2 mPosition;
+
+	/**
+	 * @brief The tiles in the atlas.
+	 */
+	std::map<TileIndex, Tile> mTiles;
+
+	/**
+	 * @brief The indices of the tiles in the atlas, with the most recently used first.
+	 */
+	std::list<TileIndex> mTileLru;
+
+	/**
+	 * @brief The slots of the atlas which aren't used by any tile.
+	 */
+	std::vector<unsigned int> mFreeSlots;
+
+	/**
+	 * @brief The number of tiles rendered by each call to update().
+	 */
+	size_t mTileRendersPerUpdate;
+
 	MapCamera mCamera;
 	MapView mView;
 
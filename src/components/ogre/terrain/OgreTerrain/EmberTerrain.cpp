@@ -23,6 +23,8 @@
 #include <Ogre.h>
 #include "EmberTerrain.h"
 
+#include <algorithm>
+
 namespace Ember {
 namespace OgreView {
 namespace Terrain {
@@ -125,7 +127,11 @@ void EmberTerrain::handleResponse(const Ogre::WorkQueue::Response* res, const Og
 		}
 		if (!mDerivedDataUpdateInProgress && wasUpdatingDerivedData) {
 			//We've finished updating derived data and should signal that we've altered.
-			Ogre::TRect<Ogre::Real> rect(dirtyRect.left, dirtyRect.top, dirtyRect.right, dirtyRect.bottom);
+			//The dirty rect is in terrain points, so it's converted into world coordinates.
+			Ogre::Vector3 corner1, corner2;
+			convertPosition(POINT_SPACE, Ogre::Vector3(dirtyRect.left, dirtyRect.top, 0), WORLD_SPACE, corner1);
+			convertPosition(POINT_SPACE, Ogre::Vector3(dirtyRect.right, dirtyRect.bottom, 0), WORLD_SPACE, corner2);
+			Ogre::TRect<Ogre::Real> rect(std::min(corner1.x, corner2.x), std::min(corner1.z, corner2.z), std::max(corner1.x, corner2.x), std::max(corner1.z, corner2.z));
 
 			mTerrainAreaUpdatedSignal(rect);
 		}
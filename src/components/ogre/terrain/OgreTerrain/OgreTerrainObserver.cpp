@@ -19,6 +19,8 @@
 #include "OgreTerrainObserver.h"
 #include "components/ogre/Convert.h"
 
+#include <algorithm>
+
 namespace Ember
 {
 namespace OgreView
@@ -44,13 +46,15 @@ void OgreTerrainObserver::observeArea(const WFMath::AxisBox<2>& area)
 
 void OgreTerrainObserver::observeArea(const Ogre::TRect<int>& area)
 {
-	mObservedArea = Ogre::TRect<Ogre::Real>(area.left, area.top, area.right, area.bottom);
+	//The area might have its top and bottom swapped, as in MapView, while intersect() expects top to be the lower value.
+	mObservedArea = Ogre::TRect<Ogre::Real>(area.left, std::min(area.top, area.bottom), area.right, std::max(area.top, area.bottom));
 }
 
 void OgreTerrainObserver::terrainUpdated(const Ogre::TRect<Ogre::Real>& updatedArea)
 {
-	if (!mObservedArea.intersect(updatedArea).isNull()) {
-		EventAreaShown();
+	auto shownArea = mObservedArea.intersect(updatedArea);
+	if (!shownArea.isNull()) {
+		EventAreaShown(Convert::toWF(shownArea));
 	}
 }
 } /* namespace Terrain */
@@ -19,6 +19,8 @@
 #ifndef PLANTAREAQUERYRESULT_H_
 #define PLANTAREAQUERYRESULT_H_
 
+#include "PlantInstance.h"
+
 #include <vector>
 
 #include <OgrePrerequisites.h>
@@ -37,7 +39,6 @@ namespace Terrain
 
 template<typename> class Buffer;
 
-class PlantInstance;
 class PlantAreaQuery;
 class PlantAreaQueryResult
 {
@@ -46,7 +47,7 @@ public:
 	/**
 	A store of plant positions. We keep this in ogre space for performance reasons.
 	*/
-	typedef std::vector<PlantInstance> PlantStore;
+	typedef Terrain::PlantStore PlantStore;
 
 	PlantAreaQueryResult(const PlantAreaQuery& query);
 	virtual ~PlantAreaQueryResult();
@@ -23,6 +23,8 @@
 #include <OgreVector3.h>
 #include <OgreVector2.h>
 
+#include <vector>
+
 namespace Ember
 {
 namespace OgreView
@@ -107,6 +109,102 @@ public:
 	Ogre::Vector2 scale;
 };
 
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief A collection of plant instances in a 3d space, stored as a structure of arrays.
+ * Each attribute of the plants is kept in its own array, so that populators can write, and the foliage can read, one attribute of
+ * many plants in one go. Use operator[] to get a single plant as a PlantInstance.
+ */
+class PlantStore
+{
+public:
+	/**
+	 * @brief The x positions of the plants.
+	 */
+	std::vector<float> positionX;
+
+	/**
+	 * @brief The y positions, i.e. the heights, of the plants.
+	 */
+	std::vector<float> positionY;
+
+	/**
+	 * @brief The z positions of the plants.
+	 */
+	std::vector<float> positionZ;
+
+	/**
+	 * @brief The rotations of the plants around the vertical axis.
+	 */
+	std::vector<float> orientation;
+
+	/**
+	 * @brief The width scales of the plants.
+	 */
+	std::vector<float> scaleX;
+
+	/**
+	 * @brief The height scales of the plants.
+	 */
+	std::vector<float> scaleY;
+
+	size_t size() const
+	{
+		return positionX.size();
+	}
+
+	bool empty() const
+	{
+		return positionX.empty();
+	}
+
+	void reserve(size_t count)
+	{
+		positionX.reserve(count);
+		positionY.reserve(count);
+		positionZ.reserve(count);
+		orientation.reserve(count);
+		scaleX.reserve(count);
+		scaleY.reserve(count);
+	}
+
+	void clear()
+	{
+		positionX.clear();
+		positionY.clear();
+		positionZ.clear();
+		orientation.clear();
+		scaleX.clear();
+		scaleY.clear();
+	}
+
+	/**
+	 * @brief Adds a plant.
+	 * @param position A position in 3d space.
+	 * @param rotation The rotation around the vertical axis for the plant.
+	 * @param scale The scale of the plant in width and height.
+	 */
+	void add(const Ogre::Vector3& position, float rotation, const Ogre::Vector2& scale)
+	{
+		positionX.push_back(position.x);
+		positionY.push_back(position.y);
+		positionZ.push_back(position.z);
+		orientation.push_back(rotation);
+		scaleX.push_back(scale.x);
+		scaleY.push_back(scale.y);
+	}
+
+	/**
+	 * @brief Gets a single plant.
+	 * @param index The index of the plant.
+	 * @return The plant.
+	 */
+	PlantInstance operator[](size_t index) const
+	{
+		return PlantInstance(Ogre::Vector3(positionX[index], positionY[index], positionZ[index]), orientation[index], Ogre::Vector2(scaleX[index], scaleY[index]));
+	}
+};
+
 }
 }
 }
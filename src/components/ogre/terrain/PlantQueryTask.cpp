@@ -18,9 +18,14 @@
 
 #include "PlantQueryTask.h"
 #include "PlantAreaQuery.h"
+#include "HeightMap.h"
+#include "HeightMapSegment.h"
+#include "Segment.h"
 #include "foliage/PlantPopulator.h"
 #include "components/ogre/Convert.h"
 
+#include <Mercator/Segment.h>
+
 namespace Ember
 {
 namespace OgreView
@@ -29,26 +34,59 @@ namespace OgreView
 namespace Terrain
 {
 
-PlantQueryTask::PlantQueryTask(const SegmentRefPtr& segmentRef, Foliage::PlantPopulator& plantPopulator, const PlantAreaQuery& query, const Ogre::ColourValue& defaultShadowColour, sigc::slot<void, const PlantAreaQueryResult&> asyncCallback) :
-	mSegmentRef(segmentRef), mPlantPopulator(plantPopulator), mAsyncCallback(asyncCallback), mQueryResult(query)
+PlantQueryTask::PlantQueryTask(const SegmentRefPtr& segmentRef, Foliage::PlantPopulator& plantPopulator, const HeightMap& heightMap, const Ogre::ColourValue& defaultShadowColour) :
+	mSegmentRef(segmentRef), mPlantPopulator(plantPopulator), mHeightMap(heightMap), mDefaultShadowColour(defaultShadowColour)
 {
-	mQueryResult.setDefaultShadowColour(defaultShadowColour);
 }
 
 PlantQueryTask::~PlantQueryTask()
 {
 }
 
+void PlantQueryTask::addQuery(const PlantAreaQuery& query, sigc::slot<void, const PlantAreaQueryResult&> asyncCallback)
+{
+	mQueryResults.emplace_back(new PlantAreaQueryResult(query));
+	mQueryResults.back()->setDefaultShadowColour(mDefaultShadowColour);
+	mAsyncCallbacks.emplace_back(std::move(asyncCallback));
+}
+
 void PlantQueryTask::executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context)
 {
-	mPlantPopulator.populate(mQueryResult, mSegmentRef);
+	std::vector<PlantAreaQueryResult*> results;
+	results.reserve(mQueryResults.size());
+	for (auto& result : mQueryResults) {
+		results.push_back(result.get());
+	}
+	mPlantPopulator.populateBatch(results, mSegmentRef);
+	for (auto result : results) {
+		placeOnGround(result->getStore());
+	}
 	//Release Segment references as soon as we can
 	mSegmentRef.reset();
 }
 
+void PlantQueryTask::placeOnGround(PlantStore& plants)
+{
+	size_t count = plants.size();
+	plants.positionY.resize(count);
+	if (count == 0 || mHeightMap.getHeights(plants.positionX.data(), plants.positionZ.data(), plants.positionY.data(), nullptr, count) == count) {
+		return;
+	}
+
+	Mercator::Segment& mercatorSegment = mSegmentRef->getMercatorSegment();
+	std::vector<float> localX(count), localZ(count);
+	for (size_t i = 0; i < count; ++i) {
+		localX[i] = plants.positionX[i] - mercatorSegment.getXRef();
+		localZ[i] = plants.positionZ[i] - mercatorSegment.getZRef();
+	}
+	HeightMapSegment::interpolateHeights(mercatorSegment.getPoints(), static_cast<size_t>(mercatorSegment.getSize()), localX.data(), localZ.data(), plants.positionY.data(), nullptr, count);
+}
+
 bool PlantQueryTask::executeTaskInMainThread()
 {
-	mAsyncCallback(mQueryResult);
+	for (size_t i = 0; i < mQueryResults.size(); ++i) {
+		mAsyncCallbacks[i](*mQueryResults[i]);
+	}
 	return true;
 }
 }
@@ -25,6 +25,9 @@
 
 #include <sigc++/slot.h>
 
+#include <memory>
+#include <vector>
+
 namespace Ember
 {
 namespace OgreView
@@ -33,6 +36,7 @@ namespace OgreView
 namespace Terrain
 {
 
+class HeightMap;
 class TerrainPage;
 class TerrainPageGeometry;
 
@@ -40,12 +44,26 @@ namespace Foliage {
 class PlantPopulator;
 }
 
+/**
+ * @brief Executes a batch of plant queries, all within the same segment and for the same populator.
+ *
+ * Foliage paging issues many small queries at once, so instead of a task per query the queries of each frame are gathered into
+ * batches, letting the populator share work (such as combining the coverage of the segment) between them.
+ * Once the plants have been placed their heights are looked up from the height map, for all plants of a query at once.
+ */
 class PlantQueryTask : public Tasks::TemplateNamedTask<PlantQueryTask>
 {
 public:
-	PlantQueryTask(const SegmentRefPtr& segmentRef, Foliage::PlantPopulator& plantPopulator, const PlantAreaQuery& query, const Ogre::ColourValue& defaultShadowColour, sigc::slot<void, const PlantAreaQueryResult&> asyncCallback);
+	PlantQueryTask(const SegmentRefPtr& segmentRef, Foliage::PlantPopulator& plantPopulator, const HeightMap& heightMap, const Ogre::ColourValue& defaultShadowColour);
 	virtual ~PlantQueryTask();
 
+	/**
+	 * @brief Adds a query to the batch. This must be done before the task is enqueued.
+	 * @param query The query.
+	 * @param asyncCallback A callback to be called in the main thread with the result of the query.
+	 */
+	void addQuery(const PlantAreaQuery& query, sigc::slot<void, const PlantAreaQueryResult&> asyncCallback);
+
 	virtual void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context);
 
 	virtual bool executeTaskInMainThread();
@@ -53,9 +71,18 @@ public:
 private:
 	SegmentRefPtr mSegmentRef;
 	Foliage::PlantPopulator& mPlantPopulator;
-	sigc::slot<void, const PlantAreaQueryResult&> mAsyncCallback;
-
-	PlantAreaQueryResult mQueryResult;
+	const HeightMap& mHeightMap;
+	Ogre::ColourValue mDefaultShadowColour;
+
+	std::vector<std::unique_ptr<PlantAreaQueryResult>> mQueryResults;
+	std::vector<sigc::slot<void, const PlantAreaQueryResult&>> mAsyncCallbacks;
+
+	/**
+	 * @brief Looks up the heights of all plants of a result.
+	 * Should the height map not yet contain the segment, the heights are interpolated from the Mercator segment instead.
+	 * @param plants The plants.
+	 */
+	void placeOnGround(PlantStore& plants);
 };
 
 }
@@ -0,0 +1,426 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SegmentCache.h"
+#include "TerrainLayerDefinition.h"
+
+#include "framework/Hasher.h"
+#include "framework/LoggingInstance.h"
+
+#include <Mercator/Segment.h>
+#include <Mercator/Surface.h>
+#include <Mercator/TerrainMod.h>
+#include <Mercator/Area.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+namespace
+{
+
+/**
+ * @brief Identifies a cached heights file, and its version.
+ */
+const std::uint32_t HeightsMagic = 0x45534832; // "ESH2"
+
+/**
+ * @brief Identifies a cached coverage file, and its version.
+ */
+const std::uint32_t CoverageMagic = 0x45534332; // "ESC2"
+
+/**
+ * @brief The version of the way keys are calculated. Changing it makes all existing files miss, so that they're replaced.
+ */
+const std::uint32_t KeyVersion = 2;
+
+struct HeightsHeader
+{
+	std::uint32_t magic;
+	std::uint32_t count;
+	float min;
+	float max;
+};
+
+struct CoverageHeader
+{
+	std::uint32_t magic;
+	std::uint32_t count;
+};
+
+/**
+ * @brief A read only view of a whole file.
+ *
+ * The file is memory mapped where supported, else it's read into memory.
+ */
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path) : mData(nullptr), mSize(0)
+	{
+#ifndef _WIN32
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd == -1) {
+			return;
+		}
+		struct stat fileStat{};
+		if (::fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+			void* data = ::mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				mData = static_cast<const char*>(data);
+				mSize = static_cast<size_t>(fileStat.st_size);
+			}
+		}
+		::close(fd);
+#else
+		std::ifstream stream(path, std::ios::binary | std::ios::ate);
+		if (!stream) {
+			return;
+		}
+		mBuffer.resize(static_cast<size_t>(stream.tellg()));
+		stream.seekg(0);
+		if (stream.read(mBuffer.data(), mBuffer.size())) {
+			mData = mBuffer.data();
+			mSize = mBuffer.size();
+		}
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (mData) {
+			::munmap(const_cast<char*>(mData), mSize);
+		}
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * @brief Gets the data of the file, after a header.
+	 * @param header Out parameter for the header.
+	 * @param dataSize The expected size of the data, in bytes.
+	 * @return The data, or null if the file doesn't exist or has the wrong size.
+	 */
+	template<typename THeader>
+	const char* getData(THeader& header, size_t dataSize) const
+	{
+		if (!mData || mSize != sizeof(THeader) + dataSize) {
+			return nullptr;
+		}
+		std::memcpy(&header, mData, sizeof(THeader));
+		return mData + sizeof(THeader);
+	}
+
+private:
+	const char* mData;
+	size_t mSize;
+#ifdef _WIN32
+	std::vector<char> mBuffer;
+#endif
+};
+
+}
+
+SegmentCache::SegmentCache(std::string directory) :
+		mDirectory(std::move(directory)),
+		mHitCount(0),
+		mMissCount(0),
+		mTemporaryFileCounter(0)
+{
+	scanDirectory();
+}
+
+std::uint64_t SegmentCache::createHeightsKey(const Mercator::Segment& segment)
+{
+	//Include the Mercator version, as the same input might be populated differently by another version.
+	Hasher hasher(KeyVersion);
+	hasher.add(std::string(MERCATOR_VERSION));
+	hasher.add(segment.getXRef());
+	hasher.add(segment.getZRef());
+	hasher.add(segment.getResolution());
+
+	auto& controlPoints = segment.getControlPoints();
+	for (unsigned int x = 0; x < 2; ++x) {
+		for (unsigned int z = 0; z < 2; ++z) {
+			auto& basePoint = controlPoints(x, z);
+			hasher.add(basePoint.height());
+			hasher.add(basePoint.roughness());
+			hasher.add(basePoint.falloff());
+		}
+	}
+
+	//Mods can't be serialized, so they are instead identified by their effect on the points of the segment they cover.
+	//Each point is probed with a very low and a very high height, which catches mods which set, offset or clamp the height.
+	const int resolution = segment.getResolution();
+	for (auto& entry : segment.getMods()) {
+		const Mercator::TerrainMod* mod = entry.second;
+		auto& bbox = mod->bbox();
+		int lowX = std::max(0, static_cast<int>(std::floor(bbox.lowCorner().x())) - segment.getXRef());
+		int highX = std::min(resolution, static_cast<int>(std::ceil(bbox.highCorner().x())) - segment.getXRef());
+		int lowZ = std::max(0, static_cast<int>(std::floor(bbox.lowCorner().y())) - segment.getZRef());
+		int highZ = std::min(resolution, static_cast<int>(std::ceil(bbox.highCorner().y())) - segment.getZRef());
+		hasher.add(lowX);
+		hasher.add(highX);
+		hasher.add(lowZ);
+		hasher.add(highZ);
+		for (int z = lowZ; z <= highZ; ++z) {
+			for (int x = lowX; x <= highX; ++x) {
+				float low = -10000.0f;
+				float high = 10000.0f;
+				mod->apply(low, x + segment.getXRef(), z + segment.getZRef());
+				mod->apply(high, x + segment.getXRef(), z + segment.getZRef());
+				hasher.add(low);
+				hasher.add(high);
+			}
+		}
+	}
+	return hasher.get();
+}
+
+std::uint64_t SegmentCache::createShaderKey(const TerrainLayerDefinition& definition)
+{
+	Hasher hasher;
+	hasher.add(definition.getShaderName());
+	hasher.add(definition.getAreaId());
+	for (auto& parameter : definition.getParameters()) {
+		hasher.add(parameter.first);
+		hasher.add(parameter.second);
+	}
+	return hasher.get();
+}
+
+std::string SegmentCache::getPath(const Mercator::Segment& segment, std::uint64_t key, const char* extension) const
+{
+	std::stringstream ss;
+	ss << mDirectory << "/" << segment.getXRef() << "_" << segment.getZRef() << "_" << std::hex << key << extension;
+	return ss.str();
+}
+
+void SegmentCache::populate(Mercator::Segment& segment)
+{
+	std::uint64_t key = createHeightsKey(segment);
+	std::string path = getPath(segment, key, ".heights");
+	const size_t count = static_cast<size_t>(segment.getSize()) * segment.getSize();
+
+	{
+		MappedFile file(path);
+		HeightsHeader header{};
+		const char* data = file.getData(header, count * sizeof(float));
+		if (data && header.magic == HeightsMagic && header.count == count) {
+			Mercator::HeightMap& heightMap = segment.getHeightMap();
+			heightMap.allocate();
+			std::memcpy(heightMap.getData(), data, count * sizeof(float));
+			heightMap.checkMaxMin(header.min);
+			heightMap.checkMaxMin(header.max);
+			mHitCount++;
+			setCurrentFile(segment, ".heights", path);
+			return;
+		}
+	}
+
+	mMissCount++;
+	segment.populate();
+
+	HeightsHeader header{HeightsMagic, static_cast<std::uint32_t>(count), segment.getMin(), segment.getMax()};
+	if (write(path, &header, sizeof(header), {{segment.getPoints(), count * sizeof(float)}})) {
+		setCurrentFile(segment, ".heights", path);
+	}
+}
+
+void SegmentCache::populateSurfaces(Mercator::Segment& segment, const std::map<int, std::uint64_t>& shaderKeys)
+{
+	std::vector<Mercator::Surface*> surfaces;
+	size_t count = 0;
+	//The heights key is the most expensive part, so the key of all surfaces is calculated at once.
+	Hasher hasher(createHeightsKey(segment));
+	for (auto& entry : shaderKeys) {
+		auto I = segment.getSurfaces().find(entry.first);
+		if (I != segment.getSurfaces().end()) {
+			surfaces.push_back(I->second);
+			count += static_cast<size_t>(I->second->getSize()) * I->second->getSize() * I->second->getChannels();
+			hasher.add(entry.first);
+			hasher.add(entry.second);
+		}
+	}
+	if (surfaces.empty()) {
+		return;
+	}
+	for (auto& entry : segment.getAreas()) {
+		const Mercator::Area* area = entry.second;
+		hasher.add(area->getLayer());
+		hasher.add(area->isHole());
+		auto& shape = area->shape();
+		for (size_t i = 0; i < shape.numCorners(); ++i) {
+			hasher.add(shape.getCorner(i).x());
+			hasher.add(shape.getCorner(i).y());
+		}
+	}
+	std::string path = getPath(segment, hasher.get(), ".coverage");
+
+	{
+		MappedFile file(path);
+		CoverageHeader header{};
+		const char* data = file.getData(header, count);
+		if (data && header.magic == CoverageMagic && header.count == count) {
+			for (auto surface : surfaces) {
+				if (!surface->isValid()) {
+					surface->allocate();
+				}
+				size_t size = static_cast<size_t>(surface->getSize()) * surface->getSize() * surface->getChannels();
+				std::memcpy(surface->getData(), data, size);
+				data += size;
+			}
+			mHitCount++;
+			setCurrentFile(segment, ".coverage", path);
+			return;
+		}
+	}
+
+	mMissCount++;
+	std::vector<std::pair<const void*, size_t>> chunks;
+	for (auto surface : surfaces) {
+		surface->populate();
+		chunks.emplace_back(surface->getData(), static_cast<size_t>(surface->getSize()) * surface->getSize() * surface->getChannels());
+	}
+
+	CoverageHeader header{CoverageMagic, static_cast<std::uint32_t>(count)};
+	if (write(path, &header, sizeof(header), chunks)) {
+		setCurrentFile(segment, ".coverage", path);
+	}
+}
+
+void SegmentCache::setCurrentFile(const Mercator::Segment& segment, const char* extension, const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mCurrentFilesMutex);
+	auto& currentPath = mCurrentFiles[std::make_tuple(segment.getXRef(), segment.getZRef(), std::string(extension))];
+	if (currentPath != path) {
+		if (!currentPath.empty()) {
+			std::remove(currentPath.c_str());
+		}
+		currentPath = path;
+	}
+}
+
+void SegmentCache::scanDirectory()
+{
+	std::map<std::tuple<int, int, std::string>, std::time_t> newestWriteTimes;
+	try {
+		boost::filesystem::path directory(mDirectory);
+		if (!boost::filesystem::is_directory(directory)) {
+			return;
+		}
+		for (boost::filesystem::directory_iterator I(directory), end; I != end; ++I) {
+			std::string fileName = I->path().filename().string();
+			//Build the path the same way as getPath() does, so that the paths can be compared.
+			std::string path = mDirectory + "/" + fileName;
+			std::string extension = I->path().extension().string();
+			if (extension.compare(0, 4, ".tmp") == 0) {
+				//Left behind by an interrupted write.
+				std::remove(path.c_str());
+				continue;
+			}
+			int x, z;
+			if ((extension != ".heights" && extension != ".coverage") || std::sscanf(fileName.c_str(), "%d_%d_", &x, &z) != 2) {
+				continue;
+			}
+			std::time_t writeTime = boost::filesystem::last_write_time(I->path());
+			auto slot = std::make_tuple(x, z, extension);
+			auto J = newestWriteTimes.find(slot);
+			if (J == newestWriteTimes.end()) {
+				newestWriteTimes.emplace(slot, writeTime);
+				mCurrentFiles.emplace(slot, path);
+			} else if (writeTime > J->second) {
+				std::remove(mCurrentFiles[slot].c_str());
+				J->second = writeTime;
+				mCurrentFiles[slot] = path;
+			} else {
+				std::remove(path.c_str());
+			}
+		}
+	} catch (const boost::filesystem::filesystem_error& e) {
+		S_LOG_WARNING("Could not scan terrain segment cache directory '" << mDirectory << "'." << e);
+	}
+}
+
+bool SegmentCache::write(const std::string& path, const void* header, size_t headerSize, const std::vector<std::pair<const void*, size_t>>& chunks)
+{
+	std::string tempPath = path + ".tmp" + std::to_string(mTemporaryFileCounter++);
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		if (!stream) {
+			S_LOG_WARNING("Could not write terrain segment to cache file '" << path << "'.");
+			return false;
+		}
+		stream.write(static_cast<const char*>(header), headerSize);
+		for (auto& chunk : chunks) {
+			stream.write(static_cast<const char*>(chunk.first), chunk.second);
+		}
+		if (!stream) {
+			S_LOG_WARNING("Could not write terrain segment to cache file '" << path << "'.");
+			stream.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+unsigned long SegmentCache::getHitCount() const
+{
+	return mHitCount;
+}
+
+unsigned long SegmentCache::getMissCount() const
+{
+	return mMissCount;
+}
+
+}
+}
+}
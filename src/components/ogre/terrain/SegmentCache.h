@@ -0,0 +1,180 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SEGMENTCACHE_H_
+#define SEGMENTCACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Mercator
+{
+class Segment;
+class Surface;
+}
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+class TerrainLayerDefinition;
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Caches populated Mercator segments on disk, so that they don't need to be calculated again the next time they're needed.
+ *
+ * Populating a segment (i.e. generating its heights from the base points and applying all mods) and shading its surfaces are the
+ * most expensive parts of loading a terrain page. Since the terrain rarely changes between sessions the results are stored in a
+ * cache directory, in files named by the position of the segment and a hash of all input which affects them. A changed base point,
+ * mod, area or shader thus results in a new hash. Only the latest heights and coverage file of each segment position are kept;
+ * the file it supersedes is removed once a new one has been written, and any older files are removed when the cache is created.
+ *
+ * The heights are keyed by the cache format, the Mercator version, the position and resolution of the segment, its base points and
+ * the effect of all its mods. The coverage of all surfaces of a segment is stored in one file, keyed by the key of the heights, all
+ * areas of the segment, and the definitions of the layers.
+ *
+ * Cached files are memory mapped when read, and copied straight into the buffers of the Mercator segment. The normals aren't
+ * stored, since Mercator has no way of accepting them; they're calculated from the heights, which is cheap compared to populating.
+ *
+ * All methods are thread safe, as long as the same segment isn't populated from multiple threads at once.
+ */
+class SegmentCache
+{
+public:
+
+	/**
+	 * @brief Ctor.
+	 * Any superseded files in the directory are removed.
+	 * @param directory The directory in which cached files are stored. It must already exist.
+	 */
+	explicit SegmentCache(std::string directory);
+
+	/**
+	 * @brief Populates the heights of a segment, reading them from the cache if possible.
+	 * If they aren't in the cache they are calculated and then written to the cache.
+	 * @param segment The segment to populate.
+	 */
+	void populate(Mercator::Segment& segment);
+
+	/**
+	 * @brief Populates the coverage of surfaces of a segment, reading them from the cache if possible.
+	 * If they aren't in the cache they're calculated and then written to the cache.
+	 * The segment must have been populated.
+	 * @param segment The segment to which the surfaces belong.
+	 * @param shaderKeys The surfaces to populate, as surface indices mapped to keys identifying the shader of each surface and
+	 * all its parameters. See createShaderKey(). Indices for which the segment has no surface are ignored.
+	 */
+	void populateSurfaces(Mercator::Segment& segment, const std::map<int, std::uint64_t>& shaderKeys);
+
+	/**
+	 * @brief Creates a key identifying the shader of a layer.
+	 * @param definition The definition of the layer.
+	 * @return A key.
+	 */
+	static std::uint64_t createShaderKey(const TerrainLayerDefinition& definition);
+
+	/**
+	 * @brief Gets the number of heights and coverage files which have been read from the cache.
+	 * @return The number of cache hits.
+	 */
+	unsigned long getHitCount() const;
+
+	/**
+	 * @brief Gets the number of heights and coverage files which weren't found in the cache, and thus had to be calculated.
+	 * @return The number of cache misses.
+	 */
+	unsigned long getMissCount() const;
+
+private:
+
+	const std::string mDirectory;
+
+	std::atomic<unsigned long> mHitCount;
+	std::atomic<unsigned long> mMissCount;
+
+	/**
+	 * @brief Used for giving each temporary file a unique name, as the same file might be written from multiple threads.
+	 */
+	std::atomic<unsigned long> mTemporaryFileCounter;
+
+	/**
+	 * @brief The latest file for each segment position and file extension.
+	 */
+	std::map<std::tuple<int, int, std::string>, std::string> mCurrentFiles;
+
+	/**
+	 * @brief Guards mCurrentFiles.
+	 */
+	std::mutex mCurrentFilesMutex;
+
+	/**
+	 * @brief Calculates the key of the heights of a segment.
+	 * @param segment The segment.
+	 * @return A key.
+	 */
+	static std::uint64_t createHeightsKey(const Mercator::Segment& segment);
+
+	/**
+	 * @brief Gets the path of a cached file.
+	 * @param segment The segment.
+	 * @param key The key of the file.
+	 * @param extension The file extension.
+	 * @return A path.
+	 */
+	std::string getPath(const Mercator::Segment& segment, std::uint64_t key, const char* extension) const;
+
+	/**
+	 * @brief Records the latest file of a segment position, removing the file it supersedes.
+	 * @param segment The segment.
+	 * @param extension The file extension.
+	 * @param path The path of the latest file.
+	 */
+	void setCurrentFile(const Mercator::Segment& segment, const char* extension, const std::string& path);
+
+	/**
+	 * @brief Finds the latest file of each segment position in the directory, and removes all others.
+	 */
+	void scanDirectory();
+
+	/**
+	 * @brief Writes data to a cache file.
+	 * The file is first written to a temporary file, and then moved into place, so that an incomplete file never is read.
+	 * @param path The path of the file.
+	 * @param header The header, which is written before the data.
+	 * @param headerSize The size of the header in bytes.
+	 * @param chunks The data, as pointers and sizes in bytes, which are written one after another.
+	 * @return True if the file was written.
+	 */
+	bool write(const std::string& path, const void* header, size_t headerSize, const std::vector<std::pair<const void*, size_t>>& chunks);
+};
+
+}
+}
+}
+
+#endif /* SEGMENTCACHE_H_ */
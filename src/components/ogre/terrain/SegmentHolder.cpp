@@ -20,7 +20,6 @@
 #include "Segment.h"
 #include "SegmentManager.h"
 
-#include <cassert>
 
 namespace Ember
 {
@@ -31,7 +30,7 @@ namespace Terrain
 {
 
 SegmentHolder::SegmentHolder(Segment* segment, SegmentManager& segmentManager) :
-	mSegment(segment), mSegmentManager(segmentManager), mRefCount(0)
+	mSegment(segment), mSegmentManager(segmentManager), mRefCount(0), mResidentBytes(0), mIsMarkedAsUnused(false), mIsPrefetched(false)
 {
 
 }
@@ -44,8 +43,8 @@ SegmentHolder::~SegmentHolder()
 std::shared_ptr<Segment> SegmentHolder::getReference()
 {
 	mRefCount++;
-	//If mRefCount is 1 we're guaranteed to be the only one interacting with the segment, so it's thread safe to call Mercator::Segment::isValid
-	if (mRefCount == 1 && mSegment->getMercatorSegment().isValid()) {
+	//References are only handed out while the SegmentManager holds the lock of the shard, so there's no race when going from zero references.
+	if (mRefCount == 1) {
 		mSegmentManager.unmarkHolder(this);
 	}
 
@@ -58,13 +57,8 @@ std::shared_ptr<Segment> SegmentHolder::getReference()
 
 void SegmentHolder::returnReference()
 {
-	assert(mRefCount > 0);
-	mRefCount--;
-	//If mRefCount is 0 we're guaranteed to be the only one interacting with the segment, so it's thread safe to call Mercator::Segment::isValid
-	if (mRefCount == 0 && mSegment->getMercatorSegment().isValid()) {
-		mSegmentManager.markHolderAsDirtyAndUnused(this);
-		mSegmentManager.pruneUnusedSegments();
-	}
+	//The counter is decreased while the SegmentManager holds the lock of the shard, so that no reference is handed out while the segment is measured.
+	mSegmentManager.returnReference(this);
 }
 
 bool SegmentHolder::isUnused()
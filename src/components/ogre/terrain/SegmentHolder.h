@@ -23,6 +23,8 @@
 #include <mutex>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <list>
 
 
 namespace Ember
@@ -46,6 +48,7 @@ class SegmentManager;
 class SegmentHolder
 {
 friend class SegmentReference;
+friend class SegmentManager;
 public:
 
 	/**
@@ -93,9 +96,38 @@ protected:
 
 	/**
 	 * @brief The number of currently active references to the Segment.
+	 * This is only changed by the SegmentManager, while holding the lock of the shard of the segment.
 	 */
 	std::atomic<unsigned int> mRefCount;
 
+	/**
+	 * @brief The number of bytes of data held by the segment, as measured when the last reference was returned.
+	 * This is only accessed by the SegmentManager, while holding its lock of the unused segments.
+	 */
+	size_t mResidentBytes;
+
+	/**
+	 * @brief When the last reference was returned.
+	 * This is only accessed by the SegmentManager, while holding its lock of the unused segments.
+	 */
+	std::chrono::steady_clock::time_point mLastUsed;
+
+	/**
+	 * @brief True if the holder is in the list of unused segments of the SegmentManager, at mUnusedIterator.
+	 * This is only accessed by the SegmentManager, while holding its lock of the unused segments.
+	 */
+	bool mIsMarkedAsUnused;
+
+	/**
+	 * @brief The position of the holder in the list of unused segments of the SegmentManager, if mIsMarkedAsUnused is true.
+	 */
+	std::list<SegmentHolder*>::iterator mUnusedIterator;
+
+	/**
+	 * @brief True if the segment was populated by a prefetch, and hasn't been used since.
+	 */
+	std::atomic<bool> mIsPrefetched;
+
 	/**
 	 * @brief Called when a reference is destroyed. This will decrease the reference counter.
 	 */
@@ -19,14 +19,21 @@
 #include "SegmentManager.h"
 #include "Segment.h"
 #include "SegmentHolder.h"
+#include "SegmentCache.h"
 
 #include "framework/LoggingInstance.h"
 
 #include <Mercator/Shader.h>
 #include <Mercator/Terrain.h>
+#include <Mercator/Surface.h>
 
 #include <wfmath/MersenneTwister.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
 namespace Ember
 {
 namespace OgreView
@@ -35,34 +42,62 @@ namespace OgreView
 namespace Terrain
 {
 
-SegmentManager::SegmentManager(Mercator::Terrain& terrain, unsigned int desiredSegmentBuffer) :
+namespace
+{
+/**
+ * @brief How much further away a segment must be, in segments, to be as suitable for release as one which was used a second earlier.
+ */
+const float EvictionSecondsPerSegment = 30.0f;
+}
+
+SegmentManager::SegmentManager(Mercator::Terrain& terrain, size_t memoryBudget) :
 		mTerrain(terrain),
-		mDesiredSegmentBuffer(desiredSegmentBuffer),
+		mMemoryBudget(memoryBudget),
+		mResidentBytes(0),
+		mEvictionCount(0),
+		mPrefetchCount(0),
+		mPrefetchHitCount(0),
 		mFakeSegmentHeight(-12.0f),
 		mFakeSegmentHeightVariation(10.0f),
-		mEndlessWorldEnabled(false)
+		mEndlessWorldEnabled(false),
+		mSegmentCache(nullptr)
 {
 
 }
 
 SegmentManager::~SegmentManager()
 {
-	for (SegmentStore::const_iterator I = mSegments.begin(); I != mSegments.end(); ++I) {
-		delete I->second;
+	for (auto& shard : mShards) {
+		for (auto& entry : shard.segments) {
+			delete entry.second;
+		}
 	}
 }
 
+SegmentManager::SegmentKey SegmentManager::createKey(int xIndex, int yIndex)
+{
+	return (static_cast<SegmentKey>(static_cast<std::uint32_t>(xIndex)) << 32) | static_cast<std::uint32_t>(yIndex);
+}
+
+SegmentManager::Shard& SegmentManager::getShard(SegmentKey key)
+{
+	//Mix the bits of both indices, so that neighbouring segments end up in different shards.
+	SegmentKey hash = key * 0x9E3779B97F4A7C15ULL;
+	return mShards[(hash >> 32) & (ShardCount - 1)];
+}
+
 SegmentRefPtr SegmentManager::getSegmentReference(int xIndex, int yIndex)
 {
-	std::stringstream ss;
-	ss << xIndex << "_" << yIndex;
-	std::string key = ss.str();
-	std::unique_lock < std::mutex > l(mSegmentsMutex);
-	SegmentStore::const_iterator I = mSegments.find(key);
-	if (I != mSegments.end()) {
+	SegmentKey key = createKey(xIndex, yIndex);
+	Shard& shard = getShard(key);
+	std::unique_lock<std::mutex> l(shard.mutex);
+	SegmentStore::const_iterator I = shard.segments.find(key);
+	if (I != shard.segments.end()) {
 		return I->second->getReference();
-	} else if (mEndlessWorldEnabled) {
-		return createFakeSegment(key, xIndex, yIndex);
+	}
+	l.unlock();
+	if (mEndlessWorldEnabled) {
+		return createFakeSegment(xIndex, yIndex);
 	} else {
 		return SegmentRefPtr();
 	}
@@ -71,21 +106,14 @@ SegmentRefPtr SegmentManager::getSegmentReference(int xIndex, int yIndex)
 size_t SegmentManager::getSegmentReferences(const SegmentManager::IndexMap& indices, SegmentRefStore& segments)
 {
 	size_t count = 0;
-	std::unique_lock < std::mutex > l(mSegmentsMutex);
 
 	for (const auto& index : indices) {
 		for (auto entry : index.second) {
 
 			const std::pair<int, int>& worldIndex = entry.second;
-			std::stringstream ss;
-			ss << worldIndex.first << "_" << worldIndex.second;
-			std::string key = ss.str();
-			SegmentStore::const_iterator segI = mSegments.find(key);
-			if (segI != mSegments.end()) {
-				segments[index.first][entry.first] = segI->second->getReference();
-				count++;
-			} else if (mEndlessWorldEnabled) {
-				segments[index.first][entry.first] = createFakeSegment(key, worldIndex.first, worldIndex.second);
+			SegmentRefPtr segment = getSegmentReference(worldIndex.first, worldIndex.second);
+			if (segment) {
+				segments[index.first][entry.first] = std::move(segment);
 				count++;
 			}
 		}
@@ -93,7 +121,7 @@ size_t SegmentManager::getSegmentReferences(const SegmentManager::IndexMap& indi
 	return count;
 }
 
-std::shared_ptr<Segment> SegmentManager::createFakeSegment(const std::string& key, int xIndex, int zIndex)
+std::shared_ptr<Segment> SegmentManager::createFakeSegment(int xIndex, int zIndex)
 {
 
 	std::function<void(Mercator::Segment*)> invalidate = [](Mercator::Segment* s)
@@ -148,11 +176,13 @@ std::shared_ptr<Segment> SegmentManager::createFakeSegment(const std::string& ke
 
 void SegmentManager::addSegment(Mercator::Segment& segment)
 {
-	std::stringstream ss;
-	ss << (segment.getXRef() / segment.getResolution()) << "_" << (segment.getZRef() / segment.getResolution());
-	std::unique_lock < std::mutex > l(mSegmentsMutex);
-	SegmentStore::const_iterator I = mSegments.find(ss.str());
-	if (I == mSegments.end()) {
+	int xIndex = segment.getXRef() / segment.getResolution();
+	int zIndex = segment.getZRef() / segment.getResolution();
+	SegmentKey key = createKey(xIndex, zIndex);
+	Shard& shard = getShard(key);
+	std::unique_lock<std::mutex> l(shard.mutex);
+	SegmentStore::const_iterator I = shard.segments.find(key);
+	if (I == shard.segments.end()) {
 		std::function<void(Mercator::Segment*)> invalidate = [](Mercator::Segment* s)
 		{
 			if (s) {
@@ -160,7 +190,7 @@ void SegmentManager::addSegment(Mercator::Segment& segment)
 			}
 		};
 		std::function<Mercator::Segment*()> segmentProvider = [&]() {return &segment;};
-		mSegments.insert(SegmentStore::value_type(ss.str(), new SegmentHolder(new Segment(segment.getXRef() / segment.getResolution(), segment.getZRef() / segment.getResolution(), segmentProvider, invalidate), *this)));
+		shard.segments.insert(SegmentStore::value_type(key, new SegmentHolder(new Segment(xIndex, zIndex, segmentProvider, invalidate), *this)));
 	}
 }
 
@@ -178,30 +208,218 @@ void SegmentManager::syncWithTerrain()
 	}
 }
 
+size_t SegmentManager::calculateResidentBytes(Mercator::Segment& segment)
+{
+	if (!segment.isValid()) {
+		return 0;
+	}
+	const size_t points = static_cast<size_t>(segment.getSize()) * segment.getSize();
+	size_t bytes = points * sizeof(float);
+	if (segment.getNormals()) {
+		bytes += points * 3 * sizeof(float);
+	}
+	for (auto& entry : segment.getSurfaces()) {
+		Mercator::Surface* surface = entry.second;
+		if (surface && surface->isValid()) {
+			bytes += points * surface->getChannels();
+		}
+	}
+	return bytes;
+}
+
+float SegmentManager::getEvictionScore(const SegmentHolder& holder, std::chrono::steady_clock::time_point now) const
+{
+	float score = std::chrono::duration_cast<std::chrono::duration<float>>(now - holder.mLastUsed).count();
+	if (mFocus.isValid()) {
+		const float resolution = mTerrain.getResolution();
+		const Segment& segment = *holder.mSegment;
+		float x = ((segment.getXIndex() + 0.5f) * resolution) - mFocus.x();
+		float y = ((segment.getYIndex() + 0.5f) * resolution) - mFocus.y();
+		score += (std::sqrt((x * x) + (y * y)) / resolution) * EvictionSecondsPerSegment;
+	}
+	return score;
+}
+
 void SegmentManager::pruneUnusedSegments()
 {
-	std::unique_lock < std::mutex > l(mSegmentsMutex);
+	//This is called each time a segment is returned, so avoid locking all of the shards when there's nothing to prune.
+	if (mResidentBytes <= mMemoryBudget) {
+		return;
+	}
+	{
+		std::unique_lock<std::mutex> l(mUnusedAndDirtySegmentsMutex);
+		if (mUnusedAndDirtySegments.empty()) {
+			return;
+		}
+	}
+	//Lock all shards, in order, so that no references are handed out while we're invalidating segments.
+	std::array<std::unique_lock<std::mutex>, ShardCount> shardLocks;
+	for (size_t i = 0; i < ShardCount; ++i) {
+		shardLocks[i] = std::unique_lock<std::mutex>(mShards[i].mutex);
+	}
 	std::unique_lock < std::mutex > l1(mUnusedAndDirtySegmentsMutex);
-	while (mUnusedAndDirtySegments.size() > mDesiredSegmentBuffer) {
-		SegmentHolder* holder = mUnusedAndDirtySegments.front();
-		mUnusedAndDirtySegments.pop_front();
+
+	//Release a bit more than needed, so that the segments don't have to be gone through again as soon as the next segment is returned.
+	const size_t memoryBudget = mMemoryBudget;
+	const size_t targetBytes = memoryBudget - (memoryBudget / 8);
+	if (mResidentBytes <= targetBytes || mUnusedAndDirtySegments.empty()) {
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	std::vector<std::pair<float, SegmentHolder*>> candidates;
+	candidates.reserve(mUnusedAndDirtySegments.size());
+	for (auto holder : mUnusedAndDirtySegments) {
+		candidates.emplace_back(getEvictionScore(*holder, now), holder);
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, SegmentHolder*>& lhs, const std::pair<float, SegmentHolder*>& rhs) { return lhs.first > rhs.first; });
+
+	for (auto& candidate : candidates) {
+		if (mResidentBytes <= targetBytes) {
+			break;
+		}
+		SegmentHolder* holder = candidate.second;
+		mUnusedAndDirtySegments.erase(holder->mUnusedIterator);
+		holder->mIsMarkedAsUnused = false;
+		//The holder might have been handed out again in between its last reference being returned and it being marked.
+		if (!holder->isUnused()) {
+			continue;
+		}
 		holder->getSegment().invalidate();
+		mResidentBytes -= holder->mResidentBytes;
+		holder->mResidentBytes = 0;
+		holder->mIsPrefetched = false;
+		mEvictionCount++;
 	}
 }
 
-void SegmentManager::markHolderAsDirtyAndUnused(SegmentHolder* holder)
+bool SegmentManager::prefetchSegment(int xIndex, int yIndex)
 {
-	std::unique_lock < std::mutex > l(mUnusedAndDirtySegmentsMutex);
+	SegmentKey key = createKey(xIndex, yIndex);
+	Shard& shard = getShard(key);
+	SegmentHolder* holder;
+	SegmentRefPtr reference;
+	{
+		std::unique_lock<std::mutex> l(shard.mutex);
+		SegmentStore::const_iterator I = shard.segments.find(key);
+		if (I == shard.segments.end()) {
+			return false;
+		}
+		holder = I->second;
+		reference = holder->getReference();
+	}
+
+	Mercator::Segment& segment = reference->getMercatorSegment();
+	if (segment.isValid()) {
+		return false;
+	}
+	if (mSegmentCache) {
+		mSegmentCache->populate(segment);
+	} else {
+		segment.populate();
+	}
+	holder->mIsPrefetched = true;
+	mPrefetchCount++;
+	//The segment is marked as unused, and measured, once the reference is returned.
+	return true;
+}
+
+void SegmentManager::setFocus(const TerrainPosition& position)
+{
+	std::unique_lock<std::mutex> l(mUnusedAndDirtySegmentsMutex);
+	mFocus = position;
+}
 
-	mUnusedAndDirtySegments.push_back(holder);
+void SegmentManager::setMemoryBudget(size_t memoryBudget)
+{
+	mMemoryBudget = memoryBudget;
+	pruneUnusedSegments();
+}
+
+SegmentManager::ResidencyStats SegmentManager::getResidencyStats() const
+{
+	std::unique_lock<std::mutex> l(mUnusedAndDirtySegmentsMutex);
+	return ResidencyStats{mResidentBytes, mMemoryBudget, mUnusedAndDirtySegments.size(), mEvictionCount, mPrefetchCount, mPrefetchHitCount};
+}
+
+void SegmentManager::remeasureSegments(const WFMath::AxisBox<2>& area)
+{
+	if (!area.isValid()) {
+		return;
+	}
+	const float resolution = mTerrain.getResolution();
+	int lowX = static_cast<int>(std::floor(area.lowCorner().x() / resolution));
+	int lowY = static_cast<int>(std::floor(area.lowCorner().y() / resolution));
+	int highX = static_cast<int>(std::ceil(area.highCorner().x() / resolution)) - 1;
+	int highY = static_cast<int>(std::ceil(area.highCorner().y() / resolution)) - 1;
+	for (int x = lowX; x <= highX; ++x) {
+		for (int y = lowY; y <= highY; ++y) {
+			SegmentKey key = createKey(x, y);
+			Shard& shard = getShard(key);
+			std::unique_lock<std::mutex> l(shard.mutex);
+			SegmentStore::const_iterator I = shard.segments.find(key);
+			//Segments in use are measured once they are returned.
+			if (I == shard.segments.end() || !I->second->isUnused()) {
+				continue;
+			}
+			size_t bytes = calculateResidentBytes(I->second->getSegment().getMercatorSegment());
+			std::unique_lock<std::mutex> l1(mUnusedAndDirtySegmentsMutex);
+			setResidentBytes(I->second, bytes);
+		}
+	}
+	pruneUnusedSegments();
+}
+
+void SegmentManager::returnReference(SegmentHolder* holder)
+{
+	Segment& segment = holder->getSegment();
+	Shard& shard = getShard(createKey(segment.getXIndex(), segment.getYIndex()));
+	{
+		std::unique_lock<std::mutex> l(shard.mutex);
+		assert(holder->mRefCount > 0);
+		if (--holder->mRefCount != 0) {
+			return;
+		}
+		//References are only handed out while the shard is locked, so as long as we hold the lock no one else can touch the segment.
+		size_t bytes = calculateResidentBytes(segment.getMercatorSegment());
+
+		std::unique_lock<std::mutex> l1(mUnusedAndDirtySegmentsMutex);
+		holder->mLastUsed = std::chrono::steady_clock::now();
+		//Move the segment to the end of the unused segments.
+		if (holder->mIsMarkedAsUnused) {
+			mUnusedAndDirtySegments.erase(holder->mUnusedIterator);
+			holder->mIsMarkedAsUnused = false;
+		}
+		setResidentBytes(holder, bytes);
+	}
+	pruneUnusedSegments();
+}
+
+void SegmentManager::setResidentBytes(SegmentHolder* holder, size_t bytes)
+{
+	mResidentBytes += bytes;
+	mResidentBytes -= holder->mResidentBytes;
+	holder->mResidentBytes = bytes;
+
+	//Segments without any data have nothing to release.
+	if (bytes == 0 && holder->mIsMarkedAsUnused) {
+		mUnusedAndDirtySegments.erase(holder->mUnusedIterator);
+		holder->mIsMarkedAsUnused = false;
+	} else if (bytes != 0 && !holder->mIsMarkedAsUnused) {
+		holder->mUnusedIterator = mUnusedAndDirtySegments.insert(mUnusedAndDirtySegments.end(), holder);
+		holder->mIsMarkedAsUnused = true;
+	}
 }
 
 void SegmentManager::unmarkHolder(SegmentHolder* holder)
 {
+	if (holder->mIsPrefetched.exchange(false)) {
+		mPrefetchHitCount++;
+	}
 	std::unique_lock < std::mutex > l(mUnusedAndDirtySegmentsMutex);
-	auto I = std::find(mUnusedAndDirtySegments.begin(), mUnusedAndDirtySegments.end(), holder);
-	if (I != mUnusedAndDirtySegments.end()) {
-		mUnusedAndDirtySegments.erase(I);
+	if (holder->mIsMarkedAsUnused) {
+		mUnusedAndDirtySegments.erase(holder->mUnusedIterator);
+		holder->mIsMarkedAsUnused = false;
 	}
 }
 
@@ -235,6 +453,16 @@ float SegmentManager::getDefaultHeightVariation() const
 	return mFakeSegmentHeightVariation;
 }
 
+void SegmentManager::setSegmentCache(SegmentCache* segmentCache)
+{
+	mSegmentCache = segmentCache;
+}
+
+SegmentCache* SegmentManager::getSegmentCache() const
+{
+	return mSegmentCache;
+}
+
 }
 }
 }
@@ -21,6 +21,13 @@
 
 #include "Types.h"
 
+#include <wfmath/point.h>
+#include <wfmath/axisbox.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <unordered_map>
 #include <string>
@@ -40,6 +47,7 @@ namespace OgreView
 namespace Terrain
 {
 class SegmentHolder;
+class SegmentCache;
 
 /**
  * @author Erik Ogenvik <erik@ogenvik.org>
@@ -55,6 +63,13 @@ class SegmentHolder;
  * The Segment instances are references from the manager through instances of SegmentHolder. This is a SegmentManager insternal class who's sole responsibility is to keep a count of how many references there are to the Segment instance. When there are no active references the Segment is eligible for data release.
  * Whenever an external subsystem needs to access a segment it will need to call the getSegmentReference() method to obtain a reference instance. As long as the reference instance is alive the Segment is considered in use and will not be "collected".
  *
+ * Since segment references are requested very often, and from many task executors at once, the segments are stored in a number of separate shards, each with its own mutex.
+ * The segments are keyed by their packed integer indices, so that a lookup never requires any allocation.
+ *
+ * The memory held by the segments is kept within a budget, measured in bytes. Whenever the last reference to a segment is returned the size of its data is
+ * measured, and if all segments together exceed the budget the data of unused segments is released. Segments which haven't been used for a long time,
+ * and segments far away from the focus (normally the avatar) are released first. Segments ahead of the focus can be prefetched, so that they are
+ * already populated once they are needed.
  */
 class SegmentManager
 {
@@ -63,13 +78,49 @@ public:
 	typedef std::unordered_map<int, std::pair<int, int>> IndexColumn;
 	typedef std::unordered_map<int, IndexColumn> IndexMap;
 
+	/**
+	 * @brief Statistics about the memory used by segments.
+	 */
+	struct ResidencyStats
+	{
+		/**
+		 * @brief The number of bytes held by all populated segments.
+		 */
+		size_t residentBytes;
+
+		/**
+		 * @brief The number of bytes segments are allowed to hold.
+		 */
+		size_t memoryBudget;
+
+		/**
+		 * @brief The number of populated segments which currently aren't used, and thus can be released.
+		 */
+		size_t unusedSegments;
+
+		/**
+		 * @brief The number of times the data of a segment has been released to keep within the budget.
+		 */
+		unsigned long evictions;
+
+		/**
+		 * @brief The number of segments which have been populated through prefetchSegment().
+		 */
+		unsigned long prefetches;
+
+		/**
+		 * @brief The number of prefetched segments which later were used.
+		 */
+		unsigned long prefetchHits;
+	};
+
 	/**
 	 * @brief Ctor.
 	 * Note that no Segments will be created until syncWithTerrain() has been called.
 	 * @param terrain The main Mercator terrain instance from which segments will be obtained.
-	 * @param desiredSegmentBuffer The amount of segments we want to keep around, not collected. Often the segments closest to the avatar are most often used and updated, and it's a good idea to keep a number of these around without releasing their data.
+	 * @param memoryBudget The number of bytes the segments are allowed to hold. Unused segments are kept around until this is exceeded.
 	 */
-	SegmentManager(Mercator::Terrain& terrain, unsigned int desiredSegmentBuffer);
+	SegmentManager(Mercator::Terrain& terrain, size_t memoryBudget);
 
 	/**
 	 * @brief Dtor.
@@ -105,12 +156,58 @@ public:
 	void syncWithTerrain();
 
 	/**
-	 * @brief Releases memory of unused segments.
+	 * @brief Releases memory of unused segments, if the budget is exceeded.
 	 * A call to this is thread safe, but will be blocking for getSegmentReference.
 	 */
 	void pruneUnusedSegments();
 
-	void markHolderAsDirtyAndUnused(SegmentHolder* holder);
+	/**
+	 * @brief Populates a segment ahead of it being needed.
+	 *
+	 * This must be called from a task which has exclusive access to the page of the segment.
+	 * @param xIndex The x index.
+	 * @param yIndex The y index.
+	 * @return True if the segment was populated; false if it already was populated or doesn't exist.
+	 */
+	bool prefetchSegment(int xIndex, int yIndex);
+
+	/**
+	 * @brief Sets the position around which segments are most likely to be used.
+	 * Segments far away from the focus are released before those close to it.
+	 * @param position The position in world space.
+	 */
+	void setFocus(const TerrainPosition& position);
+
+	/**
+	 * @brief Sets the number of bytes the segments are allowed to hold.
+	 * @param memoryBudget The budget, in bytes.
+	 */
+	void setMemoryBudget(size_t memoryBudget);
+
+	/**
+	 * @brief Gets statistics about the memory used by segments.
+	 * @return Statistics.
+	 */
+	ResidencyStats getResidencyStats() const;
+
+	/**
+	 * @brief Measures the data held by the unused segments within an area again.
+	 *
+	 * Call this after the Mercator terrain has invalidated or populated segments directly, for example after base points, mods or areas
+	 * have changed, so that the bytes held by segments don't drift from what's actually held. Segments which currently are in use are
+	 * measured once their last reference is returned.
+	 *
+	 * This must be called from a task which has exclusive access to the terrain.
+	 * @param area The area, in world space.
+	 */
+	void remeasureSegments(const WFMath::AxisBox<2>& area);
+
+	/**
+	 * @brief Called when a reference to a segment is destroyed.
+	 * If it was the last reference the data held by the segment is measured, and the segment is marked as unused.
+	 * @param holder The holder of the segment.
+	 */
+	void returnReference(SegmentHolder* holder);
 
 	void unmarkHolder(SegmentHolder* holder);
 
@@ -164,20 +261,66 @@ public:
 	 */
 	float getDefaultHeightVariation() const;
 
+	/**
+	 * @brief Sets the cache through which segments are populated.
+	 * @param segmentCache The cache, or null if populated segments shouldn't be cached. Ownership isn't transferred.
+	 */
+	void setSegmentCache(SegmentCache* segmentCache);
+
+	/**
+	 * @brief Gets the cache through which segments are populated.
+	 * @return The cache, or null if populated segments aren't cached.
+	 */
+	SegmentCache* getSegmentCache() const;
+
 protected:
 
-	typedef std::unordered_map<std::string, SegmentHolder* > SegmentStore;
+	/**
+	 * @brief The key used for looking up segments, containing both the x and the y index.
+	 */
+	typedef std::uint64_t SegmentKey;
+	typedef std::unordered_map<SegmentKey, SegmentHolder*> SegmentStore;
 	typedef std::list<SegmentHolder*> SegmentList;
 
+	/**
+	 * @brief The number of shards the segments are spread over. Must be a power of two.
+	 */
+	static const size_t ShardCount = 16;
+
+	/**
+	 * @brief A subset of all segments, guarded by its own mutex.
+	 */
+	struct Shard
+	{
+		/**
+		 * @brief A store of Segment instances.
+		 */
+		SegmentStore segments;
+
+		/**
+		 * @brief A mutex for accessing the segments.
+		 */
+		std::mutex mutex;
+	};
+
 	/**
 	 * @brief The main Mercator terrain instance.
 	 */
 	Mercator::Terrain& mTerrain;
 
 	/**
-	 * @brief The number of desired segments to keep around as a buffer.
+	 * @brief The number of bytes the segments are allowed to hold.
 	 */
-	unsigned int mDesiredSegmentBuffer;
+	std::atomic<size_t> mMemoryBudget;
+
+	/**
+	 * @brief The number of bytes held by all segments, as measured when they last were returned.
+	 */
+	std::atomic<size_t> mResidentBytes;
+
+	std::atomic<unsigned long> mEvictionCount;
+	std::atomic<unsigned long> mPrefetchCount;
+	std::atomic<unsigned long> mPrefetchHitCount;
 
 	/**
 	 * @brief The height of "fake" segments.
@@ -203,24 +346,69 @@ protected:
 	bool mEndlessWorldEnabled;
 
 	/**
-	 * @brief A store of Segment instances.
+	 * @brief The cache through which segments are populated, if any.
 	 */
-	SegmentStore mSegments;
+	SegmentCache* mSegmentCache;
 
 	/**
-	 * @brief A mutex for accessing mSegments.
+	 * @brief The shards in which all Segment instances are stored.
 	 */
-	std::mutex mSegmentsMutex;
+	std::array<Shard, ShardCount> mShards;
 
 	/**
-	 * @brief Keeps track of all
+	 * @brief Keeps track of all populated segments which aren't used, in the order they were returned.
 	 */
 	SegmentList mUnusedAndDirtySegments;
 
 	/**
-	 * @brief A mutex for accessing mUnusedAndDirtySegments.
+	 * @brief A mutex for accessing mUnusedAndDirtySegments, mFocus and the residency fields of the holders.
+	 */
+	mutable std::mutex mUnusedAndDirtySegmentsMutex;
+
+	/**
+	 * @brief The position around which segments are most likely to be used, in world space.
+	 * Invalid if no focus has been set.
+	 */
+	TerrainPosition mFocus;
+
+	/**
+	 * @brief Packs the indices of a segment into a lookup key.
+	 * @param xIndex The x index.
+	 * @param yIndex The y index.
+	 * @return A key.
+	 */
+	static SegmentKey createKey(int xIndex, int yIndex);
+
+	/**
+	 * @brief Gets the shard in which a segment with the specified key is stored.
+	 * @param key The key of the segment.
+	 * @return A shard.
+	 */
+	Shard& getShard(SegmentKey key);
+
+	/**
+	 * @brief Calculates the number of bytes of data held by a segment.
+	 * @param segment The segment, which mustn't be in use by anyone else.
+	 * @return A number of bytes.
+	 */
+	static size_t calculateResidentBytes(Mercator::Segment& segment);
+
+	/**
+	 * @brief Calculates how suitable an unused segment is for being released; a higher score means more suitable.
+	 * The score is the number of seconds since the segment was used, increased by the distance to the focus.
+	 * @param holder The holder of the segment.
+	 * @param now The current time.
+	 * @return A score.
+	 */
+	float getEvictionScore(const SegmentHolder& holder, std::chrono::steady_clock::time_point now) const;
+
+	/**
+	 * @brief Sets the number of bytes held by a segment, adding it to or removing it from the unused segments depending on if it holds any data.
+	 * The lock of the shard of the segment and mUnusedAndDirtySegmentsMutex must be held, and the segment must be unused.
+	 * @param holder The holder of the segment.
+	 * @param bytes The number of bytes held by the segment.
 	 */
-	std::mutex mUnusedAndDirtySegmentsMutex;
+	void setResidentBytes(SegmentHolder* holder, size_t bytes);
 
 	/**
 	 * @brief Adds a new Mercator segment and creates a corresponding Segment instance for it.
@@ -233,12 +421,11 @@ protected:
 	 *
 	 * A "fake" segment is one that only exists on the client. This is used to make the undefined terrain
 	 * appear infinite.
-	 * @param key The lookup key for the segment.
 	 * @param x The x index of the segment.
 	 * @param zIndex The y index of the segment.
 	 * @return A new segment holder instance which refers to the fake segment.
 	 */
-	SegmentRefPtr createFakeSegment(const std::string& key, int x, int zIndex);
+	SegmentRefPtr createFakeSegment(int x, int zIndex);
 
 
 };
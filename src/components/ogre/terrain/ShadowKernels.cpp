@@ -0,0 +1,199 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ShadowKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+namespace ShadowKernels
+{
+
+namespace
+{
+
+/**
+ * @brief The share of the light which isn't affected by shadows.
+ */
+const float AmbientShare = 0.4f;
+
+/**
+ * @brief The share of the light which is removed by shadows.
+ */
+const float DirectShare = 0.6f;
+
+/**
+ * @brief The inverse of the width, as a tangent, of the soft edge of the shadows.
+ */
+const float InversePenumbra = 10.0f;
+
+/**
+ * @brief A point along the search direction of the horizon.
+ */
+struct HorizonSample
+{
+	/**
+	 * @brief The offset of the point, in heights.
+	 */
+	ptrdiff_t offset;
+
+	/**
+	 * @brief The inverse of the horizontal distance to the point.
+	 */
+	float inverseDistance;
+};
+
+/**
+ * @brief Creates the points at which the horizon is sampled.
+ * The points are spaced further apart the further away they are, since distant points must be much higher to cast a shadow.
+ * Every point is rounded to a whole point in the grid, so that neighbouring points read neighbouring heights.
+ */
+std::vector<HorizonSample> createHorizonSamples(size_t stride, float directionX, float directionY)
+{
+	std::vector<HorizonSample> samples;
+	ptrdiff_t lastOffset = 0;
+	for (float distance = 1.0f; distance <= HorizonDistance; distance = std::max(distance + 1.0f, distance * 1.25f)) {
+		auto x = static_cast<ptrdiff_t>(std::lround(directionX * distance));
+		auto y = static_cast<ptrdiff_t>(std::lround(directionY * distance));
+		ptrdiff_t offset = (y * static_cast<ptrdiff_t>(stride)) + x;
+		if (offset != 0 && offset != lastOffset) {
+			samples.push_back(HorizonSample{offset, 1.0f / std::sqrt(static_cast<float>((x * x) + (y * y)))});
+			lastOffset = offset;
+		}
+	}
+	return samples;
+}
+
+inline float shadePoint(const float* point, size_t stride, float visibility, const float sunDirection[3])
+{
+	float dx = (point[1] - point[-1]) * 0.5f;
+	float dy = (point[stride] - point[-static_cast<ptrdiff_t>(stride)]) * 0.5f;
+	float dot = ((sunDirection[2] - (dx * sunDirection[0])) - (dy * sunDirection[1])) / std::sqrt(((dx * dx) + (dy * dy)) + 1.0f);
+	float light = ((dot * 0.5f) + 0.5f) * (AmbientShare + (DirectShare * visibility)) * 255.0f;
+	return std::min(std::max(light, 0.0f), 255.0f);
+}
+
+inline float calculateVisibility(float sunTangent, float horizon)
+{
+	return std::min(std::max(((sunTangent - horizon) * InversePenumbra) + 0.5f, 0.0f), 1.0f);
+}
+
+}
+
+void calculateHorizon(const float* heights, size_t stride, unsigned int width, unsigned int height, float directionX, float directionY, float* horizon)
+{
+	auto samples = createHorizonSamples(stride, directionX, directionY);
+
+	for (unsigned int y = 0; y < height; ++y) {
+		const float* row = heights + (y * stride);
+		float* horizonRow = horizon + (y * width);
+		unsigned int x = 0;
+#ifdef __SSE2__
+		for (; x + 4 <= width; x += 4) {
+			__m128 base = _mm_loadu_ps(row + x);
+			__m128 maxSlope = _mm_set1_ps(-std::numeric_limits<float>::max());
+			for (auto& sample : samples) {
+				__m128 heightDifference = _mm_sub_ps(_mm_loadu_ps(row + x + sample.offset), base);
+				maxSlope = _mm_max_ps(maxSlope, _mm_mul_ps(heightDifference, _mm_set1_ps(sample.inverseDistance)));
+			}
+			_mm_storeu_ps(horizonRow + x, maxSlope);
+		}
+#endif
+		for (; x < width; ++x) {
+			float base = row[x];
+			float maxSlope = -std::numeric_limits<float>::max();
+			for (auto& sample : samples) {
+				maxSlope = std::max(maxSlope, (row[x + sample.offset] - base) * sample.inverseDistance);
+			}
+			horizonRow[x] = maxSlope;
+		}
+	}
+}
+
+void shade(const float* heights, size_t stride, unsigned int width, unsigned int height, const float* horizon, const float sunDirection[3], unsigned char* destination, size_t destinationStride)
+{
+	//When the sun is down everything is in shadow, and when it's right above nothing is.
+	const bool isSunDown = sunDirection[2] <= 0.0f;
+	const bool useHorizon = horizon && !isSunDown;
+	const float constantVisibility = isSunDown ? 0.0f : 1.0f;
+	const float horizontalLength = std::sqrt((sunDirection[0] * sunDirection[0]) + (sunDirection[1] * sunDirection[1]));
+	const float sunTangent = horizontalLength > 0.0f ? sunDirection[2] / horizontalLength : std::numeric_limits<float>::max();
+
+	for (unsigned int y = 0; y < height; ++y) {
+		const float* row = heights + (y * stride);
+		const float* horizonRow = useHorizon ? horizon + (y * width) : nullptr;
+		unsigned char* destinationRow = destination + (y * destinationStride);
+		unsigned int x = 0;
+#ifdef __SSE2__
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 sunX = _mm_set1_ps(sunDirection[0]);
+		const __m128 sunY = _mm_set1_ps(sunDirection[1]);
+		const __m128 sunZ = _mm_set1_ps(sunDirection[2]);
+		for (; x + 4 <= width; x += 4) {
+			const float* point = row + x;
+			__m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(point + 1), _mm_loadu_ps(point - 1)), half);
+			__m128 dy = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(point + stride), _mm_loadu_ps(point - stride)), half);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), one));
+			__m128 dot = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(sunZ, _mm_mul_ps(dx, sunX)), _mm_mul_ps(dy, sunY)), length);
+
+			__m128 pointVisibility;
+			if (useHorizon) {
+				__m128 difference = _mm_sub_ps(_mm_set1_ps(sunTangent), _mm_loadu_ps(horizonRow + x));
+				pointVisibility = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(difference, _mm_set1_ps(InversePenumbra)), half), zero), one);
+			} else {
+				pointVisibility = _mm_set1_ps(constantVisibility);
+			}
+			__m128 shadowFactor = _mm_add_ps(_mm_set1_ps(AmbientShare), _mm_mul_ps(_mm_set1_ps(DirectShare), pointVisibility));
+			__m128 light = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(dot, half), half), shadowFactor), _mm_set1_ps(255.0f));
+			light = _mm_min_ps(_mm_max_ps(light, zero), _mm_set1_ps(255.0f));
+
+			__m128i values = _mm_cvttps_epi32(light);
+			values = _mm_packs_epi32(values, values);
+			values = _mm_packus_epi16(values, values);
+			int packed = _mm_cvtsi128_si32(values);
+			std::copy(reinterpret_cast<const unsigned char*>(&packed), reinterpret_cast<const unsigned char*>(&packed) + 4, destinationRow + x);
+		}
+#endif
+		for (; x < width; ++x) {
+			float pointVisibility = useHorizon ? calculateVisibility(sunTangent, horizonRow[x]) : constantVisibility;
+			destinationRow[x] = static_cast<unsigned char>(shadePoint(row + x, stride, pointVisibility, sunDirection));
+		}
+	}
+}
+
+}
+
+}
+}
+}
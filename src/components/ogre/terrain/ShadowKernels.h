@@ -0,0 +1,85 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SHADOWKERNELS_H_
+#define SHADOWKERNELS_H_
+
+#include <cstddef>
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+/**
+ * @brief Functions for calculating precomputed terrain lighting from a height grid.
+ *
+ * The lighting is split in two passes. The first finds the horizon of each point in the direction of the sun, expressed as the
+ * steepest slope from the point to any other point in that direction. This is the expensive part, but it only depends on the azimuth
+ * of the sun and can thus be reused while the sun rises or sets. The second pass combines the horizon with the elevation of the sun
+ * and the normal of each point into a light value.
+ *
+ * All coordinates are in grid space, where x increases along a row and y increases with each row. Heights are read around the
+ * processed area, so the grid must be padded by at least HorizonDistance points on each side.
+ *
+ * When compiled with SSE2 support four points are processed at once, else a scalar fallback is used. Both give the exact same result.
+ */
+namespace ShadowKernels
+{
+
+/**
+ * @brief The distance, in points, up to which the horizon is searched.
+ */
+static const int HorizonDistance = 64;
+
+/**
+ * @brief Calculates the horizon of each point in an area, in one direction.
+ * @param heights The height of the first point of the area.
+ * @param stride The number of heights between the start of each row.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ * @param directionX The x component of the normalized direction in which to search.
+ * @param directionY The y component of the normalized direction in which to search.
+ * @param horizon Receives the tangent of the horizon of each point, width * height values.
+ */
+void calculateHorizon(const float* heights, size_t stride, unsigned int width, unsigned int height, float directionX, float directionY, float* horizon);
+
+/**
+ * @brief Calculates the light of each point in an area.
+ * The light is a half lambert term, darkened where the sun is below the horizon of the point.
+ * @param heights The height of the first point of the area.
+ * @param stride The number of heights between the start of each row.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ * @param horizon The horizon of each point, as calculated by calculateHorizon() in the direction of the sun. Null if the sun is right above.
+ * @param sunDirection The normalized direction towards the sun.
+ * @param destination Receives the light of each point, from 0 to 255.
+ * @param destinationStride The number of bytes between the start of each row in the destination.
+ */
+void shade(const float* heights, size_t stride, unsigned int width, unsigned int height, const float* horizon, const float sunDirection[3], unsigned char* destination, size_t destinationStride);
+
+}
+
+}
+}
+}
+
+#endif /* SHADOWKERNELS_H_ */
@@ -22,10 +22,16 @@
 #include "TerrainPageShadow.h"
 #include "TerrainPageGeometry.h"
 
+#include "framework/tasks/TaskExecutionContext.h"
+#include "framework/tasks/TaskGraph.h"
+#include "framework/LoggingInstance.h"
+
 #include <OgreTextureManager.h>
 #include <OgreRoot.h>
 #include <OgreHardwarePixelBuffer.h>
 
+#include <chrono>
+
 namespace Ember
 {
 namespace OgreView
@@ -34,6 +40,49 @@ namespace OgreView
 namespace Terrain
 {
 
+namespace
+{
+void updateShadow(TerrainPageGeometry& pageGeometry, const WFMath::Vector<3>& lightDirection)
+{
+	auto& page = pageGeometry.getPage();
+	if (page.getSurface()) {
+		auto shadow = page.getSurface()->getShadow();
+		if (shadow) {
+			auto& shadowTextureName = shadow->getShadowTextureName();
+			if (!shadowTextureName.empty()) {
+				shadow->setLightDirection(lightDirection);
+				//The shadow keeps the heights of the page, so the segments only need to be populated the first time.
+				if (!shadow->updateLighting()) {
+					pageGeometry.repopulate();
+					shadow->updateShadow(pageGeometry);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Updates the shadow of a single page.
+ */
+class PageShadowUpdateTask : public Tasks::TemplateNamedTask<PageShadowUpdateTask>
+{
+public:
+	PageShadowUpdateTask(TerrainPageGeometryPtr pageGeometry, const WFMath::Vector<3>& lightDirection) :
+			mPageGeometry(std::move(pageGeometry)), mLightDirection(lightDirection)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		updateShadow(*mPageGeometry, mLightDirection);
+	}
+
+private:
+	TerrainPageGeometryPtr mPageGeometry;
+	const WFMath::Vector<3> mLightDirection;
+};
+}
+
 ShadowUpdateTask::ShadowUpdateTask(const GeometryPtrVector& pageGeometries, const WFMath::Vector<3>& lightDirection) :
 		mPageGeometries(pageGeometries), mLightDirection(lightDirection)
 {
@@ -46,19 +95,22 @@ ShadowUpdateTask::~ShadowUpdateTask()
 
 void ShadowUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context)
 {
-	for (auto& pageGeometry : mPageGeometries) {
-		auto& page = pageGeometry->getPage();
-		if (page.getSurface()) {
-			auto shadow = page.getSurface()->getShadow();
-			if (shadow) {
-				auto& shadowTextureName = shadow->getShadowTextureName();
-				if (!shadowTextureName.empty()) {
-					pageGeometry->repopulate(true);
-					shadow->setLightDirection(mLightDirection);
-					shadow->updateShadow(*pageGeometry.get());
-				}
-			}
+	auto start = std::chrono::steady_clock::now();
+	//The shadow of each page is only calculated from the geometry of the page, so the pages can be spread out over all executors.
+	if (mPageGeometries.size() > 1) {
+		Tasks::TaskGraph graph;
+		for (auto& pageGeometry : mPageGeometries) {
+			graph.addTask(new PageShadowUpdateTask(pageGeometry, mLightDirection));
 		}
+		context.executeTaskGraph(graph);
+	} else {
+		for (auto& pageGeometry : mPageGeometries) {
+			updateShadow(*pageGeometry, mLightDirection);
+		}
+	}
+	if (!mPageGeometries.empty()) {
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+		S_LOG_VERBOSE("Updated precomputed shadows for " << mPageGeometries.size() << " pages in " << elapsed << " ms (" << elapsed / mPageGeometries.size() << " ms per page).");
 	}
 }
 
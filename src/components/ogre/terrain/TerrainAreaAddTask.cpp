@@ -19,6 +19,7 @@
 #include "TerrainAreaAddTask.h"
 #include "TerrainHandler.h"
 #include "TerrainLayerDefinitionManager.h"
+#include "SegmentManager.h"
 
 #include "Mercator/Area.h"
 #include "Mercator/Terrain.h"
@@ -32,7 +33,7 @@ namespace Terrain
 {
 
 TerrainAreaAddTask::TerrainAreaAddTask(Mercator::Terrain& terrain, Mercator::Area* area, ShaderUpdateSlotType markForUpdateSlot, TerrainHandler& terrainHandler, TerrainLayerDefinitionManager& terrainLayerDefinitionManager, AreaShaderstore& areaShaders) :
-	TerrainAreaTaskBase(terrain, area, markForUpdateSlot), mTerrainHandler(terrainHandler), mTerrainLayerDefinitionManager(terrainLayerDefinitionManager), mAreaShaders(areaShaders)
+	TerrainAreaTaskBase(terrain, area, markForUpdateSlot, terrainHandler.getSegmentManager()), mTerrainHandler(terrainHandler), mTerrainLayerDefinitionManager(terrainLayerDefinitionManager), mAreaShaders(areaShaders)
 {
 }
 
@@ -46,6 +47,7 @@ void TerrainAreaAddTask::executeTaskInBackgroundThread(Tasks::TaskExecutionConte
 	mTerrain.addArea(mArea);
 	//We can only access the bbox in the background thread, so lets pass on a copy of the bbox to the main thread.
 	mNewBbox = mArea->bbox();
+	mSegmentManager.remeasureSegments(mNewBbox);
 }
 
 bool TerrainAreaAddTask::executeTaskInMainThread()
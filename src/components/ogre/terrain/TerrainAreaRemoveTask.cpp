@@ -17,6 +17,7 @@
  */
 
 #include "TerrainAreaRemoveTask.h"
+#include "SegmentManager.h"
 #include <Mercator/Terrain.h>
 #include <Mercator/Area.h>
 
@@ -28,8 +29,8 @@ namespace OgreView
 namespace Terrain
 {
 
-TerrainAreaRemoveTask::TerrainAreaRemoveTask(Mercator::Terrain& terrain, Mercator::Area* area, ShaderUpdateSlotType markForUpdateSlot, const TerrainShader* shader) :
-	TerrainAreaTaskBase(terrain, area, markForUpdateSlot), mShader(shader)
+TerrainAreaRemoveTask::TerrainAreaRemoveTask(Mercator::Terrain& terrain, Mercator::Area* area, ShaderUpdateSlotType markForUpdateSlot, const TerrainShader* shader, SegmentManager& segmentManager) :
+	TerrainAreaTaskBase(terrain, area, markForUpdateSlot, segmentManager), mShader(shader)
 {
 
 }
@@ -41,6 +42,7 @@ TerrainAreaRemoveTask::~TerrainAreaRemoveTask()
 void TerrainAreaRemoveTask::executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context)
 {
 	mTerrain.removeArea(mArea);
+	mSegmentManager.remeasureSegments(mArea->bbox());
 }
 
 bool TerrainAreaRemoveTask::executeTaskInMainThread()
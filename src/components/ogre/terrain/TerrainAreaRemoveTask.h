@@ -39,7 +39,7 @@ class TerrainShader;
 class TerrainAreaRemoveTask : public TerrainAreaTaskBase
 {
 public:
-	TerrainAreaRemoveTask(Mercator::Terrain& terrain, Mercator::Area* area, ShaderUpdateSlotType markForUpdateSlot, const TerrainShader* shader);
+	TerrainAreaRemoveTask(Mercator::Terrain& terrain, Mercator::Area* area, ShaderUpdateSlotType markForUpdateSlot, const TerrainShader* shader, SegmentManager& segmentManager);
 	virtual ~TerrainAreaRemoveTask();
 
 	virtual void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context);
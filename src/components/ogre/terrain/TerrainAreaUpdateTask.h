@@ -50,7 +50,7 @@ public:
 	 * @param markForUpdateSlot A slot which will be called in the main thread when the update is complete.
 	 * @param oldShape The old shape, before the update.
 	 */
-	TerrainAreaUpdateTask(Mercator::Terrain& terrain, Mercator::Area* area, const Mercator::Area& newArea, ShaderUpdateSlotType markForUpdateSlot, const TerrainShader* shader);
+	TerrainAreaUpdateTask(Mercator::Terrain& terrain, Mercator::Area* area, const Mercator::Area& newArea, ShaderUpdateSlotType markForUpdateSlot, const TerrainShader* shader, SegmentManager& segmentManager);
 	virtual ~TerrainAreaUpdateTask();
 
 	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override;
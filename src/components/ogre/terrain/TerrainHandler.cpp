@@ -51,6 +51,8 @@
 #include "HeightMapBufferProvider.h"
 #include "PlantAreaQuery.h"
 #include "SegmentManager.h"
+#include "SegmentCache.h"
+#include "TerrainTaskScheduler.h"
 
 #include "../Convert.h"
 #include "../ILightning.h"
@@ -59,6 +61,9 @@
 #include "framework/tasks/SerialTask.h"
 #include "framework/tasks/TaskExecutionContext.h"
 #include "framework/MainLoopController.h"
+#include "framework/TimeFrame.h"
+
+#include "domain/EmberEntity.h"
 
 #include <Eris/EventService.h>
 
@@ -67,6 +72,10 @@
 
 #include <sigc++/bind.h>
 
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
 #include <utility>
 
 namespace Ember
@@ -78,6 +87,39 @@ namespace OgreView
 namespace Terrain
 {
 
+namespace
+{
+/**
+ * @brief The number of bytes terrain segments are allowed to hold, unless configured otherwise.
+ */
+const size_t DefaultSegmentMemoryBudget = 128 * 1024 * 1024;
+
+/**
+ * @brief How far ahead, in seconds of movement, segments are prefetched.
+ */
+const float PrefetchTime = 20.0f;
+
+/**
+ * @brief The speed, in meters per second, below which nothing is prefetched.
+ */
+const float MinimumPrefetchSpeed = 0.5f;
+
+std::vector<TerrainIndex> getPageIndices(const PageVector& pages)
+{
+	std::vector<TerrainIndex> indices;
+	indices.reserve(pages.size());
+	for (auto page : pages) {
+		indices.push_back(page->getWFIndex());
+	}
+	return indices;
+}
+
+int floorDivide(int value, int divisor)
+{
+	return (value >= 0) ? (value / divisor) : -((-value + divisor - 1) / divisor);
+}
+}
+
 class BasePointRetrieveTask: public Tasks::TemplateNamedTask<BasePointRetrieveTask>
 {
 
@@ -105,6 +147,29 @@ public:
 
 };
 
+/**
+ * @brief Populates segments ahead of them being needed.
+ */
+class SegmentPrefetchTask: public Tasks::TemplateNamedTask<SegmentPrefetchTask>
+{
+public:
+	SegmentPrefetchTask(SegmentManager& segmentManager, std::vector<std::pair<int, int>> segments) :
+			mSegmentManager(segmentManager), mSegments(std::move(segments))
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		for (auto& index : mSegments) {
+			mSegmentManager.prefetchSegment(index.first, index.second);
+		}
+	}
+
+private:
+	SegmentManager& mSegmentManager;
+	const std::vector<std::pair<int, int>> mSegments;
+};
+
 class TerrainPageReloadTask: public Tasks::TemplateNamedTask<TerrainPageReloadTask>
 {
 private:
@@ -156,7 +221,8 @@ public:
 
 TerrainHandler::TerrainHandler(unsigned int pageIndexSize,
 							   ICompilerTechniqueProvider& compilerTechniqueProvider,
-							   Eris::EventService& eventService) :
+							   Eris::EventService& eventService,
+							   unsigned int numberOfWorkers) :
 		mPageIndexSize(pageIndexSize),
 		mCompilerTechniqueProvider(compilerTechniqueProvider),
 		mTerrainInfo(new TerrainInfo(pageIndexSize)),
@@ -164,13 +230,15 @@ TerrainHandler::TerrainHandler(unsigned int pageIndexSize,
 		mTerrain(new Mercator::Terrain(Mercator::Terrain::SHADED)),
 		mHeightMax(std::numeric_limits<Ogre::Real>::min()), mHeightMin(std::numeric_limits<Ogre::Real>::max()),
 		mHasTerrainInfo(false),
-		mTaskQueue(new Tasks::TaskQueue(1, eventService)),
+		mTaskQueue(new Tasks::TaskQueue(std::max(1u, numberOfWorkers), eventService, false)),
+		mTaskScheduler(new TerrainTaskScheduler(*mTaskQueue)),
 		mLightning(nullptr),
 		mHeightMap(new HeightMap(Mercator::Terrain::defaultLevel, mTerrain->getResolution())),
 		//The mercator buffers are one size larger than the resolution
 		mHeightMapBufferProvider(new HeightMapBufferProvider(mTerrain->getResolution() + 1)),
-		mSegmentManager(new SegmentManager(*mTerrain, 64)),
-		mTerrainEntity(nullptr)
+		mSegmentManager(new SegmentManager(*mTerrain, DefaultSegmentMemoryBudget)),
+		mTerrainEntity(nullptr),
+		mFocusEntity(nullptr)
 {
 	mSegmentManager->setEndlessWorldEnabled(true);
 	mSegmentManager->setDefaultHeight(getDefaultHeight());
@@ -178,6 +246,7 @@ TerrainHandler::TerrainHandler(unsigned int pageIndexSize,
 	mSegmentManager->setDefaultHeightVariation(10);
 
 	MainLoopController::getSingleton().EventFrameProcessed.connect(sigc::mem_fun(*this, &TerrainHandler::frameProcessed));
+	MainLoopController::getSingleton().EventProcessMainThreadTasks.connect(sigc::mem_fun(*this, &TerrainHandler::processMainThreadTasks));
 
 	EventTerrainEnabled.connect(sigc::mem_fun(*this, &TerrainHandler::terrainEnabled));
 	EventTerrainDisabled.connect(sigc::mem_fun(*this, &TerrainHandler::terrainDisabled));
@@ -186,8 +255,15 @@ TerrainHandler::TerrainHandler(unsigned int pageIndexSize,
 
 TerrainHandler::~TerrainHandler()
 {
+	if (mTaskQueue->isActive()) {
+		processAllTasks();
+	}
+	for (auto& entry : mPendingPlantQueries) {
+		delete entry.second;
+	}
 	//Deleting the task queue will purge it, making sure that all jobs are processed first.
 	delete mTaskQueue;
+	mTaskScheduler.reset();
 
 	for (auto& page : mPages) {
 		delete page;
@@ -201,18 +277,38 @@ TerrainHandler::~TerrainHandler()
 
 	delete mSegmentManager;
 
+	if (mSegmentCache) {
+		S_LOG_INFO("Terrain segment cache: " << mSegmentCache->getHitCount() << " hits, " << mSegmentCache->getMissCount() << " misses.");
+	}
+
 	delete mTerrain;
 }
 
 void TerrainHandler::shutdown()
 {
+	//Plant queries are only of use while the foliage is shown, so there's no point in running any which haven't been dispatched yet.
+	for (auto& entry : mPendingPlantQueries) {
+		delete entry.second;
+	}
+	mPendingPlantQueries.clear();
+	//Tasks still waiting in the scheduler would be discarded when the queue is deactivated, so let them run first.
+	processAllTasks();
 	mTaskQueue->deactivate();
 }
 
+void TerrainHandler::processAllTasks()
+{
+	while (mTaskQueue->isActive() && mTaskScheduler->getUncompletedTaskCount() != 0) {
+		if (mTaskQueue->pollProcessedTasks(TimeFrame(boost::posix_time::milliseconds(100))) == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
 void TerrainHandler::setPageSize(unsigned int pageSize)
 {
 	// Wait for all current tasks to finish
-//	mTaskQueue->pollProcessedTasks(TimeFrame(boost::posix_time::seconds(60)));
+	processAllTasks();
 	// Delete all page-related data
 	mPageBridges.clear();
 	for (auto& page : mPages) {
@@ -227,7 +323,8 @@ void TerrainHandler::setPageSize(unsigned int pageSize)
 
 void TerrainHandler::getBasePoints(sigc::slot<void, Mercator::Terrain::Pointstore&>& asyncCallback)
 {
-	mTaskQueue->enqueueTask(new BasePointRetrieveTask(*mTerrain, asyncCallback));
+	//Only reads from the terrain, so it just needs to wait for any tasks altering it.
+	mTaskScheduler->enqueuePageTask(new BasePointRetrieveTask(*mTerrain, asyncCallback), {});
 }
 
 TerrainShader* TerrainHandler::createShader(const TerrainLayerDefinition* layerDef, Mercator::Shader* mercatorShader)
@@ -279,6 +376,7 @@ void TerrainHandler::addPage(TerrainPage* page)
 void TerrainHandler::destroyPage(TerrainPage* page)
 {
 	const TerrainPosition& pos = page->getWFPosition();
+	TerrainIndex index = page->getWFIndex();
 	auto pageIter = std::find(mPages.begin(), mPages.end(), page);
 	if (pageIter != mPages.end()) {
 		mPages.erase(pageIter);
@@ -288,10 +386,8 @@ void TerrainHandler::destroyPage(TerrainPage* page)
 	if (!mTaskQueue->isActive()) {
 		delete page;
 	} else {
-		if (!mTaskQueue->enqueueTask(new TerrainPageDeletionTask(page))) {
-			//If the task queue is inactive there's no risk of deleting it.
-			delete page;
-		}
+		//If the task can't be enqueued the page is deleted along with it.
+		mTaskScheduler->enqueuePageTask(new TerrainPageDeletionTask(page), {index});
 	}
 }
 
@@ -328,15 +424,28 @@ void TerrainHandler::getPlantsForArea(Foliage::PlantPopulator& populator, PlantA
 
 	auto xIndex = static_cast<int>(std::floor(wfPos.x() / mTerrain->getResolution()));
 	auto yIndex = static_cast<int>(std::floor(wfPos.y() / mTerrain->getResolution()));
-	SegmentRefPtr segmentRef = mSegmentManager->getSegmentReference(xIndex, yIndex);
-	if (segmentRef) {
+	auto key = std::make_tuple(index, &populator, xIndex, yIndex);
+	auto I = mPendingPlantQueries.find(key);
+	if (I == mPendingPlantQueries.end()) {
+		SegmentRefPtr segmentRef = mSegmentManager->getSegmentReference(xIndex, yIndex);
+		if (!segmentRef) {
+			return;
+		}
 		Ogre::ColourValue defaultShadowColour;
 		if (mLightning) {
 			defaultShadowColour = mLightning->getAmbientLightColour();
 		}
-		mTaskQueue->enqueueTask(new PlantQueryTask(segmentRef, populator, query, defaultShadowColour, std::move(asyncCallback)));
+		I = mPendingPlantQueries.emplace(key, new PlantQueryTask(segmentRef, populator, *mHeightMap, defaultShadowColour)).first;
+	}
+	I->second->addQuery(query, std::move(asyncCallback));
+}
 
+void TerrainHandler::dispatchPlantQueries()
+{
+	for (auto& entry : mPendingPlantQueries) {
+		mTaskScheduler->enqueuePageTask(entry.second, {std::get<0>(entry.first)});
 	}
+	mPendingPlantQueries.clear();
 }
 
 ICompilerTechniqueProvider& TerrainHandler::getCompilerTechniqueProvider()
@@ -366,7 +475,7 @@ void TerrainHandler::updateShaders()
 		}
 		//use a reverse iterator, since we need to update top most layers first, since lower layers might depend on them for their foliage positions
 		for (auto I = mShadersToUpdate.rbegin(); I != mShadersToUpdate.rend(); ++I) {
-			mTaskQueue->enqueueTask(new TerrainShaderUpdateTask(geometry, I->first, I->second.Areas, EventLayerUpdated, EventTerrainMaterialRecompiled, mLightning->getMainLightDirection()), 0);
+			mTaskScheduler->enqueuePageTask(new TerrainShaderUpdateTask(geometry, I->first, I->second.Areas, EventLayerUpdated, EventTerrainMaterialRecompiled, mLightning->getMainLightDirection()), getPageIndices(mPages));
 		}
 		mShadersToUpdate.clear();
 	}
@@ -385,7 +494,7 @@ void TerrainHandler::updateAllPages()
 
 	//Update all shaders on all pages
 	for (ShaderStore::const_iterator I = mShaderMap.begin(); I != mShaderMap.end(); ++I) {
-		mTaskQueue->enqueueTask(new TerrainShaderUpdateTask(geometry, I->second, areas, EventLayerUpdated, EventTerrainMaterialRecompiled, mLightning->getMainLightDirection()), 0);
+		mTaskScheduler->enqueuePageTask(new TerrainShaderUpdateTask(geometry, I->second, areas, EventLayerUpdated, EventTerrainMaterialRecompiled, mLightning->getMainLightDirection()), getPageIndices(mPages));
 	}
 }
 
@@ -445,7 +554,7 @@ void TerrainHandler::setUpTerrainPageAtIndex(const TerrainIndex& index, ITerrain
 			if (mLightning) {
 				sunDirection = mLightning->getMainLightDirection();
 			}
-			if (!mTaskQueue->enqueueTask(new TerrainPageCreationTask(*this, page, bridgePtr, *mHeightMapBufferProvider, *mHeightMap, sunDirection))) {
+			if (!mTaskScheduler->enqueuePageTask(new TerrainPageCreationTask(*this, page, bridgePtr, *mHeightMapBufferProvider, *mHeightMap, sunDirection), {index})) {
 				//We need to alert the bridge since it's holding up a thread waiting for this call.
 				bridgePtr->terrainPageReady();
 			}
@@ -453,7 +562,7 @@ void TerrainHandler::setUpTerrainPageAtIndex(const TerrainIndex& index, ITerrain
 			TerrainPage* page = mTerrainPages[x][y];
 			TerrainPageGeometryPtr geometryInstance(new TerrainPageGeometry(*page, getSegmentManager(), getDefaultHeight()));
 
-			if (!mTaskQueue->enqueueTask(new TerrainPageReloadTask(*this, bridgePtr, geometryInstance, getAllShaders(), page->getWorldExtent(), mLightning->getMainLightDirection()))) {
+			if (!mTaskScheduler->enqueuePageTask(new TerrainPageReloadTask(*this, bridgePtr, geometryInstance, getAllShaders(), page->getWorldExtent(), mLightning->getMainLightDirection()), {index})) {
 				//We need to alert the bridge since it's holding up a thread waiting for this call.
 				bridgePtr->terrainPageReady();
 			}
@@ -482,6 +591,11 @@ bool TerrainHandler::getHeight(const TerrainPosition& point, float& height) cons
 	return mHeightMap->getHeightAndNormal(point.x(), point.y(), height, vector);
 }
 
+size_t TerrainHandler::getHeights(const float* xs, const float* ys, float* heights, size_t count) const
+{
+	return mHeightMap->getHeights(xs, ys, heights, nullptr, count);
+}
+
 void TerrainHandler::blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<float>& heights) const
 {
 	mHeightMap->blitHeights(xMin, xMax, yMin, yMax, heights);
@@ -508,7 +622,7 @@ void TerrainHandler::updateShadows()
 					geometry.emplace_back(new TerrainPageGeometry(*aPage, *mSegmentManager, getDefaultHeight()));
 				}
 
-				mTaskQueue->enqueueTask(new ShadowUpdateTask(geometry, sunDirection));
+				mTaskScheduler->enqueuePageTask(new ShadowUpdateTask(geometry, sunDirection), getPageIndices(mPages));
 			}
 		}
 	} else {
@@ -523,7 +637,7 @@ float TerrainHandler::getDefaultHeight() const
 
 bool TerrainHandler::updateTerrain(const TerrainDefPointStore& terrainPoints)
 {
-	mTaskQueue->enqueueTask(new TerrainUpdateTask(*mTerrain, terrainPoints, *this, *mTerrainInfo, mHasTerrainInfo, *mSegmentManager));
+	mTaskScheduler->enqueueTerrainTask(new TerrainUpdateTask(*mTerrain, terrainPoints, *this, *mTerrainInfo, mHasTerrainInfo, *mSegmentManager));
 	return true;
 }
 
@@ -561,7 +675,7 @@ void TerrainHandler::reloadTerrain(const std::vector<WFMath::AxisBox<2>>& areas)
 				bridgePtr = J->second;
 			}
 			geometryToUpdate.emplace_back(TerrainPageGeometryPtr(new TerrainPageGeometry(*page, *mSegmentManager, getDefaultHeight())), bridgePtr);
-			mTaskQueue->enqueueTask(new GeometryUpdateTask(geometryToUpdate, areas, *this, mShaderMap, *mHeightMapBufferProvider, *mHeightMap, mLightning->getMainLightDirection()));
+			mTaskScheduler->enqueuePageTask(new GeometryUpdateTask(geometryToUpdate, areas, *this, mShaderMap, *mHeightMapBufferProvider, *mHeightMap, mLightning->getMainLightDirection()), {page->getWFIndex()});
 		}
 	}
 }
@@ -581,9 +695,21 @@ SegmentManager& TerrainHandler::getSegmentManager()
 	return *mSegmentManager;
 }
 
+void TerrainHandler::setSegmentCacheDirectory(const std::string& directory)
+{
+	//Make sure that no task is using the current cache.
+	processAllTasks();
+	if (directory.empty()) {
+		mSegmentCache.reset();
+	} else {
+		mSegmentCache.reset(new SegmentCache(directory));
+	}
+	mSegmentManager->setSegmentCache(mSegmentCache.get());
+}
+
 void TerrainHandler::updateMod(TerrainMod* terrainMod)
 {
-	mTaskQueue->enqueueTask(new TerrainModUpdateTask(*mTerrain, *terrainMod, *this));
+	mTaskScheduler->enqueueTerrainTask(new TerrainModUpdateTask(*mTerrain, *terrainMod, *this));
 }
 
 const std::unordered_map<std::string, Mercator::Area*>& TerrainHandler::getAreas() const
@@ -601,7 +727,7 @@ void TerrainHandler::updateArea(const std::string& id, Mercator::Area* terrainAr
 			Mercator::Area* newArea = new Mercator::Area(*terrainArea);
 			mAreas.insert(AreaMap::value_type(id, newArea));
 
-			mTaskQueue->enqueueTask(new TerrainAreaAddTask(*mTerrain, newArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), *this, TerrainLayerDefinitionManager::getSingleton(), mAreaShaders));
+			mTaskScheduler->enqueueTerrainTask(new TerrainAreaAddTask(*mTerrain, newArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), *this, TerrainLayerDefinitionManager::getSingleton(), mAreaShaders));
 		}
 		//If there's no existing area, and no valid supplied one, just don't do anything.
 	} else {
@@ -613,7 +739,7 @@ void TerrainHandler::updateArea(const std::string& id, Mercator::Area* terrainAr
 				shader = mAreaShaders[existingArea->getLayer()];
 			}
 			mAreas.erase(I);
-			mTaskQueue->enqueueTask(new TerrainAreaRemoveTask(*mTerrain, existingArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), shader));
+			mTaskScheduler->enqueueTerrainTask(new TerrainAreaRemoveTask(*mTerrain, existingArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), shader, *mSegmentManager));
 		} else {
 			//Check if we need to swap the area (if the layer has changed) or if we just can update the shape.
 			if (terrainArea->getLayer() != existingArea->getLayer()) {
@@ -623,22 +749,28 @@ void TerrainHandler::updateArea(const std::string& id, Mercator::Area* terrainAr
 				}
 
 				mAreas.erase(I);
-				mTaskQueue->enqueueTask(new TerrainAreaRemoveTask(*mTerrain, existingArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), shader));
+				mTaskScheduler->enqueueTerrainTask(new TerrainAreaRemoveTask(*mTerrain, existingArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), shader, *mSegmentManager));
 
 				Mercator::Area* newArea = new Mercator::Area(*terrainArea);
 				mAreas.insert(AreaMap::value_type(id, newArea));
-				mTaskQueue->enqueueTask(new TerrainAreaAddTask(*mTerrain, newArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), *this, TerrainLayerDefinitionManager::getSingleton(), mAreaShaders));
+				mTaskScheduler->enqueueTerrainTask(new TerrainAreaAddTask(*mTerrain, newArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), *this, TerrainLayerDefinitionManager::getSingleton(), mAreaShaders));
 			} else {
 				const TerrainShader* shader = 0;
 				if (mAreaShaders.count(terrainArea->getLayer())) {
 					shader = mAreaShaders[terrainArea->getLayer()];
 				}
-				mTaskQueue->enqueueTask(new TerrainAreaUpdateTask(*mTerrain, existingArea, *terrainArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), shader));
+				mTaskScheduler->enqueueTerrainTask(new TerrainAreaUpdateTask(*mTerrain, existingArea, *terrainArea, sigc::mem_fun(*this, &TerrainHandler::markShaderForUpdate), shader, *mSegmentManager));
 			}
 		}
 	}
 }
 
+void TerrainHandler::processMainThreadTasks(const TimeFrame& timeFrame)
+{
+	dispatchPlantQueries();
+	mTaskQueue->pollProcessedTasks(timeFrame);
+}
+
 void TerrainHandler::frameProcessed(const TimeFrame&, unsigned int)
 {
 	if (mLightning) {
@@ -648,6 +780,71 @@ void TerrainHandler::frameProcessed(const TimeFrame&, unsigned int)
 			mLastLightingUpdateAngle = mLightning->getMainLightDirection();
 		}
 	}
+	if (mFocusEntity) {
+		//Check once a second, which is often enough since we look many seconds ahead.
+		auto now = std::chrono::steady_clock::now();
+		if (now - mLastPrefetch >= std::chrono::seconds(1)) {
+			mLastPrefetch = now;
+			auto position = mFocusEntity->getViewPosition();
+			if (position.isValid()) {
+				auto velocity = mFocusEntity->getPredictedVelocity();
+				prefetchSegments(TerrainPosition(position.x(), position.z()), velocity.isValid() ? WFMath::Vector<2>(velocity.x(), velocity.z()) : WFMath::Vector<2>::ZERO());
+			}
+		}
+	}
+}
+
+void TerrainHandler::setFocusEntity(EmberEntity* entity)
+{
+	mFocusEntity = entity;
+	mPrefetchedSegments.clear();
+	if (!entity) {
+		mSegmentManager->setFocus(TerrainPosition());
+	}
+}
+
+void TerrainHandler::prefetchSegments(const TerrainPosition& position, const WFMath::Vector<2>& velocity)
+{
+	mSegmentManager->setFocus(position);
+
+	float speed = velocity.mag();
+	if (speed < MinimumPrefetchSpeed) {
+		mPrefetchedSegments.clear();
+		return;
+	}
+
+	//Walk along the predicted path, collecting the segments along it as well as those next to them.
+	const int resolution = mTerrain->getResolution();
+	std::set<std::pair<int, int>> segments;
+	const float distance = speed * PrefetchTime;
+	for (float travelled = 0; travelled <= distance; travelled += resolution * 0.5f) {
+		TerrainPosition point = position + (velocity * (travelled / speed));
+		int x = static_cast<int>(std::floor(point.x() / resolution));
+		int y = static_cast<int>(std::floor(point.y() / resolution));
+		for (int dx = -1; dx <= 1; ++dx) {
+			for (int dy = -1; dy <= 1; ++dy) {
+				segments.emplace(x + dx, y + dy);
+			}
+		}
+	}
+
+	//Only ask for segments which weren't asked for the last time, as they've either been populated already or are pending.
+	std::vector<std::pair<int, int>> newSegments;
+	std::set<TerrainIndex> pages;
+	const int segmentsPerPage = std::max(1, getPageMetersSize() / resolution);
+	for (auto& segment : segments) {
+		if (mPrefetchedSegments.find(segment) == mPrefetchedSegments.end()) {
+			newSegments.push_back(segment);
+			//This is the inverse of how TerrainPageGeometry maps pages to segments.
+			pages.emplace(floorDivide(segment.first, segmentsPerPage), -floorDivide(segment.second, segmentsPerPage));
+		}
+	}
+	mPrefetchedSegments = std::move(segments);
+
+	if (!newSegments.empty()) {
+		//The task must have exclusive access to the pages of the segments, as it populates them.
+		mTaskScheduler->enqueuePageTask(new SegmentPrefetchTask(*mSegmentManager, std::move(newSegments)), std::vector<TerrainIndex>(pages.begin(), pages.end()));
+	}
 }
 
 }
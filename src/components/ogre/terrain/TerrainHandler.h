@@ -28,8 +28,11 @@
 #include <sigc++/signal.h>
 #include <sigc++/slot.h>
 
+#include <chrono>
 #include <set>
+#include <map>
 #include <memory>
+#include <tuple>
 
 namespace Mercator {
 	class Area;
@@ -73,7 +76,10 @@ class HeightMapBufferProvider;
 class TerrainDefPoint;
 class PlantAreaQuery;
 class PlantAreaQueryResult;
+class PlantQueryTask;
 class SegmentManager;
+class SegmentCache;
+class TerrainTaskScheduler;
 
 namespace Foliage {
 class PlantPopulator;
@@ -96,8 +102,10 @@ public:
 	 * @brief Ctor.
 	 * @param pageIndexSize The size of one side of a page, in indices.
 	 * @param compilerTechniqueProvider Provider for terrain surface compilation techniques.
+	 * @param eventService The event service used for executing things on the main thread.
+	 * @param numberOfWorkers The number of background threads used for terrain tasks. Tasks on different pages are executed concurrently.
 	 */
-	TerrainHandler(unsigned int pageIndexSize, ICompilerTechniqueProvider& compilerTechniqueProvider, Eris::EventService& eventService);
+	TerrainHandler(unsigned int pageIndexSize, ICompilerTechniqueProvider& compilerTechniqueProvider, Eris::EventService& eventService, unsigned int numberOfWorkers = 1);
 
 	/**
 	 * @brief Dtor.
@@ -107,7 +115,7 @@ public:
 	/**
 	 * @brief Shuts down the handler; call this before deleting the instance.
 	 *
-	 * This will mainly deactivate the task queue. This might be important if there are outstanding threads waiting for
+	 * This will mainly process all outstanding tasks and then deactivate the task queue. This might be important if there are outstanding threads waiting for
 	 * it to complete.
 	 */
 	void shutdown();
@@ -129,6 +137,18 @@ public:
 	 */
 	bool getHeight(const TerrainPosition& atPosition, float& height) const;
 
+	/**
+	 * @brief Gets the heights for a batch of positions in the world.
+	 *
+	 * This gives the same heights as getHeight(), but is much faster when many heights are needed at once, such as when placing foliage.
+	 * @param xs The x positions, in world space.
+	 * @param ys The y positions, in world space.
+	 * @param heights The heights will be stored here. Must have room for "count" values. Positions without a valid segment get the default height of the terrain.
+	 * @param count The number of positions.
+	 * @returns The number of positions for which there was a valid, populated segment.
+	 */
+	size_t getHeights(const float* xs, const float* ys, float* heights, size_t count) const;
+
     /**
      * @brief Performs a fast copy of the raw height data for the supplied area.
      * @param xMin Minimum x coord of the area.
@@ -303,6 +323,8 @@ public:
 	 * @brief Place the plants for the supplied area in the supplied store.
 	 *
 	 * This method will perform the lookup in a background thread and return the results through an async callback.
+	 * The queries are gathered during the frame, and put on the task queue in batches per segment and populator when the main
+	 * thread tasks are processed.
 	 * @param populator The plant populator to use.
 	 * @param query The plant query.
 	 * @param asyncCallback A callback to be called when the query has been executed in a background thread.
@@ -330,6 +352,14 @@ public:
 	 */
 	SegmentManager& getSegmentManager();
 
+	/**
+	 * @brief Sets the directory in which populated segments are cached, so that they don't need to be calculated again.
+	 *
+	 * This should be called before any pages are created.
+	 * @param directory An existing directory, or an empty string to disable caching.
+	 */
+	void setSegmentCacheDirectory(const std::string& directory);
+
 	/**
 	 * @brief Gets the compiler technique provider, responsible for creating terrain shader techniques.
 	 *
@@ -344,6 +374,14 @@ public:
 	 */
 	void updateAllPages();
 
+	/**
+	 * @brief Sets the entity around which terrain is most likely to be needed, normally the avatar.
+	 *
+	 * Unused segments close to the entity are kept in memory longer than others, and segments ahead of it are prefetched as it moves.
+	 * @param entity The entity, or null if there's none.
+	 */
+	void setFocusEntity(EmberEntity* entity);
+
 	/**
 	 * Gets the entity which currently defines the terrain, is any such exists.
 	 * @return An entity, or null if no entity which defines any terrain exists.
@@ -489,6 +527,11 @@ protected:
 	 */
 	Tasks::TaskQueue* mTaskQueue;
 
+	/**
+	 * @brief Schedules the tasks on the task queue, so that tasks on different pages can run concurrently.
+	 */
+	std::unique_ptr<TerrainTaskScheduler> mTaskScheduler;
+
 	/**
 	 * @brief Provides lightning information for the terrain.
 	 */
@@ -522,6 +565,11 @@ protected:
 	 */
 	SegmentManager* mSegmentManager;
 
+	/**
+	 * @brief Caches populated segments on disk, if enabled.
+	 */
+	std::unique_ptr<SegmentCache> mSegmentCache;
+
 	/**
 	 * @brief The angle used when lighting for precomputed shadows was last updated.
 	 *
@@ -537,6 +585,38 @@ protected:
 	 */
 	EmberEntity* mTerrainEntity;
 
+	/**
+	 * @brief The entity around which terrain is most likely to be needed, if any.
+	 */
+	EmberEntity* mFocusEntity;
+
+	/**
+	 * @brief When segments last were prefetched.
+	 */
+	std::chrono::steady_clock::time_point mLastPrefetch;
+
+	/**
+	 * @brief The segments which were asked for by the last prefetch.
+	 */
+	std::set<std::pair<int, int>> mPrefetchedSegments;
+
+	/**
+	 * @brief Sets the focus of the segment manager, and prefetches the segments along the predicted path of the focus.
+	 * @param position The position of the focus, in world space.
+	 * @param velocity The velocity of the focus.
+	 */
+	void prefetchSegments(const TerrainPosition& position, const WFMath::Vector<2>& velocity);
+
+	/**
+	 * @brief Plant queries gathered during the current frame, batched per page, populator and segment.
+	 */
+	std::map<std::tuple<TerrainIndex, Foliage::PlantPopulator*, int, int>, PlantQueryTask*> mPendingPlantQueries;
+
+	/**
+	 * @brief Puts all gathered plant queries on the task queue.
+	 */
+	void dispatchPlantQueries();
+
 	/**
 	 * @brief Marks a shader for update, to be updated on the next batch, normally a frameEnded event.
 	 *
@@ -553,6 +633,17 @@ protected:
 	 */
 	void frameProcessed(const TimeFrame&, unsigned int);
 
+	/**
+	 * @brief Called each frame, completes processed terrain tasks in the main thread.
+	 * @param timeFrame The time frame for the current frame.
+	 */
+	void processMainThreadTasks(const TimeFrame& timeFrame);
+
+	/**
+	 * @brief Blocks until all scheduled tasks have been completed, including any tasks they in turn schedule.
+	 */
+	void processAllTasks();
+
 	/**
 	 * @brief Updates shaders needing updating.
 	 *
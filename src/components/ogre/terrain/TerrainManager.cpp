@@ -30,6 +30,7 @@
 #include "ITerrainAdapter.h"
 
 #include "TerrainLayerDefinition.h"
+#include "SegmentManager.h"
 #include "PlantAreaQuery.h"
 
 #include "techniques/CompilerTechniqueProvider.h"
@@ -37,8 +38,11 @@
 #include "foliage/Vegetation.h"
 
 #include "framework/TimeFrame.h"
+#include "framework/osdir.h"
+#include "framework/ConsoleBackend.h"
 
 #include "services/config/ConfigService.h"
+#include "services/EmberServices.h"
 
 #include "../ShaderManager.h"
 #include "../Scene.h"
@@ -56,6 +60,9 @@
 
 #include <sigc++/bind.h>
 
+#include <algorithm>
+#include <sstream>
+#include <thread>
 #include <utility>
 
 using namespace Ogre;
@@ -66,11 +73,55 @@ namespace OgreView
 namespace Terrain
 {
 
+namespace
+{
+/**
+ * @brief Gets the number of background threads to use for terrain tasks, as set by "terrain:workers".
+ * If it's not set, or set to 0, all but one of the cores are used, leaving one for the main thread.
+ */
+unsigned int getNumberOfTerrainWorkers()
+{
+	int workers = 0;
+	auto& configService = EmberServices::getSingleton().getConfigService();
+	if (configService.itemExists("terrain", "workers")) {
+		workers = static_cast<int>(configService.getValue("terrain", "workers"));
+	}
+	if (workers <= 0) {
+		workers = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+	}
+	return static_cast<unsigned int>(std::max(1, workers));
+}
+
+/**
+ * @brief Gets the directory in which populated terrain segments are cached, creating it if needed.
+ * Caching can be disabled by setting "terrain:segmentcache" to false.
+ * @return The directory, or an empty string if segments shouldn't be cached.
+ */
+std::string getSegmentCacheDirectory()
+{
+	auto& configService = EmberServices::getSingleton().getConfigService();
+	if (configService.itemExists("terrain", "segmentcache") && !static_cast<bool>(configService.getValue("terrain", "segmentcache"))) {
+		return "";
+	}
+	std::string directory = configService.getHomeDirectory(BaseDirType_CACHE) + "/terrain/";
+	try {
+		oslink::directory osdir(directory);
+		if (!osdir.isExisting()) {
+			oslink::directory::mkdir(directory.c_str());
+		}
+	} catch (const std::exception& ex) {
+		S_LOG_WARNING("Could not create directory for terrain segment cache; segments won't be cached." << ex);
+		return "";
+	}
+	return directory;
+}
+}
 
 TerrainManager::TerrainManager(ITerrainAdapter* adapter, Scene& scene, ShaderManager& shaderManager, Eris::EventService& eventService) :
 	UpdateShadows("update_shadows", this, "Updates shadows in the terrain."),
+	ShowSegmentResidency("show_segment_residency", this, "Shows the memory used by terrain segments, the number of evictions and the prefetch hit rate."),
 	mCompilerTechniqueProvider(new Techniques::CompilerTechniqueProvider(shaderManager, scene.getSceneManager())),
-	mHandler(new TerrainHandler(adapter->getPageSize(), *mCompilerTechniqueProvider, eventService)),
+	mHandler(new TerrainHandler(adapter->getPageSize(), *mCompilerTechniqueProvider, eventService, getNumberOfTerrainWorkers())),
 	mIsFoliageShown(false),
 	mTerrainAdapter(adapter),
 	mFoliageBatchSize(32),
@@ -82,6 +133,7 @@ TerrainManager::TerrainManager(ITerrainAdapter* adapter, Scene& scene, ShaderMan
 	registerConfigListener("terrain", "preferredtechnique", sigc::mem_fun(*this, &TerrainManager::config_TerrainTechnique), false);
 	registerConfigListener("terrain", "pagesize", sigc::mem_fun(*this, &TerrainManager::config_TerrainPageSize), false);
 	registerConfigListener("terrain", "loadradius", sigc::mem_fun(*this, &TerrainManager::config_TerrainLoadRadius));
+	registerConfigListener("terrain", "segmentmemorybudget", sigc::mem_fun(*this, &TerrainManager::config_TerrainSegmentMemoryBudget));
 
 	shaderManager.EventLevelChanged.connect(sigc::bind(sigc::mem_fun(*this, &TerrainManager::shaderManager_LevelChanged), &shaderManager));
 
@@ -93,6 +145,7 @@ TerrainManager::TerrainManager(ITerrainAdapter* adapter, Scene& scene, ShaderMan
 	sigc::slot<void, const Ogre::TRect<Ogre::Real>> slot = sigc::mem_fun(*this, &TerrainManager::adapter_terrainShown);
 	adapter->bindTerrainShown(slot);
 
+	mHandler->setSegmentCacheDirectory(getSegmentCacheDirectory());
 	mHandler->setPageSize(mTerrainAdapter->getPageSize());
 	mHandler->updateAllPages();
 
@@ -123,6 +176,11 @@ bool TerrainManager::getHeight(const TerrainPosition& atPosition, float& height)
 	return mHandler->getHeight(atPosition, height);
 }
 
+size_t TerrainManager::getHeights(const float* xs, const float* ys, float* heights, size_t count) const
+{
+	return mHandler->getHeights(xs, ys, heights, count);
+}
+
 void TerrainManager::blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<float>& heights) const
 {
 	mHandler->blitHeights(xMin, xMax, yMin, yMax, heights);
@@ -196,6 +254,14 @@ void TerrainManager::config_TerrainLoadRadius(const std::string& section, const
 	}
 }
 
+void TerrainManager::config_TerrainSegmentMemoryBudget(const std::string& section, const std::string& key, varconf::Variable& variable)
+{
+	//The budget is set in megabytes.
+	if (variable.is_int() && static_cast<int>(variable) > 0) {
+		mHandler->getSegmentManager().setMemoryBudget(static_cast<size_t>(static_cast<int>(variable)) * 1024 * 1024);
+	}
+}
+
 void TerrainManager::terrainHandler_AfterTerrainUpdate(const std::vector<WFMath::AxisBox<2>>& areas, const std::set<TerrainPage*>& pages)
 {
 
@@ -258,6 +324,16 @@ void TerrainManager::runCommand(const std::string& command, const std::string& a
 {
 	if (UpdateShadows == command) {
 		mHandler->updateShadows();
+	} else if (ShowSegmentResidency == command) {
+		auto stats = mHandler->getSegmentManager().getResidencyStats();
+		std::stringstream ss;
+		ss << "Terrain segments hold " << stats.residentBytes / 1024 << " kB of " << stats.memoryBudget / 1024 << " kB allowed, " << stats.unusedSegments
+		   << " unused segments can be released. " << stats.evictions << " evictions, " << stats.prefetches << " segments prefetched";
+		if (stats.prefetches) {
+			ss << " with a hit rate of " << (stats.prefetchHits * 100) / stats.prefetches << "%";
+		}
+		ss << ".";
+		ConsoleBackend::getSingleton().pushMessage(ss.str(), "info");
 	}
 }
 
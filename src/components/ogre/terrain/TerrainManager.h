@@ -150,6 +150,11 @@ public:
 	 */
 	const ConsoleCommandWrapper UpdateShadows;
 
+	/**
+	 * @brief Console command for showing the memory used by terrain segments, the number of evictions and the prefetch hit rate.
+	 */
+	const ConsoleCommandWrapper ShowSegmentResidency;
+
 	/**
 	 * @brief Whether the foliage should be shown or not.
 	 *
@@ -169,6 +174,18 @@ public:
 	 */
 	bool getHeight(const TerrainPosition& atPosition, float& height) const override;
 
+	/**
+	 * @brief Gets the heights for a batch of positions in the world.
+	 *
+	 * This gives the same heights as getHeight(), but is much faster when many heights are needed at once, such as when placing foliage.
+	 * @param xs The x positions, in world space.
+	 * @param ys The y positions, in world space.
+	 * @param heights The heights will be stored here. Must have room for "count" values. Positions without a valid segment get the default height of the terrain.
+	 * @param count The number of positions.
+	 * @returns The number of positions for which there was a valid, populated segment.
+	 */
+	size_t getHeights(const float* xs, const float* ys, float* heights, size_t count) const override;
+
     /**
      * @brief Performs a fast copy of the raw height data for the supplied area.
      * @param xMin Minimum x coord of the area.
@@ -284,6 +301,8 @@ protected:
 
 	void config_TerrainLoadRadius(const std::string& section, const std::string& key, varconf::Variable& variable);
 
+	void config_TerrainSegmentMemoryBudget(const std::string& section, const std::string& key, varconf::Variable& variable);
+
 	void terrainHandler_AfterTerrainUpdate(const std::vector<WFMath::AxisBox<2>>& areas, const std::set<TerrainPage*>& pages);
 
 	void terrainHandler_ShaderCreated(const TerrainShader& shader);
@@ -32,12 +32,12 @@ namespace OgreView {
 
 namespace Terrain {
 
-TerrainMaterialCompilationTask::TerrainMaterialCompilationTask(const GeometryPtrVector& geometry, sigc::signal<void, TerrainPage*>& signal, const WFMath::Vector<3>& lightDirection) :
-		mGeometry(geometry), mSignal(signal), mLightDirection(lightDirection) {
+TerrainMaterialCompilationTask::TerrainMaterialCompilationTask(const GeometryPtrVector& geometry, const AreaStore& areas, sigc::signal<void, TerrainPage*>& signal, const WFMath::Vector<3>& lightDirection) :
+		mGeometry(geometry), mAreas(areas), mSignal(signal), mLightDirection(lightDirection) {
 }
 
-TerrainMaterialCompilationTask::TerrainMaterialCompilationTask(TerrainPageGeometryPtr geometry, sigc::signal<void, TerrainPage*>& signal, const WFMath::Vector<3>& lightDirection) :
-		mSignal(signal), mLightDirection(lightDirection) {
+TerrainMaterialCompilationTask::TerrainMaterialCompilationTask(TerrainPageGeometryPtr geometry, const AreaStore& areas, sigc::signal<void, TerrainPage*>& signal, const WFMath::Vector<3>& lightDirection) :
+		mAreas(areas), mSignal(signal), mLightDirection(lightDirection) {
 	mGeometry.push_back(geometry);
 }
 
@@ -45,10 +45,9 @@ void TerrainMaterialCompilationTask::executeTaskInBackgroundThread(Tasks::TaskEx
 	for (GeometryPtrVector::const_iterator J = mGeometry.begin(); J != mGeometry.end(); ++J) {
 		(*J)->repopulate();
 		TerrainPage& page = (*J)->getPage();
-		TerrainPageSurfaceCompilationInstance* compilationInstance = page.getSurface()->createSurfaceCompilationInstance(*J);
-		//If the technique requires a pregenerated shadow we must also populate normals.
+		TerrainPageSurfaceCompilationInstance* compilationInstance = page.getSurface()->createSurfaceCompilationInstance(*J, mAreas);
 		if (compilationInstance->requiresPregenShadow()) {
-			(*J)->repopulate(true);
+			page.getSurface()->getShadow()->setLightDirection(mLightDirection);
 			page.getSurface()->getShadow()->updateShadow(**J);
 		}
 		if (compilationInstance->prepare()) {
@@ -71,9 +70,9 @@ bool TerrainMaterialCompilationTask::executeTaskInMainThread() {
 		S_LOG_VERBOSE("Recompiled material for terrain page " << "[" << page->getWFIndex().first << "|" << page->getWFIndex().second << "]");
 		page->getSurface()->getShadow()->setShadowTextureName(compilationInstance->getShadowTextureName(page->getMaterial()));
 		mSignal(page); // Notify the terrain system of the material change
-		delete compilationInstance;
 		std::stringstream ss;
-		ss << "Compiled for page [" << page->getWFIndex().first << "|" << page->getWFIndex().second << "]";
+		ss << "Compiled for page [" << page->getWFIndex().first << "|" << page->getWFIndex().second << "], uploading " << compilationInstance->getUploadedTextureBytes() << " bytes of texture data";
+		delete compilationInstance;
 		timedLog.report(ss.str());
 		updateSceneManagersAfterMaterialsChange();
 		mMaterialRecompilations.erase(J);
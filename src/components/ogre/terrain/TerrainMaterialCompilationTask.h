@@ -47,17 +47,19 @@ public:
 	/**
 	 * @brief Ctor.
 	 * @param pages The pages which needs to have their material recompiled.
+	 * @param areas The areas which have changed.
 	 * @param signal The signal to emit once the compilation is finished.
 	 * @param lightDirection The main light direction.
 	 */
-	TerrainMaterialCompilationTask(const GeometryPtrVector& geometry, sigc::signal<void, TerrainPage* >& signal, const WFMath::Vector<3>& lightDirection);
+	TerrainMaterialCompilationTask(const GeometryPtrVector& geometry, const AreaStore& areas, sigc::signal<void, TerrainPage* >& signal, const WFMath::Vector<3>& lightDirection);
 
 	/**
 	 * @brief Ctor.
 	 * @param page The page which needs to have its material recompiled.
+	 * @param areas The areas which have changed.
 	 * @param lightDirection The main light direction.
 	 */
-	TerrainMaterialCompilationTask(TerrainPageGeometryPtr pageGeometry, sigc::signal<void, TerrainPage* >& signal, const WFMath::Vector<3>& lightDirection);
+	TerrainMaterialCompilationTask(TerrainPageGeometryPtr pageGeometry, const AreaStore& areas, sigc::signal<void, TerrainPage* >& signal, const WFMath::Vector<3>& lightDirection);
 
 	/**
 	 * @brief Dtor.
@@ -79,6 +81,11 @@ private:
 	 */
 	GeometryPtrVector mGeometry;
 
+	/**
+	 * @brief The areas which have changed. Only the parts of the blend maps within these need to be updated.
+	 */
+	const AreaStore mAreas;
+
 	/**
 	 * @brief The compilation instances and their corresponding pages.
 	 */
@@ -19,6 +19,7 @@
 #include "TerrainModUpdateTask.h"
 #include "TerrainHandler.h"
 #include "TerrainMod.h"
+#include "SegmentManager.h"
 #include <Mercator/Terrain.h>
 #include <Mercator/Segment.h>
 
@@ -45,6 +46,8 @@ void TerrainModUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionCon
 {
 	const Mercator::TerrainMod* existingMod = mTerrain.getMod(mId);
 	const Mercator::TerrainMod* terrainMod = nullptr;
+	//The area of the segment which is populated here, if any.
+	WFMath::AxisBox<2> populatedArea;
 	if (mTranslator.isValid()) {
 
 		Mercator::Segment* segment = mTerrain.getSegmentAtPos(mPosition.x(), mPosition.z());
@@ -56,6 +59,8 @@ void TerrainModUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionCon
 			if (segment->getMods().empty()) {
 				if (!segment->isValid()) {
 					segment->populate();
+					populatedArea = WFMath::AxisBox<2>(WFMath::Point<2>(segment->getXRef(), segment->getZRef()),
+													   WFMath::Point<2>(segment->getXRef() + segment->getResolution(), segment->getZRef() + segment->getResolution()));
 				}
 				segment->getHeight(modPos.x() - (segment->getXRef()), modPos.z() - (segment->getZRef()), modPos.y());
 			} else {
@@ -83,6 +88,12 @@ void TerrainModUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionCon
 		delete existingMod;
 	}
 
+	//Mercator has invalidated the segments covered by the mods, so the segment manager needs to measure them again.
+	auto& segmentManager = mHandler.getSegmentManager();
+	segmentManager.remeasureSegments(populatedArea);
+	for (auto& area : mUpdatedAreas) {
+		segmentManager.remeasureSegments(area);
+	}
 }
 
 bool TerrainModUpdateTask::executeTaskInMainThread()
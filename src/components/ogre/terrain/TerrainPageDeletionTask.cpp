@@ -38,6 +38,8 @@ TerrainPageDeletionTask::TerrainPageDeletionTask(TerrainPage* page) :
 
 TerrainPageDeletionTask::~TerrainPageDeletionTask()
 {
+	//If the task never got to execute (because the task queue was shut down) the page still needs to be deleted.
+	delete mPage;
 }
 
 void TerrainPageDeletionTask::executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context)
@@ -47,6 +49,7 @@ void TerrainPageDeletionTask::executeTaskInBackgroundThread(Tasks::TaskExecution
 bool TerrainPageDeletionTask::executeTaskInMainThread()
 {
 	delete mPage;
+	mPage = nullptr;
 	return true;
 }
 }
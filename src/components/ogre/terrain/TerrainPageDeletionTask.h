@@ -35,6 +35,7 @@ class TerrainPage;
  *
  * This task only deletes a page. The reason for having it as a task is that we want to make sure no other tasks
  * are using the page when it's deleted.
+ * The task owns the page, so if it's discarded without being executed the page is deleted along with it.
  */
 class TerrainPageDeletionTask: public Tasks::TemplateNamedTask<TerrainPageDeletionTask>
 {
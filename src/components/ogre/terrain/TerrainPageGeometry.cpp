@@ -27,12 +27,16 @@
 #include "TerrainPageGeometry.h"
 #include "Segment.h"
 #include "SegmentManager.h"
+#include "SegmentCache.h"
 
 #include "TerrainPage.h"
 #include "components/ogre/Convert.h"
 #include <Mercator/Segment.h>
 #include <wfmath/stream.h>
 
+#include <algorithm>
+#include <cstring>
+
 //MSVC 11.0 doesn't support std::lround so we'll use boost. When MSVC gains support for std::lround this could be removed.
 #ifdef _MSC_VER
 #include <boost/math/special_functions/round.hpp>
@@ -46,7 +50,7 @@ namespace OgreView {
 namespace Terrain {
 
 TerrainPageGeometry::TerrainPageGeometry(TerrainPage& page, SegmentManager& segmentManager, float defaultHeight) :
-		mPage(page), mDefaultHeight(defaultHeight) {
+		mPage(page), mDefaultHeight(defaultHeight), mSegmentCache(segmentManager.getSegmentCache()) {
 
 	SegmentManager::IndexMap indices;
 	int segmentsPerAxis = mPage.getNumberOfSegmentsPerAxis();
@@ -75,7 +79,11 @@ void TerrainPageGeometry::repopulate(bool alsoNormals) {
 		for (const auto& entry : column.second) {
 			Mercator::Segment& segment = entry.second->getMercatorSegment();
 			if (!segment.isValid()) {
-				segment.populate();
+				if (mSegmentCache) {
+					mSegmentCache->populate(segment);
+				} else {
+					segment.populate();
+				}
 			}
 			if (alsoNormals && !segment.getNormals()) {
 				segment.populateNormals();
@@ -88,6 +96,10 @@ TerrainPage& TerrainPageGeometry::getPage() {
 	return mPage;
 }
 
+SegmentCache* TerrainPageGeometry::getSegmentCache() const {
+	return mSegmentCache;
+}
+
 float TerrainPageGeometry::getMaxHeight() const {
 	float max = std::numeric_limits<float>::min();
 	for (const auto& column : mLocalSegments) {
@@ -101,50 +113,92 @@ float TerrainPageGeometry::getMaxHeight() const {
 	return max;
 }
 
-void TerrainPageGeometry::updateOgreHeightData(float* heightData) {
-	float* heightDataPtr = heightData;
+void TerrainPageGeometry::updateOgreHeightData(float* heightData) const {
+	updateOgreHeightData(heightData, static_cast<size_t>(mPage.getPageSize()));
+}
+
+void TerrainPageGeometry::updateOgreHeightData(float* heightData, size_t stride) const {
+	blitSegments(mLocalSegments, mPage.getPageSize(), mDefaultHeight, heightData, stride);
+}
 
-	int sizeOfBitmap = mPage.getVerticeCount();
-	//Set the height of any uninitialized part to the default height. This might be optimized better though.
-	for (int i = 0; i < sizeOfBitmap; ++i) {
-		*(heightDataPtr++) = mDefaultHeight;
+void TerrainPageGeometry::blitSegments(const SegmentRefStore& segments, int pageSize, float defaultHeight, float* heightData, size_t stride) {
+	int resolution = 0;
+	for (const auto& column : segments) {
+		for (const auto& entry : column.second) {
+			resolution = entry.second->getMercatorSegment().getResolution();
+			break;
+		}
+		if (resolution) {
+			break;
+		}
 	}
 
-	for (const auto& column : mLocalSegments) {
+	const int segmentsPerAxis = resolution ? (pageSize - 1) / resolution : 0;
+	if (segmentsPerAxis == 0 || (segmentsPerAxis * resolution) + 1 != pageSize) {
+		//The segments don't line up with the page, so fall back to first setting everything to the default height.
+		fillOgreHeightData(heightData, stride, pageSize, 0, 0, pageSize, defaultHeight);
+	} else {
+		//Only set the default height where there's no valid segment; everything else is overwritten by the segments below.
+		//This is done before blitting any segments, since neighbouring segments share their edges.
+		for (int x = 0; x < segmentsPerAxis; ++x) {
+			auto I = segments.find(x);
+			for (int z = 0; z < segmentsPerAxis; ++z) {
+				bool isValid = false;
+				if (I != segments.end()) {
+					auto J = I->second.find(z);
+					isValid = J != I->second.end() && J->second->getMercatorSegment().isValid();
+				}
+				if (!isValid) {
+					fillOgreHeightData(heightData, stride, pageSize, x * resolution, z * resolution, resolution + 1, defaultHeight);
+				}
+			}
+		}
+	}
+
+	for (const auto& column : segments) {
 		for (const auto& entry : column.second) {
 			Mercator::Segment& segment = entry.second->getMercatorSegment();
 			if (segment.isValid()) {
-				blitSegmentToOgre(heightData, segment, column.first * segment.getResolution(),
-								  entry.first * segment.getResolution());
+				blitSegmentToOgre(heightData, stride, pageSize, segment, column.first * segment.getResolution(), entry.first * segment.getResolution());
 			}
 		}
 	}
 }
 
-void TerrainPageGeometry::blitSegmentToOgre(float* ogreHeightData, Mercator::Segment& segment, int startX, int startZ) {
-	int segmentWidth = segment.getSize();
-	int pageWidth = mPage.getPageSize();
-	int ogreDataSize = pageWidth * pageWidth;
-
-	const float* sourcePtr = segment.getPoints();
-
-	float* dataEnd = ogreHeightData + ogreDataSize;
-
-	// copy points line-by line
-	float* destPtr = ogreHeightData + (pageWidth * ( pageWidth - startZ - 1)) + startX;
+void TerrainPageGeometry::blitSegmentToOgre(float* ogreHeightData, size_t stride, int pageSize, const Mercator::Segment& segment, int startX, int startZ) {
+	const int segmentWidth = segment.getSize();
 
+	//Clip the segment against the page once, instead of checking each point.
+	//Row i of the segment ends up at row (pageSize - startZ - 1 - i) of the Ogre data, since Ogre's rows run the other way.
+	const int firstColumn = std::max(0, -startX);
+	const int lastColumn = std::min(segmentWidth, pageSize - startX);
+	const int firstRow = std::max(0, -startZ);
+	const int lastRow = std::min(segmentWidth, pageSize - startZ);
+	if (firstColumn >= lastColumn || firstRow >= lastRow) {
+		return;
+	}
+	const size_t rowSize = sizeof(float) * (lastColumn - firstColumn);
 
-	for (int i = 0; i < segmentWidth; ++i) {
-		for (int j = 0; j < segmentWidth; ++j) {
-			if ((destPtr + j) >= ogreHeightData && (destPtr + j) < dataEnd) {
-				*(destPtr + j) = *(sourcePtr + j);
-			}
-		}
-		destPtr -= pageWidth;
+	const float* sourcePtr = segment.getPoints() + (firstRow * segmentWidth) + firstColumn;
+	float* destPtr = ogreHeightData + (stride * (pageSize - startZ - firstRow - 1)) + startX + firstColumn;
+	for (int i = firstRow; i < lastRow; ++i) {
+		std::memcpy(destPtr, sourcePtr, rowSize);
+		destPtr -= stride;
 		sourcePtr += segmentWidth;
 	}
 }
 
+void TerrainPageGeometry::fillOgreHeightData(float* ogreHeightData, size_t stride, int pageSize, int startX, int startZ, int width, float height) {
+	const int firstColumn = std::max(0, startX);
+	const int lastColumn = std::min(pageSize, startX + width);
+	const int firstZ = std::max(0, startZ);
+	const int lastZ = std::min(pageSize, startZ + width);
+	for (int z = firstZ; z < lastZ; ++z) {
+		float* rowPtr = ogreHeightData + (stride * (pageSize - z - 1));
+		std::fill(rowPtr + firstColumn, rowPtr + lastColumn, height);
+	}
+}
+
 Mercator::Segment* TerrainPageGeometry::getSegmentAtLocalPosition(const TerrainPosition& pos) const {
 	int ix = I_ROUND(floor(pos.x() / 64));
 	int iz = I_ROUND(floor(pos.y() / 64));
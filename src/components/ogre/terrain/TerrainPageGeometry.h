@@ -56,6 +56,7 @@ typedef std::vector<PageSegment> SegmentVector;
 
 class TerrainPage;
 class SegmentManager;
+class SegmentCache;
 
 /**
 @author Erik Ogenvik <erik@ogenvik.org>
@@ -93,7 +94,27 @@ public:
 	/**
 	 * @brief Fills the bound height data with height data. If no buffer has been bound nothing will be done.
 	 */
-	void updateOgreHeightData(float* heightData);
+	void updateOgreHeightData(float* heightData) const;
+
+	/**
+	 * @brief Fills height data with the heights of the page, where the rows are placed with a custom stride.
+	 * This allows the heights to be written straight into a larger buffer, such as one with a border around the page.
+	 * @param heightData The first height of the page.
+	 * @param stride The number of heights between the start of each row.
+	 */
+	void updateOgreHeightData(float* heightData, size_t stride) const;
+
+	/**
+	 * @brief Blits the heights of a collection of segments into Ogre height data.
+	 * The rows of each segment are copied straight from the Mercator segment, and only the parts of the page not covered by any
+	 * valid segment are set to the default height.
+	 * @param segments The segments, indexed using local coords.
+	 * @param pageSize The size of the page, in heights along each side.
+	 * @param defaultHeight The height of any parts of the page where no segment has been initialized.
+	 * @param heightData The first height of the page.
+	 * @param stride The number of heights between the start of each row.
+	 */
+	static void blitSegments(const SegmentRefStore& segments, int pageSize, float defaultHeight, float* heightData, size_t stride);
 
 	/**
 	 * @brief Gets the segment positioned at the supplied position in local space.
@@ -136,6 +157,12 @@ public:
 	 */
 	TerrainPage& getPage();
 
+	/**
+	 * @brief Gets the cache through which segments and surfaces are populated.
+	 * @returns The cache, or null if populated segments aren't cached.
+	 */
+	SegmentCache* getSegmentCache() const;
+
 private:
 
 	/**
@@ -153,15 +180,35 @@ private:
 	 */
 	float mDefaultHeight;
 
+	/**
+	 * @brief The cache through which segments are populated, if any.
+	 */
+	SegmentCache* mSegmentCache;
 
 	/**
 	 * @brief Blits a Mercator::Segment heightmap to a larger ogre height map.
+	 * Any part of the segment outside of the page is skipped.
 	 * @param ogreHeightData The Ogre height data. This is guaranteed to be <page size> * <page size>.
+	 * @param stride The number of heights between the start of each row in the Ogre height data.
+	 * @param pageSize The size of the page, in heights along each side.
 	 * @param segment The segment to blit.
 	 * @param startX The starting x position in Ogre space.
 	 * @param startZ The starting y position in Ogre space.
 	 */
-	void blitSegmentToOgre(float* ogreHeightData, Mercator::Segment& segment, int startX, int startZ);
+	static void blitSegmentToOgre(float* ogreHeightData, size_t stride, int pageSize, const Mercator::Segment& segment, int startX, int startZ);
+
+	/**
+	 * @brief Sets a square area of an ogre height map to one height.
+	 * Any part of the area outside of the page is skipped.
+	 * @param ogreHeightData The Ogre height data.
+	 * @param stride The number of heights between the start of each row in the Ogre height data.
+	 * @param pageSize The size of the page, in heights along each side.
+	 * @param startX The starting x position in Ogre space.
+	 * @param startZ The starting y position in Ogre space.
+	 * @param width The width of the area, in heights.
+	 * @param height The height to set.
+	 */
+	static void fillOgreHeightData(float* ogreHeightData, size_t stride, int pageSize, int startX, int startZ, int width, float height);
 
 };
 }
@@ -29,11 +29,13 @@
 #include "TerrainPage.h"
 #include "TerrainPageGeometry.h"
 #include "OgreImage.h"
-#include "../Convert.h"
+#include "ShadowKernels.h"
 
-#include <OgreColourValue.h>
 #include <OgreImage.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace Ember
 {
 namespace OgreView
@@ -41,8 +43,16 @@ namespace OgreView
 namespace Terrain
 {
 
+namespace
+{
+/**
+ * @brief The angle, in radians, the azimuth of the sun can change before the horizon map is recalculated. About two degrees.
+ */
+const float MaxHorizonDeviation = 0.035f;
+}
+
 TerrainPageShadow::TerrainPageShadow(const TerrainPage& terrainPage) :
-		mTerrainPage(terrainPage), mLightDirection(WFMath::Vector<3>::ZERO()), mImage(nullptr)
+		mTerrainPage(terrainPage), mLightDirection(WFMath::Vector<3>::ZERO()), mImage(nullptr), mHeightsStride(0)
 {
 }
 
@@ -58,44 +68,77 @@ void TerrainPageShadow::setLightDirection(const WFMath::Vector<3>& lightDirectio
 
 void TerrainPageShadow::updateShadow(const TerrainPageGeometry& geometry)
 {
-	if (!mImage) {
-		mImage = new OgreImage(new Image::ImageBuffer(mTerrainPage.getBlendMapSize(), 1));
+	const int pageSize = mTerrainPage.getPageSize();
+	const int border = ShadowKernels::HorizonDistance;
+
+	//The Ogre height data is already laid out as the image, with the northernmost row first.
+	//Write it straight into the middle of the padded grid, and then pad it on all sides, so that the kernels never need to check bounds.
+	mHeightsStride = static_cast<size_t>(pageSize + (border * 2));
+	mHeights.resize(mHeightsStride * mHeightsStride);
+	const size_t pageOffset = (static_cast<size_t>(border) * mHeightsStride) + border;
+	geometry.updateOgreHeightData(mHeights.data() + pageOffset, mHeightsStride);
+
+	for (int row = 0; row < pageSize; ++row) {
+		float* rowPtr = mHeights.data() + pageOffset + (row * mHeightsStride);
+		std::fill(rowPtr - border, rowPtr, rowPtr[0]);
+		std::fill(rowPtr + pageSize, rowPtr + pageSize + border, rowPtr[pageSize - 1]);
+	}
+	const float* firstRow = mHeights.data() + (border * mHeightsStride);
+	const float* lastRow = firstRow + ((pageSize - 1) * mHeightsStride);
+	for (int row = 0; row < border; ++row) {
+		std::copy(firstRow, firstRow + mHeightsStride, mHeights.data() + (row * mHeightsStride));
+		std::copy(lastRow, lastRow + mHeightsStride, mHeights.data() + ((border + pageSize + row) * mHeightsStride));
 	}
-	mImage->reset();
-
-
-	int pageSizeInVertices = mTerrainPage.getPageSize();
-	int pageSizeInMeters = pageSizeInVertices - 1;
-
-	//since Ogre uses a different coord system than WF, we have to do some conversions here
-	TerrainPosition origPosition(0, pageSizeInMeters - 1);
-
-	WFMath::Vector<3> wfLightDirection = mLightDirection;
-	wfLightDirection = wfLightDirection.normalize(1);
 
-	TerrainPosition position(origPosition);
+	mHorizon.clear();
+	mShadedLightDirection = WFMath::Vector<3>();
+	updateLighting();
+}
 
-	auto data = mImage->getData();
+bool TerrainPageShadow::updateLighting()
+{
+	if (mHeights.empty()) {
+		return false;
+	}
+	if (mShadedLightDirection.isValid() && mShadedLightDirection == mLightDirection) {
+		return true;
+	}
 
-	for (int i = 0; i < pageSizeInMeters; ++i) {
-		position = origPosition;
-		position[1] = position[1] - i;
-		for (int j = 0; j < pageSizeInMeters; ++j) {
-			WFMath::Vector<3> normal;
-			if (geometry.getNormal(position, normal)) {
-				float dotProduct = WFMath::Dot(normal.normalize(1), wfLightDirection);
+	const unsigned int resolution = static_cast<unsigned int>(mTerrainPage.getBlendMapSize());
+	if (!mImage) {
+		mImage = new OgreImage(new Image::ImageBuffer(resolution, 1));
+	}
 
-				// if the dotProduct is > 0, the face is looking away from the sun
-				*data = static_cast<unsigned char>((1.0f - ((dotProduct + 1.0f) * 0.5f)) * 255);
+	//The kernels want the direction towards the sun in grid space, where the rows run towards decreasing terrain y (i.e. world z) and heights are along the third axis.
+	float sunDirection[3] = {0.0f, 0.0f, 1.0f};
+	if (mLightDirection.isValid() && mLightDirection.sqrMag() > 0.0f) {
+		WFMath::Vector<3> lightDirection(mLightDirection);
+		lightDirection.normalize();
+		sunDirection[0] = -lightDirection.x();
+		sunDirection[1] = lightDirection.z();
+		sunDirection[2] = -lightDirection.y();
+	}
 
-			} else {
-				*data = 0;
-			}
-			data++;
-			position[0] = position[0] + 1;
+	//Each texel is lit as the point at its south west corner, i.e. the points of the row after it in the height data.
+	const int border = ShadowKernels::HorizonDistance;
+	const float* heights = mHeights.data() + ((border + 1) * mHeightsStride) + border;
+
+	//When the sun is down, or right above, nothing can shadow anything else.
+	const float* horizon = nullptr;
+	float horizontalLength = std::sqrt((sunDirection[0] * sunDirection[0]) + (sunDirection[1] * sunDirection[1]));
+	if (sunDirection[2] > 0.0f && horizontalLength > 0.0001f) {
+		WFMath::Vector<2> horizonDirection(sunDirection[0] / horizontalLength, sunDirection[1] / horizontalLength);
+		if (mHorizon.empty() || WFMath::Dot(horizonDirection, mHorizonDirection) < std::cos(MaxHorizonDeviation)) {
+			mHorizon.resize(static_cast<size_t>(resolution) * resolution);
+			ShadowKernels::calculateHorizon(heights, mHeightsStride, resolution, resolution, horizonDirection.x(), horizonDirection.y(), mHorizon.data());
+			mHorizonDirection = horizonDirection;
 		}
+		horizon = mHorizon.data();
 	}
 
+	ShadowKernels::shade(heights, mHeightsStride, resolution, resolution, horizon, sunDirection, mImage->getData(), resolution);
+	mShadedLightDirection = mLightDirection;
+	return true;
 }
 
 void TerrainPageShadow::loadIntoImage(Ogre::Image& ogreImage) const
@@ -25,6 +25,7 @@
 #include "../EmberOgrePrerequisites.h"
 
 #include <memory>
+#include <vector>
 #include <wfmath/vector.h>
 #include <OgreMath.h>
 
@@ -44,6 +45,14 @@ class OgreImage;
 
 /**
 	@author Erik Ogenvik <erik@ogenvik.org>
+	@brief Precomputed lighting of a terrain page, used by techniques which can't light the terrain themselves.
+
+	The lighting takes both the slope of the terrain and the shadows it casts on itself into account. The shadows are found through a
+	horizon map, i.e. the steepest slope from each point towards the sun. See ShadowKernels.
+
+	The heights of the page are kept, so that a new light direction can be handled without touching the segments again. The horizon
+	map only depends on the azimuth of the sun, so it's kept as long as the azimuth doesn't change noticeably. Shadows are only cast
+	by the page itself; the heights outside of the page are assumed to be the same as those at its edge.
 */
 class TerrainPageShadow
 {
@@ -52,10 +61,30 @@ public:
 
 	virtual ~TerrainPageShadow();
 
+	/**
+	 * @brief Sets the direction of the light, i.e. the direction from the sun.
+	 *
+	 * This doesn't update the shadow; call updateLighting() or updateShadow() for that.
+	 * @param lightDirection The light direction, in world space (where y is up).
+	 */
 	void setLightDirection(const WFMath::Vector<3>& lightDirection);
 
+	/**
+	 * @brief Reads the heights of the page from the geometry and recalculates the whole shadow.
+	 *
+	 * The segments of the geometry must be populated.
+	 * @param geometry The geometry of the page.
+	 */
 	void updateShadow(const TerrainPageGeometry& geometry);
 
+	/**
+	 * @brief Recalculates the shadow for the current light direction, using the heights read by the last call to updateShadow().
+	 *
+	 * Nothing is done if the light direction hasn't changed since the last update.
+	 * @return False if the heights never have been read, in which case updateShadow() must be called instead.
+	 */
+	bool updateLighting();
+
 	void loadIntoImage(Ogre::Image& ogreImage) const;
 
 	/**
@@ -85,6 +114,33 @@ protected:
 
 	OgreImage* mImage;
 
+	/**
+	 * @brief The heights of the page, padded with the heights at its edges on all sides.
+	 */
+	std::vector<float> mHeights;
+
+	/**
+	 * @brief The number of heights in each row of mHeights.
+	 */
+	size_t mHeightsStride;
+
+	/**
+	 * @brief The horizon of each texel, in the direction of mHorizonDirection.
+	 *
+	 * Empty if it needs to be calculated.
+	 */
+	std::vector<float> mHorizon;
+
+	/**
+	 * @brief The direction, in grid space, for which mHorizon was calculated.
+	 */
+	WFMath::Vector<2> mHorizonDirection;
+
+	/**
+	 * @brief The light direction used for the image. Invalid if the image needs to be recalculated.
+	 */
+	WFMath::Vector<3> mShadedLightDirection;
+
 	/**
 	 * @brief An optional shadow texture name.
 	 *
@@ -109,14 +109,14 @@ const Ogre::MaterialPtr TerrainPageSurface::getCompositeMapMaterial() const
 	return mMaterialComposite;
 }
 
-TerrainPageSurfaceCompilationInstance* TerrainPageSurface::createSurfaceCompilationInstance(const TerrainPageGeometryPtr& geometry) const
+TerrainPageSurfaceCompilationInstance* TerrainPageSurface::createSurfaceCompilationInstance(const TerrainPageGeometryPtr& geometry, const AreaStore& dirtyAreas) const
 {
 	//The compiler only works with const surfaces, so we need to create such a copy of our surface map.
 	SurfaceLayerStore constLayers;
 	for (auto entry : mLayers) {
 		constLayers.insert(SurfaceLayerStore::value_type(entry.first, entry.second));
 	}
-	return mSurfaceCompiler->createCompilationInstance(geometry, constLayers, mShadow);
+	return mSurfaceCompiler->createCompilationInstance(geometry, constLayers, mShadow, dirtyAreas);
 }
 
 TerrainPageSurfaceLayer* TerrainPageSurface::createSurfaceLayer(const TerrainLayerDefinition& definition, int surfaceIndex, const Mercator::Shader& shader)
@@ -94,10 +94,13 @@ public:
 	const Ogre::MaterialPtr getCompositeMapMaterial() const;
 
 	/**
-	 * @brief Recompiles the material.
-	 * @param reselectTechnique If true, we'll also see if we need to reselect the technique to use.
+	 * @brief Creates a new instance for compiling the material.
+	 *
+	 * The surface keeps track of what its blend map textures hold, so that only the parts touched by the dirty areas need to be refilled and uploaded.
+	 * @param geometry The geometry of the page.
+	 * @param dirtyAreas The areas which have changed since the material last was compiled.
 	 */
-	TerrainPageSurfaceCompilationInstance* createSurfaceCompilationInstance(const TerrainPageGeometryPtr& geometry) const;
+	TerrainPageSurfaceCompilationInstance* createSurfaceCompilationInstance(const TerrainPageGeometryPtr& geometry, const AreaStore& dirtyAreas) const;
 
 	const TerrainPageSurfaceLayerStore& getLayers() const;
 
@@ -52,9 +52,9 @@ TerrainPageSurfaceCompiler::~TerrainPageSurfaceCompiler()
 	}
 }
 
-TerrainPageSurfaceCompilationInstance* TerrainPageSurfaceCompiler::createCompilationInstance(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, TerrainPageShadow* terrainPageShadow)
+TerrainPageSurfaceCompilationInstance* TerrainPageSurfaceCompiler::createCompilationInstance(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas)
 {
-	return new TerrainPageSurfaceCompilationInstance(mCompilerTechniqueProvider.createTechnique(geometry, terrainPageSurfaces, terrainPageShadow), mManagedTextures);
+	return new TerrainPageSurfaceCompilationInstance(mCompilerTechniqueProvider.createTechnique(geometry, terrainPageSurfaces, terrainPageShadow, dirtyAreas, mBlendMapContents), mManagedTextures);
 
 }
 
@@ -116,6 +116,11 @@ bool TerrainPageSurfaceCompilationInstance::requiresPregenShadow() const
 	return mTechnique->requiresPregenShadow();
 }
 
+size_t TerrainPageSurfaceCompilationInstance::getUploadedTextureBytes() const
+{
+	return mTechnique->getUploadedTextureBytes();
+}
+
 }
 }
 }
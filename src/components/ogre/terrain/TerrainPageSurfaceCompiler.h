@@ -100,6 +100,11 @@ public:
 	 */
 	virtual bool requiresPregenShadow() const = 0;
 
+	/**
+	 * @brief Gets the number of bytes of texture data which were uploaded when compiling the material.
+	 * @return A number of bytes.
+	 */
+	virtual size_t getUploadedTextureBytes() const = 0;
 
 };
 
@@ -158,6 +163,12 @@ public:
 	 */
 	virtual bool requiresPregenShadow() const;
 
+	/**
+	 * @brief Gets the number of bytes of texture data which were uploaded when compiling the material.
+	 * @return A number of bytes.
+	 */
+	size_t getUploadedTextureBytes() const;
+
 private:
 
 	/**
@@ -197,9 +208,10 @@ public:
      * @param geometry The geometry to operate on.
      * @param terrainPageSurfaces The surfaces to generate a rendering technique for.
      * @param terrainPageShadow An optional shadow.
+     * @param dirtyAreas The areas which have changed since the last compilation.
      * @return A compilation instance.
      */
-    TerrainPageSurfaceCompilationInstance* createCompilationInstance(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, TerrainPageShadow* terrainPageShadow);
+    TerrainPageSurfaceCompilationInstance* createCompilationInstance(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas);
 
 private:
 
@@ -213,6 +225,13 @@ private:
      */
     std::set<std::string> mManagedTextures;
 
+    /**
+     * @brief The layers which the blend map textures in mManagedTextures currently hold.
+     * This lets later compilations only fill and upload the parts of the blend maps which have changed.
+     * It's safe to access this both when preparing and compiling, since tasks for the same page are never run concurrently.
+     */
+    BlendMapContentStore mBlendMapContents;
+
     /**
      * @brief Selects and creates a new technique. The selection depends on hardware being used and features required.
      * @param geometry The geometry to operate on.
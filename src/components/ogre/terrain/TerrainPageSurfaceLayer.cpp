@@ -29,7 +29,9 @@
 #include "TerrainPageSurface.h"
 #include "TerrainLayerDefinition.h"
 #include "TerrainPageGeometry.h"
-#include "WFImage.h"
+#include "Image.h"
+#include "BlendMapKernels.h"
+#include "SegmentCache.h"
 #include <Mercator/Surface.h>
 #include <Mercator/Shader.h>
 
@@ -66,27 +68,32 @@ bool TerrainPageSurfaceLayer::intersects(const TerrainPageGeometry& geometry) co
 void TerrainPageSurfaceLayer::fillImage(const TerrainPageGeometry& geometry, Image& image, unsigned int channel) const
 {
 	SegmentVector validSegments = geometry.getValidSegments();
-	for (SegmentVector::const_iterator I = validSegments.begin(); I != validSegments.end(); ++I) {
-		Mercator::Segment* segment = I->segment;
-		if (mShader.checkIntersect(*segment)) {
-			Mercator::Surface* surface = getSurfaceForSegment(segment);
-			if (surface && surface->isValid()) {
-				WFImage sourceImage(new Image::ImageBuffer(segment->getResolution(), 1));
-				auto srcPtr = surface->getData();
-				auto dataPtr = sourceImage.getData();
-				auto segmentSize = segment->getSize();
-				for (int i = 0; i < segment->getResolution(); ++i) {
-					for (int j = 0; j < segment->getResolution(); ++j) {
-						//interpolate four samples to get the fragment coverage
-						*dataPtr = (unsigned char)((srcPtr[(i * segmentSize) + j] + srcPtr[(i * segmentSize) + j + 1] + srcPtr[((i + 1) * segmentSize) + j] + srcPtr[((i + 1) * segmentSize) + j + 1]) / 4);
-						dataPtr++;
-					}
-				}
+	for (const auto& pageSegment : validSegments) {
+		const unsigned char* coverage = getCoverage(pageSegment.segment);
+		if (coverage) {
+			BlendMapKernels::downsample(coverage, pageSegment.segment->getResolution(), getSegmentTexel(image, pageSegment) + channel, image.getChannels(), image.getResolution() * image.getChannels());
+		}
+	}
+}
 
-				image.blit(sourceImage, channel, ((int)I->index.x() * segment->getResolution()), ((mTerrainPageSurface.getNumberOfSegmentsPerAxis() - (int)I->index.y() - 1) * segment->getResolution()));
-			}
+const unsigned char* TerrainPageSurfaceLayer::getCoverage(Mercator::Segment* segment) const
+{
+	if (mShader.checkIntersect(*segment)) {
+		Mercator::Surface* surface = getSurfaceForSegment(segment);
+		if (surface && surface->isValid()) {
+			return surface->getData();
 		}
 	}
+	return nullptr;
+}
+
+unsigned char* TerrainPageSurfaceLayer::getSegmentTexel(Image& image, const PageSegment& pageSegment) const
+{
+	int resolution = pageSegment.segment->getResolution();
+	size_t x = static_cast<size_t>(pageSegment.index.x()) * resolution;
+	//The segments are indexed from the bottom, while the image rows are stored from the top.
+	size_t y = image.getResolution() - ((mTerrainPageSurface.getNumberOfSegmentsPerAxis() - static_cast<int>(pageSegment.index.y())) * resolution);
+	return image.getData() + (((y * image.getResolution()) + x) * image.getChannels());
 }
 
 unsigned int TerrainPageSurfaceLayer::getPixelWidth() const
@@ -153,6 +160,15 @@ const TerrainLayerDefinition& TerrainPageSurfaceLayer::getDefinition() const
 void TerrainPageSurfaceLayer::populate(const TerrainPageGeometry& geometry)
 {
 	const SegmentVector validSegments = geometry.getValidSegments();
+	SegmentCache* segmentCache = geometry.getSegmentCache();
+	auto& layers = mTerrainPageSurface.getLayers();
+	//The layer definitions are the same for all segments, so their keys are only created once.
+	std::map<int, std::uint64_t> shaderKeys;
+	if (segmentCache) {
+		for (auto& entry : layers) {
+			shaderKeys.emplace(entry.first, SegmentCache::createShaderKey(entry.second->getDefinition()));
+		}
+	}
 	for (const auto& validSegment : validSegments) {
 #if 0
 		//the current Mercator code works such that whenever an Area is added to Terrain, _all_ surfaces for the affected segments are invalidated, thus requiering a total repopulation of the segment
@@ -165,7 +181,11 @@ void TerrainPageSurfaceLayer::populate(const TerrainPageGeometry& geometry)
 
 		Mercator::Segment* segment(validSegment.segment);
 		if (!segment->isValid()) {
-			segment->populate();
+			if (segmentCache) {
+				segmentCache->populate(*segment);
+			} else {
+				segment->populate();
+			}
 		}
 
 		auto I2(segment->getSurfaces().find(mSurfaceIndex));
@@ -178,7 +198,21 @@ void TerrainPageSurfaceLayer::populate(const TerrainPageGeometry& geometry)
 			}
 		}
 		//NOTE: we have to repopulate all surfaces mainly to get the foliage to work.
-		segment->populateSurfaces();
+		if (segmentCache) {
+			//Surfaces of layers are read from the cache, as we know their definitions. Any other surfaces are always populated.
+			std::map<int, std::uint64_t> segmentShaderKeys;
+			for (auto& entry : segment->getSurfaces()) {
+				auto layerI = layers.find(entry.first);
+				if (layerI == layers.end()) {
+					entry.second->populate();
+				} else if (layerI->second->mShader.checkIntersect(*segment)) {
+					segmentShaderKeys.emplace(entry.first, shaderKeys[entry.first]);
+				}
+			}
+			segmentCache->populateSurfaces(*segment, segmentShaderKeys);
+		} else {
+			segment->populateSurfaces();
+		}
 #endif
 	}
 }
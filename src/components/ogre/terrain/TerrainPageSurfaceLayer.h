@@ -35,6 +35,7 @@ class Segment;
 namespace Ogre
 {
 class Image;
+struct PageSegment;
 }
 
 
@@ -47,6 +48,7 @@ class TerrainPageSurface;
 class TerrainLayerDefinition;
 class TerrainPageGeometry;
 class Image;
+struct PageSegment;
 
 /**
  * Represents a layer of the terrain surface. The layer can either apply to a certain terrain page or not, depending on the
@@ -88,8 +90,29 @@ public:
 
 	void populate(const TerrainPageGeometry& geometry);
 
+	/**
+	 * @brief Fills one channel of a blend map image with the coverage of the layer.
+	 * @param geometry The geometry of the page.
+	 * @param image The blend map image, with rows stored top to bottom.
+	 * @param channel The channel to fill.
+	 */
 	void fillImage(const TerrainPageGeometry& geometry, Image& image, unsigned int channel) const;
 
+	/**
+	 * @brief Gets the coverage of the layer for a segment of the page.
+	 * @param segment A segment of the page.
+	 * @return The coverage, with one value per point of the segment, or null if the layer doesn't cover the segment.
+	 */
+	const unsigned char* getCoverage(Mercator::Segment* segment) const;
+
+	/**
+	 * @brief Gets the first texel of a segment of the page in a blend map image.
+	 * @param image The blend map image, with rows stored top to bottom.
+	 * @param pageSegment A segment of the page.
+	 * @return The first channel of the top left texel of the segment.
+	 */
+	unsigned char* getSegmentTexel(Image& image, const PageSegment& pageSegment) const;
+
 
 protected:
 	TerrainPageSurface& mTerrainPageSurface;
@@ -22,6 +22,7 @@
 #include "TerrainPageSurface.h"
 #include "TerrainMaterialCompilationTask.h"
 #include "framework/tasks/TaskExecutionContext.h"
+#include "framework/tasks/TaskGraph.h"
 
 #include <wfmath/intersect.h>
 
@@ -33,6 +34,30 @@ namespace OgreView
 namespace Terrain
 {
 
+/**
+ * @brief Updates the surfaces of the shaders for a single page.
+ */
+class PageShaderUpdateTask : public Tasks::TemplateNamedTask<PageShaderUpdateTask>
+{
+public:
+	PageShaderUpdateTask(TerrainPageGeometryPtr geometry, const std::vector<const TerrainShader*>& shaders) :
+			mGeometry(std::move(geometry)), mShaders(shaders)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		for (auto shader : mShaders) {
+			mGeometry->getPage().updateShaderTexture(shader, *mGeometry, true);
+		}
+		mGeometry.reset();
+	}
+
+private:
+	TerrainPageGeometryPtr mGeometry;
+	const std::vector<const TerrainShader*> mShaders;
+};
+
 TerrainShaderUpdateTask::TerrainShaderUpdateTask(const GeometryPtrVector& geometry, const TerrainShader* shader, const AreaStore& areas, sigc::signal<void, const TerrainShader*, const AreaStore&>& signal, sigc::signal<void, TerrainPage*>& signalMaterialRecompiled, const WFMath::Vector<3>& lightDirection) :
 	mGeometry(geometry), mAreas(areas), mSignal(signal), mSignalMaterialRecompiled(signalMaterialRecompiled), mLightDirection(lightDirection)
 {
@@ -60,15 +85,27 @@ void TerrainShaderUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecution
 			}
 		}
 		if (shouldUpdate) {
-			for (std::vector<const TerrainShader*>::const_iterator I = mShaders.begin(); I != mShaders.end(); ++I) {
+			updatedPages.push_back(geometry);
+		}
+	}
+
+	//The pages are independent of each other, so let other executors help out when there are many of them.
+	if (updatedPages.size() > 1) {
+		Tasks::TaskGraph graph;
+		for (auto& geometry : updatedPages) {
+			graph.addTask(new PageShaderUpdateTask(geometry, mShaders));
+		}
+		context.executeTaskGraph(graph);
+	} else {
+		for (auto& geometry : updatedPages) {
+			for (auto shader : mShaders) {
 				//repopulate the layer
-				page.updateShaderTexture(*I, *geometry, true);
+				geometry->getPage().updateShaderTexture(shader, *geometry, true);
 			}
-			updatedPages.push_back(geometry);
 		}
 	}
 
-	context.executeTask(new TerrainMaterialCompilationTask(updatedPages, mSignalMaterialRecompiled, mLightDirection));
+	context.executeTask(new TerrainMaterialCompilationTask(updatedPages, mAreas, mSignalMaterialRecompiled, mLightDirection));
 	//Release Segment references as soon as we can
 	mGeometry.clear();
 }
@@ -0,0 +1,184 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "TerrainTaskScheduler.h"
+
+#include "framework/tasks/ITask.h"
+#include "framework/tasks/TaskQueue.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace Ember
+{
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+class TerrainTaskScheduler::ScheduledTask : public Tasks::ITask
+{
+public:
+	ScheduledTask(TerrainTaskScheduler& scheduler, Tasks::ITask* task, std::vector<TerrainIndex> pages, bool isTerrainTask) :
+			mScheduler(scheduler), mTask(task), mPages(std::move(pages)), mIsTerrainTask(isTerrainTask)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		mTask->executeTaskInBackgroundThread(context);
+	}
+
+	bool executeTaskInMainThread() override
+	{
+		bool completed;
+		try {
+			completed = mTask->executeTaskInMainThread();
+		} catch (...) {
+			//The task queue will discard the task, so make sure its pages aren't held up forever.
+			mScheduler.taskCompleted(mPages, mIsTerrainTask);
+			throw;
+		}
+		if (completed) {
+			mScheduler.taskCompleted(mPages, mIsTerrainTask);
+		}
+		return completed;
+	}
+
+	float getPriority() const override
+	{
+		return mTask->getPriority();
+	}
+
+	std::string getName() const override
+	{
+		return mTask->getName();
+	}
+
+	TerrainTaskScheduler& mScheduler;
+	std::unique_ptr<Tasks::ITask> mTask;
+	const std::vector<TerrainIndex> mPages;
+	const bool mIsTerrainTask;
+};
+
+TerrainTaskScheduler::TerrainTaskScheduler(Tasks::TaskQueue& taskQueue) :
+		mTaskQueue(taskQueue), mRunningTaskCount(0), mIsTerrainTaskRunning(false)
+{
+}
+
+TerrainTaskScheduler::~TerrainTaskScheduler()
+{
+	for (auto task : mWaitingTasks) {
+		delete task;
+	}
+}
+
+bool TerrainTaskScheduler::enqueuePageTask(Tasks::ITask* task, std::vector<TerrainIndex> pages)
+{
+	return enqueue(new ScheduledTask(*this, task, std::move(pages), false));
+}
+
+bool TerrainTaskScheduler::enqueueTerrainTask(Tasks::ITask* task)
+{
+	return enqueue(new ScheduledTask(*this, task, std::vector<TerrainIndex>(), true));
+}
+
+bool TerrainTaskScheduler::enqueue(ScheduledTask* task)
+{
+	if (!mTaskQueue.isActive()) {
+		delete task;
+		return false;
+	}
+	mWaitingTasks.push_back(task);
+	dispatchWaitingTasks();
+	return true;
+}
+
+size_t TerrainTaskScheduler::getUncompletedTaskCount() const
+{
+	return mWaitingTasks.size() + mRunningTaskCount;
+}
+
+void TerrainTaskScheduler::dispatchWaitingTasks()
+{
+	if (!mTaskQueue.isActive()) {
+		//The queue is shutting down, so the waiting tasks will never be executed.
+		for (auto task : mWaitingTasks) {
+			delete task;
+		}
+		mWaitingTasks.clear();
+		return;
+	}
+
+	//Pages which are either busy, or touched by a task which is waiting and therefore must go before any later task on the same page.
+	std::set<TerrainIndex> blockedPages(mBusyPages);
+	bool isEverythingBlocked = mIsTerrainTaskRunning;
+
+	for (auto I = mWaitingTasks.begin(); I != mWaitingTasks.end() && !isEverythingBlocked;) {
+		ScheduledTask* task = *I;
+		bool canRun;
+		if (task->mIsTerrainTask) {
+			canRun = mRunningTaskCount == 0 && I == mWaitingTasks.begin();
+		} else {
+			canRun = std::none_of(task->mPages.begin(), task->mPages.end(), [&](const TerrainIndex& page) { return blockedPages.count(page) != 0; });
+		}
+
+		if (task->mIsTerrainTask) {
+			isEverythingBlocked = true;
+		} else {
+			blockedPages.insert(task->mPages.begin(), task->mPages.end());
+		}
+
+		if (canRun) {
+			I = mWaitingTasks.erase(I);
+			mRunningTaskCount++;
+			if (task->mIsTerrainTask) {
+				mIsTerrainTaskRunning = true;
+			} else {
+				mBusyPages.insert(task->mPages.begin(), task->mPages.end());
+			}
+			//The pages must be copied, since the task is deleted if it can't be enqueued.
+			auto pages = task->mPages;
+			bool isTerrainTask = task->mIsTerrainTask;
+			if (!mTaskQueue.enqueueTask(task)) {
+				taskCompleted(pages, isTerrainTask);
+				return;
+			}
+		} else {
+			++I;
+		}
+	}
+}
+
+void TerrainTaskScheduler::taskCompleted(const std::vector<TerrainIndex>& pages, bool isTerrainTask)
+{
+	mRunningTaskCount--;
+	if (isTerrainTask) {
+		mIsTerrainTaskRunning = false;
+	} else {
+		for (auto& page : pages) {
+			mBusyPages.erase(page);
+		}
+	}
+	dispatchWaitingTasks();
+}
+
+}
+}
+}
@@ -0,0 +1,144 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef TERRAINTASKSCHEDULER_H_
+#define TERRAINTASKSCHEDULER_H_
+
+#include "domain/Types.h"
+
+#include <list>
+#include <set>
+#include <vector>
+#include <cstddef>
+
+namespace Ember
+{
+namespace Tasks
+{
+class ITask;
+class TaskQueue;
+}
+namespace OgreView
+{
+
+namespace Terrain
+{
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Schedules terrain tasks on a task queue, letting tasks which touch different pages run concurrently.
+ *
+ * Each task is enqueued together with the pages it touches. A task is only put on the task queue when no task which was enqueued
+ * before it, and which is either still waiting or running, touches any of the same pages. Tasks on the same page are thus executed
+ * (including their main thread parts) in the order they were enqueued, so that the geometry of a page always is updated before its
+ * surface is compiled, while tasks on other pages are free to run on other executors.
+ *
+ * Tasks which alter the terrain as a whole (such as changing base points, mods or areas) are instead enqueued as "terrain tasks".
+ * These are run in isolation, waiting for all earlier tasks to complete and holding up all later tasks until they are done.
+ * A page task without any pages only waits for terrain tasks; use that for tasks which just read from the terrain.
+ *
+ * All methods must be called from the main thread.
+ */
+class TerrainTaskScheduler
+{
+public:
+
+	/**
+	 * @brief Ctor.
+	 * @param taskQueue The task queue on which tasks are executed.
+	 */
+	explicit TerrainTaskScheduler(Tasks::TaskQueue& taskQueue);
+
+	/**
+	 * @brief Dtor.
+	 * Any tasks still waiting are deleted without being executed.
+	 */
+	~TerrainTaskScheduler();
+
+	/**
+	 * @brief Enqueues a task which only touches the specified pages.
+	 * Ownership of the task is transferred to the scheduler.
+	 * @param task The task.
+	 * @param pages The indices of the pages the task touches.
+	 * @return False if the task queue isn't active, in which case the task has been deleted.
+	 */
+	bool enqueuePageTask(Tasks::ITask* task, std::vector<TerrainIndex> pages);
+
+	/**
+	 * @brief Enqueues a task which alters the terrain as a whole, and therefore must run in isolation.
+	 * Ownership of the task is transferred to the scheduler.
+	 * @param task The task.
+	 * @return False if the task queue isn't active, in which case the task has been deleted.
+	 */
+	bool enqueueTerrainTask(Tasks::ITask* task);
+
+	/**
+	 * @brief Gets the number of tasks which either are waiting or have been put on the task queue but not yet completed.
+	 * @return The number of uncompleted tasks.
+	 */
+	size_t getUncompletedTaskCount() const;
+
+private:
+
+	/**
+	 * @brief Wraps a scheduled task, notifying the scheduler when it's completed.
+	 */
+	class ScheduledTask;
+
+	Tasks::TaskQueue& mTaskQueue;
+
+	/**
+	 * @brief Tasks which are waiting for earlier tasks touching the same pages, in the order they were enqueued.
+	 */
+	std::list<ScheduledTask*> mWaitingTasks;
+
+	/**
+	 * @brief Pages which are touched by tasks on the task queue.
+	 */
+	std::set<TerrainIndex> mBusyPages;
+
+	/**
+	 * @brief The number of tasks on the task queue.
+	 */
+	size_t mRunningTaskCount;
+
+	/**
+	 * @brief True if the task on the task queue is a terrain task.
+	 */
+	bool mIsTerrainTaskRunning;
+
+	bool enqueue(ScheduledTask* task);
+
+	/**
+	 * @brief Puts all waiting tasks which don't conflict with any earlier task on the task queue.
+	 */
+	void dispatchWaitingTasks();
+
+	/**
+	 * @brief Called when a task on the task queue has completed, releasing its pages.
+	 * @param pages The pages touched by the task.
+	 * @param isTerrainTask True if the task was a terrain task.
+	 */
+	void taskCompleted(const std::vector<TerrainIndex>& pages, bool isTerrainTask);
+};
+
+}
+}
+}
+
+#endif /* TERRAINTASKSCHEDULER_H_ */
@@ -65,6 +65,11 @@ void TerrainUpdateTask::executeTaskInBackgroundThread(Tasks::TaskExecutionContex
 		mUpdatedPositions.push_back(TerrainPosition(pos.x() * terrainRes, pos.y() * terrainRes));
 	}
 	mSegmentManager.syncWithTerrain();
+	//Each base point affects the segments on all sides of it.
+	const WFMath::Vector<2> extent(terrainRes, terrainRes);
+	for (auto& position : mUpdatedPositions) {
+		mSegmentManager.remeasureSegments(WFMath::AxisBox<2>(position - extent, position + extent));
+	}
 }
 
 bool TerrainUpdateTask::executeTaskInMainThread() {
@@ -117,6 +117,11 @@ namespace OgreView {
 
 		typedef std::map<int, const TerrainPageSurfaceLayer*> SurfaceLayerStore;
 
+		/**
+		 * @brief The surface indices of the layers which each blend map texture of a page was last filled with, in channel order, keyed by texture name.
+		 */
+		typedef std::map<std::string, std::vector<int>> BlendMapContentStore;
+
 		typedef std::unordered_map<std::string, Mercator::Area*> AreaMap;
 
 		typedef std::map<const Mercator::Shader*, const TerrainShader*> ShaderStore;
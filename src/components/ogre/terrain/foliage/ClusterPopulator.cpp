@@ -19,6 +19,15 @@
 #include <Mercator/Segment.h>
 #include <Mercator/Surface.h>
 #include <Mercator/Shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace Ember
 {
 namespace OgreView
@@ -30,6 +39,30 @@ namespace Terrain
 namespace Foliage
 {
 
+namespace
+{
+/**
+ * @brief Subtracts the coverage of a layer from another, clamping at zero.
+ * @param coverage The coverage to subtract from.
+ * @param other The coverage to subtract.
+ * @param size The number of values.
+ */
+void subtractCoverage(unsigned char* coverage, const unsigned char* other, size_t size)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(coverage + i), _mm_subs_epu8(a, b));
+	}
+#endif
+	for (; i < size; ++i) {
+		coverage[i] -= std::min<unsigned char>(other[i], coverage[i]);
+	}
+}
+}
+
 ClusterPopulator::ClusterPopulator(unsigned int layerIndex, IScaler* scaler, size_t plantIndex) :
 	PlantPopulator(layerIndex, scaler, plantIndex),
 	mMinClusterRadius(1.0f),
@@ -42,79 +75,114 @@ ClusterPopulator::ClusterPopulator(unsigned int layerIndex, IScaler* scaler, siz
 }
 
 void ClusterPopulator::populate(PlantAreaQueryResult& result, SegmentRefPtr segmentRef)
+{
+	populateBatch({&result}, std::move(segmentRef));
+}
+
+void ClusterPopulator::populateBatch(const std::vector<PlantAreaQueryResult*>& results, SegmentRefPtr segmentRef)
 {
 	Mercator::Segment& mercatorSegment = segmentRef->getMercatorSegment();
 	if (!mercatorSegment.isValid()) {
 		mercatorSegment.populate();
 	}
 
-	const PlantAreaQuery& query = result.getQuery();
+	Buffer<unsigned char> combinedCoverage(static_cast<unsigned int>(mercatorSegment.getSize()), 1);
+	//Check that there actually is a valid surface on which the plants can be placed
+	if (!combineCoverage(mercatorSegment, combinedCoverage)) {
+		return;
+	}
 
-	const WFMath::AxisBox<2>& area = Convert::toWF(query.getArea());
+	ClusterStore clusters;
+	for (auto result : results) {
+		const WFMath::AxisBox<2>& area = Convert::toWF(result->getQuery().getArea());
+		clusters.clear();
+		getClustersForArea(mercatorSegment, area, clusters);
+		populateWithClusters(mercatorSegment, *result, area, clusters, combinedCoverage);
+	}
+}
 
-	//Make a small list of surfaces in order
-	std::list<int> indexSort;
-	for (Mercator::Segment::Surfacestore::const_iterator I = mercatorSegment.getSurfaces().begin(); I != mercatorSegment.getSurfaces().end(); ++I) {
-		if (I->first >= mLayerIndex) {
-			if (I->second->m_shader.checkIntersect(mercatorSegment)) {
-				if (!I->second->isValid()) {
-					I->second->populate();
+bool ClusterPopulator::combineCoverage(Mercator::Segment& mercatorSegment, Buffer<unsigned char>& combinedCoverage)
+{
+	//The surfaces are sorted by their index, so the first one found must be our layer.
+	std::vector<Mercator::Surface*> surfaces;
+	for (auto& entry : mercatorSegment.getSurfaces()) {
+		if (entry.first >= mLayerIndex) {
+			if (entry.second->m_shader.checkIntersect(mercatorSegment)) {
+				if (surfaces.empty() && entry.first != mLayerIndex) {
+					return false;
 				}
-				indexSort.push_back(I->first);
+				if (!entry.second->isValid()) {
+					entry.second->populate();
+				}
+				surfaces.push_back(entry.second);
 			}
 		}
 	}
 
-	indexSort.sort();
-	//Check that there actually is a valid surface on which the plants can be placed
-	if (!indexSort.empty() && indexSort.front() == mLayerIndex) {
-		Buffer<unsigned char> combinedCoverage(static_cast<unsigned int>(mercatorSegment.getSize()), 1);
-		unsigned char* combinedCoverageData = combinedCoverage.getData();
-		size_t size = combinedCoverage.getSize();
-		//The first layer should be copied just as it is
-		std::list<int>::const_iterator I = indexSort.begin();
-		{
-			Mercator::Surface* surface = mercatorSegment.getSurfaces()[*I];
-			memcpy(combinedCoverageData, surface->getData(), combinedCoverage.getSize());
-		}
-		++I;
-		for (; I != indexSort.end(); ++I) {
-			Mercator::Surface* surface = mercatorSegment.getSurfaces()[*I];
-			unsigned char* surfaceData = surface->getData();
-			for (size_t i = 0; i < size; ++i) {
-				combinedCoverageData[i] -= std::min<unsigned char>(surfaceData[i], combinedCoverageData[i]);
-			}
-		}
+	if (surfaces.empty()) {
+		return false;
+	}
 
-		ClusterStore store;
-		getClustersForArea(segmentRef, area, store);
-		populateWithClusters(segmentRef, result, area, store, combinedCoverage);
+	unsigned char* combinedCoverageData = combinedCoverage.getData();
+	size_t size = combinedCoverage.getSize();
+	//The first layer should be copied just as it is, and any layers above it hide it.
+	memcpy(combinedCoverageData, surfaces.front()->getData(), size);
+	for (size_t i = 1; i < surfaces.size(); ++i) {
+		subtractCoverage(combinedCoverageData, surfaces[i]->getData(), size);
 	}
+	return true;
 }
 
-void ClusterPopulator::getClustersForArea(const SegmentRefPtr& segmentRef, const WFMath::AxisBox<2>& area, ClusterStore& store)
+std::shared_ptr<const ClusterStore> ClusterPopulator::getClustersForSegment(int segmentX, int segmentZ, int resolution)
 {
-	//Generate clusters for the current page and all surrounding pages and check if any of these are contained or intersect our local area
+	auto key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(segmentX)) << 32) | static_cast<std::uint32_t>(segmentZ);
+	{
+		std::lock_guard<std::mutex> lock(mClusterCacheMutex);
+		auto I = mClusterCache.find(key);
+		if (I != mClusterCache.end()) {
+			return I->second;
+		}
+	}
 
-	Mercator::Segment& mercatorSegment = segmentRef->getMercatorSegment();
-	int res = mercatorSegment.getResolution();
-	auto clustersPerSegment = static_cast<int>((res * res) / (mClusterDistance * mClusterDistance));
+	//Generate the clusters without holding the lock. Should another thread do the same at the same time the result is identical anyway.
+	auto clustersPerSegment = static_cast<int>((resolution * resolution) / (mClusterDistance * mClusterDistance));
 	float clusterRadiusRange = mMaxClusterRadius - mMinClusterRadius;
-	float xRef = mercatorSegment.getXRef();
-	float zRef = mercatorSegment.getZRef();
+	auto clusters = std::make_shared<ClusterStore>();
+	clusters->reserve(static_cast<size_t>(std::max(0, clustersPerSegment)));
+
+	WFMath::MTRand::uint32 seed(static_cast<WFMath::MTRand::uint32>(mPlantIndex + (static_cast<WFMath::MTRand::uint32> (segmentX) << 4) + (static_cast<WFMath::MTRand::uint32> (segmentZ) << 8)));
+	WFMath::MTRand rng(seed);
+	for (int k = 0; k < clustersPerSegment; ++k) {
+		clusters->emplace_back(WFMath::Point<2>((rng.rand<float>() * resolution) + segmentX,
+												(rng.rand<float>() * resolution) + segmentZ),
+							   (rng.rand<float>() * clusterRadiusRange) + mMinClusterRadius);
+	}
+
+	std::lock_guard<std::mutex> lock(mClusterCacheMutex);
+	if (mClusterCache.size() >= MaxCachedSegments) {
+		mClusterCache.clear();
+	}
+	mClusterCache.emplace(key, clusters);
+	return clusters;
+}
+
+void ClusterPopulator::clearClusterCache()
+{
+	std::lock_guard<std::mutex> lock(mClusterCacheMutex);
+	mClusterCache.clear();
+}
 
-	WFMath::MTRand rng;
+void ClusterPopulator::getClustersForArea(const Mercator::Segment& mercatorSegment, const WFMath::AxisBox<2>& area, ClusterStore& store)
+{
+	//Get the clusters for the current segment and all surrounding segments and check if any of these are contained or intersect our local area
+	int res = mercatorSegment.getResolution();
+	int xRef = mercatorSegment.getXRef();
+	int zRef = mercatorSegment.getZRef();
 
 	for (int i = -1; i < 2; ++i) {
 		for (int j = -1; j < 2; ++j) {
-			auto currentSegmentX = static_cast<int>(xRef + (i * res));
-			auto currentSegmentZ = static_cast<int>(zRef + (j * res));
-			WFMath::MTRand::uint32 seed(static_cast<WFMath::MTRand::uint32>(mPlantIndex + (static_cast<WFMath::MTRand::uint32> (currentSegmentX) << 4) + (static_cast<WFMath::MTRand::uint32> (currentSegmentZ) << 8)));
-			rng.seed(seed);
-			for (int k = 0; k < clustersPerSegment; ++k) {
-				WFMath::Ball<2> cluster(WFMath::Point<2>((rng.rand<float>() * res) + currentSegmentX,
-														 (rng.rand<float>() * res) + currentSegmentZ),
-										(rng.rand<float>() * clusterRadiusRange) + mMinClusterRadius);
+			auto clusters = getClustersForSegment(xRef + (i * res), zRef + (j * res), res);
+			for (auto& cluster : *clusters) {
 				if (WFMath::Contains(area, cluster.center(), true) || WFMath::Intersect(area, cluster, true)) {
 					store.push_back(cluster);
 				}
@@ -123,18 +191,17 @@ void ClusterPopulator::getClustersForArea(const SegmentRefPtr& segmentRef, const
 	}
 }
 
-void ClusterPopulator::populateWithClusters(const SegmentRefPtr& segmentRef, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const ClusterStore& clusters, const Buffer<unsigned char>& combinedCoverage)
+void ClusterPopulator::populateWithClusters(Mercator::Segment& mercatorSegment, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const ClusterStore& clusters, const Buffer<unsigned char>& combinedCoverage)
 {
 	for (const auto& cluster : clusters) {
-		populateWithCluster(segmentRef, result, area, cluster, combinedCoverage);
+		populateWithCluster(mercatorSegment, result, area, cluster, combinedCoverage);
 	}
 
 }
 
-void ClusterPopulator::populateWithCluster(const SegmentRefPtr& segmentRef, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const WFMath::Ball<2>& cluster, const Buffer<unsigned char>& combinedCoverage)
+void ClusterPopulator::populateWithCluster(Mercator::Segment& mercatorSegment, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const WFMath::Ball<2>& cluster, const Buffer<unsigned char>& combinedCoverage)
 {
 	PlantAreaQueryResult::PlantStore& plants = result.getStore();
-	Mercator::Segment& mercatorSegment = segmentRef->getMercatorSegment();
 
 	float volume = (cluster.radius() * cluster.radius()) * WFMath::numeric_constants<WFMath::CoordType>::pi();
 	auto instancesInEachCluster = static_cast<unsigned int>(volume * mDensity);
@@ -143,11 +210,10 @@ void ClusterPopulator::populateWithCluster(const SegmentRefPtr& segmentRef, Plan
 
 	unsigned int res = combinedCoverage.getResolution();
 	const unsigned char* data = combinedCoverage.getData();
+	const float xRef = mercatorSegment.getXRef();
+	const float zRef = mercatorSegment.getZRef();
 
-	float height = 0;
-	WFMath::Vector<3> normal;
-	//place one cluster
-	for (unsigned int j = 0; j < instancesInEachCluster; ++j) {
+	for (unsigned int i = 0; i < instancesInEachCluster; ++i) {
 		auto theta = rng.rand<float>() * WFMath::numeric_constants<WFMath::CoordType>::pi() * 2;
 		auto length = rng.rand<float>() * mMaxClusterRadius;
 
@@ -158,10 +224,14 @@ void ClusterPopulator::populateWithCluster(const SegmentRefPtr& segmentRef, Plan
 		mScaler->scale(rng, pos, scale);
 
 		if (WFMath::Contains(area, pos, true)) {
-			WFMath::Point<2> localPos(pos.x() - mercatorSegment.getXRef(), pos.y() - mercatorSegment.getZRef());
-			if (data[((unsigned int)localPos.y() * res) + ((unsigned int)localPos.x())] >= mThreshold) {
-				mercatorSegment.getHeightAndNormal(localPos.x(), localPos.y(), height, normal);
-				plants.emplace_back(Ogre::Vector3(pos.x(), height, pos.y()), rotation, scale);
+			float x = pos.x() - xRef;
+			float z = pos.y() - zRef;
+			if (data[((unsigned int)z * res) + ((unsigned int)x)] >= mThreshold) {
+				plants.positionX.push_back(pos.x());
+				plants.positionZ.push_back(pos.y());
+				plants.orientation.push_back(static_cast<float>(rotation));
+				plants.scaleX.push_back(scale.x);
+				plants.scaleY.push_back(scale.y);
 			}
 		}
 	}
@@ -175,6 +245,7 @@ float ClusterPopulator::getMinClusterRadius() const
 void ClusterPopulator::setMinClusterRadius(float theValue)
 {
 	mMinClusterRadius = theValue;
+	clearClusterCache();
 }
 
 float ClusterPopulator::getMaxClusterRadius() const
@@ -185,6 +256,7 @@ float ClusterPopulator::getMaxClusterRadius() const
 void ClusterPopulator::setMaxClusterRadius(float theValue)
 {
 	mMaxClusterRadius = theValue;
+	clearClusterCache();
 }
 
 float ClusterPopulator::getDensity() const
@@ -215,6 +287,7 @@ float ClusterPopulator::getClusterDistance() const
 void ClusterPopulator::setClusterDistance(float theValue)
 {
 	mClusterDistance = theValue;
+	clearClusterCache();
 }
 
 void ClusterPopulator::setThreshold(unsigned char theValue)
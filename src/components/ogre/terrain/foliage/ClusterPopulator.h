@@ -10,9 +10,18 @@
 
 #include "PlantPopulator.h"
 
-namespace WFMath
+#include <wfmath/ball.h>
+#include <wfmath/axisbox.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Mercator
 {
-	template<int> class Ball;
+class Segment;
 }
 
 namespace Ember
@@ -30,6 +39,14 @@ namespace Foliage
 
 typedef std::vector<WFMath::Ball<2>> ClusterStore;
 
+/**
+ * @brief Places plants in randomly generated clusters, on the parts of a segment where its layer is visible.
+ *
+ * The clusters of each segment are generated from a seed based on the segment position, so they never change. They are therefore
+ * cached per segment, as each query needs the clusters of the segment it's in as well as all neighbouring segments.
+ *
+ * The plants are filtered against the query area and coverage, and written as a structure of arrays.
+ */
 class ClusterPopulator : public PlantPopulator
 {
 public:
@@ -39,6 +56,13 @@ public:
 
 	void populate(PlantAreaQueryResult& result, SegmentRefPtr segmentRef) override;
 
+	/**
+	 * @brief Populates a batch of queries, sharing the combined coverage and the clusters between them.
+	 * @param results The results to populate.
+	 * @param segmentRef The segment in which all queries are.
+	 */
+	void populateBatch(const std::vector<PlantAreaQueryResult*>& results, SegmentRefPtr segmentRef) override;
+
 	void setMinClusterRadius(float theValue);
 	float getMinClusterRadius() const;
 
@@ -58,16 +82,54 @@ public:
 	float getTreshold() const;
 protected:
 
-	void getClustersForArea(const SegmentRefPtr& segmentRef, const WFMath::AxisBox<2>& area, ClusterStore& clusters);
+	/**
+	 * @brief The maximum number of segments for which clusters are cached. When exceeded the cache is cleared.
+	 */
+	static const size_t MaxCachedSegments = 1024;
+
+	/**
+	 * @brief Combines the coverage of our layer with all layers above it, which hide it.
+	 * @param mercatorSegment The segment.
+	 * @param combinedCoverage The combined coverage will be written here.
+	 * @return False if our layer isn't present in the segment, in which case there's nothing to place plants on.
+	 */
+	bool combineCoverage(Mercator::Segment& mercatorSegment, Buffer<unsigned char>& combinedCoverage);
+
+	/**
+	 * @brief Gets the clusters of a segment, from the cache if possible.
+	 * @param segmentX The x position of the segment, in world units.
+	 * @param segmentZ The z position of the segment, in world units.
+	 * @param resolution The resolution of the segment.
+	 * @return All clusters of the segment.
+	 */
+	std::shared_ptr<const ClusterStore> getClustersForSegment(int segmentX, int segmentZ, int resolution);
+
+	void getClustersForArea(const Mercator::Segment& mercatorSegment, const WFMath::AxisBox<2>& area, ClusterStore& clusters);
+
+	void populateWithClusters(Mercator::Segment& mercatorSegment, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const ClusterStore& clusters, const Buffer<unsigned char>& combinedCoverage);
+	void populateWithCluster(Mercator::Segment& mercatorSegment, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const WFMath::Ball<2>& cluster, const Buffer<unsigned char>& combinedCoverage);
+
+	/**
+	 * @brief Clears the cached clusters. Must be called whenever a setting which affects the clusters is changed.
+	 */
+	void clearClusterCache();
 
-	void populateWithClusters(const SegmentRefPtr& segmentRef, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const ClusterStore& clusters, const Buffer<unsigned char>& combinedCoverage);
-	void populateWithCluster(const SegmentRefPtr& segmentRef, PlantAreaQueryResult& result, const WFMath::AxisBox<2>& area, const WFMath::Ball<2>& cluster, const Buffer<unsigned char>& combinedCoverage);
 	float mMinClusterRadius;
 	float mMaxClusterRadius;
 	float mClusterDistance;
 	float mDensity;
 	float mFalloff;
 	unsigned char mThreshold;
+
+	/**
+	 * @brief All clusters of the segments queried so far, keyed by the packed position of the segment.
+	 */
+	std::unordered_map<std::uint64_t, std::shared_ptr<const ClusterStore>> mClusterCache;
+
+	/**
+	 * @brief Guards mClusterCache, as queries on different pages are executed concurrently.
+	 */
+	std::mutex mClusterCacheMutex;
 };
 
 }
@@ -30,6 +30,13 @@ PlantPopulator::~PlantPopulator()
 	delete mScaler;
 }
 
+void PlantPopulator::populateBatch(const std::vector<PlantAreaQueryResult*>& results, SegmentRefPtr segmentRef)
+{
+	for (auto result : results) {
+		populate(*result, segmentRef);
+	}
+}
+
 UniformScaler::UniformScaler(float min, float max) :
 	mMin(min), mRange(max - min)
 {
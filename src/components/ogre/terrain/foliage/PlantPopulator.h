@@ -10,6 +10,8 @@
 
 #include "components/ogre/terrain/Types.h"
 
+#include <vector>
+
 namespace WFMath
 {
 class MTRand;
@@ -74,8 +76,24 @@ public:
 	PlantPopulator(unsigned int layerIndex, IScaler* scaler, size_t plantIndex);
 	virtual ~PlantPopulator();
 
+	/**
+	 * @brief Populates the result of a query.
+	 * Only the horizontal positions, orientations and scales of the plants are set. The heights are left for the caller to look up,
+	 * which it does for all plants at once.
+	 * @param result The result to populate.
+	 * @param segmentRef The segment in which the query is.
+	 */
 	virtual void populate(PlantAreaQueryResult& result, SegmentRefPtr segmentRef) = 0;
 
+	/**
+	 * @brief Populates the results of a batch of queries, all within the same segment.
+	 * The default implementation populates each result by itself; override this to share work between the queries.
+	 * As with populate(), the heights of the plants aren't set.
+	 * @param results The results to populate.
+	 * @param segmentRef The segment in which all queries are.
+	 */
+	virtual void populateBatch(const std::vector<PlantAreaQueryResult*>& results, SegmentRefPtr segmentRef);
+
 protected:
 
 	int mLayerIndex;
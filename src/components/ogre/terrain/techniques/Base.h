@@ -64,6 +64,11 @@ public:
 		return false;
 	}
 
+	virtual size_t getUploadedTextureBytes() const
+	{
+		return 0;
+	}
+
 
 
 protected:
@@ -62,7 +62,7 @@ CompilerTechniqueProvider::~CompilerTechniqueProvider()
 	delete mOnePixelMaterialGenerator;
 }
 
-TerrainPageSurfaceCompilerTechnique* CompilerTechniqueProvider::createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow) const
+TerrainPageSurfaceCompilerTechnique* CompilerTechniqueProvider::createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas, BlendMapContentStore& blendMapContents) const
 {
 	std::string preferredTech;
 	if (EmberServices::getSingleton().getConfigService().itemExists("terrain", "preferredtechnique")) {
@@ -82,11 +82,11 @@ TerrainPageSurfaceCompilerTechnique* CompilerTechniqueProvider::createTechnique(
 	bool useNormalMapping = (preferredTech == "ShaderNormalMapped");
 	if ((useNormalMapping || preferredTech == "Shader") && shaderSupport && graphicsLevel >= ShaderManager::LEVEL_HIGH) {
 		//Use shader tech with shadows
-		return new Techniques::Shader(true, geometry, terrainPageSurfaces, terrainPageShadow, mSceneManager, useNormalMapping);
+		return new Techniques::Shader(true, geometry, terrainPageSurfaces, terrainPageShadow, dirtyAreas, blendMapContents, mSceneManager, useNormalMapping);
 	}
 //	if ((preferredTech == "Shader" || useNormalMapping) && shaderSupport && graphicsLevel >= ShaderManager::LEVEL_MEDIUM) {
 		//Use shader tech without shadows
-		return new Techniques::Shader(false, geometry, terrainPageSurfaces, terrainPageShadow, mSceneManager, false);
+		return new Techniques::Shader(false, geometry, terrainPageSurfaces, terrainPageShadow, dirtyAreas, blendMapContents, mSceneManager, false);
 //	} else {
 //		return new Techniques::Simple(geometry, terrainPageSurfaces, terrainPageShadow);
 //	}
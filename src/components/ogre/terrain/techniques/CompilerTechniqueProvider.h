@@ -54,7 +54,7 @@ public:
 
 	virtual ~CompilerTechniqueProvider();
 
-	virtual TerrainPageSurfaceCompilerTechnique* createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow) const;
+	virtual TerrainPageSurfaceCompilerTechnique* createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas, BlendMapContentStore& blendMapContents) const;
 
 protected:
 
@@ -18,6 +18,7 @@
 
 #include "Shader.h"
 #include "ShaderPass.h"
+#include "ShaderPassBlendMapBatch.h"
 #include "components/ogre/terrain/TerrainPageSurfaceLayer.h"
 #include "components/ogre/terrain/TerrainPage.h"
 #include "components/ogre/terrain/TerrainPageGeometry.h"
@@ -26,6 +27,9 @@
 #include <OgreTechnique.h>
 #include <OgreMaterialManager.h>
 #include <OgreSceneManager.h>
+#include <Mercator/Segment.h>
+#include <wfmath/intersect.h>
+#include <algorithm>
 
 namespace Ember
 {
@@ -40,8 +44,8 @@ namespace Techniques
 const std::string Shader::NORMAL_TEXTURE_ALIAS = "EmberTerrain/NormalTexture";
 const std::string Shader::COMPOSITE_MAP_ALIAS = "EmberTerrain/CompositeMap";
 
-Shader::Shader(bool includeShadows, const TerrainPageGeometryPtr& mGeometry, const SurfaceLayerStore& mTerrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, Ogre::SceneManager& sceneManager, bool UseNormalMapping) :
-		Base(mGeometry, mTerrainPageSurfaces, terrainPageShadow), mIncludeShadows(includeShadows), mSceneManager(sceneManager), mUseNormalMapping(UseNormalMapping), mUseCompositeMap(false)
+Shader::Shader(bool includeShadows, const TerrainPageGeometryPtr& mGeometry, const SurfaceLayerStore& mTerrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas, BlendMapContentStore& blendMapContents, Ogre::SceneManager& sceneManager, bool UseNormalMapping) :
+		Base(mGeometry, mTerrainPageSurfaces, terrainPageShadow), mIncludeShadows(includeShadows), mSceneManager(sceneManager), mUseNormalMapping(UseNormalMapping), mUseCompositeMap(false), mDirtyAreas(dirtyAreas), mBlendMapContents(blendMapContents)
 {
 }
 
@@ -76,11 +80,77 @@ bool Shader::prepareMaterial()
 
 	buildPasses(false);
 
-	//We don't need the geometry any more, so we'll release it as soon as we can.
+	Ogre::Box dirtyBox = getDirtyBlendMapBox();
+	for (auto pass : mPassesNormalMapped) {
+		pass->fillBlendMaps(mGeometry, dirtyBox);
+	}
+	for (auto pass : mPasses) {
+		pass->fillBlendMaps(mGeometry, dirtyBox);
+	}
+
+	//We don't need the geometry any more, so we'll release it as soon as we can. Batches which have only been partially filled keep it until they are assigned.
 	mGeometry.reset();
 	return true;
 }
 
+Ogre::Box Shader::getDirtyBlendMapBox() const
+{
+	auto blendMapSize = static_cast<unsigned int>(mPage.getBlendMapSize());
+	Ogre::Box fullBox(0, 0, blendMapSize, blendMapSize);
+
+	//Parts of the textures can only be left as they are if they will hold the same layers as before.
+	//Note that the normal mapped passes and the ordinary passes share textures.
+	BlendMapContentStore contents;
+	for (const PassStore* passes : {&mPassesNormalMapped, &mPasses}) {
+		for (size_t i = 0; i < passes->size(); ++i) {
+			if (!(*passes)[i]->collectBlendMapContents(i, contents)) {
+				return fullBox;
+			}
+		}
+	}
+	for (auto& entry : contents) {
+		auto I = mBlendMapContents.find(entry.first);
+		if (I == mBlendMapContents.end() || I->second != entry.second) {
+			return fullBox;
+		}
+	}
+
+	bool isEmpty = true;
+	Ogre::Box dirtyBox(0, 0, 0, 0);
+	for (auto& pageSegment : mGeometry->getValidSegments()) {
+		Mercator::Segment* segment = pageSegment.segment;
+		WFMath::AxisBox<2> segmentExtent(WFMath::Point<2>(segment->getXRef(), segment->getZRef()), WFMath::Point<2>(segment->getXRef() + segment->getResolution(), segment->getZRef() + segment->getResolution()));
+		for (auto& area : mDirtyAreas) {
+			if (WFMath::Intersect(area, segmentExtent, false)) {
+				Ogre::Box segmentBox = ShaderPassBlendMapBatch::getSegmentBox(pageSegment, blendMapSize);
+				if (isEmpty) {
+					dirtyBox = segmentBox;
+					isEmpty = false;
+				} else {
+					dirtyBox.left = std::min(dirtyBox.left, segmentBox.left);
+					dirtyBox.top = std::min(dirtyBox.top, segmentBox.top);
+					dirtyBox.right = std::max(dirtyBox.right, segmentBox.right);
+					dirtyBox.bottom = std::max(dirtyBox.bottom, segmentBox.bottom);
+				}
+				break;
+			}
+		}
+	}
+	return dirtyBox;
+}
+
+size_t Shader::getUploadedTextureBytes() const
+{
+	size_t bytes = 0;
+	for (auto pass : mPassesNormalMapped) {
+		bytes += pass->getUploadedBytes();
+	}
+	for (auto pass : mPasses) {
+		bytes += pass->getUploadedBytes();
+	}
+	return bytes;
+}
+
 void Shader::buildPasses(bool normalMapped)
 {
 	ShaderPass* shaderPass;
@@ -107,7 +177,7 @@ void Shader::buildPasses(bool normalMapped)
 							shaderPass = addPass();
 						}
 					}
-					shaderPass->addLayer(*mGeometry, surfaceLayer);
+					shaderPass->addLayer(surfaceLayer);
 					activeLayersCount++;
 				}
 			}
@@ -291,7 +361,7 @@ bool Shader::compileCompositeMapMaterial(Ogre::MaterialPtr material, std::set<st
 
 ShaderPass* Shader::addPass()
 {
-	ShaderPass* shaderPass(new ShaderPass(mSceneManager, mPage.getBlendMapSize(), mPage.getWFPosition()));
+	ShaderPass* shaderPass(new ShaderPass(mSceneManager, mPage.getBlendMapSize(), mPage.getWFPosition(), mBlendMapContents));
 	if (mIncludeShadows) {
 		for (size_t i = 0; i < mSceneManager.getShadowTextureCount(); ++i) {
 			shaderPass->addShadowLayer(mTerrainPageShadow);
@@ -303,7 +373,7 @@ ShaderPass* Shader::addPass()
 
 ShaderPass* Shader::addPassNormalMapped()
 {
-	ShaderPass* shaderPass(new ShaderPass(mSceneManager, mPage.getBlendMapSize(), mPage.getWFPosition(), true));
+	ShaderPass* shaderPass(new ShaderPass(mSceneManager, mPage.getBlendMapSize(), mPage.getWFPosition(), mBlendMapContents, true));
 	if (mIncludeShadows) {
 		for (size_t i = 0; i < mSceneManager.getShadowTextureCount(); ++i) {
 			shaderPass->addShadowLayer(mTerrainPageShadow);
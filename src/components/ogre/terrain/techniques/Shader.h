@@ -23,6 +23,8 @@
 #include "Base.h"
 #include "components/ogre/OgreIncludes.h"
 
+#include <OgreCommon.h>
+
 namespace Ember
 {
 namespace OgreView
@@ -64,10 +66,12 @@ public:
      * @param geometry The geometry to operate on.
      * @param terrainPageSurfaces The surfaces to generate a rendering technique for.
      * @param terrainPageShadow An optional shadow.
+     * @param dirtyAreas The areas which have changed since the material last was compiled.
+     * @param blendMapContents The layers which the blend map textures of the page currently hold.
      * @param sceneManager The scene manager which will hold the terrain.
 	 * @param useNormalMapping Whether to use normal mapping.
      */
-	Shader(bool includeShadows, const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, Ogre::SceneManager& sceneManager, bool useNormalMapping = false);
+	Shader(bool includeShadows, const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas, BlendMapContentStore& blendMapContents, Ogre::SceneManager& sceneManager, bool useNormalMapping = false);
 
 	/**
 	 * @brief Dtor.
@@ -79,6 +83,8 @@ public:
 
 	virtual bool compileCompositeMapMaterial(Ogre::MaterialPtr material, std::set<std::string>& managedTextures) const;
 
+	virtual size_t getUploadedTextureBytes() const;
+
 protected:
 	typedef std::vector<ShaderPass*> PassStore;
 
@@ -116,6 +122,16 @@ protected:
 	 */
 	bool mUseCompositeMap;
 
+	/**
+	 * @brief The areas which have changed since the material last was compiled.
+	 */
+	const AreaStore mDirtyAreas;
+
+	/**
+	 * @brief The layers which the blend map textures of the page currently hold.
+	 */
+	BlendMapContentStore& mBlendMapContents;
+
 	/**
 	 * @brief Adds a new pass to the list of passes.
 	 * @return The new pass.
@@ -153,6 +169,14 @@ protected:
 	 */
 	void reset();
 
+	/**
+	 * @brief Gets the part of the blend maps which needs to be filled and uploaded.
+	 *
+	 * This is the box covering all segments touched by the dirty areas, as long as the blend map textures already hold the same layers as the passes. Else the whole blend maps need to be updated.
+	 * @return A box, aligned to segment boundaries.
+	 */
+	Ogre::Box getDirtyBlendMapBox() const;
+
 };
 
 
@@ -37,13 +37,18 @@ namespace Terrain
 namespace Techniques
 {
 
-Ogre::TexturePtr ShaderPass::getCombinedBlendMapTexture(size_t passIndex, size_t batchIndex, std::set<std::string>& managedTextures) const
+std::string ShaderPass::getCombinedBlendMapTextureName(size_t passIndex, size_t batchIndex) const
 {
 	// we need an unique name for our alpha texture
 	std::stringstream combinedBlendMapTextureNameSS;
 
 	combinedBlendMapTextureNameSS << "terrain_" << mPosition.x() << "_" << mPosition.y() << "_combinedBlendMap_" << passIndex << "_" << batchIndex << "_" << mBlendMapPixelWidth;
-	const Ogre::String combinedBlendMapName(combinedBlendMapTextureNameSS.str());
+	return combinedBlendMapTextureNameSS.str();
+}
+
+Ogre::TexturePtr ShaderPass::getCombinedBlendMapTexture(size_t passIndex, size_t batchIndex, std::set<std::string>& managedTextures) const
+{
+	const Ogre::String combinedBlendMapName(getCombinedBlendMapTextureName(passIndex, batchIndex));
 	Ogre::TexturePtr combinedBlendMapTexture;
 	Ogre::TextureManager* textureMgr = Ogre::Root::getSingletonPtr()->getTextureManager();
 	if (textureMgr->resourceExists(combinedBlendMapName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME)) {
@@ -51,6 +56,8 @@ Ogre::TexturePtr ShaderPass::getCombinedBlendMapTexture(size_t passIndex, size_t
 		combinedBlendMapTexture = static_cast<Ogre::TexturePtr>(textureMgr->getByName(combinedBlendMapName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME));
 		if(!combinedBlendMapTexture->isLoaded()) {
 			combinedBlendMapTexture->createInternalResources();
+			//The content of the texture is lost.
+			mBlendMapContents.erase(combinedBlendMapName);
 		}
 		return combinedBlendMapTexture;
 	}
@@ -61,14 +68,15 @@ Ogre::TexturePtr ShaderPass::getCombinedBlendMapTexture(size_t passIndex, size_t
 #ifndef _WIN32
 	flags |= Ogre::TU_AUTOMIPMAP;
 #endif // ifndef _WIN32
+	mBlendMapContents.erase(combinedBlendMapName);
 	combinedBlendMapTexture = textureMgr->createManual(combinedBlendMapName, "General", Ogre::TEX_TYPE_2D, mBlendMapPixelWidth, mBlendMapPixelWidth, textureMgr->getDefaultNumMipmaps(), Ogre::PF_B8G8R8A8, flags);
 	managedTextures.insert(combinedBlendMapName);
 	combinedBlendMapTexture->createInternalResources();
 	return combinedBlendMapTexture;
 }
 
-ShaderPass::ShaderPass(Ogre::SceneManager& sceneManager, unsigned int blendMapPixelWidth, const WFMath::Point<2>& position, bool useNormalMapping) :
-		mBaseLayer(nullptr), mSceneManager(sceneManager), mBlendMapPixelWidth(blendMapPixelWidth), mPosition(position), mShadowLayers(0), mUseNormalMapping(useNormalMapping)
+ShaderPass::ShaderPass(Ogre::SceneManager& sceneManager, unsigned int blendMapPixelWidth, const WFMath::Point<2>& position, BlendMapContentStore& blendMapContents, bool useNormalMapping) :
+		mBaseLayer(nullptr), mSceneManager(sceneManager), mBlendMapPixelWidth(blendMapPixelWidth), mPosition(position), mBlendMapContents(blendMapContents), mShadowLayers(0), mUseNormalMapping(useNormalMapping)
 {
 	for (float& mScale : mScales) {
 		mScale = 0.0;
@@ -105,14 +113,41 @@ ShaderPassBlendMapBatch* ShaderPass::createNewBatch()
 	return new ShaderPassBlendMapBatch(*this, getBlendMapPixelWidth());
 }
 
-void ShaderPass::addLayer(const TerrainPageGeometry& geometry, const TerrainPageSurfaceLayer* layer)
+void ShaderPass::addLayer(const TerrainPageSurfaceLayer* layer)
 {
-	getCurrentBatch()->addLayer(geometry, layer);
+	getCurrentBatch()->addLayer(layer);
 
 	mScales[mLayers.size()] = layer->getScale();
 	mLayers.push_back(layer);
 }
 
+void ShaderPass::fillBlendMaps(const TerrainPageGeometryPtr& geometry, const Ogre::Box& dirtyBox)
+{
+	for (auto batch : mBlendMapBatches) {
+		batch->fillBlendMap(geometry, dirtyBox);
+	}
+}
+
+bool ShaderPass::collectBlendMapContents(size_t passIndex, BlendMapContentStore& contents) const
+{
+	for (size_t i = 0; i < mBlendMapBatches.size(); ++i) {
+		auto result = contents.insert(BlendMapContentStore::value_type(getCombinedBlendMapTextureName(passIndex, i), mBlendMapBatches[i]->getLayerIndices()));
+		if (!result.second && result.first->second != mBlendMapBatches[i]->getLayerIndices()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t ShaderPass::getUploadedBytes() const
+{
+	size_t bytes = 0;
+	for (auto batch : mBlendMapBatches) {
+		bytes += batch->getUploadedBytes();
+	}
+	return bytes;
+}
+
 LayerStore& ShaderPass::getLayers()
 {
 	return mLayers;
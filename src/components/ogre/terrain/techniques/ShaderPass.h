@@ -21,6 +21,7 @@
 #define EMBEROGRETERRAINTECHNIQUESSHADERPASS_H_
 
 #include "components/ogre/OgreIncludes.h"
+#include "components/ogre/terrain/Types.h"
 #include <wfmath/point.h>
 #include <vector>
 #include <string>
@@ -49,15 +50,36 @@ class ShaderPass
 {
 public:
 friend class ShaderPassBlendMapBatch;
-	ShaderPass(Ogre::SceneManager& sceneManager, unsigned int blendMapPixelWidth, const WFMath::Point<2>& position, bool useNormalMapping = false);
+	ShaderPass(Ogre::SceneManager& sceneManager, unsigned int blendMapPixelWidth, const WFMath::Point<2>& position, BlendMapContentStore& blendMapContents, bool useNormalMapping = false);
 	virtual ~ShaderPass();
 
-	virtual void addLayer(const TerrainPageGeometry& geometry, const TerrainPageSurfaceLayer* layer);
+	virtual void addLayer(const TerrainPageSurfaceLayer* layer);
 	virtual void setBaseLayer(const TerrainPageSurfaceLayer* layer);
 	void addShadowLayer(const TerrainPageShadow* terrainPageShadow);
 
 	virtual bool hasRoomForLayer(const TerrainPageSurfaceLayer* layer);
 
+	/**
+	 * @brief Fills the combined blend maps with the coverage of all added layers. Call this once all layers have been added.
+	 * @param geometry The geometry of the page.
+	 * @param dirtyBox The part of the blend maps which needs to be updated.
+	 */
+	void fillBlendMaps(const TerrainPageGeometryPtr& geometry, const Ogre::Box& dirtyBox);
+
+	/**
+	 * @brief Adds the layers which each of the combined blend map textures of the pass will hold.
+	 * @param passIndex The index of the pass in the material technique.
+	 * @param contents The store to add to.
+	 * @return False if a texture already in the store would hold other layers.
+	 */
+	bool collectBlendMapContents(size_t passIndex, BlendMapContentStore& contents) const;
+
+	/**
+	 * @brief Gets the number of bytes uploaded to the combined blend map textures.
+	 * @return A number of bytes.
+	 */
+	size_t getUploadedBytes() const;
+
 	/**
 	 * @brief Creates the combined final blend maps and sets the shader params. Be sure to call this before you load the material.
      * @param managedTextures A set of textures created in the process. These will be destroyed when the page is destroyed.
@@ -76,6 +98,7 @@ protected:
 	virtual ShaderPassBlendMapBatch* createNewBatch();
 
 	unsigned int getBlendMapPixelWidth() const;
+	std::string getCombinedBlendMapTextureName(size_t passIndex, size_t batchIndex) const;
 	Ogre::TexturePtr getCombinedBlendMapTexture(size_t passIndex, size_t batchIndex, std::set<std::string>& managedTextures) const;
 
 	float mScales[16];
@@ -86,6 +109,11 @@ protected:
 	unsigned int mBlendMapPixelWidth;
 	WFMath::Point<2> mPosition;
 
+	/**
+	 * @brief The layers which the combined blend map textures of the page currently hold.
+	 */
+	BlendMapContentStore& mBlendMapContents;
+
 	unsigned int mShadowLayers;
 
 	bool mUseNormalMapping;
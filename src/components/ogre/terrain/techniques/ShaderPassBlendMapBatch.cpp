@@ -19,10 +19,17 @@
 #include "ShaderPassBlendMapBatch.h"
 #include "ShaderPass.h"
 #include "components/ogre/terrain/TerrainPageSurfaceLayer.h"
+#include "components/ogre/terrain/TerrainPageGeometry.h"
+#include "components/ogre/terrain/BlendMapKernels.h"
 
 #include "framework/TimedLog.h"
 
+#include <algorithm>
+
+#include <Mercator/Segment.h>
+
 #include <OgreHardwarePixelBuffer.h>
+#include <OgrePixelFormat.h>
 #include <OgreTextureUnitState.h>
 #include <OgrePass.h>
 
@@ -38,7 +45,7 @@ namespace Techniques
 {
 
 ShaderPassBlendMapBatch::ShaderPassBlendMapBatch(ShaderPass& shaderPass, unsigned int imageSize) :
-	mShaderPass(shaderPass), mCombinedBlendMapImage(new Image::ImageBuffer(imageSize, 4))
+	mShaderPass(shaderPass), mCombinedBlendMapImage(new Image::ImageBuffer(imageSize, 4)), mDirtyBox(0, 0, imageSize, imageSize), mUploadedBytes(0)
 {
 	//reset the blendMap image
 	mCombinedBlendMapImage.reset();
@@ -48,16 +55,70 @@ ShaderPassBlendMapBatch::~ShaderPassBlendMapBatch()
 {
 }
 
-void ShaderPassBlendMapBatch::addLayer(const TerrainPageGeometry& geometry, const TerrainPageSurfaceLayer* layer)
+void ShaderPassBlendMapBatch::addLayer(const TerrainPageSurfaceLayer* layer)
 {
-	addBlendMap(geometry, layer, mLayers.size());
 	mLayers.push_back(layer);
 }
 
-void ShaderPassBlendMapBatch::addBlendMap(const TerrainPageGeometry& geometry, const TerrainPageSurfaceLayer* layer, unsigned int channel)
+void ShaderPassBlendMapBatch::fillBlendMap(const TerrainPageGeometryPtr& geometry, const Ogre::Box& dirtyBox)
 {
-	layer->fillImage(geometry, mCombinedBlendMapImage, channel);
 	mSyncedTextures.clear();
+	mDirtyBox = dirtyBox;
+	const bool isFullUpdate = mDirtyBox.left == 0 && mDirtyBox.top == 0 && mDirtyBox.right == mCombinedBlendMapImage.getResolution() && mDirtyBox.bottom == mCombinedBlendMapImage.getResolution();
+	mGeometry = isFullUpdate ? TerrainPageGeometryPtr() : geometry;
+	fillSegments(*geometry, mDirtyBox, Ogre::Box(0, 0, 0, 0));
+}
+
+void ShaderPassBlendMapBatch::fillSegments(const TerrainPageGeometry& geometry, const Ogre::Box& box, const Ogre::Box& filledBox)
+{
+	if (mLayers.empty()) {
+		return;
+	}
+
+	SegmentVector validSegments = geometry.getValidSegments();
+	for (const auto& pageSegment : validSegments) {
+		Ogre::Box segmentBox = getSegmentBox(pageSegment, mCombinedBlendMapImage.getResolution());
+		if (segmentBox.right <= box.left || segmentBox.left >= box.right || segmentBox.bottom <= box.top || segmentBox.top >= box.bottom) {
+			continue;
+		}
+		if (segmentBox.left >= filledBox.left && segmentBox.right <= filledBox.right && segmentBox.top >= filledBox.top && segmentBox.bottom <= filledBox.bottom) {
+			continue;
+		}
+		const unsigned char* sources[BlendMapKernels::InterleavedLayers] = {};
+		bool isCovered = false;
+		for (size_t i = 0; i < mLayers.size() && i < BlendMapKernels::InterleavedLayers; ++i) {
+			sources[i] = mLayers[i]->getCoverage(pageSegment.segment);
+			isCovered = isCovered || sources[i];
+		}
+		//The image is cleared when created, so there's no need to write segments which no layer covers.
+		if (isCovered) {
+			BlendMapKernels::downsampleInterleaved(sources, pageSegment.segment->getResolution(), mLayers.front()->getSegmentTexel(mCombinedBlendMapImage, pageSegment),
+												   mCombinedBlendMapImage.getResolution() * mCombinedBlendMapImage.getChannels());
+		}
+	}
+}
+
+std::vector<int> ShaderPassBlendMapBatch::getLayerIndices() const
+{
+	std::vector<int> layerIndices;
+	for (auto layer : mLayers) {
+		layerIndices.push_back(layer->getSurfaceIndex());
+	}
+	return layerIndices;
+}
+
+size_t ShaderPassBlendMapBatch::getUploadedBytes() const
+{
+	return mUploadedBytes;
+}
+
+Ogre::Box ShaderPassBlendMapBatch::getSegmentBox(const PageSegment& pageSegment, unsigned int blendMapSize)
+{
+	auto resolution = static_cast<unsigned int>(pageSegment.segment->getResolution());
+	auto left = static_cast<unsigned int>(pageSegment.index.x()) * resolution;
+	//The segments are indexed from the bottom, while the image rows are stored from the top.
+	unsigned int top = blendMapSize - (((blendMapSize / resolution) - static_cast<unsigned int>(pageSegment.index.y())) * resolution);
+	return Ogre::Box(left, top, left + resolution, top + resolution);
 }
 
 std::vector<const TerrainPageSurfaceLayer*>& ShaderPassBlendMapBatch::getLayers()
@@ -68,24 +129,66 @@ std::vector<const TerrainPageSurfaceLayer*>& ShaderPassBlendMapBatch::getLayers(
 void ShaderPassBlendMapBatch::assignCombinedBlendMapTexture(Ogre::TexturePtr texture)
 {
 	if (std::find(mSyncedTextures.begin(), mSyncedTextures.end(), texture->getName()) == mSyncedTextures.end()) {
+		mSyncedTextures.push_back(texture->getName());
+
+		const Ogre::Box fullBox(0, 0, mCombinedBlendMapImage.getResolution(), mCombinedBlendMapImage.getResolution());
+		auto layerIndices = getLayerIndices();
+		if (mGeometry) {
+			//Only the dirty part of the image has been filled, which is fine as long as the texture still holds the same layers as when it last was uploaded.
+			auto I = mShaderPass.mBlendMapContents.find(texture->getName());
+			if (I == mShaderPass.mBlendMapContents.end() || I->second != layerIndices) {
+				S_LOG_VERBOSE("Blend map texture " << texture->getName() << " was reset since the last update; filling and uploading all of it.");
+				fillSegments(*mGeometry, fullBox, mDirtyBox);
+				mDirtyBox = fullBox;
+				mGeometry.reset();
+			}
+		}
+		if (mDirtyBox.getWidth() == 0 || mDirtyBox.getHeight() == 0) {
+			mGeometry.reset();
+			return;
+		}
+
 		TimedLog log("ShaderPassBlendMapBatch::assignCombinedBlendMapTexture", true);
 
-		//blit the whole image to the hardware buffer
-		Ogre::PixelBox sourceBox(mCombinedBlendMapImage.getResolution(), mCombinedBlendMapImage.getResolution(), 1, Ogre::PF_B8G8R8A8, mCombinedBlendMapImage.getData());
+		//blit the dirty part of the image to the hardware buffer
+		Ogre::PixelBox imageBox(mCombinedBlendMapImage.getResolution(), mCombinedBlendMapImage.getResolution(), 1, Ogre::PF_B8G8R8A8, mCombinedBlendMapImage.getData());
+		Ogre::PixelBox sourceBox = imageBox.getSubVolume(mDirtyBox);
 
 		if ((texture->getUsage() & Ogre::TU_AUTOMIPMAP) && texture->getMipmapsHardwareGenerated()) {
 			//No need to blit for all mipmaps as they will be generated.
 			Ogre::HardwarePixelBufferSharedPtr hardwareBuffer(texture->getBuffer(0, 0));
-			hardwareBuffer->blitFromMemory(sourceBox);
+			hardwareBuffer->blitFromMemory(sourceBox, mDirtyBox);
+			mUploadedBytes += sourceBox.getConsecutiveSize();
 		} else {
-			for (size_t i = 0; i <= texture->getNumMipmaps(); ++i)
-			{
+			const Ogre::uint32 resolution = mCombinedBlendMapImage.getResolution();
+			//Each texel of a mipmap is generated from a block of texels in the image, so the dirty box is widened to whole blocks.
+			auto getMipmapSourceBox = [&](size_t level) {
+				Ogre::uint32 scale = 1u << level;
+				return Ogre::Box((mDirtyBox.left / scale) * scale, (mDirtyBox.top / scale) * scale,
+								 std::min(((mDirtyBox.right + scale - 1) / scale) * scale, resolution),
+								 std::min(((mDirtyBox.bottom + scale - 1) / scale) * scale, resolution));
+			};
+			if (mGeometry) {
+				//The coarsest mipmap covers the most, so filling its part of the image is enough for all levels.
+				fillSegments(*mGeometry, getMipmapSourceBox(texture->getNumMipmaps()), mDirtyBox);
+			}
+			for (size_t i = 0; i <= texture->getNumMipmaps(); ++i) {
 				Ogre::HardwarePixelBufferSharedPtr hardwareBuffer(texture->getBuffer(0, i));
-				hardwareBuffer->blitFromMemory(sourceBox);
+				Ogre::uint32 scale = 1u << i;
+				Ogre::Box mipmapSourceBox = getMipmapSourceBox(i);
+				Ogre::uint32 left = std::min(mipmapSourceBox.left / scale, hardwareBuffer->getWidth() - 1);
+				Ogre::uint32 top = std::min(mipmapSourceBox.top / scale, hardwareBuffer->getHeight() - 1);
+				Ogre::Box mipmapBox(left, top,
+									std::max(left + 1, std::min((mipmapSourceBox.right + scale - 1) / scale, hardwareBuffer->getWidth())),
+									std::max(top + 1, std::min((mipmapSourceBox.bottom + scale - 1) / scale, hardwareBuffer->getHeight())));
+				//Ogre scales the source when blitting, which gives the same result as generating the whole mipmap since the source box covers whole blocks.
+				hardwareBuffer->blitFromMemory(imageBox.getSubVolume(mipmapSourceBox), mipmapBox);
+				mUploadedBytes += Ogre::PixelUtil::getMemorySize(mipmapBox.getWidth(), mipmapBox.getHeight(), 1, Ogre::PF_B8G8R8A8);
 			}
 		}
+		mGeometry.reset();
 
-		mSyncedTextures.push_back(texture->getName());
+		mShaderPass.mBlendMapContents[texture->getName()] = layerIndices;
 	}
 }
 
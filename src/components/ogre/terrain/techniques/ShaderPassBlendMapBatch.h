@@ -21,6 +21,7 @@
 
 #include "components/ogre/OgreIncludes.h"
 #include "components/ogre/terrain/OgreImage.h"
+#include "components/ogre/terrain/Types.h"
 #include <vector>
 #include <OgreTexture.h>
 
@@ -34,6 +35,7 @@ namespace Terrain
 
 class TerrainPageGeometry;
 class TerrainPageSurfaceLayer;
+struct PageSegment;
 
 namespace Techniques
 {
@@ -52,7 +54,39 @@ public:
 	ShaderPassBlendMapBatch(ShaderPass& shaderPass, unsigned int imageSize);
 	virtual ~ShaderPassBlendMapBatch();
 
-	void addLayer(const TerrainPageGeometry& geometry, const TerrainPageSurfaceLayer* layer);
+	void addLayer(const TerrainPageSurfaceLayer* layer);
+
+	/**
+	 * @brief Fills the combined blend map with the coverage of all layers, with one layer per channel.
+	 * All layers are downsampled and interleaved straight into the combined image in one pass per segment.
+	 *
+	 * Only the segments within the dirty box are filled, and only that part of the image is later uploaded to the texture.
+	 * For such partial updates the geometry is kept until the texture has been assigned, since the rest of the image
+	 * might need to be filled then, either because the texture has lost its contents or to generate the mipmaps.
+	 * @param geometry The geometry of the page.
+	 * @param dirtyBox The part of the blend map which needs to be updated. This must be aligned to segment boundaries.
+	 */
+	void fillBlendMap(const TerrainPageGeometryPtr& geometry, const Ogre::Box& dirtyBox);
+
+	/**
+	 * @brief Gets the surface indices of the layers in the batch, in channel order.
+	 * @return The surface indices of the layers.
+	 */
+	std::vector<int> getLayerIndices() const;
+
+	/**
+	 * @brief Gets the number of bytes uploaded to the combined blend map texture.
+	 * @return A number of bytes.
+	 */
+	size_t getUploadedBytes() const;
+
+	/**
+	 * @brief Gets the box of texels which a segment covers in a blend map.
+	 * @param pageSegment The segment.
+	 * @param blendMapSize The size of the blend map.
+	 * @return The box of texels.
+	 */
+	static Ogre::Box getSegmentBox(const PageSegment& pageSegment, unsigned int blendMapSize);
 
 	std::vector<const TerrainPageSurfaceLayer*>& getLayers();
 	Image& getCombinedBlendMapImage();
@@ -71,8 +105,30 @@ protected:
 	 */
 	std::vector<std::string> mSyncedTextures;
 
+	/**
+	 * @brief The part of the image which has been filled, and needs to be uploaded.
+	 */
+	Ogre::Box mDirtyBox;
+
+	/**
+	 * @brief The number of bytes uploaded to the combined blend map texture.
+	 */
+	size_t mUploadedBytes;
+
+	/**
+	 * @brief The geometry of the page, kept after a partial fill until the texture has been assigned.
+	 */
+	TerrainPageGeometryPtr mGeometry;
+
+	/**
+	 * @brief Fills the segments which intersect a box, skipping those which already have been filled.
+	 * @param geometry The geometry of the page.
+	 * @param box The part of the image to fill.
+	 * @param filledBox The part of the image which already has been filled.
+	 */
+	void fillSegments(const TerrainPageGeometry& geometry, const Ogre::Box& box, const Ogre::Box& filledBox);
+
 	void assignCombinedBlendMapTexture(Ogre::TexturePtr texture);
-	void addBlendMap(const TerrainPageGeometry& geometry, const TerrainPageSurfaceLayer* layer, unsigned int channel);
 
 };
 
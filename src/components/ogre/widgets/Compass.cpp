@@ -69,7 +69,10 @@ bool DelayedCompassRenderer::frameStarted(const Ogre::FrameEvent& event)
 	if (mRenderNextFrame) {
 		try {
 			mRenderNextFrame = false;
-			mCompass.getMap().render();
+			//The map renders only a few tiles each frame, so we'll keep on until it's done.
+			if (!mCompass.getMap().update()) {
+				mRenderNextFrame = true;
+			}
 			mCompass.refresh();
 		} catch (const std::exception& ex) {
 			S_LOG_WARNING("Error when updating compass.");
@@ -136,9 +139,11 @@ void Compass::refresh()
 	}
 }
 
-void Compass::terrainObserver_AreaShown()
+void Compass::terrainObserver_AreaShown(const WFMath::AxisBox<2>& area)
 {
-	queueRefresh();
+	if (mMap->invalidate(area)) {
+		queueRefresh();
+	}
 }
 
 void Compass::queueRefresh()
@@ -149,6 +154,8 @@ void Compass::queueRefresh()
 void Compass::mapView_BoundsChanged()
 {
 	updateTerrainObserver();
+	//Any new tiles which weren't rendered when the map was repositioned need to be rendered in the following frames.
+	queueRefresh();
 }
 
 void Compass::updateTerrainObserver()
@@ -29,6 +29,12 @@
 #include <OgreFrameListener.h>
 #include <OgreMath.h>
 
+namespace WFMath
+{
+template<int>
+class AxisBox;
+}
+
 namespace Ogre
 {
 class Rectangle2D;
@@ -153,9 +159,10 @@ protected:
 	DelayedCompassRenderer mDelayedRenderer;
 
 	/**
-	 * @brief When new parts of the terrain becomes visible, we need to rerender the map.
+	 * @brief When parts of the terrain are shown or changed, the map tiles showing them need to be rendered again.
+	 * @param area The area which was shown.
 	 */
-	void terrainObserver_AreaShown();
+	void terrainObserver_AreaShown(const WFMath::AxisBox<2>& area);
 
 	/**
 	 * @brief When the bounds of the map changes, we need to update our terrain observer.
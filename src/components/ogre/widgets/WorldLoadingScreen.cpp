@@ -19,6 +19,7 @@
 #include "WorldLoadingScreen.h"
 #include "../GUIManager.h"
 #include "../EmberOgre.h"
+#include "../EmberEntityFactory.h"
 
 #include <CEGUI/Window.h>
 #include <CEGUI/WindowManager.h>
@@ -27,11 +28,16 @@
 #include <services/server/ServerService.h>
 #include <Eris/Account.h>
 
+#include <string>
+
 namespace Ember {
 namespace OgreView {
 namespace Gui {
 
-WorldLoadingScreen::WorldLoadingScreen() {
+WorldLoadingScreen::WorldLoadingScreen() :
+		mLoadingWindow(nullptr),
+		mEntityFactory(nullptr),
+		mHasAvatar(false) {
 
 	/*
 	 * Get Everything setup
@@ -50,7 +56,8 @@ WorldLoadingScreen::WorldLoadingScreen() {
 	mLoadingWindow->setProperty("HorzFormatting", "CentreAligned");
 	mLoadingWindow->setText("Entering world, please wait...");
 
-	EmberOgre::getSingleton().EventCreatedAvatarEntity.connect(sigc::hide(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::hideScreen)));
+	EmberOgre::getSingleton().EventCreatedEmberEntityFactory.connect(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::EmberOgre_CreatedEmberEntityFactory));
+	EmberOgre::getSingleton().EventCreatedAvatarEntity.connect(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::EmberOgre_CreatedAvatarEntity));
 	//A failsafe if something went wrong and the avatar never was created.
 	EmberOgre::getSingleton().EventWorldDestroyed.connect(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::hideScreen));
 
@@ -66,6 +73,35 @@ CEGUI::Window& WorldLoadingScreen::getWindow() {
 	return *mLoadingWindow;
 }
 
+void WorldLoadingScreen::EmberOgre_CreatedEmberEntityFactory(EmberEntityFactory& entityFactory) {
+	mEntityFactory = &entityFactory;
+	mHasAvatar = false;
+	entityFactory.EventInstantiationProgress.connect(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::EntityFactory_InstantiationProgress));
+	entityFactory.EventBeingDeleted.connect(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::EntityFactory_BeingDeleted));
+}
+
+void WorldLoadingScreen::EmberOgre_CreatedAvatarEntity(EmberEntity&) {
+	mHasAvatar = true;
+	//Entities are instantiated closest to the avatar first, so any still queued will mostly be further away; but if there are many of them we'll wait.
+	if (!mEntityFactory || mEntityFactory->getPendingEntityCount() == 0) {
+		hideScreen();
+	}
+}
+
+void WorldLoadingScreen::EntityFactory_InstantiationProgress(size_t processedCount, size_t queuedCount) {
+	if (mLoadingWindow->getParent()) {
+		if (processedCount == queuedCount && mHasAvatar) {
+			hideScreen();
+		} else {
+			mLoadingWindow->setText("Entering world, please wait... (" + std::to_string(processedCount) + " of " + std::to_string(queuedCount) + " entities)");
+		}
+	}
+}
+
+void WorldLoadingScreen::EntityFactory_BeingDeleted() {
+	mEntityFactory = nullptr;
+}
+
 void WorldLoadingScreen::showScreen() {
 	//Allow ESC to remove the screen.
 	Input::getSingleton().EventKeyReleased.connect([&](const SDL_Keysym& keysym, Input::InputMode) {
@@ -79,6 +115,7 @@ void WorldLoadingScreen::showScreen() {
 		account->AvatarFailure.connect(sigc::hide(sigc::mem_fun(*this, &Ember::OgreView::Gui::WorldLoadingScreen::hideScreen)));
 	}
 	if (!mLoadingWindow->getParent()) {
+		mLoadingWindow->setText("Entering world, please wait...");
 		/*
 		 * Add to the main sheet.  This is "turning on" the load screen
 		 */
@@ -29,8 +29,10 @@ class WindowManager;
 
 namespace Ember
 {
+class EmberEntity;
 namespace OgreView
 {
+class EmberEntityFactory;
 namespace Gui
 {
 
@@ -67,6 +69,35 @@ protected:
 	 */
 	CEGUI::Window* mLoadingWindow;
 
+	/**
+	 * @brief The factory of the current world, if any.
+	 */
+	EmberEntityFactory* mEntityFactory;
+
+	/**
+	 * @brief True if the avatar entity has been created.
+	 */
+	bool mHasAvatar;
+
+	/**
+	 * @brief Listens to the entity factory of a new world.
+	 */
+	void EmberOgre_CreatedEmberEntityFactory(EmberEntityFactory& entityFactory);
+
+	/**
+	 * @brief Hides the screen once the entities around the avatar have been instantiated.
+	 */
+	void EmberOgre_CreatedAvatarEntity(EmberEntity& entity);
+
+	/**
+	 * @brief Shows the progress of the entity instantiation, and hides the screen when it's done if the avatar has been created.
+	 * @param processedCount The number of instantiated entities.
+	 * @param queuedCount The number of queued entities.
+	 */
+	void EntityFactory_InstantiationProgress(size_t processedCount, size_t queuedCount);
+
+	void EntityFactory_BeingDeleted();
+
 };
 
 }
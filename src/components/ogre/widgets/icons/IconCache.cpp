@@ -0,0 +1,167 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IconCache.h"
+
+#include "framework/Hasher.h"
+#include "framework/LoggingInstance.h"
+
+#include <OgrePixelFormat.h>
+#include <OgreResourceGroupManager.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace Ember {
+namespace OgreView {
+
+namespace Gui {
+
+namespace Icons {
+
+namespace {
+
+/**
+ * @brief Identifies a cached icon file, and its version.
+ */
+const std::uint32_t IconMagic = 0x45494331; // "EIC1"
+
+/**
+ * @brief Icons are stored in the same format as the icon textures, so that they can be uploaded without conversion.
+ */
+const Ogre::PixelFormat IconFormat = Ogre::PF_A8R8G8B8;
+
+struct IconHeader
+{
+	std::uint32_t magic;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t format;
+	std::uint64_t definitionHash;
+};
+
+}
+
+IconCache::IconCache(std::string directory, int pixelWidth) :
+		mDirectory(std::move(directory)),
+		mPixelWidth(pixelWidth) {
+}
+
+std::string IconCache::getPath(const std::string& modelName) const {
+	Hasher hasher;
+	hasher.add(modelName);
+	hasher.add(mPixelWidth);
+	std::stringstream ss;
+	ss << mDirectory << "/" << std::hex << hasher.get() << ".icon";
+	return ss.str();
+}
+
+bool IconCache::getDefinitionHash(const std::string& modelName, std::uint64_t& hash) const {
+	Hasher hasher;
+	try {
+		Ogre::DataStreamPtr stream = Ogre::ResourceGroupManager::getSingleton().openResource(modelName, Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+		char buffer[4096];
+		while (!stream->eof()) {
+			size_t read = stream->read(buffer, sizeof(buffer));
+			if (read == 0) {
+				break;
+			}
+			hasher.add(buffer, read);
+		}
+	} catch (const Ogre::Exception&) {
+		//Definitions which aren't loaded from a file (such as ones being authored) can't be cached.
+		return false;
+	}
+	hash = hasher.get();
+	return true;
+}
+
+IconCache::LoadResult IconCache::load(const std::string& modelName, Ogre::Image& image) const {
+	std::ifstream stream(getPath(modelName), std::ios::binary);
+	if (!stream) {
+		return LoadResult::Missing;
+	}
+
+	IconHeader header{};
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != IconMagic
+		|| header.width != static_cast<std::uint32_t>(mPixelWidth) || header.height != static_cast<std::uint32_t>(mPixelWidth) || header.format != IconFormat) {
+		return LoadResult::Missing;
+	}
+
+	size_t size = Ogre::PixelUtil::getMemorySize(header.width, header.height, 1, IconFormat);
+	auto data = OGRE_ALLOC_T(Ogre::uchar, size, Ogre::MEMCATEGORY_GENERAL);
+	if (!stream.read(reinterpret_cast<char*>(data), size)) {
+		OGRE_FREE(data, Ogre::MEMCATEGORY_GENERAL);
+		return LoadResult::Missing;
+	}
+	//The image takes ownership of the data.
+	image.loadDynamicImage(data, header.width, header.height, 1, IconFormat, true);
+
+	std::uint64_t definitionHash;
+	if (getDefinitionHash(modelName, definitionHash) && definitionHash == header.definitionHash) {
+		return LoadResult::Current;
+	}
+	return LoadResult::Stale;
+}
+
+void IconCache::store(const std::string& modelName, const Ogre::PixelBox& pixels) {
+	if (pixels.getWidth() != static_cast<size_t>(mPixelWidth) || pixels.getHeight() != static_cast<size_t>(mPixelWidth)) {
+		return;
+	}
+
+	IconHeader header{IconMagic, static_cast<std::uint32_t>(mPixelWidth), static_cast<std::uint32_t>(mPixelWidth), IconFormat, 0};
+	if (!getDefinitionHash(modelName, header.definitionHash)) {
+		return;
+	}
+
+	std::vector<Ogre::uchar> data(Ogre::PixelUtil::getMemorySize(header.width, header.height, 1, IconFormat));
+	Ogre::PixelBox iconPixels(header.width, header.height, 1, IconFormat, data.data());
+	Ogre::PixelUtil::bulkPixelConversion(pixels, iconPixels);
+
+	//Write to a temporary file first, and then move it into place, so that an incomplete file never is read.
+	std::string path = getPath(modelName);
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!stream) {
+			S_LOG_WARNING("Could not write icon to cache file '" << path << "'.");
+			stream.close();
+			std::remove(tempPath.c_str());
+			return;
+		}
+	}
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::remove(tempPath.c_str());
+	}
+}
+
+}
+
+}
+
+}
+}
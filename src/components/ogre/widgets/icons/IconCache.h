@@ -0,0 +1,120 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef EMBEROGRE_GUI_ICONSICONCACHE_H
+#define EMBEROGRE_GUI_ICONSICONCACHE_H
+
+#include <OgreImage.h>
+
+#include <cstdint>
+#include <string>
+
+namespace Ember {
+namespace OgreView {
+
+namespace Gui {
+
+namespace Icons {
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Caches rendered model icons on disk, so that they don't need to be rendered again in the next session.
+ *
+ * Rendering an icon requires the model to be loaded and rendered into a texture, and then a frame to pass before the
+ * result can be copied into the icon. With the cache, the pixels are instead read from a file and uploaded directly.
+ *
+ * There's one file per model and icon size. Each file also contains a hash of the model definition file, so that a
+ * changed definition can be detected. The stale icon can then still be shown while a new one is being rendered.
+ */
+class IconCache
+{
+public:
+
+	/**
+	 * @brief The outcome of looking up an icon.
+	 */
+	enum class LoadResult
+	{
+		/**
+		 * @brief There's no cached icon.
+		 */
+		Missing,
+
+		/**
+		 * @brief There's a cached icon, but it was rendered from an older version of the model definition.
+		 */
+		Stale,
+
+		/**
+		 * @brief There's a cached icon which is up to date.
+		 */
+		Current
+	};
+
+	/**
+	 * @brief Ctor.
+	 * @param directory The directory in which cached icons are stored. It must already exist.
+	 * @param pixelWidth The width and height of the icons.
+	 */
+	IconCache(std::string directory, int pixelWidth);
+
+	/**
+	 * @brief Loads the cached icon of a model.
+	 * @param modelName The name of the model definition.
+	 * @param image An image into which the icon is loaded, if it's found.
+	 * @return Whether an icon was found, and if so whether it's up to date.
+	 */
+	LoadResult load(const std::string& modelName, Ogre::Image& image) const;
+
+	/**
+	 * @brief Stores the icon of a model.
+	 * @param modelName The name of the model definition.
+	 * @param pixels The pixels of the icon. These must be of the icon size.
+	 */
+	void store(const std::string& modelName, const Ogre::PixelBox& pixels);
+
+private:
+
+	const std::string mDirectory;
+
+	const int mPixelWidth;
+
+	/**
+	 * @brief Gets the path of the cache file of a model.
+	 * @param modelName The name of the model definition.
+	 */
+	std::string getPath(const std::string& modelName) const;
+
+	/**
+	 * @brief Calculates a hash of the contents of a model definition file.
+	 * @param modelName The name of the model definition.
+	 * @param hash Set to the hash.
+	 * @return False if the definition file couldn't be read, in which case the icon can't be cached.
+	 */
+	bool getDefinitionHash(const std::string& modelName, std::uint64_t& hash) const;
+};
+
+}
+
+}
+
+}
+
+}
+
+#endif
@@ -25,6 +25,7 @@
 #endif
 
 #include "IconManager.h"
+#include "IconCache.h"
 
 #include "components/ogre/EmberOgre.h"
 #include "components/ogre/World.h"
@@ -39,6 +40,8 @@
 #include "components/ogre/mapping/ModelActionCreator.h"
 #include "services/server/ServerService.h"
 #include "services/EmberServices.h"
+#include "services/config/ConfigService.h"
+#include "framework/osdir.h"
 #include <Eris/Connection.h>
 
 #include <OgreTextureManager.h>
@@ -82,6 +85,20 @@ IconManager::IconManager() :
 	// 	mIconRenderer.setWorker(new DirectRendererWorker(mIconRenderer));
 
 	mIconRenderer.setWorker(new DelayedIconRendererWorker(mIconRenderer));
+
+	auto& configService = EmberServices::getSingleton().getConfigService();
+	if (!configService.itemExists("graphics", "iconcache") || static_cast<bool>(configService.getValue("graphics", "iconcache"))) {
+		std::string directory = configService.getHomeDirectory(BaseDirType_CACHE) + "/icons/";
+		try {
+			oslink::directory osdir(directory);
+			if (!osdir.isExisting()) {
+				oslink::directory::mkdir(directory.c_str());
+			}
+			mIconRenderer.setCache(std::unique_ptr<IconCache>(new IconCache(directory, 64)));
+		} catch (const std::exception& ex) {
+			S_LOG_WARNING("Could not create directory for icon cache; rendered icons won't be cached." << ex);
+		}
+	}
 }
 
 Icon* IconManager::getIcon(int, EmberEntity* entity) {
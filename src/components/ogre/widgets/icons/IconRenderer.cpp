@@ -26,6 +26,7 @@
 
 #include "IconRenderer.h"
 #include "Icon.h"
+#include "IconCache.h"
 #include "IconImageStore.h"
 
 #include "../../model/Model.h"
@@ -39,6 +40,8 @@
 #include <OgreViewport.h>
 #include <sigc++/bind.h>
 
+#include <vector>
+
 namespace Ember
 {
 namespace OgreView
@@ -68,8 +71,26 @@ void IconRenderer::setWorker(IconRenderWorker* worker)
 	mWorker = worker;
 }
 
+void IconRenderer::setCache(std::unique_ptr<IconCache> cache)
+{
+	mCache = std::move(cache);
+}
+
 void IconRenderer::render(const std::string& modelName, Icon* icon)
 {
+	if (mCache) {
+		Ogre::Image image;
+		auto result = mCache->load(modelName, image);
+		if (result != IconCache::LoadResult::Missing) {
+			blitPixelsToIcon(image.getPixelBox(), icon);
+		}
+		if (result == IconCache::LoadResult::Current) {
+			return;
+		}
+		//Render the icon anew, and keep showing the stale icon until that's done.
+		mIconsToCache[icon] = modelName;
+	}
+
 	auto modelDef = Model::ModelDefinitionManager::getSingleton().getByName(modelName);
 	if (modelDef) {
 		auto model = std::make_shared<Model::Model>(*getRenderContext()->getSceneManager(), modelDef);
@@ -80,6 +101,8 @@ void IconRenderer::render(const std::string& modelName, Icon* icon)
 			//If it's being loaded in a background thread, listen for reloading and render it then. The "Reload" signal will be emitted in the main thread.
 			model->Reloaded.connect([=] { renderDelayed(model, icon); });
 		}
+	} else {
+		mIconsToCache.erase(icon);
 	}
 }
 
@@ -162,11 +185,39 @@ void IconRenderer::blitRenderToIcon(Icon* icon)
 			S_LOG_WARNING("Got exception when trying to lock buffers. This will lead to some corrupt icons.");
 		}
 
+		auto I = mIconsToCache.find(icon);
+		if (I != mIconsToCache.end()) {
+			try {
+				std::vector<Ogre::uchar> data(Ogre::PixelUtil::getMemorySize(sourceBox.getWidth(), sourceBox.getHeight(), 1, Ogre::PF_A8R8G8B8));
+				Ogre::PixelBox pixels(sourceBox.getWidth(), sourceBox.getHeight(), 1, Ogre::PF_A8R8G8B8, data.data());
+				srcBuffer->blitToMemory(sourceBox, pixels);
+				mCache->store(I->second, pixels);
+			} catch (const std::exception& ex) {
+				S_LOG_WARNING("Could not read back rendered icon for storing in the cache." << ex);
+			}
+			mIconsToCache.erase(I);
+		}
+
 		//Now that the icon is updated, emit a signal to this effect.
 		icon->EventUpdated.emit();
 	}
 }
 
+void IconRenderer::blitPixelsToIcon(const Ogre::PixelBox& pixels, Icon* icon)
+{
+	try {
+		Ogre::HardwarePixelBufferSharedPtr dstBuffer = icon->getImageStoreEntry()->getTexture()->getBuffer();
+		if (dstBuffer->isLocked()) {
+			dstBuffer->unlock();
+		}
+		dstBuffer->blitFromMemory(pixels, icon->getImageStoreEntry()->getBox());
+	} catch (const std::exception& ex) {
+		S_LOG_WARNING("Could not upload cached icon." << ex);
+		return;
+	}
+	icon->EventUpdated.emit();
+}
+
 SimpleRenderContext* IconRenderer::getRenderContext()
 {
 	return mRenderContext.get();
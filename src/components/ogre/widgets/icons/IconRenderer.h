@@ -27,6 +27,7 @@
 #include <memory>
 #include "components/ogre/EmberOgrePrerequisites.h"
 #include <queue>
+#include <unordered_map>
 #include <OgreFrameListener.h>
 #include <components/ogre/SceneNodeProvider.h>
 
@@ -45,6 +46,7 @@ namespace Gui {
 namespace Icons {
 
 class Icon;
+class IconCache;
 class IconRenderer;
 class IconImageStoreEntry;
 class DelayedIconRendererWorker;
@@ -198,6 +200,7 @@ public:
 
     /**
      * Renders a model by the specified name to the icon.
+     * If there's a cache, and it has an up to date icon for the model, that's used instead and the model is never loaded.
      * @param modelName The name of the model to render.
      * @param icon The icon it should be rendered to.
      */
@@ -223,6 +226,12 @@ public:
      */
     void setWorker(IconRenderWorker* worker);
 
+    /**
+     * @brief Sets a cache in which rendered icons are stored, and from which they are loaded.
+     * @param cache The cache.
+     */
+    void setCache(std::unique_ptr<IconCache> cache);
+
 
     /**
      * Performs the actual rendering op.
@@ -246,6 +255,23 @@ protected:
 	IconRenderWorker* mWorker;
 	SceneNodeProvider mSceneNodeProvider;
 
+	/**
+	 * @brief An optional cache of rendered icons.
+	 */
+	std::unique_ptr<IconCache> mCache;
+
+	/**
+	 * @brief Icons being rendered which should be stored in the cache once they are done, with the names of their models.
+	 */
+	std::unordered_map<Icon*, std::string> mIconsToCache;
+
+	/**
+	 * @brief Uploads the pixels of an icon, as loaded from the cache, to the icon texture.
+	 * @param pixels The pixels.
+	 * @param icon The icon.
+	 */
+	void blitPixelsToIcon(const Ogre::PixelBox& pixels, Icon* icon);
+
 	/**
 	 * @brief Call this when the model is being rendered in a backround thread, and we want to render it to the icon once it's done.
 	 * @param model The model.
@@ -50,6 +50,18 @@ public:
 	 */
 	virtual bool getHeight(const TerrainPosition& atPosition, float& height) const = 0;
 
+	/**
+	 * @brief Gets the heights for a batch of positions in the world.
+	 *
+	 * This gives the same heights as getHeight(), but is much faster when many heights are needed at once, such as when placing foliage.
+	 * @param xs The x positions, in world space.
+	 * @param ys The y positions, in world space.
+	 * @param heights The heights will be stored here. Must have room for "count" values. Positions without a valid segment get the default height of the terrain.
+	 * @param count The number of positions.
+	 * @returns The number of positions for which there was a valid, populated segment.
+	 */
+	virtual size_t getHeights(const float* xs, const float* ys, float* heights, size_t count) const = 0;
+
     /**
      * @brief Performs a fast copy of the raw height data for the supplied area.
      * @param xMin Minimum x coord of the area.
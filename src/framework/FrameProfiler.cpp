@@ -0,0 +1,144 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace Ember
+{
+
+FrameProfiler::FrameProfiler(size_t capacity) :
+		mFrames(std::max<size_t>(capacity, 1)), mNextFrame(0), mFrameCount(0), mCurrentFrame(nullptr), mEnabled(false)
+{
+}
+
+void FrameProfiler::setEnabled(bool enabled)
+{
+	mEnabled = enabled;
+	mCurrentFrame = nullptr;
+	if (enabled) {
+		mNextFrame = 0;
+		mFrameCount = 0;
+	}
+}
+
+void FrameProfiler::startFrame(unsigned long frameNumber)
+{
+	if (!mEnabled) {
+		return;
+	}
+	Frame& frame = mFrames[mNextFrame];
+	frame.number = frameNumber;
+	frame.start = frame.end = std::chrono::steady_clock::now();
+	frame.phaseCount = 0;
+	mCurrentFrame = &frame;
+}
+
+void FrameProfiler::endFrame()
+{
+	if (!mCurrentFrame) {
+		return;
+	}
+	mCurrentFrame->end = std::chrono::steady_clock::now();
+	mCurrentFrame = nullptr;
+	mNextFrame = (mNextFrame + 1) % mFrames.size();
+	if (mFrameCount < mFrames.size()) {
+		mFrameCount++;
+	}
+}
+
+size_t FrameProfiler::getFrameCount() const
+{
+	return mFrameCount;
+}
+
+const char* FrameProfiler::getIndexedName(const char* name, size_t index)
+{
+	std::vector<const char*>* names = nullptr;
+	for (auto& entry : mIndexedNameLookup) {
+		if (entry.first == name) {
+			names = &entry.second;
+			break;
+		}
+	}
+	if (!names) {
+		mIndexedNameLookup.emplace_back(name, std::vector<const char*>());
+		names = &mIndexedNameLookup.back().second;
+	}
+	while (names->size() <= index) {
+		std::stringstream ss;
+		ss << name << "[" << names->size() << "]";
+		mIndexedNames.push_back(ss.str());
+		names->push_back(mIndexedNames.back().c_str());
+	}
+	return (*names)[index];
+}
+
+namespace
+{
+void writeJsonString(std::ostream& stream, const char* string)
+{
+	stream << '"';
+	for (const char* c = string; *c; ++c) {
+		if (*c == '"' || *c == '\\') {
+			stream << '\\';
+		}
+		stream << *c;
+	}
+	stream << '"';
+}
+
+void writeEvent(std::ostream& stream, const char* name, const char* category, FrameProfiler::TimePoint origin, FrameProfiler::TimePoint start, FrameProfiler::TimePoint end,
+		unsigned long frameNumber)
+{
+	auto ts = std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count();
+	auto dur = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	stream << "{\"name\":";
+	writeJsonString(stream, name);
+	stream << ",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << ts << ",\"dur\":" << dur << ",\"args\":{\"frame\":" << frameNumber << "}}";
+}
+}
+
+void FrameProfiler::writeChromeTrace(std::ostream& stream) const
+{
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	if (mFrameCount) {
+		size_t firstFrame = (mNextFrame + mFrames.size() - mFrameCount) % mFrames.size();
+		TimePoint origin = mFrames[firstFrame].start;
+		for (size_t i = 0; i < mFrameCount; ++i) {
+			const Frame& frame = mFrames[(firstFrame + i) % mFrames.size()];
+			if (!first) {
+				stream << ",";
+			}
+			first = false;
+			stream << "\n";
+			writeEvent(stream, "Frame", "frame", origin, frame.start, frame.end, frame.number);
+			for (size_t j = 0; j < frame.phaseCount; ++j) {
+				const Phase& phase = frame.phases[j];
+				stream << ",\n";
+				writeEvent(stream, phase.name, "phase", origin, phase.start, phase.end, frame.number);
+			}
+		}
+	}
+	stream << "\n]}\n";
+}
+
+}
@@ -0,0 +1,220 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FRAMEPROFILER_H_
+#define FRAMEPROFILER_H_
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Ember
+{
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Records how long each phase of each frame takes.
+ *
+ * The main loop marks the start and end of each frame, and of each phase within it (such as polling io or rendering). The records
+ * are kept in a ring buffer, holding the latest frames, which can be written out in the Chrome trace format. Open such a file in
+ * "chrome://tracing" to see exactly where the time was spent in frames which took too long.
+ *
+ * The profiler should only be used from the main thread. When disabled all calls are close to free.
+ */
+class FrameProfiler
+{
+public:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	/**
+	 * @brief The maximum number of phases recorded for each frame. Any more phases are ignored.
+	 */
+	static const size_t MaxPhasesPerFrame = 64;
+
+	/**
+	 * @brief A timed phase of a frame.
+	 */
+	struct Phase
+	{
+		/**
+		 * @brief The name of the phase. This must be a pointer to a string which outlives the profiler.
+		 */
+		const char* name;
+		TimePoint start;
+		TimePoint end;
+	};
+
+	/**
+	 * @brief A recorded frame.
+	 */
+	struct Frame
+	{
+		unsigned long number;
+		TimePoint start;
+		TimePoint end;
+		size_t phaseCount;
+		std::array<Phase, MaxPhasesPerFrame> phases;
+	};
+
+	/**
+	 * @brief Times a phase for as long as the instance is alive.
+	 */
+	class ScopedPhase
+	{
+	public:
+		ScopedPhase(FrameProfiler& profiler, const char* name) :
+				mPhase(profiler.startPhase(name))
+		{
+		}
+
+		~ScopedPhase()
+		{
+			if (mPhase) {
+				mPhase->end = std::chrono::steady_clock::now();
+			}
+		}
+
+	private:
+		Phase* mPhase;
+	};
+
+	/**
+	 * @brief Ctor.
+	 * @param capacity The number of frames to keep records for.
+	 */
+	explicit FrameProfiler(size_t capacity = 600);
+
+	/**
+	 * @brief Enables or disables recording. Enabling clears any earlier records.
+	 * @param enabled True if frames should be recorded.
+	 */
+	void setEnabled(bool enabled);
+
+	bool isEnabled() const
+	{
+		return mEnabled;
+	}
+
+	/**
+	 * @brief Marks the start of a new frame.
+	 * @param frameNumber The number of the frame.
+	 */
+	void startFrame(unsigned long frameNumber);
+
+	/**
+	 * @brief Marks the end of the current frame.
+	 */
+	void endFrame();
+
+	/**
+	 * @brief Starts a phase in the current frame.
+	 *
+	 * Prefer to use ScopedPhase.
+	 * @param name The name of the phase. This must be a pointer to a string which outlives the profiler.
+	 * @return The phase, whose end time should be set when it's done, or null if it's not recorded.
+	 */
+	Phase* startPhase(const char* name)
+	{
+		if (!mCurrentFrame || mCurrentFrame->phaseCount == MaxPhasesPerFrame) {
+			return nullptr;
+		}
+		Phase& phase = mCurrentFrame->phases[mCurrentFrame->phaseCount++];
+		phase.name = name;
+		phase.start = phase.end = std::chrono::steady_clock::now();
+		return &phase;
+	}
+
+	/**
+	 * @brief Emits a signal, recording each listener as a separate phase.
+	 *
+	 * When disabled the signal is just emitted as usual.
+	 * @param signal A sigc++ signal.
+	 * @param name The name of the signal. The phases are named "name[index of listener]".
+	 * @param args The arguments to emit.
+	 */
+	template<typename TSignal, typename ... TArgs>
+	void emit(TSignal& signal, const char* name, TArgs&&... args)
+	{
+		if (!mCurrentFrame) {
+			signal.emit(std::forward<TArgs>(args)...);
+			return;
+		}
+		//Copy the slots, so that listeners can disconnect while we iterate.
+		std::vector<typename TSignal::slot_type> slots(signal.slots().begin(), signal.slots().end());
+		for (size_t i = 0; i < slots.size(); ++i) {
+			auto& slot = slots[i];
+			if (!slot.empty() && !slot.blocked()) {
+				ScopedPhase phase(*this, getIndexedName(name, i));
+				slot(args...);
+			}
+		}
+	}
+
+	/**
+	 * @brief Gets the number of recorded frames.
+	 * @return The number of frames.
+	 */
+	size_t getFrameCount() const;
+
+	/**
+	 * @brief Writes all recorded frames in the Chrome trace event format.
+	 * @param stream The stream to write to.
+	 */
+	void writeChromeTrace(std::ostream& stream) const;
+
+private:
+
+	std::vector<Frame> mFrames;
+
+	/**
+	 * @brief The index in mFrames where the next frame will be recorded.
+	 */
+	size_t mNextFrame;
+
+	/**
+	 * @brief The number of recorded frames.
+	 */
+	size_t mFrameCount;
+
+	/**
+	 * @brief The frame currently being recorded, if any.
+	 */
+	Frame* mCurrentFrame;
+
+	bool mEnabled;
+
+	/**
+	 * @brief Generated phase names. A deque is used so that pointers to the names stay valid.
+	 */
+	std::deque<std::string> mIndexedNames;
+
+	/**
+	 * @brief Lookup of generated names, by signal name and index.
+	 */
+	std::vector<std::pair<const char*, std::vector<const char*>>> mIndexedNameLookup;
+
+	const char* getIndexedName(const char* name, size_t index);
+};
+
+}
+
+#endif /* FRAMEPROFILER_H_ */
@@ -0,0 +1,78 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef EMBER_HASHER_H
+#define EMBER_HASHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Ember
+{
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief Calculates a 64 bit FNV-1a hash.
+ *
+ * This is used for naming files in the disk caches, and is neither meant to be fast for large amounts of data nor cryptographically secure.
+ */
+class Hasher
+{
+public:
+	Hasher() : mHash(14695981039346656037ULL)
+	{
+	}
+
+	explicit Hasher(std::uint64_t seed) : Hasher()
+	{
+		add(seed);
+	}
+
+	void add(const void* data, size_t size)
+	{
+		auto bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; ++i) {
+			mHash = (mHash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+
+	template<typename T>
+	void add(const T& value)
+	{
+		add(&value, sizeof(value));
+	}
+
+	void add(const std::string& value)
+	{
+		add(value.size());
+		add(value.data(), value.size());
+	}
+
+	std::uint64_t get() const
+	{
+		return mHash;
+	}
+
+private:
+	std::uint64_t mHash;
+};
+
+}
+
+#endif
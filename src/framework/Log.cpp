@@ -30,6 +30,13 @@
 
 #include <boost/date_time.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 //#include <stdio.h>
 
 
@@ -54,14 +61,214 @@ public:
 	}
 };
 
+/**
+ * @brief Guards the observers, making sure that they aren't called concurrently.
+ *
+ * This is recursive since observers might log messages themselves.
+ */
+static std::recursive_mutex sObserverMutex;
+
+/**
+ * @brief The context of the message currently being passed to the observers in this thread.
+ */
+static thread_local Log::MessageContext sCurrentMessageContext;
+
+/**
+ * @brief Passes messages on to the observers in a separate thread.
+ *
+ * Messages are put in a bounded lock free multi producer, single consumer ring buffer. Each slot has a sequence number which tells
+ * whether it's free to be written to or ready to be read, so producers only need to compete for the write position.
+ * If the buffer is full producers will wait for the writer thread, so no messages are ever lost.
+ */
+class AsyncLogWriter
+{
+public:
+	static const size_t Capacity = 4096;
+
+	AsyncLogWriter() :
+			mSlots(Capacity), mEnqueuePos(0), mDequeuePos(0), mWriterSleeping(false), mStop(false)
+	{
+		for (size_t i = 0; i < Capacity; ++i) {
+			mSlots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		mThread = std::thread([this]() {run();});
+	}
+
+	~AsyncLogWriter()
+	{
+		mStop = true;
+		wake();
+		mThread.join();
+	}
+
+	/**
+	 * @brief Returns true if called from the writer thread.
+	 */
+	bool isWriterThread() const
+	{
+		return std::this_thread::get_id() == mThread.get_id();
+	}
+
+	void push(std::string&& message, const std::string& file, const int line, const Log::MessageImportance importance, const Log::MessageContext& context)
+	{
+		size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+		Slot* slot;
+		while (true) {
+			slot = &mSlots[pos & (Capacity - 1)];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+			if (diff == 0) {
+				if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (diff < 0) {
+				//The buffer is full; wait for the writer to catch up.
+				wake();
+				std::this_thread::yield();
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			} else {
+				pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		slot->message = std::move(message);
+		slot->file = file;
+		slot->line = line;
+		slot->importance = importance;
+		slot->context = context;
+		slot->sequence.store(pos + 1, std::memory_order_release);
+
+		if (mWriterSleeping.load(std::memory_order_acquire)) {
+			wake();
+		}
+	}
+
+	/**
+	 * @brief Waits until all messages pushed before this call have been written.
+	 */
+	void flush()
+	{
+		size_t target = mEnqueuePos.load(std::memory_order_acquire);
+		while (mDequeuePos.load(std::memory_order_acquire) < target) {
+			wake();
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		std::string message;
+		std::string file;
+		int line;
+		Log::MessageImportance importance;
+		Log::MessageContext context;
+	};
+
+	std::vector<Slot> mSlots;
+
+	/**
+	 * @brief The next position to write to. Producers compete for this.
+	 */
+	std::atomic<size_t> mEnqueuePos;
+
+	/**
+	 * @brief The next position to read from. Only altered by the writer thread.
+	 */
+	std::atomic<size_t> mDequeuePos;
+
+	std::atomic<bool> mWriterSleeping;
+	std::atomic<bool> mStop;
+	std::mutex mWakeMutex;
+	std::condition_variable mWakeCondition;
+	std::thread mThread;
+
+	void wake()
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mWakeCondition.notify_one();
+	}
+
+	bool hasMessage(size_t pos) const
+	{
+		return mSlots[pos & (Capacity - 1)].sequence.load(std::memory_order_acquire) == pos + 1;
+	}
+
+	void run()
+	{
+		size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+		while (true) {
+			if (hasMessage(pos)) {
+				Slot& slot = mSlots[pos & (Capacity - 1)];
+				{
+					std::lock_guard<std::recursive_mutex> lock(sObserverMutex);
+					Log::dispatchMessage(slot.message, slot.file, slot.line, slot.importance, slot.context);
+				}
+				slot.message.clear();
+				slot.sequence.store(pos + Capacity, std::memory_order_release);
+				pos++;
+				mDequeuePos.store(pos, std::memory_order_release);
+				continue;
+			}
+			//Only stop once all messages which have been claimed also have been written.
+			if (mStop && mEnqueuePos.load(std::memory_order_acquire) == pos) {
+				break;
+			}
+			std::unique_lock<std::mutex> lock(mWakeMutex);
+			mWriterSleeping.store(true, std::memory_order_release);
+			//Producers don't take the lock when checking if the writer is sleeping, so a wake up might be missed. The timeout makes sure that it doesn't matter much.
+			mWakeCondition.wait_for(lock, std::chrono::milliseconds(10), [&]() {return hasMessage(pos) || mStop;});
+			mWriterSleeping.store(false, std::memory_order_release);
+		}
+	}
+};
+
 Log::ObserverList Log::sObserverList;
 
 int Log::sNumberOfExternalObservers = 0;
 
 StdOutLogObserver Log::sStdOutLogObserver;
 
-unsigned long Log::sCurrentFrame = 0;
-boost::posix_time::ptime Log::sCurrentFrameStartMilliseconds = boost::posix_time::microsec_clock::local_time();
+std::atomic<int> Log::sMinimumImportance(Log::INFO);
+
+/**
+ * @brief The asynchronous writer, if asynchronous mode is enabled.
+ *
+ * This is declared after the observer list so that it's destroyed, and all messages written, before the list.
+ */
+static std::unique_ptr<AsyncLogWriter> sAsyncLogWriter;
+
+/**
+ * @brief Guards the creation and destruction of the asynchronous writer.
+ */
+static std::mutex sAsyncLogWriterMutex;
+
+/**
+ * @brief Quick check for whether asynchronous mode is enabled.
+ */
+static std::atomic<AsyncLogWriter*> sActiveAsyncLogWriter(nullptr);
+
+/**
+ * @brief The number of threads currently pushing messages to the asynchronous writer.
+ *
+ * The writer is only destroyed once this is zero.
+ */
+static std::atomic<int> sAsyncLogProducers(0);
+
+/**
+ * @brief Makes sure that the writer thread is stopped, and all messages written, at exit.
+ */
+struct AsyncLogShutdown
+{
+	~AsyncLogShutdown()
+	{
+		Log::setAsynchronous(false);
+	}
+};
+static AsyncLogShutdown sAsyncLogShutdown;
+
+std::atomic<unsigned long> Log::sCurrentFrame(0);
+std::atomic<boost::posix_time::ptime> Log::sCurrentFrameStartMilliseconds(boost::posix_time::microsec_clock::local_time());
 
 
 
@@ -119,6 +326,9 @@ void Log::log (const char *file, const int line,  const MessageImportance import
 
 void Log::logVarParam (const char *file, const int line, const MessageImportance importance, const char *message, va_list argptr)
 {
+	if (!isEnabled(importance)) {
+		return;
+	}
 	char Buffer[MESSAGE_BUFFER_SIZE];
 	vsprintf((char *) Buffer, message, argptr);
 	sendMessage(std::string((char *) Buffer), file, line, importance);
@@ -155,6 +365,7 @@ LoggingInstance Log::slog (const std::string & file)
 
 void Log::addObserver(LogObserver* observer)
 {
+	std::lock_guard<std::recursive_mutex> lock(sObserverMutex);
 	//test on already existing observer
 	if (std::find(sObserverList.begin(), sObserverList.end(), observer) == sObserverList.end()) {
 		if (sNumberOfExternalObservers == 0) {
@@ -163,11 +374,15 @@ void Log::addObserver(LogObserver* observer)
 		//no existing observer, add a new
 		sObserverList.push_back(observer);
 		sNumberOfExternalObservers++;
+		updateMinimumImportance();
 	}
 }
 
 int Log::removeObserver(LogObserver* observer)
 {
+	//Make sure that the observer gets all messages logged before it was removed.
+	flush();
+	std::lock_guard<std::recursive_mutex> lock(sObserverMutex);
 	ObserverList::iterator I = std::find(sObserverList.begin(), sObserverList.end(), observer);
 	if (I != sObserverList.end()) {
 		sObserverList.erase(I);
@@ -175,6 +390,7 @@ int Log::removeObserver(LogObserver* observer)
 		if (sNumberOfExternalObservers == 0) {
 			sObserverList.push_back(&sStdOutLogObserver);
 		}
+		updateMinimumImportance();
 		return 0;
 	}
 	return -1;
@@ -189,12 +405,85 @@ Log::HexNumber Log::hexNumber(const int intDecimal)
 
 void Log::sendMessage(const std::string & message, const std::string & file, const int line, const MessageImportance importance)
 {
+	sendMessage(std::string(message), file, line, importance);
+}
+
+void Log::sendMessage(std::string&& message, const std::string & file, const int line, const MessageImportance importance)
+{
+	MessageContext context;
+	context.time = boost::posix_time::microsec_clock::local_time();
+	context.threadId = std::this_thread::get_id();
+	context.frame = sCurrentFrame;
+	context.frameStart = sCurrentFrameStartMilliseconds;
+
+	sAsyncLogProducers++;
+	auto writer = sActiveAsyncLogWriter.load();
+	//Messages logged by the observers themselves are written directly, since the writer thread otherwise could end up waiting for itself.
+	if (writer && !writer->isWriterThread()) {
+		writer->push(std::move(message), file, line, importance, context);
+		sAsyncLogProducers--;
+		return;
+	}
+	sAsyncLogProducers--;
 
+	std::lock_guard<std::recursive_mutex> lock(sObserverMutex);
+	dispatchMessage(message, file, line, importance, context);
+}
+
+void Log::dispatchMessage(const std::string& message, const std::string& file, const int line, const MessageImportance importance, const MessageContext& context)
+{
+	MessageContext previousContext = sCurrentMessageContext;
+	sCurrentMessageContext = context;
 	for (ObserverList::iterator i = sObserverList.begin(); i != sObserverList.end(); i++) {
 		if (static_cast<int>(importance) >= static_cast<int>((*i)->getFilter())) {
 			(*i)->onNewMessage(message, file, line, importance);
 		}
 	}
+	sCurrentMessageContext = previousContext;
+}
+
+void Log::updateMinimumImportance()
+{
+	std::lock_guard<std::recursive_mutex> lock(sObserverMutex);
+	int minimum = CRITICAL;
+	for (auto observer : sObserverList) {
+		minimum = std::min(minimum, static_cast<int>(observer->getFilter()));
+	}
+	sMinimumImportance.store(minimum, std::memory_order_relaxed);
+}
+
+void Log::setAsynchronous(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(sAsyncLogWriterMutex);
+	if (enabled && !sAsyncLogWriter) {
+		sAsyncLogWriter.reset(new AsyncLogWriter());
+		sActiveAsyncLogWriter.store(sAsyncLogWriter.get());
+	} else if (!enabled && sAsyncLogWriter) {
+		//Messages logged from now on will be written synchronously. Wait for any threads still pushing to the writer before destroying it.
+		sActiveAsyncLogWriter.store(nullptr);
+		while (sAsyncLogProducers.load() != 0) {
+			std::this_thread::yield();
+		}
+		sAsyncLogWriter.reset();
+	}
+}
+
+bool Log::isAsynchronous()
+{
+	return sActiveAsyncLogWriter.load(std::memory_order_acquire) != nullptr;
+}
+
+void Log::flush()
+{
+	auto writer = sActiveAsyncLogWriter.load(std::memory_order_acquire);
+	if (writer && !writer->isWriterThread()) {
+		writer->flush();
+	}
+}
+
+const Log::MessageContext& Log::getMessageContext()
+{
+	return sCurrentMessageContext;
 }
 
 }
@@ -25,9 +25,11 @@
 
 #include <boost/date_time/posix_time/ptime.hpp>
 
+#include <atomic>
 #include <cstdarg>
 #include <string>
 #include <list>
+#include <thread>
 
 //======================================================================
 // Short type macros
@@ -67,7 +69,12 @@ class LogObserver;
  *
  * To less the amount of messages passed through to the observers, you can specify a filter by
  * levels of importance. Thus all messages above or equal a filter level of importance are
- * written/passed by the callback to an observer.
+ * written/passed by the callback to an observer. Messages which no observer would accept are
+ * discarded before they are formatted (when using the S_LOG_* macros or the printf-like methods).
+ *
+ * By default the observers are called in the thread which logs the message. In asynchronous mode
+ * (see setAsynchronous()) messages are instead put on a lock free queue, and a separate writer thread
+ * passes them on to the observers. Either way observers are never called concurrently.
  *
  *
  * HINT: Names marked with * were chosen this short, because they are intentended to be used very
@@ -93,10 +100,12 @@ class LogObserver;
  */
 
 class StdOutLogObserver;
+class AsyncLogWriter;
 
 class Log
 {
 	friend class StdOutLogObserver;
+	friend class AsyncLogWriter;
 private:
 
 	/**
@@ -129,6 +138,32 @@ public:
 		VERBOSE = 0, INFO = 1, WARNING = 2, FAILURE = 3, CRITICAL = 4
 	};
 
+	/**
+	 * @brief Describes where and when a message was logged.
+	 */
+	struct MessageContext
+	{
+		/**
+		 * @brief The time when the message was logged.
+		 */
+		boost::posix_time::ptime time;
+
+		/**
+		 * @brief The thread which logged the message.
+		 */
+		std::thread::id threadId;
+
+		/**
+		 * @brief The frame in which the message was logged.
+		 */
+		unsigned long frame;
+
+		/**
+		 * @brief The start time of the frame in which the message was logged.
+		 */
+		boost::posix_time::ptime frameStart;
+	};
+
 	/**
 	 * Pseudo-enum necessary to make the END_MESSAGE constant not be mixed with ints
 	 */
@@ -141,15 +176,17 @@ public:
 	 * @brief Counter for the current frame.
 	 *
 	 * Used when providing detailed log output. This needs to be set from outside.
+	 * Atomic since messages can be logged from any thread.
 	 */
-    static unsigned long sCurrentFrame;
+    static std::atomic<unsigned long> sCurrentFrame;
 
     /**
      * @brief Start time of the current frame.
      *
 	 * Used when providing detailed log output. This needs to be set from outside.
+	 * Atomic since messages can be logged from any thread.
      */
-    static boost::posix_time::ptime sCurrentFrameStartMilliseconds;
+    static std::atomic<boost::posix_time::ptime> sCurrentFrameStartMilliseconds;
 
 
 	/**
@@ -225,6 +262,63 @@ public:
 	 */
 	static void sendMessage(const std::string & message, const std::string & file, const int line, const MessageImportance importance);
 
+	/**
+	 * @brief Sends a message, taking ownership of the message string.
+	 *
+	 * This avoids copying the message when logging asynchronously.
+	 */
+	static void sendMessage(std::string&& message, const std::string & file, const int line, const MessageImportance importance);
+
+	/**
+	 * @brief Checks whether any observer would accept a message of the specified importance.
+	 *
+	 * This is cheap, and is used for discarding messages before they are formatted.
+	 * @param importance The importance of a message.
+	 * @return True if the message would be accepted by at least one observer.
+	 */
+	static bool isEnabled(const MessageImportance importance)
+	{
+		return static_cast<int>(importance) >= sMinimumImportance.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Recalculates the lowest importance accepted by any observer.
+	 *
+	 * This is called automatically when an observer's filter changes.
+	 */
+	static void updateMinimumImportance();
+
+	/**
+	 * @brief Switches between synchronous and asynchronous logging.
+	 *
+	 * In asynchronous mode messages are put on a queue, and a separate writer thread passes them to the observers. This means that
+	 * threads which log don't have to wait for the observers to write the messages.
+	 * When switching back to synchronous mode all queued messages are first written, and the writer thread is stopped.
+	 * @param enabled True if messages should be logged asynchronously.
+	 */
+	static void setAsynchronous(bool enabled);
+
+	/**
+	 * @brief Returns true if messages are logged asynchronously.
+	 * @return True if in asynchronous mode.
+	 */
+	static bool isAsynchronous();
+
+	/**
+	 * @brief Blocks until all messages which have been logged so far have been passed to the observers.
+	 *
+	 * This is only needed in asynchronous mode.
+	 */
+	static void flush();
+
+	/**
+	 * @brief Gets the context of the message which currently is passed to the observers.
+	 *
+	 * Only valid when called from within LogObserver::onNewMessage.
+	 * @return The context of the current message.
+	 */
+	static const MessageContext& getMessageContext();
+
 private:
 
 	typedef std::list<LogObserver*> ObserverList;
@@ -251,6 +345,18 @@ private:
 	 */
 	static StdOutLogObserver sStdOutLogObserver;
 
+	/**
+	 * @brief The lowest importance accepted by any observer.
+	 */
+	static std::atomic<int> sMinimumImportance;
+
+	/**
+	 * @brief Passes a message to all observers.
+	 *
+	 * The caller must make sure that this isn't called concurrently.
+	 */
+	static void dispatchMessage(const std::string& message, const std::string& file, const int line, const MessageImportance importance, const MessageContext& context);
+
 };
 
 }
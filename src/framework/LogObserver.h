@@ -63,6 +63,7 @@ public:
 	void setFilter (Log::MessageImportance filter)
 	{
 		mFilter = filter;
+		Log::updateMinimumImportance();
 	}
 
 private:
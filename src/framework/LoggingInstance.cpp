@@ -65,7 +65,7 @@ LoggingInstance::~LoggingInstance()
 {
 	//If we haven't sent to the service yet, do it now.
 	if (!mMessage.empty()) {
-		Log::sendMessage (mMessage, mFile, mLine, mImportance);
+		Log::sendMessage(std::move(mMessage), mFile, mLine, mImportance);
 	}
 }
 
@@ -138,8 +138,8 @@ LoggingInstance& LoggingInstance::operator<< (unsigned long long ulongLongToAdd)
 
 void LoggingInstance::operator<< (Log::EndMessageEnum endMessage)
 {
-	Log::sendMessage(mMessage, mFile, mLine, mImportance);
-	mMessage = "";
+	Log::sendMessage(std::move(mMessage), mFile, mLine, mImportance);
+	mMessage.clear();
 }
 
 LoggingInstance& LoggingInstance::operator<< (const std::exception& exception)
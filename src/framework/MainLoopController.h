@@ -131,6 +131,13 @@ public:
 	 */
 	sigc::signal<void, const TimeFrame&, unsigned int> EventFrameProcessed;
 
+	/**
+	 * @brief Emitted once each frame, after the main thread handlers have been processed, to let deferred main thread work be done.
+	 * Listeners should try to stay within the time frame, but should make at least some progress each frame even if there's no time left in it.
+	 * The parameter sent is the time frame for this frame.
+	 */
+	sigc::signal<void, const TimeFrame&> EventProcessMainThreadTasks;
+
 private:
 
 	/**
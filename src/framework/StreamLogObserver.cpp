@@ -79,7 +79,9 @@ std::atomic<int> ThreadIdentifier::sCounter;
     void StreamLogObserver::onNewMessage(const std::string & message, const std::string & file, const int & line, 
                                                  const Log::MessageImportance & importance)
     {
-    	boost::posix_time::ptime currentTime = boost::posix_time::microsec_clock::local_time();
+    	//Use the time and thread of when the message was logged, since it might be written later by another thread.
+    	const Log::MessageContext& context = Log::getMessageContext();
+    	const boost::posix_time::ptime& currentTime = context.time;
 
         myOut.fill('0');
         myOut << "[";
@@ -94,7 +96,7 @@ std::atomic<int> ThreadIdentifier::sCounter;
         	static std::map<std::thread::id, ThreadIdentifier> threadIdentifiers;
         	myOut << "(";
 			myOut.width(8);
-			myOut << ((currentTime - mStart).total_microseconds()) << ":"<< threadIdentifiers[std::this_thread::get_id()].id << ":" << Log::sCurrentFrame << ":" << (currentTime - Log::sCurrentFrameStartMilliseconds).total_milliseconds() << ")";
+			myOut << ((currentTime - mStart).total_microseconds()) << ":"<< threadIdentifiers[context.threadId].id << ":" << context.frame << ":" << (currentTime - context.frameStart).total_milliseconds() << ")";
         }
         myOut << "] ";
 
@@ -55,6 +55,15 @@ public:
 	 */
 	virtual bool executeTaskInMainThread() { return true; };
 
+	/**
+	 * @brief Gets the priority of the task.
+	 * Tasks with a higher priority are executed before tasks with a lower priority. Tasks with the same priority are executed in the order they were enqueued.
+	 * A typical use is to return the negated distance to the camera, so that work close to the camera is done first.
+	 * @note This is called once, in the thread enqueuing the task, so it's fine to use state that's only safe to access from that thread.
+	 * @return The priority of the task. The default is 0.
+	 */
+	virtual float getPriority() const { return 0; };
+
 	/**
 	 * @brief Gets the name of the task.
 	 * This is mainly used for logging purposes.
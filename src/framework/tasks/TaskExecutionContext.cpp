@@ -20,6 +20,7 @@
 #include "TaskExecutor.h"
 #include "TaskUnit.h"
 #include "ITask.h"
+#include "TaskGraph.h"
 
 namespace Ember
 {
@@ -54,5 +55,10 @@ void TaskExecutionContext::executeTasks(std::vector<ITask*> tasks)
 	}
 }
 
+void TaskExecutionContext::executeTaskGraph(TaskGraph& graph)
+{
+	graph.execute(*this);
+}
+
 }
 }
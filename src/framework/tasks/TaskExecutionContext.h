@@ -30,6 +30,7 @@ class TaskExecutor;
 class ITask;
 class TaskUnit;
 class ITaskExecutionListener;
+class TaskGraph;
 
 /**
  * @author Erik Ogenvik <erik@ogenvik.org>
@@ -39,6 +40,7 @@ class ITaskExecutionListener;
  */
 class TaskExecutionContext
 {
+	friend class TaskGraph;
 public:
 
 	TaskExecutionContext(TaskExecutor& executor, TaskUnit& taskUnit);
@@ -67,6 +69,16 @@ public:
 	 */
 	void executeTasks(std::vector<ITask*> tasks);
 
+	/**
+	 * @brief Executes a graph of subtasks, blocking until all of them have been executed.
+	 * Tasks which don't depend on each other are spread out over all of the executors of the queue, with the current executor helping out.
+	 * After the subtasks have been executed in the background thread, the task framework will make sure that they are executed in the main thread,
+	 * in the order they were added to the graph, before the main task is executed.
+	 * @note This should only be called from a background thread, i.e. while the task is being executed.
+	 * @param graph The graph to execute. All tasks will be transferred from the graph, which will be empty afterwards.
+	 */
+	void executeTaskGraph(TaskGraph& graph);
+
 
 private:
 
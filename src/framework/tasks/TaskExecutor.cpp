@@ -22,13 +22,20 @@
 #include "TaskUnit.h"
 #include "framework/LoggingInstance.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace Ember
 {
 
 namespace Tasks
 {
 TaskExecutor::TaskExecutor(TaskQueue& taskQueue) :
-	mTaskQueue(taskQueue), mActive(true)
+	mTaskQueue(taskQueue), mActive(true), mThread(nullptr), mTopPriority(std::numeric_limits<float>::lowest()), mQueueSize(0)
+{
+}
+
+void TaskExecutor::start()
 {
 	mThread = new std::thread([&](){this->run();});
 }
@@ -44,13 +51,17 @@ void TaskExecutor::run()
 	pthread_setname_np(pthread_self(), "Task Executor");
 #endif
 	while (mActive) {
-		TaskUnit* taskUnit = mTaskQueue.fetchNextTask();
+		TaskUnit* taskUnit = mTaskQueue.fetchNextTask(*this);
 		//If the queue returns a null pointer, it means that the queue is being shut down, and this executor is expected to exit its main processing loop.
 		if (taskUnit) {
 			try {
 				TaskExecutionContext context(*this, *taskUnit);
 				taskUnit->executeInBackgroundThread(context);
-				mTaskQueue.addProcessedTask(taskUnit);
+				if (taskUnit->isBackgroundOnly()) {
+					delete taskUnit;
+				} else {
+					mTaskQueue.addProcessedTask(taskUnit);
+				}
 			} catch (const std::exception& ex) {
 				S_LOG_CRITICAL("Error when executing task in background." << ex);
 				delete taskUnit;
@@ -71,7 +82,46 @@ void TaskExecutor::setActive(bool active)
 
 void TaskExecutor::join()
 {
-	mThread->join();
+	if (mThread) {
+		mThread->join();
+	}
+}
+
+size_t TaskExecutor::getQueueSize() const
+{
+	return mQueueSize;
+}
+
+void TaskExecutor::pushTask(TaskUnit* taskUnit, float priority, unsigned long sequence)
+{
+	std::unique_lock<std::mutex> lock(mQueueMutex);
+	mQueue.push_back(QueueEntry{priority, sequence, taskUnit});
+	std::push_heap(mQueue.begin(), mQueue.end());
+	updateQueueState();
+}
+
+TaskUnit* TaskExecutor::popTask(bool block)
+{
+	std::unique_lock<std::mutex> lock(mQueueMutex, std::defer_lock);
+	if (block) {
+		lock.lock();
+	} else if (!lock.try_lock()) {
+		return nullptr;
+	}
+	if (mQueue.empty()) {
+		return nullptr;
+	}
+	std::pop_heap(mQueue.begin(), mQueue.end());
+	TaskUnit* taskUnit = mQueue.back().taskUnit;
+	mQueue.pop_back();
+	updateQueueState();
+	return taskUnit;
+}
+
+void TaskExecutor::updateQueueState()
+{
+	mQueueSize = mQueue.size();
+	mTopPriority = mQueue.empty() ? std::numeric_limits<float>::lowest() : mQueue.front().priority;
 }
 
 }
@@ -19,7 +19,10 @@
 #ifndef TASKEXECUTOR_H_
 #define TASKEXECUTOR_H_
 
+#include <atomic>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 namespace Ember
 {
@@ -28,15 +31,20 @@ namespace Tasks
 {
 
 class TaskQueue;
+class TaskUnit;
 
 /**
  * @author Erik Ogenvik <erik@ogenvik.org>
  * @brief A task executor, responsible for processing tasks.
  * Each instance of this holds a thread. It's only purpose is to ask the queue for new tasks to process. If no tasks are available it will sleep (inside of TaskQueue::fetchNextTask).
+ *
+ * Each executor also owns a queue of pending task units, ordered by priority and guarded by its own mutex, so that executors don't contend on a single lock.
+ * Executors normally take work from their own queue, but will steal from the other executors when those hold more urgent work, or when their own queue is empty.
  */
 class TaskExecutor
 {
 	friend class TaskQueue;
+	friend class TaskGraph;
 public:
 
 	/**
@@ -55,8 +63,43 @@ public:
 	 */
 	void join();
 
+	/**
+	 * @brief Gets the number of task units currently waiting in this executor's queue.
+	 * @return The number of queued task units.
+	 */
+	size_t getQueueSize() const;
+
 protected:
 
+	/**
+	 * @brief An entry in the pending queue.
+	 */
+	struct QueueEntry
+	{
+		/**
+		 * @brief The priority of the task, as reported by ITask::getPriority() when enqueued.
+		 */
+		float priority;
+
+		/**
+		 * @brief A sequence number, used to keep FIFO order between tasks of the same priority.
+		 */
+		unsigned long sequence;
+
+		TaskUnit* taskUnit;
+
+		/**
+		 * @brief Ordering used for the heap; the entry which should be executed first is the "largest".
+		 */
+		bool operator<(const QueueEntry& rhs) const
+		{
+			if (priority != rhs.priority) {
+				return priority < rhs.priority;
+			}
+			return sequence > rhs.sequence;
+		}
+	};
+
 	/**
 	 * @brief The queue to which this executor belong.
 	 */
@@ -72,17 +115,63 @@ protected:
 	 */
 	std::thread* mThread;
 
+	/**
+	 * @brief Pending task units, kept as a heap.
+	 */
+	std::vector<QueueEntry> mQueue;
+
+	/**
+	 * @brief Guards mQueue.
+	 */
+	mutable std::mutex mQueueMutex;
+
+	/**
+	 * @brief The priority of the most urgent task in the queue, or the lowest possible value if the queue is empty.
+	 * This can be read without locking, which allows other executors to check for urgent work without contention.
+	 */
+	std::atomic<float> mTopPriority;
+
+	/**
+	 * @brief The number of entries in mQueue, readable without locking.
+	 */
+	std::atomic<size_t> mQueueSize;
+
 	/**
 	 * @brief Ctor.
-	 * During construction a new thread will be created and executed.
+	 * The thread isn't created until start() is called.
 	 * @param taskQueue The queue to which this executor belongs.
 	 */
 	TaskExecutor(TaskQueue& taskQueue);
 
+	/**
+	 * @brief Creates the background thread and starts processing tasks.
+	 */
+	void start();
+
 	/**
 	 * @brief Main loop method.
 	 */
 	void run();
+
+	/**
+	 * @brief Adds a task unit to this executor's queue.
+	 * @param taskUnit The task unit.
+	 * @param priority The priority of the task.
+	 * @param sequence The sequence number of the task.
+	 */
+	void pushTask(TaskUnit* taskUnit, float priority, unsigned long sequence);
+
+	/**
+	 * @brief Removes the most urgent task unit from the queue.
+	 * @param block If false, the call won't wait for the queue mutex if it's held by another thread.
+	 * @return The task unit, or null if the queue was empty (or locked, if not blocking).
+	 */
+	TaskUnit* popTask(bool block);
+
+	/**
+	 * @brief Updates the lock free state after the queue has changed. Must be called with mQueueMutex held.
+	 */
+	void updateQueueState();
 	//	void shutdown();
 };
 
@@ -0,0 +1,197 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "TaskGraph.h"
+#include "TaskExecutionContext.h"
+#include "TaskExecutor.h"
+#include "TaskQueue.h"
+#include "TaskUnit.h"
+#include "TemplateNamedTask.h"
+
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace Ember
+{
+
+namespace Tasks
+{
+
+struct TaskGraph::Execution
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+
+	/**
+	 * @brief The units of all tasks, indexed by node id. These are owned by the unit of the task owning the graph.
+	 */
+	std::vector<TaskUnit*> units;
+
+	/**
+	 * @brief For each node, the nodes which depend on it.
+	 */
+	std::vector<std::vector<NodeId>> dependents;
+
+	/**
+	 * @brief For each node, the number of dependencies not yet executed.
+	 */
+	std::vector<size_t> remainingDependencies;
+
+	std::vector<float> priorities;
+
+	/**
+	 * @brief Nodes which are ready to be executed.
+	 */
+	std::deque<NodeId> ready;
+
+	size_t completed = 0;
+};
+
+class TaskGraph::Worker : public TemplateNamedTask<TaskGraph::Worker>
+{
+public:
+	explicit Worker(std::shared_ptr<Execution> execution) :
+			mExecution(std::move(execution))
+	{
+	}
+
+	void executeTaskInBackgroundThread(TaskExecutionContext& context) override
+	{
+		//If the tasks already have been taken care of by other executors this will do nothing.
+		TaskGraph::runReadyNodes(context, mExecution);
+	}
+
+private:
+	std::shared_ptr<Execution> mExecution;
+};
+
+TaskGraph::TaskGraph()
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+	for (auto& node : mNodes) {
+		delete node.task;
+	}
+}
+
+TaskGraph::NodeId TaskGraph::addTask(ITask* task, const std::vector<NodeId>& dependencies, ITaskExecutionListener* listener)
+{
+	for (auto dependency : dependencies) {
+		assert(dependency < mNodes.size());
+	}
+	mNodes.push_back(Node{task, listener, dependencies});
+	return mNodes.size() - 1;
+}
+
+size_t TaskGraph::size() const
+{
+	return mNodes.size();
+}
+
+void TaskGraph::execute(TaskExecutionContext& context)
+{
+	if (mNodes.empty()) {
+		return;
+	}
+	auto execution = std::make_shared<Execution>();
+	execution->units.reserve(mNodes.size());
+	execution->dependents.resize(mNodes.size());
+	execution->remainingDependencies.resize(mNodes.size());
+	execution->priorities.reserve(mNodes.size());
+
+	for (NodeId id = 0; id < mNodes.size(); ++id) {
+		Node& node = mNodes[id];
+		execution->priorities.push_back(node.task->getPriority());
+		//Adding the units as subtasks makes sure that they are executed in the main thread in the order they were added to the graph.
+		execution->units.push_back(context.mTaskUnit.addSubtask(node.task, node.listener));
+		execution->remainingDependencies[id] = node.dependencies.size();
+		for (auto dependency : node.dependencies) {
+			execution->dependents[dependency].push_back(id);
+		}
+		if (node.dependencies.empty()) {
+			execution->ready.push_back(id);
+		}
+	}
+	//The tasks are now owned by the task units.
+	mNodes.clear();
+
+	//Let other executors help out with all but one of the ready tasks; this thread will take care of the rest.
+	for (size_t i = 1; i < execution->ready.size(); ++i) {
+		enqueueWorker(context, execution, execution->priorities[execution->ready[i]]);
+	}
+
+	while (true) {
+		runReadyNodes(context, execution);
+		std::unique_lock<std::mutex> lock(execution->mutex);
+		execution->cond.wait(lock, [&] {
+			return execution->completed == execution->units.size() || !execution->ready.empty();
+		});
+		if (execution->completed == execution->units.size()) {
+			break;
+		}
+	}
+}
+
+void TaskGraph::runReadyNodes(TaskExecutionContext& context, const std::shared_ptr<Execution>& execution)
+{
+	while (true) {
+		NodeId id;
+		{
+			std::unique_lock<std::mutex> lock(execution->mutex);
+			if (execution->ready.empty()) {
+				return;
+			}
+			id = execution->ready.front();
+			execution->ready.pop_front();
+		}
+
+		TaskUnit* taskUnit = execution->units[id];
+		TaskExecutionContext nodeContext(context.mExecutor, *taskUnit);
+		taskUnit->executeInBackgroundThread(nodeContext);
+
+		std::vector<NodeId> newlyReady;
+		{
+			std::unique_lock<std::mutex> lock(execution->mutex);
+			execution->completed++;
+			for (auto dependent : execution->dependents[id]) {
+				if (--execution->remainingDependencies[dependent] == 0) {
+					execution->ready.push_back(dependent);
+					newlyReady.push_back(dependent);
+				}
+			}
+		}
+		execution->cond.notify_all();
+
+		for (size_t i = 1; i < newlyReady.size(); ++i) {
+			enqueueWorker(context, execution, execution->priorities[newlyReady[i]]);
+		}
+	}
+}
+
+void TaskGraph::enqueueWorker(TaskExecutionContext& context, const std::shared_ptr<Execution>& execution, float priority)
+{
+	context.mExecutor.mTaskQueue.enqueueBackgroundTask(new Worker(execution), priority);
+}
+
+}
+
+}
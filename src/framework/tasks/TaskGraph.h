@@ -0,0 +1,130 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef TASKGRAPH_H_
+#define TASKGRAPH_H_
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+namespace Ember
+{
+
+namespace Tasks
+{
+
+class ITask;
+class ITaskExecutionListener;
+class TaskExecutionContext;
+
+/**
+ * @author Erik Ogenvik <erik@ogenvik.org>
+ * @brief A graph of tasks, where each task can depend on other tasks.
+ *
+ * Use this when a task can be split up into smaller tasks which don't all depend on each other. Build the graph in the background
+ * thread of the owning task and execute it through TaskExecutionContext::executeTaskGraph(). Tasks whose dependencies all have been
+ * executed are then spread out over all of the executors of the task queue, while the calling executor helps out with the work until
+ * the whole graph is done.
+ *
+ * Since a task only can depend on tasks which already have been added to the graph, the order in which tasks are added is always a
+ * valid execution order. This is the order in which the tasks are executed in the main thread, before the owning task is.
+ */
+class TaskGraph
+{
+	friend class TaskExecutionContext;
+public:
+
+	/**
+	 * @brief Identifies a task in the graph.
+	 */
+	typedef size_t NodeId;
+
+	TaskGraph();
+
+	/**
+	 * @brief Dtor.
+	 * Any tasks which haven't been executed will be deleted.
+	 */
+	~TaskGraph();
+
+	/**
+	 * @brief Adds a task to the graph.
+	 * Ownership of the task is transferred to the graph.
+	 * @param task The task to add.
+	 * @param dependencies Tasks which must be executed before this task. These must already have been added to the graph.
+	 * @param listener An optional listener. This won't be owned by the graph.
+	 * @return An id identifying the task in the graph, to be used when other tasks depend on this one.
+	 */
+	NodeId addTask(ITask* task, const std::vector<NodeId>& dependencies = std::vector<NodeId>(), ITaskExecutionListener* listener = nullptr);
+
+	/**
+	 * @brief Gets the number of tasks in the graph.
+	 * @return The number of tasks.
+	 */
+	size_t size() const;
+
+private:
+
+	/**
+	 * @brief State shared between the executors while the graph is being executed.
+	 */
+	struct Execution;
+
+	/**
+	 * @brief A task which is put on the task queue to let other executors help with executing the graph.
+	 */
+	class Worker;
+
+	struct Node
+	{
+		ITask* task;
+		ITaskExecutionListener* listener;
+		std::vector<NodeId> dependencies;
+	};
+
+	std::vector<Node> mNodes;
+
+	/**
+	 * @brief Executes tasks in the graph which are ready, until there are no more ready tasks.
+	 * @param context The context of the task executing the graph, or of a worker.
+	 * @param execution The execution state.
+	 */
+	static void runReadyNodes(TaskExecutionContext& context, const std::shared_ptr<Execution>& execution);
+
+	/**
+	 * @brief Puts a worker on the task queue, allowing another executor to help out.
+	 * @param context The current context.
+	 * @param execution The execution state.
+	 * @param priority The priority of the worker.
+	 */
+	static void enqueueWorker(TaskExecutionContext& context, const std::shared_ptr<Execution>& execution, float priority);
+
+	/**
+	 * @brief Executes all tasks in the graph, blocking until all are done.
+	 * The tasks are added as subtasks to the task unit of the context, in the order they were added to the graph.
+	 * @param context The context of the task which owns the graph.
+	 */
+	void execute(TaskExecutionContext& context);
+};
+
+}
+
+}
+
+#endif /* TASKGRAPH_H_ */
@@ -26,17 +26,36 @@
 
 #include <Eris/EventService.h>
 
+#include <limits>
+#include <thread>
+
 namespace Ember {
 
 namespace Tasks {
 
-TaskQueue::TaskQueue(unsigned int numberOfExecutors, Eris::EventService& eventService) :
-		mEventService(eventService), mActive(true), mIsQueuedOnMainThread(false) {
+/**
+ * @brief The time spent processing tasks each time the queue is polled through the event service.
+ */
+const boost::posix_time::time_duration EventServiceTimeSlice = boost::posix_time::milliseconds(2);
+
+TaskQueue::TaskQueue(unsigned int numberOfExecutors, Eris::EventService& eventService, bool processOnEventService) :
+		mEventService(eventService),
+		mActive(true),
+		mProcessOnEventService(processOnEventService),
+		mIsQueuedOnMainThread(false),
+		mMainThreadStatistics{0, boost::posix_time::time_duration(), 0, boost::posix_time::time_duration()},
+		mPendingTaskCount(0),
+		mTaskSequence(0),
+		mNextExecutorIndex(0) {
 	S_LOG_VERBOSE("Creating task queue with " << numberOfExecutors << " executors.");
 	for (unsigned int i = 0; i < numberOfExecutors; ++i) {
 		TaskExecutor* executor = new TaskExecutor(*this);
 		mExecutors.push_back(executor);
 	}
+	//Only start the threads once all executors exist, since they will look in each other's queues.
+	for (auto executor : mExecutors) {
+		executor->start();
+	}
 }
 
 TaskQueue::~TaskQueue() {
@@ -46,61 +65,116 @@ TaskQueue::~TaskQueue() {
 void TaskQueue::deactivate() {
 	if (mActive) {
 		{
-			std::unique_lock<std::mutex> l(mUnprocessedQueueMutex);
+			std::unique_lock<std::mutex> l(mIdleMutex);
 			mActive = false;
 		}
-		mUnprocessedQueueCond.notify_all();
+		mIdleCond.notify_all();
 		//Join all executors. Since the queue is shutting down they will all exit their main loop if there are no more tasks to process.
 		for (TaskExecutorStore::iterator I = mExecutors.begin(); I != mExecutors.end(); ++I) {
 			TaskExecutor* executor = *I;
 			executor->join();
+		}
+		//Executors look in each other's queues, so they can't be deleted until all have exited.
+		for (auto executor : mExecutors) {
 			delete executor;
 		}
+		mExecutors.clear();
 
 		//Finally we must process all of the tasks in our main loop. This of course requires that this instance is destroyed from the main loop.
 		mEventService.processAllHandlers();
+		while (!mProcessedTaskUnits.empty()) {
+			pollProcessedTasks(TimeFrame(boost::posix_time::seconds(1)));
+		}
 
 		assert(mProcessedTaskUnits.empty());
-		assert(mUnprocessedTaskUnits.empty());
+		assert(mPendingTaskCount == 0);
 	}
 }
 
 bool TaskQueue::enqueueTask(ITask* task, ITaskExecutionListener* listener) {
-	std::unique_lock<std::mutex> l(mUnprocessedQueueMutex);
-	if (mActive) {
-		mUnprocessedTaskUnits.push(new TaskUnit(task, listener));
-		mUnprocessedQueueCond.notify_one();
+	std::string name = task->getName();
+	if (!enqueueTaskUnit(new TaskUnit(task, listener), task->getPriority())) {
+		S_LOG_WARNING("Tried to enqueue the task " << name << " on a task queue which isn't active (i.e. is shutting down).");
+		return false;
+	}
+	return true;
+}
+
+void TaskQueue::enqueueBackgroundTask(ITask* task, float priority) {
+	enqueueTaskUnit(new TaskUnit(task, nullptr, true), priority, true);
+}
+
+bool TaskQueue::enqueueTaskUnit(TaskUnit* taskUnit, float priority, bool evenIfInactive) {
+	std::unique_lock<std::mutex> l(mIdleMutex);
+	if (mActive || evenIfInactive) {
+		//Put the task on the executor with the fewest queued tasks, starting the search at the next executor in turn.
+		TaskExecutor* executor = mExecutors[mNextExecutorIndex];
+		for (size_t i = 1; i < mExecutors.size() && executor->getQueueSize() != 0; ++i) {
+			TaskExecutor* candidate = mExecutors[(mNextExecutorIndex + i) % mExecutors.size()];
+			if (candidate->getQueueSize() < executor->getQueueSize()) {
+				executor = candidate;
+			}
+		}
+		mNextExecutorIndex = (mNextExecutorIndex + 1) % mExecutors.size();
+		executor->pushTask(taskUnit, priority, mTaskSequence++);
+		mPendingTaskCount++;
+		l.unlock();
+		mIdleCond.notify_one();
 		return true;
 	} else {
-		S_LOG_WARNING("Tried to enqueue the task " << task->getName() << " on a task queue which isn't active (i.e. is shutting down).");
+		l.unlock();
+		delete taskUnit;
 		return false;
 	}
-
 }
 
-TaskUnit* TaskQueue::fetchNextTask() {
+TaskUnit* TaskQueue::fetchNextTask(TaskExecutor& executor) {
 	//The semantics of this method is that if a null pointer is returned the task executor is required to exit its main processing loop, since this indicates that the queue is shuttin down.
-	TaskUnit* taskUnit(0);
-	std::unique_lock<std::mutex> lock(mUnprocessedQueueMutex);
-	if (mUnprocessedTaskUnits.empty()) {
-		if (!mActive) {
-			return 0;
+	while (true) {
+		//Find the most urgent work, preferring our own queue. This is done without taking any locks.
+		TaskExecutor* best = &executor;
+		float bestPriority = executor.getQueueSize() ? executor.mTopPriority.load() : std::numeric_limits<float>::lowest();
+		for (auto candidate : mExecutors) {
+			if (candidate != &executor && candidate->getQueueSize() != 0) {
+				float candidatePriority = candidate->mTopPriority.load();
+				if (best->getQueueSize() == 0 || candidatePriority > bestPriority) {
+					best = candidate;
+					bestPriority = candidatePriority;
+				}
+			}
+		}
+
+		TaskUnit* taskUnit = best->popTask(best == &executor);
+		if (!taskUnit && best != &executor) {
+			//Someone else got there first, or the queue is busy; try our own queue before looking again.
+			taskUnit = executor.popTask(true);
+		}
+		if (taskUnit) {
+			mPendingTaskCount--;
+			return taskUnit;
+		}
+
+		std::unique_lock<std::mutex> lock(mIdleMutex);
+		if (mPendingTaskCount <= 0) {
+			if (!mActive) {
+				return nullptr;
+			}
+			mIdleCond.wait(lock);
+		} else {
+			//There is work, but we lost the race for it. Let the other threads run before trying again.
+			lock.unlock();
+			std::this_thread::yield();
 		}
-		mUnprocessedQueueCond.wait(lock);
-	}
-	if (!mUnprocessedTaskUnits.empty()) {
-		taskUnit = mUnprocessedTaskUnits.front();
-		mUnprocessedTaskUnits.pop();
 	}
-	return taskUnit;
 }
 
 void TaskQueue::addProcessedTask(TaskUnit* taskUnit) {
 	std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
 
 	mProcessedTaskUnits.push(taskUnit);
-	if (!mIsQueuedOnMainThread) {
+	if (mProcessOnEventService && !mIsQueuedOnMainThread) {
 		//Make sure that the task is handled on the main queue.
+		mIsQueuedOnMainThread = true;
 		mEventService.runOnMainThread([this] {
 			processCompletedTasks();
 		});
@@ -112,53 +186,72 @@ bool TaskQueue::isActive() const {
 	return mActive;
 }
 
+const TaskQueue::MainThreadStatistics& TaskQueue::getMainThreadStatistics() const {
+	return mMainThreadStatistics;
+}
+
 void TaskQueue::processCompletedTasks() {
+	pollProcessedTasks(TimeFrame(EventServiceTimeSlice));
+
+	std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
 	if (!mProcessedTaskUnits.empty()) {
+		mEventService.runOnMainThread([this] {
+			processCompletedTasks();
+		});
+	} else {
+		mIsQueuedOnMainThread = false;
+	}
+}
+
+size_t TaskQueue::pollProcessedTasks(const TimeFrame& timeFrame) {
+	auto start = boost::posix_time::microsec_clock::local_time();
+	size_t completed = 0;
+	do {
 		TaskUnit* taskUnit;
 		{
 			std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
+			if (mProcessedTaskUnits.empty()) {
+				break;
+			}
 			taskUnit = mProcessedTaskUnits.front();
 		}
-		try {
-			bool result = taskUnit->executeInMainThread();
-			if (result) {
-				try {
-					delete taskUnit;
-				} catch (const std::exception& ex) {
-					S_LOG_FAILURE("Error when deleting task in main thread." << ex);
-				} catch (...) {
-					S_LOG_FAILURE("Unknown error when deleting task in main thread.");
-				}
-				{
-					std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
-					mProcessedTaskUnits.pop();
-				}
-			}
-
-		} catch (const std::exception& ex) {
-			S_LOG_FAILURE("Error when executing task in main thread." << ex);
-			//Task is broken; remove it
-			std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
-			mProcessedTaskUnits.pop();
-		} catch (...) {
-			S_LOG_FAILURE("Unknown error when executing task in main thread.");
-			//Task is broken; remove it
-			std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
-			mProcessedTaskUnits.pop();
+		if (executeProcessedTask(taskUnit)) {
+			completed++;
 		}
+	} while (timeFrame.isTimeLeft());
 
-		{
-			std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
-			if (!mProcessedTaskUnits.empty()) {
-				mEventService.runOnMainThread([this] {
-					processCompletedTasks();
-				});
-			} else {
-				mIsQueuedOnMainThread = false;
+	auto elapsed = boost::posix_time::microsec_clock::local_time() - start;
+	mMainThreadStatistics.lastPollTaskCount = completed;
+	mMainThreadStatistics.lastPollTime = elapsed;
+	mMainThreadStatistics.totalTaskCount += completed;
+	mMainThreadStatistics.totalTime += elapsed;
+	return completed;
+}
+
+bool TaskQueue::executeProcessedTask(TaskUnit* taskUnit) {
+	try {
+		bool result = taskUnit->executeInMainThread();
+		if (result) {
+			try {
+				delete taskUnit;
+			} catch (const std::exception& ex) {
+				S_LOG_FAILURE("Error when deleting task in main thread." << ex);
+			} catch (...) {
+				S_LOG_FAILURE("Unknown error when deleting task in main thread.");
 			}
+			std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
+			mProcessedTaskUnits.pop();
 		}
-
+		return result;
+	} catch (const std::exception& ex) {
+		S_LOG_FAILURE("Error when executing task in main thread." << ex);
+	} catch (...) {
+		S_LOG_FAILURE("Unknown error when executing task in main thread.");
 	}
+	//Task is broken; remove it
+	std::unique_lock<std::mutex> lock(mProcessedQueueMutex);
+	mProcessedTaskUnits.pop();
+	return true;
 }
 
 }
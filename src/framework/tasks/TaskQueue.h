@@ -22,7 +22,9 @@
 #include "framework/TimeFrame.h"
 
 #include <queue>
+#include <vector>
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 
@@ -51,19 +53,29 @@ class TaskUnit;
  *
  * This is the main entry into the task framework. Each instance of this represents a queue onto which tasks can be added.
  *
- * Create an instance of this in your main thread, and then call pollProcessedTasks() from the same thread at a regular interval.
+ * Enqueued tasks are distributed over the executors, each of which keeps its own priority ordered queue. An executor will always
+ * pick the most urgent task it can find, stealing from the other executors if needed. Tasks with the same priority are processed
+ * in the order they were enqueued, as long as they end up on the same executor (which is always the case if there's only one).
+ * @see ITask::getPriority()
+ *
+ * Create an instance of this in your main thread. By default, processed tasks are handed back to the main thread through the event service, in batches.
+ * If you instead want to control how much time is spent each frame on processed tasks, create the queue with "processOnEventService" set to false
+ * and call pollProcessedTasks() from the main thread at a regular interval (typically each frame).
  * You must also make sure that you delete this instance in the main thread.
  */
 class TaskQueue
 {
 	friend class TaskExecutor;
+	friend class TaskGraph;
 public:
 
 	/**
 	 * @brief Ctor.
 	 * @param numberOfExecutors The number of concurrent task executors to use.
+	 * @param eventService The event service, used for processing tasks in the main thread.
+	 * @param processOnEventService If true, processed tasks will be handled in the main thread through the event service. If false, pollProcessedTasks() must be called regularly.
 	 */
-	TaskQueue(unsigned int numberOfExecutors, Eris::EventService& eventService);
+	TaskQueue(unsigned int numberOfExecutors, Eris::EventService& eventService, bool processOnEventService = true);
 
 	/**
 	 * @brief Dtor.
@@ -73,7 +85,7 @@ public:
 	/**
 	 * @brief Adds a task to the queue.
 	 * Ownership of the task will be transferred to this queue. Ownership of the optional listener will not be transferred however.
-	 * @note If the queue is being shut down, the task will not be queued and a warning will be written to the log.
+	 * @note If the queue is being shut down, the task will not be queued and a warning will be written to the log. The task is then deleted.
 	 * @param task The task to add. Note that ownership will be transferred.
 	 * @param listener An optional listener. Note that ownership won't be transferred.
 	 * @return False if the task couldn't be enqueued, probably because the task queue is inactive.
@@ -96,6 +108,47 @@ public:
 	 */
 	bool isActive() const;
 
+	/**
+	 * @brief Statistics for the processing of tasks in the main thread.
+	 */
+	struct MainThreadStatistics
+	{
+		/**
+		 * @brief The number of tasks which were completed during the last poll.
+		 */
+		size_t lastPollTaskCount;
+
+		/**
+		 * @brief The time spent during the last poll.
+		 */
+		boost::posix_time::time_duration lastPollTime;
+
+		/**
+		 * @brief The total number of tasks completed in the main thread.
+		 */
+		size_t totalTaskCount;
+
+		/**
+		 * @brief The total time spent processing tasks in the main thread.
+		 */
+		boost::posix_time::time_duration totalTime;
+	};
+
+	/**
+	 * @brief Processes tasks which have been processed in the background and now needs to be processed in the main thread.
+	 * Tasks are processed until there are no more tasks, or until the time frame has run out. At least one task is always processed, if there are any.
+	 * @note This must only be called from the main thread.
+	 * @param timeFrame The time frame within which tasks are processed.
+	 * @return The number of tasks which were completed.
+	 */
+	size_t pollProcessedTasks(const TimeFrame& timeFrame);
+
+	/**
+	 * @brief Gets statistics for the processing of tasks in the main thread.
+	 * @return Statistics.
+	 */
+	const MainThreadStatistics& getMainThreadStatistics() const;
+
 protected:
 
 	/**
@@ -110,11 +163,6 @@ protected:
 
 	Eris::EventService& mEventService;
 
-	/**
-	 * @brief A collection of unprocessed task units, which is a tuple of a task and a listener.
-	 */
-	TaskUnitQueue mUnprocessedTaskUnits;
-
 	/**
 	 * @brief A collection of processed task units. These will need to be executed in the main thread before they can be deleted.
 	 * @see pollProcessedTasks()
@@ -127,16 +175,17 @@ protected:
 	TaskExecutorStore mExecutors;
 
 	/**
-	 * @brief A mutex used whenever the unprocessed queue is accessed.
+	 * @brief A mutex used when executors go idle, and when the active state changes.
+	 * This is only taken by executors when there's no work to be found in any of the executor queues.
 	 */
-	std::mutex mUnprocessedQueueMutex;
+	std::mutex mIdleMutex;
 
 	std::mutex mProcessedQueueMutex;
 
 	/**
 	 * @brief A condition variable used for letting threads sleep while waiting for new tasks.
 	 */
-	std::condition_variable mUnprocessedQueueCond;
+	std::condition_variable mIdleCond;
 
 	/**
 	 * @brief Whether this queue is active or not.
@@ -147,15 +196,62 @@ protected:
 	 */
 	bool mActive;
 
+	/**
+	 * @brief Whether processed tasks should be handled through the event service, or by calls to pollProcessedTasks().
+	 */
+	const bool mProcessOnEventService;
+
+	/**
+	 * @brief True if processCompletedTasks() has been posted to the event service and not yet run.
+	 * Guarded by mProcessedQueueMutex.
+	 */
 	bool mIsQueuedOnMainThread;
 
+	MainThreadStatistics mMainThreadStatistics;
+
+	/**
+	 * @brief The number of task units which are enqueued but not yet fetched by any executor.
+	 * This is signed since an executor might fetch a task unit before the enqueuing thread has had time to increase the count.
+	 */
+	std::atomic<long> mPendingTaskCount;
+
+	/**
+	 * @brief Sequence counter used to keep FIFO order for tasks with the same priority.
+	 */
+	unsigned long mTaskSequence;
+
+	/**
+	 * @brief Index of the executor which should get the next enqueued task, if all queues are equally loaded.
+	 */
+	size_t mNextExecutorIndex;
+
 	/**
 	 * @brief Gets the next task to process.
 	 * @note This is normally only called by a TaskExecutor.
+	 * The most urgent task found in any of the executor queues is returned, preferring the queue of the calling executor.
 	 * Calling this while there's no current tasks will result in the current thread being put on hold until a new task is enqueued.
+	 * @param executor The executor asking for a task.
 	 * @returns A pointer to a task unit, or a null pointer if the executor is expected to exit its processing loop (i.e. when the queue is being shut down).
 	 */
-	TaskUnit* fetchNextTask();
+	TaskUnit* fetchNextTask(TaskExecutor& executor);
+
+	/**
+	 * @brief Adds a task which only will be executed in the background, and never handed back to the main thread.
+	 * This is accepted even if the queue is being shut down, since the executor calling this won't exit before it has been processed.
+	 * @note This must only be called from an executor thread.
+	 * @param task The task to add. Note that ownership will be transferred.
+	 * @param priority The priority of the task.
+	 */
+	void enqueueBackgroundTask(ITask* task, float priority);
+
+	/**
+	 * @brief Puts a task unit on the queue of one of the executors.
+	 * @param taskUnit The task unit. Ownership is transferred.
+	 * @param priority The priority of the task.
+	 * @param evenIfInactive Whether the unit should be enqueued even if the queue isn't active.
+	 * @return False if the queue isn't active, in which case the unit is deleted.
+	 */
+	bool enqueueTaskUnit(TaskUnit* taskUnit, float priority, bool evenIfInactive = false);
 
 	/**
 	 * @brief Adds a processed task back to the queue, to be handled in the main thread and then deleted.
@@ -163,8 +259,19 @@ protected:
 	 */
 	void addProcessedTask(TaskUnit* taskUnit);
 
+	/**
+	 * @brief Called through the event service, processes a batch of processed tasks.
+	 * If there are still tasks to process afterwards, this is posted to the event service again.
+	 */
 	void processCompletedTasks();
 
+	/**
+	 * @brief Executes the first processed task in the main thread, removing and deleting it if it's complete.
+	 * @param taskUnit The first task in mProcessedTaskUnits.
+	 * @return True if the task was completed.
+	 */
+	bool executeProcessedTask(TaskUnit* taskUnit);
+
 };
 
 }
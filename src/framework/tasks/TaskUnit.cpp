@@ -33,8 +33,8 @@ namespace Ember {
 
 namespace Tasks {
 
-TaskUnit::TaskUnit(ITask* task, ITaskExecutionListener* listener) :
-		mTask(task), mListener(listener) {
+TaskUnit::TaskUnit(ITask* task, ITaskExecutionListener* listener, bool backgroundOnly) :
+		mTask(task), mListener(listener), mBackgroundOnly(backgroundOnly) {
 
 }
 
@@ -55,6 +55,10 @@ const TaskUnit::SubtasksStore& TaskUnit::getSubtasks() const {
 	return mSubtasks;
 }
 
+bool TaskUnit::isBackgroundOnly() const {
+	return mBackgroundOnly;
+}
+
 void TaskUnit::executeInBackgroundThread(TaskExecutionContext& context) {
 #ifdef LOG_TASKS
 	TimedLog timedLog(mTask->getName() + ": background");
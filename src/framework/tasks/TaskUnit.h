@@ -52,8 +52,9 @@ public:
 	 * @brief Ctor.
 	 * @param task The main task. This will be owned by the unit.
 	 * @param listener An optional listener. This won't be owned by the unit.
+	 * @param backgroundOnly If true, the unit won't be handed back to the main thread after it has been executed in the background.
 	 */
-	TaskUnit(ITask* task, ITaskExecutionListener* listener = 0);
+	TaskUnit(ITask* task, ITaskExecutionListener* listener = 0, bool backgroundOnly = false);
 
 	/**
 	 * @brief Dtor.
@@ -89,6 +90,11 @@ public:
 	 */
 	bool executeInMainThread();
 
+	/**
+	 * @brief Returns true if the unit should be deleted directly after being executed in the background, without being executed in the main thread.
+	 */
+	bool isBackgroundOnly() const;
+
 private:
 
 	/**
@@ -107,6 +113,11 @@ private:
 	 * When the executeInMainThread() method is called these subtasks will be executed before the main task is.
 	 */
 	SubtasksStore mSubtasks;
+
+	/**
+	 * @brief Whether the unit only should be executed in the background.
+	 */
+	bool mBackgroundOnly;
 };
 
 }
@@ -40,6 +40,7 @@
 #include "framework/FileResourceProvider.h"
 #include "framework/osdir.h"
 #include "framework/StackChecker.h"
+#include "framework/Tokeniser.h"
 
 #include "components/lua/LuaScriptingProvider.h"
 #include "components/lua/Connectors.h"
@@ -82,6 +83,8 @@ TOLUA_API int tolua_Cegui_open(lua_State* tolua_S);
 
 #include <boost/thread.hpp>
 
+#include <sstream>
+
 #ifndef HAVE_SIGHANDLER_T
 
 typedef void (* sighandler_t)(int);
@@ -200,6 +203,7 @@ Application::Application(const std::string prefix, const std::string homeDir, co
 		mConfigSettings(configSettings),
 		mConsoleBackend(new ConsoleBackend()), Quit("quit", this, "Quit Ember."),
 		ToggleErisPolling("toggle_erispolling", this, "Switch server polling on and off."),
+		FrameProfile("frame_profile", this, "Profiles the phases of each frame. Use 'start' to start recording, 'stop' to stop and 'dump <file>' to write the latest frames as a Chrome trace file (by default 'frameprofile.json' in the home directory)."),
 		mScriptingResourceProvider(nullptr) {
 
 }
@@ -228,6 +232,8 @@ Application::~Application() {
 	delete mFileSystemObserver;
 	delete mSession;
 	S_LOG_INFO("Ember shut down normally.");
+	//Stop the writer thread, making sure that all messages have been written before the observer is removed.
+	Log::setAsynchronous(false);
 	Log::removeObserver(mLogObserver);
 	delete mLogObserver;
 }
@@ -258,10 +264,12 @@ void Application::mainLoop() {
 	DesiredFpsListener desiredFpsListener;
 	Eris::EventService& eventService = mSession->getEventService();
 	Input& input(Input::getSingleton());
+	unsigned long frameNumber = 0;
 
 	do {
 		try {
 			Log::sCurrentFrameStartMilliseconds = microsec_clock::local_time();
+			mFrameProfiler.startFrame(frameNumber++);
 
 			StackChecker::resetCounter();
 
@@ -269,29 +277,44 @@ void Application::mainLoop() {
 			boost::posix_time::microseconds desiredMicrosecondsPerFrame(desiredFpsListener.getMicrosecondsPerFrame());
 			TimeFrame timeFrame = TimeFrame(desiredMicrosecondsPerFrame);
 
-			mSession->getIoService().poll_one();
+			{
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Poll io");
+				mSession->getIoService().poll_one();
+			}
 
-			eventService.processOneHandler();
+			{
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Event handlers");
+				eventService.processOneHandler();
+			}
 
 			if (mWorldView) {
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Update world view");
 				mWorldView->update();
 			}
 
-
-			bool updatedRendering = mOgreView->renderOneFrame(timeFrame);
+			bool updatedRendering;
+			{
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Render frame");
+				updatedRendering = mOgreView->renderOneFrame(timeFrame);
+			}
 			if (updatedRendering) {
 				frameActionMask |= MainLoopController::FA_GRAPHICS;
 				frameActionMask |= MainLoopController::FA_INPUT;
 			} else {
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Input");
 				input.processInput();
 				frameActionMask |= MainLoopController::FA_INPUT;
 			}
 
-			mServices->getSoundService().cycle();
+			{
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Sound");
+				mServices->getSoundService().cycle();
+			}
 			frameActionMask |= MainLoopController::FA_SOUND;
 
 			//If there's time left this frame, poll any outstanding io handlers.
 			if (timeFrame.isTimeLeft()) {
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Poll io");
 				size_t handersRun = 0;
 				do {
 					handersRun = mSession->getIoService().poll_one();
@@ -300,14 +323,22 @@ void Application::mainLoop() {
 
 			//If there's still time left this frame, process any outstanding main thread handlers.
 			if (timeFrame.isTimeLeft()) {
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Event handlers");
 				size_t handersRun = 0;
 				do {
 					handersRun = eventService.processOneHandler();
 				} while (handersRun != 0 && timeFrame.isTimeLeft());
 			}
 
+			//Let any task queues complete their processed tasks in the main thread, within the time left of this frame.
+			{
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Main thread tasks");
+				mFrameProfiler.emit(mMainLoopController.EventProcessMainThreadTasks, "EventProcessMainThreadTasks", timeFrame);
+			}
+
 			//And if there's yet still time left this frame, wait until time is up, and do io in the meantime.
 			if (timeFrame.isTimeLeft()) {
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Idle");
 				boost::asio::deadline_timer deadlineTimer(mSession->getIoService());
 				deadlineTimer.expires_at(boost::asio::time_traits<boost::posix_time::ptime>::now() + timeFrame.getRemainingTime());
 
@@ -319,7 +350,11 @@ void Application::mainLoop() {
 				}
 			}
 
-			mMainLoopController.EventFrameProcessed(timeFrame, frameActionMask);
+			{
+				FrameProfiler::ScopedPhase phase(mFrameProfiler, "Frame processed");
+				mFrameProfiler.emit(mMainLoopController.EventFrameProcessed, "EventFrameProcessed", timeFrame, frameActionMask);
+			}
+			mFrameProfiler.endFrame();
 
 			if (updatedRendering && timeFrame.getElapsedTime().total_microseconds() > (desiredMicrosecondsPerFrame.total_microseconds() * 1.4f)) {
 				S_LOG_VERBOSE("Frame took too long.");
@@ -571,6 +606,32 @@ void Application::runCommand(const std::string& command, const std::string& args
 		mShouldQuit = true;
 	} else if (ToggleErisPolling == command) {
 		mPollEris = !mPollEris;
+	} else if (FrameProfile == command) {
+		Tokeniser tokeniser(args);
+		std::string action = tokeniser.nextToken();
+		if (action == "start") {
+			mFrameProfiler.setEnabled(true);
+			ConsoleBackend::getSingleton().pushMessage("Started frame profiling.", "info");
+		} else if (action == "stop") {
+			mFrameProfiler.setEnabled(false);
+			ConsoleBackend::getSingleton().pushMessage("Stopped frame profiling.", "info");
+		} else if (action == "dump") {
+			std::string path = tokeniser.remainingTokens();
+			if (path.empty()) {
+				path = mServices->getConfigService().getHomeDirectory(BaseDirType_DATA) + "frameprofile.json";
+			}
+			std::ofstream stream(path);
+			if (stream) {
+				mFrameProfiler.writeChromeTrace(stream);
+				std::stringstream ss;
+				ss << "Wrote " << mFrameProfiler.getFrameCount() << " frames to '" << path << "'.";
+				ConsoleBackend::getSingleton().pushMessage(ss.str(), "info");
+			} else {
+				ConsoleBackend::getSingleton().pushMessage("Could not write frame profile to '" + path + "'.", "error");
+			}
+		} else {
+			ConsoleBackend::getSingleton().pushMessage("Usage: frame_profile start|stop|dump [file]", "info");
+		}
 	}
 }
 
@@ -16,6 +16,7 @@
 #include "framework/ConsoleObject.h"
 #include "framework/ConsoleBackend.h"
 #include "framework/MainLoopController.h"
+#include "framework/FrameProfiler.h"
 
 #include <sigc++/signal.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -256,6 +257,16 @@ private:
 	 */
 	const ConsoleCommandWrapper ToggleErisPolling;
 
+	/**
+	 * @brief Controls the frame profiler.
+	 */
+	const ConsoleCommandWrapper FrameProfile;
+
+	/**
+	 * @brief Records the time spent in each phase of the main loop.
+	 */
+	FrameProfiler mFrameProfiler;
+
 	/**
 	 * @brief Provides resources to the scripting system.
 	 */
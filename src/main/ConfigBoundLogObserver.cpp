@@ -66,12 +66,18 @@ void ConfigBoundLogObserver::updateFromConfig()
 			setDetailed(static_cast<bool>(detailed));
 		}
 	}
+	if (mConfigService.itemExists("general", "loggingasynchronous")) {
+		varconf::Variable asynchronous = mConfigService.getValue("general", "loggingasynchronous");
+		if (asynchronous.is_bool()) {
+			Log::setAsynchronous(static_cast<bool>(asynchronous));
+		}
+	}
 }
 
 void ConfigBoundLogObserver::ConfigService_EventChangedConfigItem(const std::string& section, const std::string& key)
 {
 	if (section == "general") {
-		if (key == "logginglevel" || key == "loggingdetailed") {
+		if (key == "logginglevel" || key == "loggingdetailed" || key == "loggingasynchronous") {
 			updateFromConfig();
 		}
 	}
@@ -0,0 +1,281 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Benchmarks for the batched geometry of PagedGeometry.
+ *
+ * Measures the transformation of the vertices of a page of trees into a batch, comparing the previous per vertex loop (which looked
+ * up each element of each vertex and rotated it with a quaternion) with the per element kernels. If their results differ by more
+ * than rounding the program exits with an error.
+ *
+ * Measures the build of a whole page with BatchedGeometry, using software hardware buffers, comparing a synchronous build with a
+ * background build. For the background build the time spent on the main thread (preparing and uploading) is reported separately.
+ */
+
+#include "components/ogre/environment/pagedgeometry/include/BatchedGeometry.h"
+#include "components/ogre/environment/pagedgeometry/include/BatchKernels.h"
+#include "RandomFixture.h"
+
+#include <Ogre.h>
+#include <OgreDefaultHardwareBufferManager.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+//Position, normal and tangent as three floats each, and a two float texture coordinate.
+const size_t VertexSize = (3 + 3 + 3 + 2) * sizeof(float);
+
+template<typename T>
+double timeIt(T function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+}
+
+Ogre::VertexDeclaration::VertexElementList createElements()
+{
+	Ogre::VertexDeclaration::VertexElementList elements;
+	elements.emplace_back(0, 0, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+	elements.emplace_back(0, 12, Ogre::VET_FLOAT3, Ogre::VES_NORMAL);
+	elements.emplace_back(0, 24, Ogre::VET_FLOAT3, Ogre::VES_TANGENT);
+	elements.emplace_back(0, 36, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES);
+	return elements;
+}
+
+std::vector<float> createVertices(size_t vertexCount)
+{
+	std::vector<float> vertices;
+	Ember::RandomFixture randomFixture;
+	auto random = [&]() { return randomFixture.nextFloat(); };
+	for (size_t i = 0; i < vertexCount; ++i) {
+		Ogre::Vector3 position(random() * 4 - 2, random() * 10, random() * 4 - 2);
+		Ogre::Vector3 normal = Ogre::Vector3(random() - 0.5f, random() - 0.5f, random() - 0.5f).normalisedCopy();
+		Ogre::Vector3 tangent = normal.perpendicular();
+		for (auto& vector : {position, normal, tangent}) {
+			vertices.insert(vertices.end(), {vector.x, vector.y, vector.z});
+		}
+		vertices.insert(vertices.end(), {random(), random()});
+	}
+	return vertices;
+}
+
+struct Instance
+{
+	Ogre::Vector3 position;
+	Ogre::Quaternion orientation;
+	Ogre::Vector3 scale;
+};
+
+std::vector<Instance> createInstances(size_t instanceCount)
+{
+	std::vector<Instance> instances;
+	for (size_t i = 0; i < instanceCount; ++i) {
+		float size = 0.8f + (i % 5) * 0.1f;
+		instances.push_back({Ogre::Vector3((i % 20) * 3.0f, 0, (i / 20) * 3.0f), Ogre::Quaternion(Ogre::Degree(i * 37.0f), Ogre::Vector3::UNIT_Y), Ogre::Vector3(size)});
+	}
+	return instances;
+}
+
+/**
+ * Returns false if the kernels don't give the same result as the per vertex loop.
+ */
+bool benchmarkTransforms(size_t vertexCount, size_t instanceCount, int iterations)
+{
+	auto elements = createElements();
+	auto source = createVertices(vertexCount);
+	auto instances = createInstances(instanceCount);
+	const Ogre::Vector3 batchCenter(30, 5, 30);
+
+	std::vector<unsigned char> perVertexResult(VertexSize * vertexCount * instanceCount);
+	std::vector<unsigned char> kernelResult(perVertexResult.size());
+
+	//The previous implementation, which walked the elements of each vertex.
+	double perVertexTime = timeIt([&]() {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			unsigned char* destBase = perVertexResult.data();
+			for (auto& instance : instances) {
+				auto sourceBase = reinterpret_cast<const unsigned char*>(source.data());
+				for (size_t v = 0; v < vertexCount; ++v) {
+					for (auto& elem : elements) {
+						float* sourcePtr;
+						float* destPtr;
+						elem.baseVertexPointerToElement(const_cast<unsigned char*>(sourceBase), &sourcePtr);
+						elem.baseVertexPointerToElement(destBase, &destPtr);
+						Ogre::Vector3 tmp;
+						switch (elem.getSemantic()) {
+							case Ogre::VES_POSITION:
+								tmp = Ogre::Vector3(sourcePtr[0], sourcePtr[1], sourcePtr[2]);
+								tmp = (instance.orientation * (tmp * instance.scale)) + instance.position;
+								tmp -= batchCenter;
+								std::memcpy(destPtr, tmp.ptr(), sizeof(float) * 3);
+								break;
+							case Ogre::VES_NORMAL:
+							case Ogre::VES_TANGENT:
+								tmp = instance.orientation * Ogre::Vector3(sourcePtr[0], sourcePtr[1], sourcePtr[2]);
+								std::memcpy(destPtr, tmp.ptr(), sizeof(float) * 3);
+								break;
+							default:
+								std::memcpy(destPtr, sourcePtr, Ogre::VertexElement::getTypeSize(elem.getType()));
+								break;
+						}
+					}
+					destBase += VertexSize;
+					sourceBase += VertexSize;
+				}
+			}
+		}
+	});
+
+	double kernelTime = timeIt([&]() {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			unsigned char* destBase = kernelResult.data();
+			auto sourceBase = reinterpret_cast<const unsigned char*>(source.data());
+			for (auto& instance : instances) {
+				auto transform = Forests::BatchKernels::makeInstanceTransform(instance.orientation, instance.scale, instance.position - batchCenter);
+				std::memcpy(destBase, sourceBase, VertexSize * vertexCount);
+				Forests::BatchKernels::transformPositions(sourceBase, destBase, VertexSize, vertexCount, transform);
+				Forests::BatchKernels::rotateVectors(sourceBase + 12, destBase + 12, VertexSize, vertexCount, transform);
+				Forests::BatchKernels::rotateVectors(sourceBase + 24, destBase + 24, VertexSize, vertexCount, transform);
+				destBase += VertexSize * vertexCount;
+			}
+		}
+	});
+
+	//The matrix and the quaternion round differently, so the results are compared with a tolerance relative to the magnitude.
+	float maxDifference = 0;
+	bool matches = true;
+	auto perVertexFloats = reinterpret_cast<const float*>(perVertexResult.data());
+	auto kernelFloats = reinterpret_cast<const float*>(kernelResult.data());
+	for (size_t i = 0; i < perVertexResult.size() / sizeof(float); ++i) {
+		float difference = std::abs(perVertexFloats[i] - kernelFloats[i]);
+		maxDifference = std::max(maxDifference, difference);
+		if (!(difference <= 1e-4f * std::max(1.0f, std::abs(perVertexFloats[i])))) {
+			matches = false;
+		}
+	}
+
+	std::cout << "Batch transforms, " << instanceCount << " instances of " << vertexCount << " vertices, " << iterations << " iterations: per vertex "
+			  << perVertexTime / iterations << " ms/page, kernels " << kernelTime / iterations << " ms/page (" << perVertexTime / kernelTime
+			  << "x, max difference " << maxDifference << (matches ? "" : ", results DIFFER") << ")" << std::endl;
+	return matches;
+}
+
+Ogre::MeshPtr createMesh(size_t vertexCount)
+{
+	auto mesh = Ogre::MeshManager::getSingleton().createManual("tree", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+	auto subMesh = mesh->createSubMesh();
+	subMesh->useSharedVertices = false;
+	subMesh->setMaterialName("BaseWhite");
+
+	subMesh->vertexData = OGRE_NEW Ogre::VertexData();
+	subMesh->vertexData->vertexCount = vertexCount;
+	auto declaration = subMesh->vertexData->vertexDeclaration;
+	for (auto& element : createElements()) {
+		declaration->addElement(element.getSource(), element.getOffset(), element.getType(), element.getSemantic());
+	}
+	auto vertices = createVertices(vertexCount);
+	auto vertexBuffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(VertexSize, vertexCount, Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+	vertexBuffer->writeData(0, vertexBuffer->getSizeInBytes(), vertices.data(), true);
+	subMesh->vertexData->vertexBufferBinding->setBinding(0, vertexBuffer);
+
+	//Three triangles per two vertices, as in a typical tree.
+	std::vector<Ogre::uint16> indices((vertexCount / 2) * 9);
+	for (size_t i = 0; i < indices.size(); ++i) {
+		indices[i] = static_cast<Ogre::uint16>((i * 7) % vertexCount);
+	}
+	subMesh->indexData->indexCount = indices.size();
+	subMesh->indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(Ogre::HardwareIndexBuffer::IT_16BIT, indices.size(),
+																									 Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+	subMesh->indexData->indexBuffer->writeData(0, subMesh->indexData->indexBuffer->getSizeInBytes(), indices.data(), true);
+
+	mesh->_setBounds(Ogre::AxisAlignedBox(-2, 0, -2, 2, 10, 2));
+	mesh->_setBoundingSphereRadius(10);
+	mesh->load();
+	return mesh;
+}
+
+void benchmarkPageBuilds(size_t vertexCount, size_t instanceCount, int iterations)
+{
+	Ogre::Root root("", "", "");
+	std::unique_ptr<Ogre::DefaultHardwareBufferManager> bufferManager(new Ogre::DefaultHardwareBufferManager());
+	root.getWorkQueue()->startup();
+	Ogre::SceneManager* sceneManager = root.createSceneManager(Ogre::DefaultSceneManagerFactory::FACTORY_TYPE_NAME);
+
+	auto mesh = createMesh(vertexCount);
+	Ogre::Entity* entity = sceneManager->createEntity(mesh);
+	auto instances = createInstances(instanceCount);
+
+	auto addInstances = [&](Forests::BatchedGeometry& batch) {
+		for (auto& instance : instances) {
+			batch.addEntity(entity, instance.position, instance.orientation, instance.scale);
+		}
+	};
+
+	double syncTime = 0;
+	double backgroundTotalTime = 0;
+	double backgroundMainThreadTime = 0;
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		{
+			Forests::BatchedGeometry batch(sceneManager, sceneManager->getRootSceneNode());
+			addInstances(batch);
+			syncTime += timeIt([&]() { batch.build(); });
+		}
+		{
+			Forests::BatchedGeometry batch(sceneManager, sceneManager->getRootSceneNode());
+			addInstances(batch);
+			auto start = std::chrono::steady_clock::now();
+			backgroundMainThreadTime += timeIt([&]() { batch.buildInBackground(); });
+			while (batch.isBuildPending()) {
+				backgroundMainThreadTime += timeIt([&]() { root.getWorkQueue()->processResponses(); });
+			}
+			backgroundTotalTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+		}
+	}
+
+	std::cout << "Batch page builds, " << instanceCount << " instances of " << vertexCount << " vertices, " << iterations << " iterations: synchronous "
+			  << syncTime / iterations << " ms/page, background " << backgroundTotalTime / iterations << " ms/page of which "
+			  << backgroundMainThreadTime / iterations << " ms/page on the main thread" << std::endl;
+
+	sceneManager->destroyEntity(entity);
+	root.destroySceneManager(sceneManager);
+	mesh.reset();
+	Ogre::MeshManager::getSingleton().removeAll();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	size_t instanceCount = 300;
+	if (argc > 1) {
+		instanceCount = static_cast<size_t>(std::max(1, std::atoi(argv[1])));
+	}
+	bool matches = benchmarkTransforms(2000, instanceCount, 10);
+	benchmarkPageBuilds(2000, instanceCount, 10);
+	return matches ? 0 : 1;
+}
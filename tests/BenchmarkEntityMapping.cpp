@@ -0,0 +1,280 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Benchmarks for the entity mapping.
+ *
+ * Creates mappings for a number of entities which all share the same definition, with attribute, numeric, entity type and height
+ * matches, reporting the time and the number of allocations per entity. Then changes an attribute of every entity, which makes
+ * each mapping switch cases, and finally destroys all mappings.
+ */
+
+#include "components/entitymapping/EntityMappingManager.h"
+#include "components/entitymapping/EntityMapping.h"
+#include "components/entitymapping/IActionCreator.h"
+#include "components/entitymapping/Actions/Action.h"
+#include "components/entitymapping/Cases/CaseBase.h"
+#include "components/entitymapping/Definitions/EntityMappingDefinition.h"
+
+#include <Eris/Entity.h>
+#include <Eris/TypeService.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace
+{
+std::atomic<size_t> sNewCount(0);
+std::atomic<size_t> sNewBytes(0);
+}
+
+void* operator new(std::size_t size)
+{
+	sNewCount++;
+	sNewBytes += size;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	free(ptr);
+}
+
+namespace Ember
+{
+namespace EntityMapping
+{
+
+class BenchmarkEntity: public Eris::Entity
+{
+public:
+	BenchmarkEntity(const std::string& id, Eris::TypeInfo* type, Eris::TypeService& typeService) :
+			Eris::Entity(id, type), mTypeService(typeService)
+	{
+	}
+
+	void setAttribute(const std::string& name, const Atlas::Message::Element& value)
+	{
+		setAttr(name, value);
+	}
+
+protected:
+	Eris::TypeService& mTypeService;
+
+	Eris::TypeService* getTypeService() const override
+	{
+		return &mTypeService;
+	}
+
+	void removeFromMovementPrediction() override
+	{
+	}
+
+	void addToMovementPredition() override
+	{
+	}
+
+	Eris::Entity* getEntity(const std::string&) override
+	{
+		return nullptr;
+	}
+};
+
+class CountingAction: public Actions::Action
+{
+public:
+	explicit CountingAction(size_t& activations) :
+			mActivations(activations)
+	{
+	}
+
+	void activate(ChangeContext&) override
+	{
+		mActivations++;
+	}
+
+	void deactivate(ChangeContext&) override
+	{
+	}
+
+private:
+	size_t& mActivations;
+};
+
+class CountingActionCreator: public IActionCreator
+{
+public:
+	size_t activations = 0;
+
+	void createActions(EntityMapping&, Cases::CaseBase* aCase, Definitions::CaseDefinition& caseDefinition) override
+	{
+		for (size_t i = 0; i < caseDefinition.getActions().size(); ++i) {
+			aCase->addAction(new CountingAction(activations));
+		}
+	}
+};
+
+Definitions::CaseDefinition createCase(const std::string& parameter, const std::string& value)
+{
+	Definitions::CaseDefinition caseDefinition;
+	caseDefinition.getCaseParameters().emplace_back(parameter, value);
+	Definitions::ActionDefinition actionDefinition;
+	actionDefinition.setType("display-model");
+	caseDefinition.getActions().emplace_back(std::move(actionDefinition));
+	return caseDefinition;
+}
+
+Definitions::MatchDefinition createMatch(const std::string& type, const std::string& attribute, const std::string& comparison)
+{
+	Definitions::MatchDefinition matchDefinition;
+	matchDefinition.setType(type);
+	if (!attribute.empty()) {
+		matchDefinition.getProperties()["attribute"] = attribute;
+	}
+	if (!comparison.empty()) {
+		matchDefinition.getProperties()["type"] = comparison;
+	}
+	return matchDefinition;
+}
+
+/**
+ * @brief Creates a definition resembling the one of a character, with a model for each mode, each with a numeric match on the status.
+ */
+Definitions::EntityMappingDefinition* createDefinition()
+{
+	auto definition = new Definitions::EntityMappingDefinition();
+	definition->setName("settler");
+
+	auto modeMatch = createMatch("attribute", "mode", "");
+	for (auto& mode : {"standing", "walking", "running", "swimming"}) {
+		auto modeCase = createCase("equals", mode);
+		auto statusMatch = createMatch("attribute", "status", "numeric");
+		statusMatch.getCases().push_back(createCase("lesser", "0.3"));
+		statusMatch.getCases().push_back(createCase("greaterequals", "0.3"));
+		modeCase.getMatches().push_back(std::move(statusMatch));
+		modeMatch.getCases().push_back(std::move(modeCase));
+	}
+	definition->getRoot().getMatches().push_back(std::move(modeMatch));
+
+	auto typeMatch = createMatch("entitytype", "", "");
+	typeMatch.getCases().push_back(createCase("equals", "settler"));
+	typeMatch.getCases().push_back(createCase("equals", "character"));
+	definition->getRoot().getMatches().push_back(std::move(typeMatch));
+
+	auto wieldMatch = createMatch("attribute", "right_hand_wield", "");
+	wieldMatch.getCases().push_back(createCase("notempty", ""));
+	definition->getRoot().getMatches().push_back(std::move(wieldMatch));
+
+	auto heightMatch = createMatch("attribute", "height", "function");
+	heightMatch.getCases().push_back(createCase("lesser", "1"));
+	heightMatch.getCases().push_back(createCase("greaterequals", "1"));
+	definition->getRoot().getMatches().push_back(std::move(heightMatch));
+
+	return definition;
+}
+
+template<typename T>
+double timeIt(T function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+}
+
+void benchmarkMappings(size_t entityCount)
+{
+	Eris::TypeService typeService(nullptr);
+	EntityMappingManager manager;
+	manager.setTypeService(&typeService);
+	manager.addDefinition(createDefinition());
+	CountingActionCreator actionCreator;
+
+	Eris::TypeInfo* type = typeService.getTypeByName("settler");
+	std::vector<std::unique_ptr<BenchmarkEntity>> entities;
+	for (size_t i = 0; i < entityCount; ++i) {
+		entities.emplace_back(new BenchmarkEntity(std::to_string(i), type, typeService));
+		entities.back()->setAttribute("present", "settler");
+		entities.back()->setAttribute("mode", "standing");
+		entities.back()->setAttribute("status", 1.0);
+	}
+
+	std::vector<EntityMapping*> mappings;
+	mappings.reserve(entityCount);
+	size_t newCountStart = sNewCount;
+	size_t newBytesStart = sNewBytes;
+	double createTime = timeIt([&]() {
+		for (auto& entity : entities) {
+			auto mapping = manager.createMapping(*entity, actionCreator, nullptr);
+			mapping->initialize();
+			mappings.push_back(mapping);
+		}
+	});
+	size_t allocations = sNewCount - newCountStart;
+	size_t bytes = sNewBytes - newBytesStart;
+	size_t initialActivations = actionCreator.activations;
+
+	double changeTime = timeIt([&]() {
+		for (auto& entity : entities) {
+			entity->setAttribute("mode", "walking");
+		}
+	});
+
+	double destroyTime = timeIt([&]() {
+		for (auto mapping : mappings) {
+			delete mapping;
+		}
+	});
+
+	std::cout << "Entity mappings, " << entityCount << " entities: created in " << createTime << " ms (" << (createTime * 1000.0) / entityCount
+			  << " us/entity, " << allocations / (double)entityCount << " allocations and " << bytes / (double)entityCount << " bytes per entity, "
+			  << initialActivations << " actions activated)" << std::endl;
+	std::cout << "Entity mappings, " << entityCount << " entities: attribute changed in " << changeTime << " ms (" << (changeTime * 1000.0) / entityCount
+			  << " us/entity, " << actionCreator.activations - initialActivations << " actions activated), destroyed in " << destroyTime << " ms" << std::endl;
+
+	for (auto& entity : entities) {
+		entity->shutdown();
+	}
+}
+
+}
+}
+
+int main(int argc, char** argv)
+{
+	size_t entityCount = 10000;
+	if (argc > 1) {
+		entityCount = static_cast<size_t>(std::max(1, std::atoi(argv[1])));
+	}
+	Ember::EntityMapping::benchmarkMappings(entityCount);
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Benchmarks for the navigation.
+ *
+ * Rasterizes a number of tiles of a synthetic terrain, reporting the time per tile and the number of
+ * allocations per tile, both for the first tiles (when the scratch memory is cold) and once it has warmed up.
+ */
+
+#include "components/navigation/Awareness.h"
+#include "components/navigation/AwarenessUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> sNewCount(0);
+std::atomic<size_t> sDetourAllocCount(0);
+
+void* countingDetourAlloc(int size, dtAllocHint)
+{
+	sDetourAllocCount++;
+	return malloc(size);
+}
+
+void countingDetourFree(void* ptr)
+{
+	free(ptr);
+}
+}
+
+void* operator new(std::size_t size)
+{
+	sNewCount++;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	free(ptr);
+}
+
+namespace Ember
+{
+namespace Navigation
+{
+
+class BenchmarkContext: public rcContext
+{
+public:
+	BenchmarkContext() :
+			rcContext(false)
+	{
+	}
+};
+
+void buildInput(int tx, int ty, TileInput& input)
+{
+	const int tileSize = 64;
+	const float cellSize = 0.25f;
+	rcConfig& cfg = input.cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = cellSize;
+	cfg.ch = cfg.cs / 2.0f;
+	cfg.walkableHeight = (int)std::ceil(2.0f / cfg.ch);
+	cfg.walkableClimb = 100;
+	cfg.walkableRadius = (int)std::ceil(0.4f / cfg.cs);
+	cfg.walkableSlopeAngle = 70;
+	cfg.tileSize = tileSize;
+	cfg.borderSize = cfg.walkableRadius + 3;
+	cfg.width = cfg.tileSize + cfg.borderSize * 2;
+	cfg.height = cfg.tileSize + cfg.borderSize * 2;
+
+	const float tcs = cfg.tileSize * cfg.cs;
+	cfg.bmin[0] = tx * tcs - cfg.borderSize * cfg.cs;
+	cfg.bmin[1] = -500;
+	cfg.bmin[2] = ty * tcs - cfg.borderSize * cfg.cs;
+	cfg.bmax[0] = (tx + 1) * tcs + cfg.borderSize * cfg.cs;
+	cfg.bmax[1] = 500;
+	cfg.bmax[2] = (ty + 1) * tcs + cfg.borderSize * cfg.cs;
+
+	input.tx = tx;
+	input.ty = ty;
+	input.heightsXMin = (int)std::floor(cfg.bmin[0]) - 1;
+	input.heightsYMin = (int)std::floor(cfg.bmin[2]) - 1;
+	input.sizeX = (int)std::ceil(cfg.bmax[0]) + 1 - input.heightsXMin;
+	input.sizeY = (int)std::ceil(cfg.bmax[2]) + 1 - input.heightsYMin;
+	input.heights.resize(input.sizeX * input.sizeY);
+	for (int y = 0; y < input.sizeY; ++y) {
+		for (int x = 0; x < input.sizeX; ++x) {
+			float wx = input.heightsXMin + x;
+			float wy = input.heightsYMin + y;
+			input.heights[(y * input.sizeX) + x] = std::sin(wx * 0.1f) * 4.0f + std::cos(wy * 0.07f) * 3.0f;
+		}
+	}
+	input.entityAreas.clear();
+	input.entityAreas.emplace_back(WFMath::Point<2>(tx * tcs + 2, ty * tcs + 2), WFMath::Vector<2>(3, 2), WFMath::RotMatrix<2>().rotation(0.3));
+}
+
+void benchmarkRasterization(int numberOfTiles)
+{
+	BenchmarkContext ctx;
+	RasterizationScratch scratch;
+	TileInput input;
+	TileCacheData tiles[MAX_LAYERS];
+
+	auto rasterize = [&](int first, int count, const char* label) {
+		size_t newCountStart = sNewCount;
+		size_t detourCountStart = sDetourAllocCount;
+		size_t arenaCountStart = scratch.arena.systemAllocations;
+		size_t layers = 0;
+		std::chrono::steady_clock::duration elapsed(0);
+		for (int i = first; i < first + count; ++i) {
+			//Building the input is done in the main thread in the client, so it's not measured.
+			size_t newCountBefore = sNewCount;
+			buildInput(i % 16, i / 16, input);
+			newCountStart += sNewCount - newCountBefore;
+
+			auto start = std::chrono::steady_clock::now();
+			int ntiles = Awareness::rasterizeTileLayers(ctx, input, scratch, tiles, MAX_LAYERS);
+			elapsed += std::chrono::steady_clock::now() - start;
+			for (int j = 0; j < ntiles; ++j) {
+				dtFree(tiles[j].data);
+			}
+			layers += ntiles;
+		}
+		auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+		std::cout << label << ": " << count << " tiles (" << layers << " layers) in " << micros / 1000.0 << " ms ("
+				  << micros / (double)count << " us/tile). Allocations per tile: "
+				  << (sNewCount - newCountStart) / (double)count << " operator new, "
+				  << (scratch.arena.systemAllocations - arenaCountStart) / (double)count << " Recast, "
+				  << (sDetourAllocCount - detourCountStart) / (double)count << " Detour (including result)" << std::endl;
+	};
+
+	rasterize(0, 1, "First tile");
+	rasterize(1, numberOfTiles, "Steady state");
+}
+
+}
+}
+
+int main(int argc, char** argv)
+{
+	dtAllocSetCustom(countingDetourAlloc, countingDetourFree);
+	int numberOfTiles = 256;
+	if (argc > 1) {
+		numberOfTiles = std::max(1, std::atoi(argv[1]));
+	}
+	Ember::Navigation::benchmarkRasterization(numberOfTiles);
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Benchmarks for the task framework.
+ *
+ * Measures raw task throughput for a varying number of executors (which mostly measures contention on the queues),
+ * and the latency of an urgent task enqueued on a queue which already is flooded with work.
+ */
+
+#include "framework/tasks/TaskQueue.h"
+#include "framework/tasks/ITask.h"
+#include "framework/tasks/TaskExecutionContext.h"
+
+#include <Eris/EventService.h>
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace Ember
+{
+
+class SpinTask: public Tasks::ITask
+{
+public:
+
+	std::atomic<int>& mCounter;
+	int mIterations;
+	float mPriority;
+
+	SpinTask(std::atomic<int>& counter, int iterations, float priority = 0) :
+			mCounter(counter), mIterations(iterations), mPriority(priority)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		volatile int sum = 0;
+		for (int i = 0; i < mIterations; ++i) {
+			sum += i;
+		}
+		mCounter++;
+	}
+
+	float getPriority() const override
+	{
+		return mPriority;
+	}
+
+	std::string getName() const override
+	{
+		return "SpinTask";
+	}
+};
+
+class StampTask: public Tasks::ITask
+{
+public:
+
+	std::chrono::steady_clock::time_point& mStarted;
+	std::atomic<bool>& mDone;
+
+	StampTask(std::chrono::steady_clock::time_point& started, std::atomic<bool>& done) :
+			mStarted(started), mDone(done)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		mStarted = std::chrono::steady_clock::now();
+		mDone = true;
+	}
+
+	float getPriority() const override
+	{
+		return 1000;
+	}
+
+	std::string getName() const override
+	{
+		return "StampTask";
+	}
+};
+
+void benchmarkThroughput(boost::asio::io_service& io_service, unsigned int executors, int numberOfTasks)
+{
+	std::atomic<int> counter(0);
+	Eris::EventService es(io_service);
+	Tasks::TaskQueue taskQueue(executors, es);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numberOfTasks; ++i) {
+		taskQueue.enqueueTask(new SpinTask(counter, 100));
+	}
+	while (counter < numberOfTasks) {
+		es.processAllHandlers();
+		std::this_thread::yield();
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	es.processAllHandlers();
+	std::cout << "Throughput, " << executors << " executors: " << numberOfTasks << " tasks in " << elapsed / 1000.0 << " ms ("
+			  << (numberOfTasks * 1000000.0 / elapsed) << " tasks/s)" << std::endl;
+}
+
+void benchmarkUrgentLatency(boost::asio::io_service& io_service, unsigned int executors, int backlog)
+{
+	std::atomic<int> counter(0);
+	std::atomic<bool> done(false);
+	std::chrono::steady_clock::time_point started;
+	Eris::EventService es(io_service);
+	Tasks::TaskQueue taskQueue(executors, es);
+	for (int i = 0; i < backlog; ++i) {
+		taskQueue.enqueueTask(new SpinTask(counter, 20000));
+	}
+	auto enqueued = std::chrono::steady_clock::now();
+	taskQueue.enqueueTask(new StampTask(started, done));
+	while (!done || counter < backlog) {
+		es.processAllHandlers();
+		std::this_thread::yield();
+	}
+	es.processAllHandlers();
+	auto latency = std::chrono::duration_cast<std::chrono::microseconds>(started - enqueued).count();
+	std::cout << "Urgent task latency, " << executors << " executors, " << backlog << " queued tasks: " << latency << " us" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	boost::asio::io_service io_service;
+	unsigned int maxExecutors = std::max(2u, std::thread::hardware_concurrency());
+	for (unsigned int executors = 1; executors <= maxExecutors; executors *= 2) {
+		Ember::benchmarkThroughput(io_service, executors, 50000);
+	}
+	for (unsigned int executors = 1; executors <= maxExecutors; executors *= 2) {
+		Ember::benchmarkUrgentLatency(io_service, executors, 2000);
+	}
+	return 0;
+}
@@ -0,0 +1,788 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Benchmarks for the terrain subsystem.
+ *
+ * Measures the number of segment lookups per second through the SegmentManager, with a varying number of concurrent threads,
+ * mimicking the task executors all requesting segments at once.
+ *
+ * Measures height lookups and blits through the HeightMap, comparing them with the sparse map storage which was used before,
+ * as well as comparing single lookups with batched lookups.
+ *
+ * Measures the number of terrain pages processed per second through the TerrainTaskScheduler, with a varying number of
+ * executors. Each page gets a geometry task followed by a surface task, which the scheduler must keep in order.
+ *
+ * Measures blend map generation for a page with eight layers, comparing the previous per layer and per segment blits with the
+ * fused kernel which downsamples and interleaves four layers at once.
+ *
+ * Measures page loads through the SegmentCache, comparing populating segments and surfaces directly with a cold cache (where
+ * everything is populated and written to disk) and a warm cache (where everything is read back from disk).
+ *
+ * Measures the number of plants generated per second by the ClusterPopulator, comparing executing each foliage query by itself
+ * with executing all queries for a segment as one batch.
+ *
+ * Measures the throughput of the precomputed terrain shadows per page, comparing a full update (where the horizon map is calculated)
+ * with an update for a new sun elevation (where only the lighting is recalculated).
+ *
+ * Measures the time it takes to refresh the geometry of a full page, i.e. to blit all its segments into the Ogre height data,
+ * comparing the previous bounds checked copy of each height with the row copies, for both a complete and a half loaded page.
+ *
+ * The benchmarks which compare an implementation with the previous one also check that their results are the same; if not the
+ * program exits with an error.
+ */
+
+#include "components/ogre/terrain/SegmentManager.h"
+#include "components/ogre/terrain/Segment.h"
+#include "components/ogre/terrain/HeightMap.h"
+#include "components/ogre/terrain/HeightMapSegment.h"
+#include "components/ogre/terrain/HeightMapBuffer.h"
+#include "components/ogre/terrain/HeightMapBufferProvider.h"
+#include "components/ogre/terrain/Buffer.h"
+#include "components/ogre/terrain/TerrainTaskScheduler.h"
+#include "components/ogre/terrain/TerrainPageGeometry.h"
+#include "components/ogre/terrain/BlendMapKernels.h"
+#include "components/ogre/terrain/ShadowKernels.h"
+#include "components/ogre/terrain/OgreImage.h"
+#include "components/ogre/terrain/WFImage.h"
+#include "components/ogre/terrain/SegmentCache.h"
+#include "RandomFixture.h"
+#include "components/ogre/terrain/PlantAreaQuery.h"
+#include "components/ogre/terrain/PlantAreaQueryResult.h"
+#include "components/ogre/terrain/TerrainLayerDefinition.h"
+#include "components/ogre/terrain/foliage/ClusterPopulator.h"
+
+#include "framework/tasks/TaskQueue.h"
+#include "framework/tasks/TemplateNamedTask.h"
+#include "framework/TimeFrame.h"
+#include "framework/osdir.h"
+
+#include <Mercator/Terrain.h>
+#include <Mercator/BasePoint.h>
+#include <Mercator/Segment.h>
+#include <Mercator/Surface.h>
+#include <Mercator/GrassShader.h>
+#include <Mercator/FillShader.h>
+
+#include <Eris/EventService.h>
+
+#include <boost/asio.hpp>
+
+#include <wfmath/vector.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Ember
+{
+
+void benchmarkSegmentLookups(OgreView::Terrain::SegmentManager& segmentManager, int segmentsPerSide, unsigned int threads, int lookupsPerThread)
+{
+	std::atomic<long> found(0);
+	std::vector<std::thread> workers;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < threads; ++i) {
+		workers.emplace_back([&, i]() {
+			long localFound = 0;
+			RandomFixture random(i * 7919);
+			for (int j = 0; j < lookupsPerThread; ++j) {
+				unsigned int seed = random.next();
+				int x = (seed >> 8) % segmentsPerSide;
+				int y = (seed >> 20) % segmentsPerSide;
+				if (segmentManager.getSegmentReference(x, y)) {
+					localFound++;
+				}
+			}
+			found += localFound;
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	long lookups = static_cast<long>(threads) * lookupsPerThread;
+	std::cout << "Segment lookups, " << threads << " threads: " << lookups << " lookups (" << found << " found) in " << elapsed / 1000.0 << " ms ("
+			  << (lookups * 1000000.0 / elapsed) << " lookups/s)" << std::endl;
+}
+
+/**
+ * @brief The sparse storage previously used by HeightMap, kept here as a reference.
+ */
+struct SparseHeightMap
+{
+	std::unordered_map<int, std::unordered_map<int, std::shared_ptr<OgreView::Terrain::IHeightMapSegment>>> segments;
+
+	std::shared_ptr<OgreView::Terrain::IHeightMapSegment> getSegment(int xIndex, int yIndex) const
+	{
+		auto I = segments.find(xIndex);
+		if (I == segments.end()) {
+			return std::shared_ptr<OgreView::Terrain::IHeightMapSegment>();
+		}
+		auto J = I->second.find(yIndex);
+		if (J == I->second.end()) {
+			return std::shared_ptr<OgreView::Terrain::IHeightMapSegment>();
+		}
+		return J->second;
+	}
+
+	bool getHeightAndNormal(float x, float y, float& height, WFMath::Vector<3>& normal) const
+	{
+		int ix = static_cast<int>(std::floor(x / 64));
+		int iy = static_cast<int>(std::floor(y / 64));
+		auto segment = getSegment(ix, iy);
+		if (!segment) {
+			return false;
+		}
+		segment->getHeightAndNormal(x - (ix * 64), y - (iy * 64), height, normal);
+		return true;
+	}
+
+	void blitHeights(int xMin, int xMax, int yMin, int yMax, std::vector<float>& heights) const
+	{
+		int xSize = xMax - xMin;
+		for (int segmentX = static_cast<int>(std::floor(xMin / 64.0)); segmentX <= static_cast<int>(std::floor(xMax / 64.0)); ++segmentX) {
+			for (int segmentY = static_cast<int>(std::floor(yMin / 64.0)); segmentY <= static_cast<int>(std::floor(yMax / 64.0)); ++segmentY) {
+				auto segment = getSegment(segmentX, segmentY);
+				if (segment) {
+					int segmentXStart = segmentX * 64;
+					int segmentYStart = segmentY * 64;
+					int xEnd = std::min(xMax - segmentXStart, 64);
+					int yEnd = std::min(yMax - segmentYStart, 64);
+					for (int x = std::max(xMin - segmentXStart, 0); x < xEnd; ++x) {
+						for (int y = std::max(yMin - segmentYStart, 0); y < yEnd; ++y) {
+							heights[((segmentYStart - yMin + y) * xSize) + (segmentXStart - xMin + x)] = segment->getHeight(x, y);
+						}
+					}
+				}
+			}
+		}
+	}
+};
+
+template<typename T>
+double timeIt(T function)
+{
+	auto start = std::chrono::steady_clock::now();
+	function();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+}
+
+void benchmarkHeightMap(int segmentsPerSide)
+{
+	OgreView::Terrain::HeightMapBufferProvider provider(65, segmentsPerSide * segmentsPerSide);
+	OgreView::Terrain::HeightMap heightMap(0, 64);
+	SparseHeightMap sparseHeightMap;
+	for (int x = 0; x < segmentsPerSide; ++x) {
+		for (int y = 0; y < segmentsPerSide; ++y) {
+			auto buffer = provider.checkout();
+			float* data = buffer->getBuffer()->getData();
+			for (int i = 0; i < 65 * 65; ++i) {
+				data[i] = std::sin(i * 0.01f) * 10.0f;
+			}
+			auto segment = new OgreView::Terrain::HeightMapSegment(buffer);
+			heightMap.insert(x, y, segment);
+			//The sparse map mustn't delete the segment, since it's owned by the height map.
+			sparseHeightMap.segments[x][y] = std::shared_ptr<OgreView::Terrain::IHeightMapSegment>(segment, [](OgreView::Terrain::IHeightMapSegment*) {});
+		}
+	}
+
+	//Sample along a number of lines, as when rasterizing or snapping a group of entities.
+	const size_t samples = 1000000;
+	std::vector<float> xs(samples), ys(samples), heights(samples), normals(samples * 3);
+	float worldSize = segmentsPerSide * 64.0f;
+	for (size_t i = 0; i < samples; ++i) {
+		xs[i] = std::fmod(i * 0.37f, worldSize - 1);
+		ys[i] = std::fmod((i / 1000) * 7.3f, worldSize - 1);
+	}
+
+	float sum = 0;
+	double sparseTime = timeIt([&]() {
+		for (size_t i = 0; i < samples; ++i) {
+			WFMath::Vector<3> normal;
+			sparseHeightMap.getHeightAndNormal(xs[i], ys[i], heights[i], normal);
+			sum += normal.y();
+		}
+	});
+	double denseTime = timeIt([&]() {
+		for (size_t i = 0; i < samples; ++i) {
+			WFMath::Vector<3> normal;
+			heightMap.getHeightAndNormal(xs[i], ys[i], heights[i], normal);
+			sum += normal.y();
+		}
+	});
+	double batchTime = timeIt([&]() {
+		heightMap.getHeights(xs.data(), ys.data(), heights.data(), normals.data(), samples);
+	});
+	double batchNoNormalsTime = timeIt([&]() {
+		heightMap.getHeights(xs.data(), ys.data(), heights.data(), nullptr, samples);
+	});
+	std::cout << "Height and normal lookups, " << samples << " samples: sparse " << sparseTime << " ms, dense " << denseTime << " ms, batch " << batchTime
+			  << " ms, batch without normals " << batchNoNormalsTime << " ms (" << sum << ")" << std::endl;
+
+	int size = segmentsPerSide * 64 - 32;
+	std::vector<float> blit(static_cast<size_t>(size) * size);
+	double sparseBlitTime = timeIt([&]() {
+		sparseHeightMap.blitHeights(16, 16 + size, 16, 16 + size, blit);
+	});
+	double denseBlitTime = timeIt([&]() {
+		heightMap.blitHeights(16, 16 + size, 16, 16 + size, blit);
+	});
+	std::cout << "Height blit, " << size << "x" << size << ": sparse " << sparseBlitTime << " ms, dense " << denseBlitTime << " ms" << std::endl;
+}
+
+}
+
+/**
+ * @brief Mimics a geometry update, by populating the heights and normals of all segments in a page.
+ */
+class PageGeometryTask : public Tasks::TemplateNamedTask<PageGeometryTask>
+{
+public:
+	PageGeometryTask(std::vector<OgreView::Terrain::SegmentRefPtr> segments, std::set<TerrainIndex>& activePages, std::mutex& mutex, TerrainIndex index, std::atomic<int>& violations) :
+			mSegments(std::move(segments)), mActivePages(activePages), mMutex(mutex), mIndex(index), mViolations(violations)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (!mActivePages.insert(mIndex).second) {
+				mViolations++;
+			}
+		}
+		for (auto& segment : mSegments) {
+			Mercator::Segment& mercatorSegment = segment->getMercatorSegment();
+			mercatorSegment.invalidate();
+			mercatorSegment.populate();
+			mercatorSegment.populateNormals();
+		}
+		std::lock_guard<std::mutex> lock(mMutex);
+		mActivePages.erase(mIndex);
+	}
+
+private:
+	std::vector<OgreView::Terrain::SegmentRefPtr> mSegments;
+	std::set<TerrainIndex>& mActivePages;
+	std::mutex& mMutex;
+	TerrainIndex mIndex;
+	std::atomic<int>& mViolations;
+};
+
+/**
+ * @brief Mimics a surface compilation, by calculating a slope based blend map from the normals of all segments in a page.
+ * The segments must have been populated by a PageGeometryTask first.
+ */
+class PageSurfaceTask : public Tasks::TemplateNamedTask<PageSurfaceTask>
+{
+public:
+	PageSurfaceTask(std::vector<OgreView::Terrain::SegmentRefPtr> segments, std::atomic<int>& completedPages, std::atomic<int>& violations) :
+			mSegments(std::move(segments)), mCompletedPages(completedPages), mViolations(violations)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		for (auto& segment : mSegments) {
+			Mercator::Segment& mercatorSegment = segment->getMercatorSegment();
+			const float* normals = mercatorSegment.getNormals();
+			if (!mercatorSegment.isValid() || !normals) {
+				mViolations++;
+				continue;
+			}
+			int size = mercatorSegment.getSize();
+			mBlendMap.resize(static_cast<size_t>(size) * size);
+			for (int i = 0; i < size * size; ++i) {
+				float slope = 1.0f - normals[(i * 3) + 2];
+				mBlendMap[i] = static_cast<unsigned char>(std::min(255.0f, slope * 1024.0f));
+			}
+		}
+		mSegments.clear();
+	}
+
+	bool executeTaskInMainThread() override
+	{
+		mCompletedPages++;
+		return true;
+	}
+
+private:
+	std::vector<OgreView::Terrain::SegmentRefPtr> mSegments;
+	std::vector<unsigned char> mBlendMap;
+	std::atomic<int>& mCompletedPages;
+	std::atomic<int>& mViolations;
+};
+
+void benchmarkPageTasks(boost::asio::io_service& io_service, OgreView::Terrain::SegmentManager& segmentManager, unsigned int executors, int pagesPerSide, int segmentsPerPage)
+{
+	Eris::EventService es(io_service);
+	Tasks::TaskQueue taskQueue(executors, es, false);
+	OgreView::Terrain::TerrainTaskScheduler scheduler(taskQueue);
+
+	std::set<TerrainIndex> activePages;
+	std::mutex mutex;
+	std::atomic<int> completedPages(0);
+	std::atomic<int> violations(0);
+
+	auto start = std::chrono::steady_clock::now();
+	//Enqueue each page twice, as when a page is created and then altered, to exercise the ordering of tasks on the same page.
+	for (int pass = 0; pass < 2; ++pass) {
+		for (int pageX = 0; pageX < pagesPerSide; ++pageX) {
+			for (int pageY = 0; pageY < pagesPerSide; ++pageY) {
+				std::vector<OgreView::Terrain::SegmentRefPtr> segments;
+				for (int x = 0; x < segmentsPerPage; ++x) {
+					for (int y = 0; y < segmentsPerPage; ++y) {
+						segments.push_back(segmentManager.getSegmentReference((pageX * segmentsPerPage) + x, (pageY * segmentsPerPage) + y));
+					}
+				}
+				TerrainIndex index(pageX, pageY);
+				scheduler.enqueuePageTask(new PageGeometryTask(segments, activePages, mutex, index, violations), {index});
+				scheduler.enqueuePageTask(new PageSurfaceTask(segments, completedPages, violations), {index});
+			}
+		}
+	}
+	while (scheduler.getUncompletedTaskCount() != 0) {
+		if (taskQueue.pollProcessedTasks(TimeFrame(boost::posix_time::milliseconds(10))) == 0) {
+			std::this_thread::yield();
+		}
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Page tasks, " << executors << " executors: " << completedPages << " pages in " << elapsed / 1000.0 << " ms ("
+			  << (completedPages * 1000000.0 / elapsed) << " pages/s, " << violations << " ordering violations)" << std::endl;
+}
+
+/**
+ * Returns false if the fused kernel doesn't give the same result as the blits.
+ */
+bool benchmarkBlendMaps(int iterations)
+{
+	const unsigned int resolution = 64;
+	const unsigned int segmentsPerAxis = 4;
+	const unsigned int layers = 8;
+	const unsigned int imageSize = resolution * segmentsPerAxis;
+	const unsigned int segmentSize = resolution + 1;
+
+	//Coverage for each layer and segment.
+	std::vector<std::vector<unsigned char>> coverage;
+	RandomFixture random;
+	for (unsigned int i = 0; i < layers * segmentsPerAxis * segmentsPerAxis; ++i) {
+		coverage.push_back(random.createBytes(segmentSize * segmentSize));
+	}
+	auto getCoverage = [&](unsigned int layer, unsigned int x, unsigned int y) {
+		return coverage[(layer * segmentsPerAxis * segmentsPerAxis) + (y * segmentsPerAxis) + x].data();
+	};
+
+	std::vector<std::unique_ptr<OgreView::Terrain::OgreImage>> images;
+	for (unsigned int batch = 0; batch < layers / 4; ++batch) {
+		images.emplace_back(new OgreView::Terrain::OgreImage(new OgreView::Terrain::Image::ImageBuffer(imageSize, 4)));
+	}
+
+	//The previous implementation, which allocated an image per segment and layer and blitted it one channel at a time.
+	double blitTime = timeIt([&]() {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			for (unsigned int layer = 0; layer < layers; ++layer) {
+				auto& image = *images[layer / 4];
+				for (unsigned int y = 0; y < segmentsPerAxis; ++y) {
+					for (unsigned int x = 0; x < segmentsPerAxis; ++x) {
+						const unsigned char* srcPtr = getCoverage(layer, x, y);
+						OgreView::Terrain::WFImage sourceImage(new OgreView::Terrain::Image::ImageBuffer(resolution, 1));
+						auto dataPtr = sourceImage.getData();
+						for (unsigned int i = 0; i < resolution; ++i) {
+							for (unsigned int j = 0; j < resolution; ++j) {
+								*dataPtr = (unsigned char)((srcPtr[(i * segmentSize) + j] + srcPtr[(i * segmentSize) + j + 1] + srcPtr[((i + 1) * segmentSize) + j] + srcPtr[((i + 1) * segmentSize) + j + 1]) / 4);
+								dataPtr++;
+							}
+						}
+						image.blit(sourceImage, layer % 4, x * resolution, (segmentsPerAxis - y - 1) * resolution);
+					}
+				}
+			}
+		}
+	});
+	std::vector<unsigned char> blitResult(images[0]->getData(), images[0]->getData() + images[0]->getSize());
+
+	double fusedTime = timeIt([&]() {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			for (unsigned int batch = 0; batch < layers / 4; ++batch) {
+				auto& image = *images[batch];
+				for (unsigned int y = 0; y < segmentsPerAxis; ++y) {
+					for (unsigned int x = 0; x < segmentsPerAxis; ++x) {
+						const unsigned char* sources[OgreView::Terrain::BlendMapKernels::InterleavedLayers];
+						for (unsigned int i = 0; i < OgreView::Terrain::BlendMapKernels::InterleavedLayers; ++i) {
+							sources[i] = getCoverage((batch * 4) + i, x, y);
+						}
+						unsigned char* destination = image.getData() + ((((imageSize - ((segmentsPerAxis - y) * resolution)) * imageSize) + (x * resolution)) * 4);
+						OgreView::Terrain::BlendMapKernels::downsampleInterleaved(sources, resolution, destination, imageSize * 4);
+					}
+				}
+			}
+		}
+	});
+	bool identical = std::equal(blitResult.begin(), blitResult.end(), images[0]->getData());
+
+	std::cout << "Blend maps, " << layers << " layers of " << imageSize << "x" << imageSize << ", " << iterations << " iterations: per layer blits " << blitTime
+			  << " ms, fused " << fusedTime << " ms (" << blitTime / fusedTime << "x, results " << (identical ? "identical" : "DIFFER") << ")" << std::endl;
+	return identical;
+}
+
+void benchmarkSegmentCache(int pages, int segmentsPerPage)
+{
+	char directoryTemplate[] = "/tmp/ember-segmentcache-XXXXXX";
+	if (!mkdtemp(directoryTemplate)) {
+		std::cerr << "Could not create a temporary directory for the segment cache benchmark." << std::endl;
+		return;
+	}
+	std::string directory(directoryTemplate);
+
+	const int resolution = 64;
+	const int segmentsPerSide = pages * segmentsPerPage;
+	Mercator::GrassShader shader;
+	std::vector<std::unique_ptr<Mercator::Segment>> segments;
+	for (int x = 0; x < segmentsPerSide; ++x) {
+		for (int y = 0; y < segmentsPerSide; ++y) {
+			auto segment = new Mercator::Segment(x * resolution, y * resolution, resolution);
+			segment->setCornerPoint(0, 0, Mercator::BasePoint(10.0f + x, 2.0f));
+			segment->setCornerPoint(1, 0, Mercator::BasePoint(10.0f + x + 1, 2.0f));
+			segment->setCornerPoint(0, 1, Mercator::BasePoint(10.0f + y, 2.0f));
+			segment->setCornerPoint(1, 1, Mercator::BasePoint(10.0f + y + 1, 2.0f));
+			segments.emplace_back(segment);
+			segment->getSurfaces()[1] = shader.newSurface(*segment);
+		}
+	}
+
+	//Populates all segments as a terrain page does, with heights, normals and the surface.
+	auto loadPages = [&](OgreView::Terrain::SegmentCache* cache) {
+		for (size_t i = 0; i < segments.size(); ++i) {
+			auto& segment = *segments[i];
+			segment.invalidate();
+			if (cache) {
+				cache->populate(segment);
+				segment.populateNormals();
+				cache->populateSurfaces(segment, {{1, 0}});
+			} else {
+				segment.populate();
+				segment.populateNormals();
+				segment.populateSurfaces();
+			}
+		}
+	};
+
+	OgreView::Terrain::SegmentCache cache(directory);
+	double uncachedTime = timeIt([&]() { loadPages(nullptr); });
+	double coldTime = timeIt([&]() { loadPages(&cache); });
+	double warmTime = timeIt([&]() { loadPages(&cache); });
+
+	int pageCount = pages * pages;
+	std::cout << "Segment cache, " << pageCount << " pages of " << segmentsPerPage << "x" << segmentsPerPage << " segments: uncached " << uncachedTime / pageCount
+			  << " ms/page, cold " << coldTime / pageCount << " ms/page, warm " << warmTime / pageCount << " ms/page (" << uncachedTime / warmTime << "x, "
+			  << cache.getHitCount() << " hits, " << cache.getMissCount() << " misses)" << std::endl;
+
+	oslink::directory osdir(directory);
+	while (osdir) {
+		std::string name = osdir.next();
+		if (name != "." && name != "..") {
+			std::remove((directory + "/" + name).c_str());
+		}
+	}
+	std::remove(directory.c_str());
+}
+
+void benchmarkPlantQueries(int segmentsPerSide, int queriesPerSide, int iterations)
+{
+	//The shader must outlive the terrain, which holds surfaces referring to it.
+	Mercator::FillShader shader;
+	Mercator::Terrain terrain(Mercator::Terrain::SHADED);
+	terrain.addShader(&shader, 0);
+	for (int x = 0; x <= segmentsPerSide; ++x) {
+		for (int y = 0; y <= segmentsPerSide; ++y) {
+			terrain.setBasePoint(x, y, Mercator::BasePoint(10.0f + (x % 3), 2.0f));
+		}
+	}
+	OgreView::Terrain::SegmentManager segmentManager(terrain, 256 * 1024 * 1024);
+	segmentManager.syncWithTerrain();
+
+	OgreView::Terrain::TerrainLayerDefinition layerDefinition;
+	std::string plantType("grass");
+	OgreView::Terrain::Foliage::ClusterPopulator populator(0, new OgreView::Terrain::Foliage::UniformScaler(0.5f, 1.5f), 0);
+	populator.setMinClusterRadius(2.0f);
+	populator.setMaxClusterRadius(6.0f);
+	populator.setClusterDistance(6.0f);
+	populator.setDensity(1.0f);
+
+	//Split each segment into a number of query areas, as the foliage paging does.
+	const int resolution = terrain.getResolution();
+	const float querySize = static_cast<float>(resolution) / queriesPerSide;
+	std::vector<OgreView::Terrain::SegmentRefPtr> segments;
+	std::vector<std::vector<OgreView::Terrain::PlantAreaQuery>> queries;
+	for (int x = 0; x < segmentsPerSide; ++x) {
+		for (int y = 0; y < segmentsPerSide; ++y) {
+			segments.push_back(segmentManager.getSegmentReference(x, y));
+			queries.emplace_back();
+			for (int i = 0; i < queriesPerSide; ++i) {
+				for (int j = 0; j < queriesPerSide; ++j) {
+					float left = (x * resolution) + (i * querySize);
+					float top = (y * resolution) + (j * querySize);
+					Ogre::TRect<Ogre::Real> area(left, top, left + querySize, top + querySize);
+					queries.back().emplace_back(layerDefinition, plantType, area, Ogre::Vector2(left + (querySize / 2), top + (querySize / 2)));
+				}
+			}
+		}
+	}
+
+	size_t plantCount = 0;
+	auto runQueries = [&](bool batched) {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			for (size_t i = 0; i < segments.size(); ++i) {
+				std::vector<std::unique_ptr<OgreView::Terrain::PlantAreaQueryResult>> results;
+				std::vector<OgreView::Terrain::PlantAreaQueryResult*> batch;
+				for (auto& query : queries[i]) {
+					results.emplace_back(new OgreView::Terrain::PlantAreaQueryResult(query));
+					batch.push_back(results.back().get());
+				}
+				if (batched) {
+					populator.populateBatch(batch, segments[i]);
+				} else {
+					for (auto result : batch) {
+						populator.populate(*result, segments[i]);
+					}
+				}
+				for (auto& result : results) {
+					plantCount += result->getStore().size();
+				}
+			}
+		}
+	};
+
+	//Populate the segments and the cluster cache before timing.
+	runQueries(true);
+	plantCount = 0;
+	double singleTime = timeIt([&]() { runQueries(false); });
+	size_t singlePlants = plantCount;
+	plantCount = 0;
+	double batchedTime = timeIt([&]() { runQueries(true); });
+	size_t batchedPlants = plantCount;
+
+	std::cout << "Plant queries, " << segments.size() * queriesPerSide * queriesPerSide << " queries, " << iterations << " iterations: single "
+			  << (singlePlants * 1000.0 / singleTime) << " plants/s, batched " << (batchedPlants * 1000.0 / batchedTime) << " plants/s ("
+			  << singleTime / batchedTime << "x, " << batchedPlants / iterations << " plants per iteration)" << std::endl;
+}
+
+/**
+ * Returns false if the kernels give a different result for whole rows than for each point by itself, i.e. if the SIMD path
+ * differs from the scalar path.
+ */
+bool benchmarkShadows(int iterations)
+{
+	const unsigned int resolution = 512;
+	const int border = OgreView::Terrain::ShadowKernels::HorizonDistance;
+	const size_t stride = resolution + 1 + (border * 2);
+
+	//Rolling hills, steep enough to cast shadows on each other.
+	std::vector<float> heights(stride * stride);
+	for (size_t y = 0; y < stride; ++y) {
+		for (size_t x = 0; x < stride; ++x) {
+			heights[(y * stride) + x] = 20.0f * std::sin(x * 0.05f) * std::cos(y * 0.03f);
+		}
+	}
+	const float* pageHeights = heights.data() + ((border + 1) * stride) + border;
+	std::vector<float> horizon(resolution * resolution);
+	std::vector<unsigned char> image(resolution * resolution);
+
+	auto sunDirection = [](float elevation, float azimuth, float direction[3]) {
+		direction[0] = std::cos(elevation) * std::cos(azimuth);
+		direction[1] = std::cos(elevation) * std::sin(azimuth);
+		direction[2] = std::sin(elevation);
+	};
+
+	double fullTime = timeIt([&]() {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			float direction[3];
+			sunDirection(0.3f, iteration * 0.1f, direction);
+			OgreView::Terrain::ShadowKernels::calculateHorizon(pageHeights, stride, resolution, resolution, direction[0] / std::cos(0.3f), direction[1] / std::cos(0.3f), horizon.data());
+			OgreView::Terrain::ShadowKernels::shade(pageHeights, stride, resolution, resolution, horizon.data(), direction, image.data(), resolution);
+		}
+	});
+
+	double lightingTime = timeIt([&]() {
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			float direction[3];
+			sunDirection(0.1f + iteration * 0.01f, (iterations - 1) * 0.1f, direction);
+			OgreView::Terrain::ShadowKernels::shade(pageHeights, stride, resolution, resolution, horizon.data(), direction, image.data(), resolution);
+		}
+	});
+
+	//Calculating a single point at a time only uses the scalar path.
+	bool identical = true;
+	float horizonDirection[3];
+	float lightingDirection[3];
+	sunDirection(0.3f, (iterations - 1) * 0.1f, horizonDirection);
+	sunDirection(0.1f + (iterations - 1) * 0.01f, (iterations - 1) * 0.1f, lightingDirection);
+	for (unsigned int y = 0; y < resolution && identical; ++y) {
+		for (unsigned int x = 0; x < resolution; ++x) {
+			const float* point = pageHeights + (y * stride) + x;
+			float pointHorizon;
+			unsigned char pointValue;
+			OgreView::Terrain::ShadowKernels::calculateHorizon(point, stride, 1, 1, horizonDirection[0] / std::cos(0.3f), horizonDirection[1] / std::cos(0.3f), &pointHorizon);
+			OgreView::Terrain::ShadowKernels::shade(point, stride, 1, 1, &pointHorizon, lightingDirection, &pointValue, 1);
+			if (pointHorizon != horizon[(y * resolution) + x] || pointValue != image[(y * resolution) + x]) {
+				identical = false;
+				break;
+			}
+		}
+	}
+
+	size_t shadowedTexels = std::count_if(image.begin(), image.end(), [](unsigned char value) { return value < 128; });
+	double texels = static_cast<double>(resolution) * resolution * iterations;
+	std::cout << "Shadows, " << resolution << "x" << resolution << " pages, " << iterations << " iterations: full update " << fullTime / iterations << " ms/page ("
+			  << texels / (fullTime * 1000.0) << " Mtexels/s), new elevation " << lightingTime / iterations << " ms/page (" << texels / (lightingTime * 1000.0)
+			  << " Mtexels/s), " << shadowedTexels * 100 / image.size() << "% dark, results " << (identical ? "identical" : "DIFFER") << std::endl;
+	return identical;
+}
+
+/**
+ * Returns false if the row copies don't give the same result as the per height copies.
+ */
+bool benchmarkHeightBlits(OgreView::Terrain::SegmentManager& segmentManager, int iterations)
+{
+	const int segmentsPerPage = 8;
+	const int pageSize = (segmentsPerPage * 64) + 1;
+	const float defaultHeight = -15.0f;
+
+	OgreView::Terrain::SegmentManager::IndexMap indices;
+	for (int x = 0; x < segmentsPerPage; ++x) {
+		for (int z = 0; z < segmentsPerPage; ++z) {
+			indices[x][z] = std::make_pair(x, z);
+		}
+	}
+	OgreView::Terrain::SegmentRefStore segments;
+	segmentManager.getSegmentReferences(indices, segments);
+	for (auto& column : segments) {
+		for (auto& entry : column.second) {
+			entry.second->getMercatorSegment().populate();
+		}
+	}
+
+	//The blit as it was done before, with the whole page first set to the default height and a bounds check for each height.
+	auto blitPerHeight = [&](float* heightData) {
+		std::fill(heightData, heightData + (pageSize * pageSize), defaultHeight);
+		float* dataEnd = heightData + (pageSize * pageSize);
+		for (auto& column : segments) {
+			for (auto& entry : column.second) {
+				Mercator::Segment& segment = entry.second->getMercatorSegment();
+				if (segment.isValid()) {
+					int segmentWidth = segment.getSize();
+					const float* sourcePtr = segment.getPoints();
+					float* destPtr = heightData + (pageSize * (pageSize - (entry.first * 64) - 1)) + (column.first * 64);
+					for (int i = 0; i < segmentWidth; ++i) {
+						for (int j = 0; j < segmentWidth; ++j) {
+							if ((destPtr + j) >= heightData && (destPtr + j) < dataEnd) {
+								*(destPtr + j) = *(sourcePtr + j);
+							}
+						}
+						destPtr -= pageSize;
+						sourcePtr += segmentWidth;
+					}
+				}
+			}
+		}
+	};
+
+	std::vector<float> perHeightData(pageSize * pageSize);
+	std::vector<float> rowData(pageSize * pageSize);
+
+	bool matches = true;
+	auto measure = [&](const char* name) {
+		double perHeightTime = timeIt([&]() {
+			for (int iteration = 0; iteration < iterations; ++iteration) {
+				blitPerHeight(perHeightData.data());
+			}
+		});
+		double rowTime = timeIt([&]() {
+			for (int iteration = 0; iteration < iterations; ++iteration) {
+				OgreView::Terrain::TerrainPageGeometry::blitSegments(segments, pageSize, defaultHeight, rowData.data(), pageSize);
+			}
+		});
+		bool identical = std::memcmp(perHeightData.data(), rowData.data(), rowData.size() * sizeof(float)) == 0;
+		std::cout << "Height blits, " << name << " " << pageSize << "x" << pageSize << " page, " << iterations << " iterations: per height " << perHeightTime / iterations
+				  << " ms/page, row copies " << rowTime / iterations << " ms/page (" << perHeightTime / rowTime << "x, results " << (identical ? "identical" : "DIFFER") << ")" << std::endl;
+		matches = matches && identical;
+	};
+
+	measure("full");
+
+	//Leave every other segment unpopulated, as when a page is shown before all of its segments have been loaded.
+	int count = 0;
+	for (auto& column : segments) {
+		for (auto& entry : column.second) {
+			if (count++ % 2) {
+				entry.second->getMercatorSegment().invalidate();
+			}
+		}
+	}
+	measure("half loaded");
+	return matches;
+}
+
+int main(int argc, char** argv)
+{
+	const int segmentsPerSide = 64;
+	Mercator::Terrain terrain;
+	for (int x = 0; x <= segmentsPerSide; ++x) {
+		for (int y = 0; y <= segmentsPerSide; ++y) {
+			terrain.setBasePoint(x, y, Mercator::BasePoint(10.0f));
+		}
+	}
+
+	Ember::OgreView::Terrain::SegmentManager segmentManager(terrain, 256 * 1024 * 1024);
+	segmentManager.syncWithTerrain();
+
+	unsigned int maxThreads = std::max(2u, std::thread::hardware_concurrency());
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+		Ember::benchmarkSegmentLookups(segmentManager, segmentsPerSide, threads, 1000000);
+	}
+
+	Ember::benchmarkHeightMap(16);
+
+	bool matches = Ember::benchmarkBlendMaps(100);
+
+	Ember::benchmarkSegmentCache(4, 4);
+
+	Ember::benchmarkPlantQueries(8, 4, 10);
+
+	matches = Ember::benchmarkShadows(20) && matches;
+
+	matches = Ember::benchmarkHeightBlits(segmentManager, 200) && matches;
+
+	boost::asio::io_service io_service;
+	for (unsigned int executors = 1; executors <= maxThreads; executors *= 2) {
+		Ember::benchmarkPageTasks(io_service, segmentManager, executors, 8, 4);
+	}
+	return matches ? 0 : 1;
+}
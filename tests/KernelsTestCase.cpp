@@ -0,0 +1,245 @@
+#include "KernelsTestCase.h"
+#include "RandomFixture.h"
+
+#include "components/ogre/environment/pagedgeometry/include/BatchKernels.h"
+#include "components/ogre/terrain/BlendMapKernels.h"
+#include "components/ogre/terrain/ShadowKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace Ember::OgreView::Terrain;
+
+namespace Ember
+{
+
+namespace
+{
+
+struct Vertex
+{
+	float position[3];
+	float normal[3];
+	Ogre::uint32 colour;
+};
+
+/**
+ * The matrix used by the kernels and the quaternion round differently, so the results are compared with a tolerance.
+ */
+void assertVectorsClose(const Ogre::Vector3& expected, const float* actual)
+{
+	for (int i = 0; i < 3; ++i) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i], actual[i], 1e-4 * std::max(1.0f, std::abs(expected[i])));
+	}
+}
+
+/**
+ * Finds the horizon of a single point, sampling the same points as the kernel.
+ */
+float calculateReferenceHorizon(const float* point, size_t stride, float directionX, float directionY)
+{
+	float maxSlope = -std::numeric_limits<float>::max();
+	for (float distance = 1.0f; distance <= ShadowKernels::HorizonDistance; distance = std::max(distance + 1.0f, distance * 1.25f)) {
+		long x = std::lround(directionX * distance);
+		long y = std::lround(directionY * distance);
+		if (x != 0 || y != 0) {
+			float inverseDistance = 1.0f / std::sqrt(static_cast<float>((x * x) + (y * y)));
+			maxSlope = std::max(maxSlope, (point[(y * static_cast<long>(stride)) + x] - point[0]) * inverseDistance);
+		}
+	}
+	return maxSlope;
+}
+
+float calculateReferenceVisibility(const float sunDirection[3], float horizon)
+{
+	float sunTangent = sunDirection[2] / std::sqrt((sunDirection[0] * sunDirection[0]) + (sunDirection[1] * sunDirection[1]));
+	return std::min(std::max(((sunTangent - horizon) * 10.0f) + 0.5f, 0.0f), 1.0f);
+}
+
+unsigned char shadeReferencePoint(const float* point, size_t stride, float visibility, const float sunDirection[3])
+{
+	float dx = (point[1] - point[-1]) * 0.5f;
+	float dy = (point[stride] - point[-static_cast<long>(stride)]) * 0.5f;
+	float dot = ((sunDirection[2] - (dx * sunDirection[0])) - (dy * sunDirection[1])) / std::sqrt(((dx * dx) + (dy * dy)) + 1.0f);
+	float light = ((dot * 0.5f) + 0.5f) * (0.4f + (0.6f * visibility)) * 255.0f;
+	return static_cast<unsigned char>(std::min(std::max(light, 0.0f), 255.0f));
+}
+
+}
+
+void KernelsTestCase::testBatchKernels()
+{
+	RandomFixture random;
+
+	//Use a vertex count which isn't a multiple of the SIMD width, and a stride which isn't a multiple of 16 bytes.
+	const size_t vertexCount = 37;
+	std::vector<Vertex> source(vertexCount);
+	for (auto& vertex : source) {
+		for (int i = 0; i < 3; ++i) {
+			vertex.position[i] = (random.nextFloat() * 20.0f) - 10.0f;
+			vertex.normal[i] = random.nextFloat() - 0.5f;
+		}
+		vertex.colour = random.next();
+	}
+
+	const Ogre::Quaternion orientation(Ogre::Degree(37), Ogre::Vector3(1, 2, 3).normalisedCopy());
+	const Ogre::Vector3 scale(0.8f, 1.2f, 0.9f);
+	const Ogre::Vector3 translation(3, -2, 5);
+	const Ogre::ColourValue colour(0.5f, 0.25f, 1.0f, 0.3f);
+	auto transform = Forests::BatchKernels::makeInstanceTransform(orientation, scale, translation);
+
+	std::vector<Vertex> destination(source);
+	auto sourceBytes = reinterpret_cast<const unsigned char*>(source.data());
+	auto destinationBytes = reinterpret_cast<unsigned char*>(destination.data());
+	Forests::BatchKernels::transformPositions(sourceBytes + offsetof(Vertex, position), destinationBytes + offsetof(Vertex, position), sizeof(Vertex), vertexCount, transform);
+	Forests::BatchKernels::rotateVectors(sourceBytes + offsetof(Vertex, normal), destinationBytes + offsetof(Vertex, normal), sizeof(Vertex), vertexCount, transform);
+	Forests::BatchKernels::modulateColours(sourceBytes + offsetof(Vertex, colour), destinationBytes + offsetof(Vertex, colour), sizeof(Vertex), vertexCount, colour);
+
+	for (size_t i = 0; i < vertexCount; ++i) {
+		Ogre::Vector3 position(source[i].position[0], source[i].position[1], source[i].position[2]);
+		Ogre::Vector3 normal(source[i].normal[0], source[i].normal[1], source[i].normal[2]);
+		assertVectorsClose((orientation * (position * scale)) + translation, destination[i].position);
+		assertVectorsClose(orientation * normal, destination[i].normal);
+
+		Ogre::uint32 packed = source[i].colour;
+		Ogre::uint32 expectedColour = static_cast<Ogre::uint8>((packed & 0xFF) * colour.r)
+									  | (static_cast<Ogre::uint8>(((packed >> 8) & 0xFF) * colour.g) << 8)
+									  | (static_cast<Ogre::uint8>(((packed >> 16) & 0xFF) * colour.b) << 16)
+									  | (packed & 0xFF000000);
+		CPPUNIT_ASSERT_EQUAL(expectedColour, destination[i].colour);
+	}
+
+	//Transforming in place must give the same result.
+	std::vector<Vertex> inPlace(source);
+	auto inPlaceBytes = reinterpret_cast<unsigned char*>(inPlace.data());
+	Forests::BatchKernels::transformPositions(inPlaceBytes, inPlaceBytes, sizeof(Vertex), vertexCount, transform);
+	Forests::BatchKernels::rotateVectors(inPlaceBytes + offsetof(Vertex, normal), inPlaceBytes + offsetof(Vertex, normal), sizeof(Vertex), vertexCount, transform);
+	CPPUNIT_ASSERT(std::memcmp(inPlace.data(), destination.data(), sizeof(Vertex) * vertexCount) == 0);
+
+	//Leave an extra index at the end of each destination, which must be left untouched.
+	std::vector<Ogre::uint16> indices16(vertexCount);
+	std::vector<Ogre::uint32> indices32(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		indices16[i] = static_cast<Ogre::uint16>(random.next() >> 16);
+		indices32[i] = random.next();
+	}
+	std::vector<Ogre::uint16> offset16(vertexCount + 1, 7);
+	std::vector<Ogre::uint32> offset16To32(vertexCount + 1, 7);
+	std::vector<Ogre::uint32> offset32(vertexCount + 1, 7);
+	Forests::BatchKernels::offsetIndices(indices16.data(), offset16.data(), vertexCount, 65000);
+	Forests::BatchKernels::offsetIndices(indices16.data(), offset16To32.data(), vertexCount, 70000);
+	Forests::BatchKernels::offsetIndices(indices32.data(), offset32.data(), vertexCount, 70000);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		CPPUNIT_ASSERT_EQUAL(static_cast<Ogre::uint16>(indices16[i] + 65000u), offset16[i]);
+		CPPUNIT_ASSERT_EQUAL(static_cast<Ogre::uint32>(indices16[i] + 70000u), offset16To32[i]);
+		CPPUNIT_ASSERT_EQUAL(static_cast<Ogre::uint32>(indices32[i] + 70000u), offset32[i]);
+	}
+	CPPUNIT_ASSERT_EQUAL(static_cast<Ogre::uint16>(7), offset16[vertexCount]);
+	CPPUNIT_ASSERT_EQUAL(static_cast<Ogre::uint32>(7), offset16To32[vertexCount]);
+	CPPUNIT_ASSERT_EQUAL(static_cast<Ogre::uint32>(7), offset32[vertexCount]);
+}
+
+void KernelsTestCase::testBlendMapKernels()
+{
+	//Use a resolution which isn't a multiple of 16, to also exercise the scalar tail.
+	const unsigned int resolution = 37;
+	const unsigned int segmentSize = resolution + 1;
+	const unsigned int imageSize = resolution + 3;
+	RandomFixture random;
+	std::vector<unsigned char> coverage[BlendMapKernels::InterleavedLayers];
+	for (auto& layerCoverage : coverage) {
+		layerCoverage = random.createBytes(segmentSize * segmentSize);
+	}
+	//Leave one layer out, which should result in zeroes.
+	const unsigned char* sources[BlendMapKernels::InterleavedLayers] = {coverage[0].data(), nullptr, coverage[2].data(), coverage[3].data()};
+
+	std::vector<unsigned char> interleaved(imageSize * imageSize * 4, 255);
+	std::vector<unsigned char> separate(imageSize * imageSize * 4, 255);
+	unsigned char* interleavedStart = interleaved.data() + ((imageSize + 2) * 4);
+	unsigned char* separateStart = separate.data() + ((imageSize + 2) * 4);
+	BlendMapKernels::downsampleInterleaved(sources, resolution, interleavedStart, imageSize * 4);
+	for (unsigned int channel = 0; channel < BlendMapKernels::InterleavedLayers; ++channel) {
+		BlendMapKernels::downsample(coverage[channel].data(), resolution, separateStart + channel, 4, imageSize * 4);
+	}
+
+	for (unsigned int y = 0; y < imageSize; ++y) {
+		for (unsigned int x = 0; x < imageSize; ++x) {
+			for (unsigned int channel = 0; channel < BlendMapKernels::InterleavedLayers; ++channel) {
+				size_t index = (((y * imageSize) + x) * 4) + channel;
+				if (y >= 1 && y < 1 + resolution && x >= 2 && x < 2 + resolution) {
+					const unsigned char* source = coverage[channel].data() + ((y - 1) * segmentSize) + (x - 2);
+					unsigned char expected = static_cast<unsigned char>((source[0] + source[1] + source[segmentSize] + source[segmentSize + 1]) / 4);
+					CPPUNIT_ASSERT_EQUAL(expected, separate[index]);
+					CPPUNIT_ASSERT_EQUAL(sources[channel] ? expected : static_cast<unsigned char>(0), interleaved[index]);
+				} else {
+					//Texels outside of the segment must be left untouched.
+					CPPUNIT_ASSERT_EQUAL(static_cast<unsigned char>(255), separate[index]);
+					CPPUNIT_ASSERT_EQUAL(static_cast<unsigned char>(255), interleaved[index]);
+				}
+			}
+		}
+	}
+}
+
+void KernelsTestCase::testShadowKernels()
+{
+	//Use a width which isn't a multiple of four, to also exercise the scalar tail.
+	const unsigned int width = 37;
+	const unsigned int height = 5;
+	const unsigned int border = ShadowKernels::HorizonDistance + 1;
+	const size_t stride = width + (border * 2);
+	const size_t destinationStride = width + 3;
+
+	RandomFixture random;
+	std::vector<float> heights(stride * (height + (border * 2)));
+	for (auto& value : heights) {
+		value = random.nextFloat() * 20.0f;
+	}
+	const float* pageHeights = heights.data() + (border * stride) + border;
+
+	//Search in a straight, a diagonal and an arbitrary direction, with the sun both up and down.
+	const float azimuths[] = {0.0f, 0.785398f, 2.5f};
+	const float elevations[] = {0.3f, -0.2f};
+	for (float azimuth : azimuths) {
+		const float directionX = std::cos(azimuth);
+		const float directionY = std::sin(azimuth);
+		std::vector<float> horizon(width * height);
+		ShadowKernels::calculateHorizon(pageHeights, stride, width, height, directionX, directionY, horizon.data());
+		for (unsigned int y = 0; y < height; ++y) {
+			for (unsigned int x = 0; x < width; ++x) {
+				CPPUNIT_ASSERT_EQUAL(calculateReferenceHorizon(pageHeights + (y * stride) + x, stride, directionX, directionY), horizon[(y * width) + x]);
+			}
+		}
+
+		for (float elevation : elevations) {
+			const float sunDirection[3] = {std::cos(elevation) * directionX, std::cos(elevation) * directionY, std::sin(elevation)};
+			std::vector<unsigned char> shaded(destinationStride * height, 7);
+			std::vector<unsigned char> unshadowed(destinationStride * height, 7);
+			ShadowKernels::shade(pageHeights, stride, width, height, horizon.data(), sunDirection, shaded.data(), destinationStride);
+			ShadowKernels::shade(pageHeights, stride, width, height, nullptr, sunDirection, unshadowed.data(), destinationStride);
+			for (unsigned int y = 0; y < height; ++y) {
+				for (unsigned int x = 0; x < destinationStride; ++x) {
+					size_t index = (y * destinationStride) + x;
+					if (x < width) {
+						const float* point = pageHeights + (y * stride) + x;
+						//When the sun is down everything is in shadow, and without a horizon nothing is.
+						float visibility = elevation > 0 ? calculateReferenceVisibility(sunDirection, horizon[(y * width) + x]) : 0.0f;
+						CPPUNIT_ASSERT(std::abs(shadeReferencePoint(point, stride, visibility, sunDirection) - shaded[index]) <= 1);
+						CPPUNIT_ASSERT(std::abs(shadeReferencePoint(point, stride, elevation > 0 ? 1.0f : 0.0f, sunDirection) - unshadowed[index]) <= 1);
+					} else {
+						//The padding at the end of each row must be left untouched.
+						CPPUNIT_ASSERT_EQUAL(static_cast<unsigned char>(7), shaded[index]);
+						CPPUNIT_ASSERT_EQUAL(static_cast<unsigned char>(7), unshadowed[index]);
+					}
+				}
+			}
+		}
+	}
+}
+
+}
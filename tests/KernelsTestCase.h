@@ -0,0 +1,16 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace Ember {
+	class KernelsTestCase : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(KernelsTestCase);
+		CPPUNIT_TEST(testBatchKernels);
+		CPPUNIT_TEST(testBlendMapKernels);
+		CPPUNIT_TEST(testShadowKernels);
+		CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void testBatchKernels();
+		void testBlendMapKernels();
+		void testShadowKernels();
+	};
+}
@@ -0,0 +1,143 @@
+#include "LodCacheTestCase.h"
+
+#include "components/ogre/lod/LodCache.h"
+#include "framework/osdir.h"
+
+#include <Ogre.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace Ember::OgreView::Lod;
+
+namespace Ember
+{
+
+namespace
+{
+
+std::uint64_t createKey(const std::string& meshContents, const Ogre::LodConfig& lodConfig)
+{
+	std::vector<char> buffer(meshContents.begin(), meshContents.end());
+	Ogre::MemoryDataStream stream(buffer.data(), buffer.size());
+	return LodCache::createKey(stream, lodConfig);
+}
+
+std::vector<std::string> listFiles(const std::string& directory)
+{
+	std::vector<std::string> files;
+	oslink::directory osdir(directory);
+	while (osdir) {
+		std::string name = osdir.next();
+		if (name != "." && name != "..") {
+			files.push_back(name);
+		}
+	}
+	return files;
+}
+
+LodCache::LodLevels createLevels(unsigned short indexOffset)
+{
+	LodCache::LodLevels levels;
+	levels.subMeshCount = 2;
+	levels.usages = {{10.0f, 100.0f}, {20.0f, 400.0f}};
+	for (unsigned short i = 0; i < 4; ++i) {
+		LodCache::LodLevels::Indices indices{0, i == 1, {}};
+		//Leave the second submesh of the last level empty, as happens when it's reduced away completely.
+		if (i != 3) {
+			indices.count = 6u + i;
+			for (unsigned short j = 0; j < indices.count; ++j) {
+				if (indices.is32Bit) {
+					std::uint32_t index = 70000u + j + indexOffset;
+					indices.data.insert(indices.data.end(), reinterpret_cast<char*>(&index), reinterpret_cast<char*>(&index) + sizeof(index));
+				} else {
+					std::uint16_t index = j + indexOffset;
+					indices.data.insert(indices.data.end(), reinterpret_cast<char*>(&index), reinterpret_cast<char*>(&index) + sizeof(index));
+				}
+			}
+		}
+		levels.indices.push_back(indices);
+	}
+	return levels;
+}
+
+void assertEqual(const LodCache::LodLevels& expected, const LodCache::LodLevels& actual)
+{
+	CPPUNIT_ASSERT_EQUAL(expected.subMeshCount, actual.subMeshCount);
+	CPPUNIT_ASSERT_EQUAL(expected.usages.size(), actual.usages.size());
+	for (size_t i = 0; i < expected.usages.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(expected.usages[i].userValue, actual.usages[i].userValue);
+		CPPUNIT_ASSERT_EQUAL(expected.usages[i].value, actual.usages[i].value);
+	}
+	CPPUNIT_ASSERT_EQUAL(expected.indices.size(), actual.indices.size());
+	for (size_t i = 0; i < expected.indices.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(expected.indices[i].count, actual.indices[i].count);
+		CPPUNIT_ASSERT_EQUAL(expected.indices[i].is32Bit, actual.indices[i].is32Bit);
+		CPPUNIT_ASSERT(expected.indices[i].data == actual.indices[i].data);
+	}
+}
+
+}
+
+void LodCacheTestCase::testKey()
+{
+	Ogre::LodConfig lodConfig;
+	Ogre::LodLevel level;
+	level.distance = 10.0f;
+	level.reductionMethod = Ogre::LodLevel::VRM_PROPORTIONAL;
+	level.reductionValue = 0.5f;
+	lodConfig.levels.push_back(level);
+
+	const std::uint64_t key = createKey("mesh", lodConfig);
+	CPPUNIT_ASSERT_EQUAL(key, createKey("mesh", lodConfig));
+	CPPUNIT_ASSERT(key != createKey("mesh2", lodConfig));
+
+	lodConfig.levels.back().reductionValue = 0.25f;
+	CPPUNIT_ASSERT(key != createKey("mesh", lodConfig));
+}
+
+void LodCacheTestCase::testStoreAndLoad()
+{
+	//The cache registers itself with the work queue of the root.
+	Ogre::Root root;
+
+	char directoryTemplate[] = "/tmp/ember-testlodcache-XXXXXX";
+	CPPUNIT_ASSERT(mkdtemp(directoryTemplate));
+	std::string directory(directoryTemplate);
+
+	const LodCache::LodLevels levels = createLevels(0);
+	{
+		LodCache cache(directory);
+		LodCache::LodLevels readLevels;
+		CPPUNIT_ASSERT(!cache.read("test.mesh", 1, readLevels));
+		CPPUNIT_ASSERT(cache.write("test.mesh", 1, levels));
+		CPPUNIT_ASSERT(cache.write("other.mesh", 1, createLevels(1)));
+	}
+
+	{
+		//A new cache should find the files written by the previous one, and read back exactly what was written.
+		LodCache cache(directory);
+		LodCache::LodLevels readLevels;
+		CPPUNIT_ASSERT(cache.read("test.mesh", 1, readLevels));
+		assertEqual(levels, readLevels);
+		CPPUNIT_ASSERT(!cache.read("test.mesh", 2, readLevels));
+
+		//A new key for a mesh should replace its old file, but leave the files of other meshes alone.
+		const LodCache::LodLevels newLevels = createLevels(2);
+		CPPUNIT_ASSERT(cache.write("test.mesh", 2, newLevels));
+		CPPUNIT_ASSERT_EQUAL(size_t(2), listFiles(directory).size());
+		CPPUNIT_ASSERT(!cache.read("test.mesh", 1, readLevels));
+		LodCache::LodLevels newReadLevels;
+		CPPUNIT_ASSERT(cache.read("test.mesh", 2, newReadLevels));
+		assertEqual(newLevels, newReadLevels);
+	}
+
+	for (auto& name : listFiles(directory)) {
+		std::remove((directory + "/" + name).c_str());
+	}
+	std::remove(directory.c_str());
+}
+
+}
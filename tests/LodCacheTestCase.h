@@ -0,0 +1,14 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace Ember {
+	class LodCacheTestCase : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(LodCacheTestCase);
+		CPPUNIT_TEST(testKey);
+		CPPUNIT_TEST(testStoreAndLoad);
+		CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void testKey();
+		void testStoreAndLoad();
+	};
+}
@@ -0,0 +1,80 @@
+/*
+ Copyright (C) 2018 Erik Ogenvik
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation; either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software Foundation,
+ Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef EMBER_TESTS_RANDOMFIXTURE_H_
+#define EMBER_TESTS_RANDOMFIXTURE_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace Ember
+{
+
+/**
+ * @brief Generates the random data used by the tests and benchmarks.
+ *
+ * This is a plain linear congruential generator, so that the same seed gives the same data on every platform and
+ * every run, and thus reproducible results.
+ */
+class RandomFixture
+{
+public:
+	explicit RandomFixture(unsigned int seed = 1) :
+			mSeed(seed)
+	{
+	}
+
+	/**
+	 * @brief Advances the generator.
+	 * @return All 32 bits of the new state. The low bits aren't very random, so shift them away when using only a few bits.
+	 */
+	unsigned int next()
+	{
+		mSeed = (mSeed * 1103515245u) + 12345u;
+		return mSeed;
+	}
+
+	/**
+	 * @brief Returns a float between 0 and 1, inclusive.
+	 */
+	float nextFloat()
+	{
+		return ((next() >> 16) & 0x7FFF) / 32767.0f;
+	}
+
+	unsigned char nextByte()
+	{
+		return static_cast<unsigned char>(next() >> 16);
+	}
+
+	std::vector<unsigned char> createBytes(size_t count)
+	{
+		std::vector<unsigned char> bytes(count);
+		for (auto& byte : bytes) {
+			byte = nextByte();
+		}
+		return bytes;
+	}
+
+private:
+	unsigned int mSeed;
+};
+
+}
+
+#endif /* EMBER_TESTS_RANDOMFIXTURE_H_ */
@@ -0,0 +1,96 @@
+#include "SegmentCacheTestCase.h"
+
+#include "components/ogre/terrain/SegmentCache.h"
+#include "framework/osdir.h"
+
+#include <Mercator/BasePoint.h>
+#include <Mercator/GrassShader.h>
+#include <Mercator/Segment.h>
+#include <Mercator/Surface.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace Ember::OgreView::Terrain;
+
+namespace Ember
+{
+
+namespace
+{
+
+std::vector<std::string> listFiles(const std::string& directory)
+{
+	std::vector<std::string> files;
+	oslink::directory osdir(directory);
+	while (osdir) {
+		std::string name = osdir.next();
+		if (name != "." && name != "..") {
+			files.push_back(name);
+		}
+	}
+	return files;
+}
+
+}
+
+void SegmentCacheTestCase::testPopulate()
+{
+	char directoryTemplate[] = "/tmp/ember-testsegmentcache-XXXXXX";
+	CPPUNIT_ASSERT(mkdtemp(directoryTemplate));
+	std::string directory(directoryTemplate);
+
+	Mercator::GrassShader shader;
+	Mercator::Segment segment(0, 0, 64);
+	segment.setCornerPoint(0, 0, Mercator::BasePoint(10.0f, 2.0f));
+	segment.setCornerPoint(1, 0, Mercator::BasePoint(-5.0f, 2.0f));
+	segment.setCornerPoint(0, 1, Mercator::BasePoint(20.0f, 2.0f));
+	segment.setCornerPoint(1, 1, Mercator::BasePoint(0.0f, 2.0f));
+	segment.getSurfaces()[1] = shader.newSurface(segment);
+	const std::map<int, std::uint64_t> shaderKeys{{1, 0}};
+
+	std::vector<float> heights;
+	std::vector<unsigned char> coverage;
+	{
+		SegmentCache cache(directory);
+		cache.populate(segment);
+		cache.populateSurfaces(segment, shaderKeys);
+		CPPUNIT_ASSERT_EQUAL(0ul, cache.getHitCount());
+		CPPUNIT_ASSERT_EQUAL(2ul, cache.getMissCount());
+		heights.assign(segment.getPoints(), segment.getPoints() + segment.getSize() * segment.getSize());
+		Mercator::Surface& surface = *segment.getSurfaces()[1];
+		coverage.assign(surface.getData(), surface.getData() + surface.getSize() * surface.getSize() * surface.getChannels());
+	}
+
+	{
+		//A new cache should find the files written by the previous one, and read back exactly what was written.
+		SegmentCache cache(directory);
+		segment.invalidate();
+		cache.populate(segment);
+		cache.populateSurfaces(segment, shaderKeys);
+		CPPUNIT_ASSERT_EQUAL(2ul, cache.getHitCount());
+		CPPUNIT_ASSERT_EQUAL(0ul, cache.getMissCount());
+		CPPUNIT_ASSERT(std::equal(heights.begin(), heights.end(), segment.getPoints()));
+		CPPUNIT_ASSERT(std::equal(coverage.begin(), coverage.end(), segment.getSurfaces()[1]->getData()));
+
+		//Changing a base point results in new files, which should replace the old ones.
+		segment.setCornerPoint(0, 0, Mercator::BasePoint(30.0f, 2.0f));
+		segment.invalidate();
+		cache.populate(segment);
+		cache.populateSurfaces(segment, shaderKeys);
+		CPPUNIT_ASSERT_EQUAL(2ul, cache.getMissCount());
+		CPPUNIT_ASSERT_EQUAL(size_t(2), listFiles(directory).size());
+	}
+
+	for (auto& name : listFiles(directory)) {
+		std::remove((directory + "/" + name).c_str());
+	}
+	std::remove(directory.c_str());
+}
+
+}
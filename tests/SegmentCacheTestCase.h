@@ -0,0 +1,12 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace Ember {
+	class SegmentCacheTestCase : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(SegmentCacheTestCase);
+		CPPUNIT_TEST(testPopulate);
+		CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void testPopulate();
+	};
+}
@@ -0,0 +1,75 @@
+#include "SegmentManagerTestCase.h"
+
+#include "components/ogre/terrain/SegmentManager.h"
+#include "components/ogre/terrain/Segment.h"
+
+#include <Mercator/BasePoint.h>
+#include <Mercator/Segment.h>
+#include <Mercator/Terrain.h>
+
+#include <wfmath/axisbox.h>
+#include <wfmath/point.h>
+
+using namespace Ember::OgreView::Terrain;
+
+namespace Ember
+{
+
+void SegmentManagerTestCase::testMemoryBudget()
+{
+	//A row of four segments, with only heights.
+	Mercator::Terrain terrain;
+	for (int x = 0; x <= 4; ++x) {
+		terrain.setBasePoint(x, 0, Mercator::BasePoint(10.0f));
+		terrain.setBasePoint(x, 1, Mercator::BasePoint(20.0f));
+	}
+	const size_t segmentBytes = static_cast<size_t>(terrain.getResolution() + 1) * (terrain.getResolution() + 1) * sizeof(float);
+
+	SegmentManager segmentManager(terrain, segmentBytes * 10);
+	segmentManager.syncWithTerrain();
+	//Put the focus in the first segment, which makes the last segment the first to be released.
+	segmentManager.setFocus(TerrainPosition(terrain.getResolution() / 2, terrain.getResolution() / 2));
+	auto isPopulated = [&](int x) {
+		return segmentManager.getSegmentReference(x, 0)->getMercatorSegment().isValid();
+	};
+
+	for (int x = 0; x < 4; ++x) {
+		auto segment = segmentManager.getSegmentReference(x, 0);
+		CPPUNIT_ASSERT(segment);
+		segment->getMercatorSegment().populate();
+	}
+	auto stats = segmentManager.getResidencyStats();
+	CPPUNIT_ASSERT_EQUAL(segmentBytes * 4, stats.residentBytes);
+	CPPUNIT_ASSERT_EQUAL(size_t(4), stats.unusedSegments);
+	CPPUNIT_ASSERT_EQUAL(0ul, stats.evictions);
+
+	//Segments are released until the budget is an eighth below, furthest away first.
+	segmentManager.setMemoryBudget(segmentBytes * 3);
+	stats = segmentManager.getResidencyStats();
+	CPPUNIT_ASSERT_EQUAL(segmentBytes * 2, stats.residentBytes);
+	CPPUNIT_ASSERT_EQUAL(2ul, stats.evictions);
+	CPPUNIT_ASSERT(isPopulated(0));
+	CPPUNIT_ASSERT(isPopulated(1));
+	CPPUNIT_ASSERT(!isPopulated(2));
+	CPPUNIT_ASSERT(!isPopulated(3));
+
+	//Only prefetched segments which later are used count as hits.
+	CPPUNIT_ASSERT(segmentManager.prefetchSegment(3, 0));
+	CPPUNIT_ASSERT(!segmentManager.prefetchSegment(0, 0));
+	stats = segmentManager.getResidencyStats();
+	CPPUNIT_ASSERT_EQUAL(1ul, stats.prefetches);
+	CPPUNIT_ASSERT_EQUAL(0ul, stats.prefetchHits);
+	CPPUNIT_ASSERT_EQUAL(segmentBytes * 3, stats.residentBytes);
+	CPPUNIT_ASSERT(isPopulated(3));
+	stats = segmentManager.getResidencyStats();
+	CPPUNIT_ASSERT_EQUAL(1ul, stats.prefetchHits);
+
+	//Segments which Mercator invalidates on its own are accounted for once they are measured again.
+	terrain.getSegmentAtIndex(0, 0)->invalidate();
+	segmentManager.remeasureSegments(WFMath::AxisBox<2>(WFMath::Point<2>(0, 0), WFMath::Point<2>(terrain.getResolution(), terrain.getResolution())));
+	stats = segmentManager.getResidencyStats();
+	CPPUNIT_ASSERT_EQUAL(segmentBytes * 2, stats.residentBytes);
+	CPPUNIT_ASSERT_EQUAL(size_t(2), stats.unusedSegments);
+}
+
+}
@@ -0,0 +1,12 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace Ember {
+	class SegmentManagerTestCase : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(SegmentManagerTestCase);
+		CPPUNIT_TEST(testMemoryBudget);
+		CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void testMemoryBudget();
+	};
+}
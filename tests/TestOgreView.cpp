@@ -2,10 +2,18 @@
 #include <cppunit/ui/text/TestRunner.h>
 
 #include "ConvertTestCase.h"
+#include "KernelsTestCase.h"
+#include "LodCacheTestCase.h"
 #include "ModelMountTestCase.h"
+#include "SegmentCacheTestCase.h"
+#include "SegmentManagerTestCase.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION( Ember::ConvertTestCase);
 CPPUNIT_TEST_SUITE_REGISTRATION( Ember::ModelMountTestCase );
+CPPUNIT_TEST_SUITE_REGISTRATION( Ember::LodCacheTestCase );
+CPPUNIT_TEST_SUITE_REGISTRATION( Ember::KernelsTestCase );
+CPPUNIT_TEST_SUITE_REGISTRATION( Ember::SegmentCacheTestCase );
+CPPUNIT_TEST_SUITE_REGISTRATION( Ember::SegmentManagerTestCase );
 
 int main(int argc, char **argv)
 {
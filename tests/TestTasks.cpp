@@ -8,7 +8,9 @@
 #include "framework/tasks/ITask.h"
 #include "framework/tasks/ITaskExecutionListener.h"
 #include "framework/tasks/TaskExecutionContext.h"
+#include "framework/tasks/TaskGraph.h"
 #include "framework/Exception.h"
+#include "framework/TimeFrame.h"
 
 #include <Eris/EventService.h>
 
@@ -20,6 +22,9 @@
 #include <thread>
 #include <chrono>
 #include <condition_variable>
+#include <map>
+#include <mutex>
+#include <vector>
 
 namespace Ember
 {
@@ -104,6 +109,112 @@ public:
 	}
 };
 
+class PriorityTask: public Tasks::ITask
+{
+public:
+
+	std::vector<int>& mOrder;
+	std::mutex& mOrderMutex;
+	int mId;
+	float mPriority;
+	int mSleep;
+
+	PriorityTask(std::vector<int>& order, std::mutex& orderMutex, int id, float priority, int sleep = 0)
+	: mOrder(order), mOrderMutex(orderMutex), mId(id), mPriority(priority), mSleep(sleep)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		{
+			std::unique_lock<std::mutex> lock(mOrderMutex);
+			mOrder.push_back(mId);
+		}
+		if (mSleep) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(mSleep));
+		}
+	}
+
+	float getPriority() const override {
+		return mPriority;
+	}
+
+	std::string getName() const override {
+		return "PriorityTask";
+	}
+};
+
+/**
+ * What the tasks of a graph observed. Assertions can't be made in the background threads, since any exceptions thrown there are
+ * caught by the task unit, so they are made on the main thread once the queue has been drained.
+ */
+struct GraphRecord {
+	std::mutex mutex;
+	std::map<int, std::pair<WFMath::TimeStamp, WFMath::TimeStamp>> backgroundTimes;
+	std::vector<int> mainThreadOrder;
+	/**
+	 * The number of tasks left in the graph after it has been executed, or -1 if it never was.
+	 */
+	int remainingGraphTasks = -1;
+};
+
+class GraphNodeTask: public Tasks::ITask
+{
+public:
+
+	GraphRecord& mRecord;
+	int mId;
+	int mSleep;
+
+	GraphNodeTask(GraphRecord& record, int id, int sleep)
+	: mRecord(record), mId(id), mSleep(sleep)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		auto start = WFMath::TimeStamp::now();
+		std::this_thread::sleep_for(std::chrono::milliseconds(mSleep));
+		std::unique_lock<std::mutex> lock(mRecord.mutex);
+		mRecord.backgroundTimes[mId] = std::make_pair(start, WFMath::TimeStamp::now());
+	}
+
+	bool executeTaskInMainThread() override
+	{
+		mRecord.mainThreadOrder.push_back(mId);
+		return true;
+	}
+
+	std::string getName() const override {
+		return "GraphNodeTask";
+	}
+};
+
+/**
+ * Executes a diamond shaped graph: 1 -> (2, 3) -> 4
+ */
+class DiamondGraphTask: public GraphNodeTask
+{
+public:
+
+	DiamondGraphTask(GraphRecord& record)
+	: GraphNodeTask(record, 0, 0)
+	{
+	}
+
+	void executeTaskInBackgroundThread(Tasks::TaskExecutionContext& context) override
+	{
+		Tasks::TaskGraph graph;
+		auto first = graph.addTask(new GraphNodeTask(mRecord, 1, 20));
+		auto second = graph.addTask(new GraphNodeTask(mRecord, 2, 100), {first});
+		auto third = graph.addTask(new GraphNodeTask(mRecord, 3, 100), {first});
+		graph.addTask(new GraphNodeTask(mRecord, 4, 20), {second, third});
+		context.executeTaskGraph(graph);
+		std::unique_lock<std::mutex> lock(mRecord.mutex);
+		mRecord.remainingGraphTasks = static_cast<int>(graph.size());
+	}
+};
+
 class CounterTaskBackgroundException: public CounterTask {
 public:
 	CounterTaskBackgroundException(int& counter) : CounterTask(counter) {
@@ -160,6 +271,11 @@ class TaskTestCase: public CppUnit::TestFixture
 	CPPUNIT_TEST(testBackgroundException);
 	CPPUNIT_TEST(testTaskOrder);
 	CPPUNIT_TEST(testSubTaskOrder);
+	CPPUNIT_TEST(testPriorityOrder);
+	CPPUNIT_TEST(testManyTasksManyExecs);
+	CPPUNIT_TEST(testPollProcessedTasks);
+	CPPUNIT_TEST(testTaskGraph);
+	CPPUNIT_TEST(testTaskGraphOneExec);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -301,6 +417,113 @@ public:
 		CPPUNIT_ASSERT(time1.time < time3.time);
 	}
 
+	void testPriorityOrder()
+	{
+		std::vector<int> order;
+		std::mutex orderMutex;
+		{
+			Eris::EventService es(io_service);
+			Tasks::TaskQueue taskQueue(1, es);
+			//Keep the executor busy while the other tasks are enqueued.
+			taskQueue.enqueueTask(new PriorityTask(order, orderMutex, 0, 0, 100));
+			taskQueue.enqueueTask(new PriorityTask(order, orderMutex, 1, -1));
+			taskQueue.enqueueTask(new PriorityTask(order, orderMutex, 2, -1));
+			taskQueue.enqueueTask(new PriorityTask(order, orderMutex, 3, 10));
+		}
+		CPPUNIT_ASSERT(order.size() == 4);
+		std::vector<int> lowPriority;
+		for (auto id : order) {
+			if (id != 0) {
+				lowPriority.push_back(id);
+			}
+		}
+		//The high priority task should run before the low ones, which should be run in the order they were added.
+		CPPUNIT_ASSERT(lowPriority == std::vector<int>({3, 1, 2}));
+	}
+
+	void testManyTasksManyExecs()
+	{
+		int counters[64] = {};
+		{
+			Eris::EventService es(io_service);
+			Tasks::TaskQueue taskQueue(4, es);
+			for (int i = 0; i < 64; ++i) {
+				taskQueue.enqueueTask(new CounterTask(counters[i], i % 3));
+			}
+		}
+		for (int i = 0; i < 64; ++i) {
+			CPPUNIT_ASSERT(counters[i] == 0);
+		}
+	}
+
+	void testPollProcessedTasks()
+	{
+		int counter = 0;
+		{
+			Eris::EventService es(io_service);
+			Tasks::TaskQueue taskQueue(1, es, false);
+			for (int i = 0; i < 10; ++i) {
+				taskQueue.enqueueTask(new CounterTask(counter));
+			}
+			//200 ms should be enough... This isn't deterministic though.
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			//Nothing should be posted to the event service.
+			es.processAllHandlers();
+			CPPUNIT_ASSERT(counter == 10);
+
+			//An exhausted time frame should still process one task.
+			CPPUNIT_ASSERT(taskQueue.pollProcessedTasks(TimeFrame(boost::posix_time::microseconds(0))) == 1);
+			CPPUNIT_ASSERT(counter == 9);
+
+			CPPUNIT_ASSERT(taskQueue.pollProcessedTasks(TimeFrame(boost::posix_time::seconds(10))) == 9);
+			CPPUNIT_ASSERT(counter == 0);
+			CPPUNIT_ASSERT(taskQueue.getMainThreadStatistics().lastPollTaskCount == 9);
+			CPPUNIT_ASSERT(taskQueue.getMainThreadStatistics().totalTaskCount == 10);
+		}
+	}
+
+	void assertDiamondGraphOrder(GraphRecord& record)
+	{
+		//All tasks of the graph should have been handed over to the owning task.
+		CPPUNIT_ASSERT(record.remainingGraphTasks == 0);
+		CPPUNIT_ASSERT(record.backgroundTimes.size() == 4);
+		//2 and 3 must start after 1 has ended, and 4 must start after both have ended.
+		CPPUNIT_ASSERT(record.backgroundTimes[1].second < record.backgroundTimes[2].first);
+		CPPUNIT_ASSERT(record.backgroundTimes[1].second < record.backgroundTimes[3].first);
+		CPPUNIT_ASSERT(record.backgroundTimes[2].second < record.backgroundTimes[4].first);
+		CPPUNIT_ASSERT(record.backgroundTimes[3].second < record.backgroundTimes[4].first);
+		//In the main thread the tasks should be executed in the order they were added, before the owning task.
+		CPPUNIT_ASSERT(record.mainThreadOrder == std::vector<int>({1, 2, 3, 4, 0}));
+	}
+
+	void testTaskGraph()
+	{
+		GraphRecord record;
+		{
+			Eris::EventService es(io_service);
+			Tasks::TaskQueue taskQueue(4, es);
+			taskQueue.enqueueTask(new DiamondGraphTask(record));
+			//Wait for the graph to complete, since the other executors will exit as soon as the queue is shut down.
+			//500 ms should be enough... This isn't deterministic though.
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+		assertDiamondGraphOrder(record);
+		//With more than one executor 2 and 3 should run concurrently.
+		CPPUNIT_ASSERT(record.backgroundTimes[2].first < record.backgroundTimes[3].second);
+		CPPUNIT_ASSERT(record.backgroundTimes[3].first < record.backgroundTimes[2].second);
+	}
+
+	void testTaskGraphOneExec()
+	{
+		GraphRecord record;
+		{
+			Eris::EventService es(io_service);
+			Tasks::TaskQueue taskQueue(1, es);
+			taskQueue.enqueueTask(new DiamondGraphTask(record));
+		}
+		assertDiamondGraphOrder(record);
+	}
+
 
 };
 
@@ -69,13 +69,17 @@ class DummyTerrainTechnique : public TerrainPageSurfaceCompilerTechnique
     	return false;
     }
 
+	virtual size_t getUploadedTextureBytes() const
+	{
+		return 0;
+	}
 
 };
 
 class DummyCompilerTechniqueProvider: public ICompilerTechniqueProvider
 {
 public:
-	virtual TerrainPageSurfaceCompilerTechnique* createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow) const
+	virtual TerrainPageSurfaceCompilerTechnique* createTechnique(const TerrainPageGeometryPtr& geometry, const SurfaceLayerStore& terrainPageSurfaces, const TerrainPageShadow* terrainPageShadow, const AreaStore& dirtyAreas, BlendMapContentStore& blendMapContents) const
 	{
 		return new DummyTerrainTechnique();
 	}